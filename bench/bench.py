@@ -0,0 +1,207 @@
+"""
+Benchmarks BPlusSet against the builtin set and dict.
+
+Each operation is timed for every combination of size, key type and (for
+BPlusSet) b, keeping the best of a few repeats, and the results are written
+to a JSON file that bench/compare.py can compare against an earlier run:
+
+    python bench/bench.py --out before.json
+    python bench/bench.py --out after.json
+    python bench/compare.py before.json after.json
+"""
+import argparse
+import gc
+import json
+import os
+import platform
+import random
+import subprocess
+import sys
+import time
+
+from five_one_one_bplus import BPlusSet
+
+SEED = 511
+DEFAULT_SIZES = [10**3, 10**4, 10**5, 10**6]
+DEFAULT_BS = [8, 16, 64, 255]
+OPS = ["construct", "add", "contains_hit", "contains_miss", "iterate", "equal", "teardown"]
+
+
+class Colliding:
+    """
+    An element whose hash is shared with 15 others, so that every lookup has
+    to compare elements as well as hashes.
+    """
+
+    __slots__ = ("x",)
+
+    def __init__(self, x):
+        self.x = x
+
+    def __hash__(self):
+        return self.x >> 4
+
+    def __eq__(self, other):
+        return isinstance(other, Colliding) and self.x == other.x
+
+    def __lt__(self, other):
+        return self.x < other.x
+
+
+def randostr(rng):
+    return "".join([chr(rng.randint(ord("A"), ord("Z"))) for _ in range(32)])
+
+
+# each key type makes {n} distinct keys from {rng}, and {n} more that are not
+# among them, for the misses
+def ints(n, rng):
+    keys = rng.sample(range(1 << 62), 2*n)
+    return keys[:n], keys[n:]
+
+def sequential_ints(n, rng):
+    return list(range(n)), list(range(n, 2*n))
+
+def strs(n, rng):
+    keys = list({randostr(rng) for _ in range(2*n + 16)})[:2*n]
+    return keys[:n], keys[n:]
+
+def tuples(n, rng):
+    keys, misses = ints(n, rng)
+    return [(x, x & 0xffff) for x in keys], [(x, x & 0xffff) for x in misses]
+
+def colliding(n, rng):
+    keys, misses = sequential_ints(n, rng)
+    return [Colliding(x) for x in keys], [Colliding(x) for x in misses]
+
+KEY_TYPES = {
+    "ints": ints,
+    "sequential_ints": sequential_ints,
+    "strs": strs,
+    "tuples": tuples,
+    "colliding": colliding,
+}
+
+
+# each implementation makes a container of {keys}, and an empty one to add to
+IMPLS = {
+    "BPlusSet": (lambda keys, b: BPlusSet(keys, b=b), lambda b: BPlusSet(b=b)),
+    "set": (lambda keys, b: set(keys), lambda b: set()),
+    "dict": (lambda keys, b: dict.fromkeys(keys), lambda b: {}),
+}
+
+
+def add_all(c, keys):
+    if isinstance(c, dict):
+        for x in keys:
+            c[x] = None
+    else:
+        add = c.add
+        for x in keys:
+            add(x)
+
+def time_op(op, impl, keys, misses, b):
+    """
+    Returns the seconds {op} took once on a container of {keys} made by
+    {impl}; only the operation itself is timed.
+    """
+    make, make_empty = IMPLS[impl]
+    if op == "construct":
+        start = time.perf_counter()
+        c = make(keys, b)
+        return time.perf_counter() - start
+    if op == "add":
+        c = make_empty(b)
+        start = time.perf_counter()
+        add_all(c, keys)
+        return time.perf_counter() - start
+    c = make(keys, b)
+    if op == "contains_hit" or op == "contains_miss":
+        probes = keys if op == "contains_hit" else misses
+        start = time.perf_counter()
+        for x in probes:
+            x in c
+        return time.perf_counter() - start
+    if op == "iterate":
+        start = time.perf_counter()
+        for x in c:
+            pass
+        return time.perf_counter() - start
+    if op == "equal":
+        other = make(keys, b)
+        start = time.perf_counter()
+        c == other
+        return time.perf_counter() - start
+    if op == "teardown":
+        start = time.perf_counter()
+        del c
+        return time.perf_counter() - start
+    raise ValueError(f"unknown op {op!r}")
+
+
+def git_revision():
+    try:
+        return subprocess.run(
+            ["git", "rev-parse", "--short", "HEAD"],
+            capture_output=True, text=True, check=True,
+            cwd=os.path.dirname(os.path.abspath(__file__)),
+        ).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def run(sizes, bs, key_types, impls, ops, repeat, quiet=False):
+    results = []
+    for key_type in key_types:
+        for n in sizes:
+            keys, misses = KEY_TYPES[key_type](n, random.Random(SEED))
+            for impl in impls:
+                for b in (bs if impl == "BPlusSet" else [None]):
+                    for op in ops:
+                        # the best of {repeat} runs, with the collector
+                        # kept out of the timings
+                        best = float("inf")
+                        for _ in range(repeat):
+                            gc.collect()
+                            gc.disable()
+                            try:
+                                best = min(best, time_op(op, impl, keys, misses, b))
+                            finally:
+                                gc.enable()
+                        results.append({
+                            "impl": impl, "op": op, "key": key_type,
+                            "n": n, "b": b, "seconds": best,
+                        })
+                        if not quiet:
+                            print(f"{impl:>8} {op:>13} {key_type:>15} n={n:<10} b={str(b):<4} {best:.6f}s", flush=True)
+            del keys, misses
+    return results
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--out", default="bench.json", help="the JSON file to write the results to")
+    parser.add_argument("--sizes", type=int, nargs="+", default=DEFAULT_SIZES, help="the numbers of keys to sweep over (up to 10**8 is supported, memory allowing)")
+    parser.add_argument("--b", type=int, nargs="+", default=DEFAULT_BS, dest="bs", help="the values of b to sweep BPlusSet over")
+    parser.add_argument("--keys", nargs="+", default=list(KEY_TYPES), choices=list(KEY_TYPES), help="the key types to sweep over")
+    parser.add_argument("--impls", nargs="+", default=list(IMPLS), choices=list(IMPLS), help="the containers to time")
+    parser.add_argument("--ops", nargs="+", default=OPS, choices=OPS, help="the operations to time")
+    parser.add_argument("--repeat", type=int, default=3, help="the best of this many runs of each operation is kept")
+    parser.add_argument("--quiet", action="store_true", help="only write the JSON file")
+    args = parser.parse_args(argv)
+
+    results = run(args.sizes, args.bs, args.keys, args.impls, args.ops, args.repeat, args.quiet)
+    meta = {
+        "python": sys.version,
+        "platform": platform.platform(),
+        "machine": platform.machine(),
+        "revision": git_revision(),
+        "time": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+        "repeat": args.repeat,
+    }
+    with open(args.out, "w") as f:
+        json.dump({"meta": meta, "results": results}, f, indent=1)
+    print(f"wrote {len(results)} results to {args.out}")
+
+
+if __name__ == "__main__":
+    main()
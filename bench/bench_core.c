@@ -0,0 +1,348 @@
+// Microbenchmarks of the CPython-independent core of the tree (bpluscore.c and
+// array32.c), built without the interpreter so that node layout work can be
+// measured without its noise:
+//
+//     make bench-core BENCH_CORE_ARGS="-n 1000000 -n 10000000 -b 16 -b 64"
+//
+// For each size {n} and each {b}, times:
+//  1. "load": laying out a tree from {n} sorted keys (BPlusBuild_*()).
+//  2. "descent": BPlusNode_search() and BPlusLeaf_bisect_left() of every key,
+//      in random order.
+//  3. "scan": a walk of the leaf chain reading every key.
+//  4. "insert": inserting every key in random order into an empty tree,
+//      splitting leaves and branches as they fill.
+// and reports nanoseconds per key and, where the kernel allows it (see
+// perf_event_open(2) and /proc/sys/kernel/perf_event_paranoid), cycles,
+// instructions and cache misses per key. The value slots of the trees are
+// left empty.
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "bpluscore.h"
+#include "array32.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define BENCH_PERF 1
+#endif
+
+
+// the hardware counters read around each benchmark
+#define BENCH_NCOUNTERS 3
+static const char *counter_names[BENCH_NCOUNTERS] = {"cycles", "instr", "misses"};
+
+typedef struct Counters {
+    double seconds;
+    long long values[BENCH_NCOUNTERS];
+    int ok;
+} Counters;
+
+// the perf event group: {fds}[0] leads, or is -1 if counters are unavailable
+static int fds[BENCH_NCOUNTERS] = {-1, -1, -1};
+static struct timespec started;
+
+
+// opens the counters once; if any of them cannot be opened, only times are
+// reported.
+static void counters_open(void) {
+
+    #ifdef BENCH_PERF
+    unsigned long long configs[BENCH_NCOUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+    };
+    struct perf_event_attr attr;
+
+    for (int ix = 0; ix < BENCH_NCOUNTERS; ix++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[ix];
+        attr.disabled = ix == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        fds[ix] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, ix == 0 ? -1 : fds[0], 0);
+        if (fds[ix] == -1) {
+            for (int jx = 0; jx < ix; jx++) {
+                close(fds[jx]);
+                fds[jx] = -1;
+            }
+            return;
+        }
+    }
+    #endif
+
+}
+
+static void counters_start(void) {
+
+    #ifdef BENCH_PERF
+    if (fds[0] != -1) {
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    #endif
+
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+}
+
+static void counters_stop(Counters *out) {
+
+    struct timespec stopped;
+
+    clock_gettime(CLOCK_MONOTONIC, &stopped);
+    out->seconds = (double)(stopped.tv_sec - started.tv_sec) + (stopped.tv_nsec - started.tv_nsec) / 1e9;
+    out->ok = 0;
+
+    #ifdef BENCH_PERF
+    // with PERF_FORMAT_GROUP, a read gives the number of counters followed by
+    // their values
+    long long group[1 + BENCH_NCOUNTERS];
+    if (fds[0] != -1) {
+        ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        if (read(fds[0], group, sizeof(group)) == (ssize_t)sizeof(group)) {
+            memcpy(out->values, group + 1, sizeof(out->values));
+            out->ok = 1;
+        }
+    }
+    #endif
+
+}
+
+static void report(const char *name, int n, int b, Counters *c) {
+
+    printf("%-8s n=%-10d b=%-4d %8.2f ns", name, n, b, c->seconds * 1e9 / n);
+    for (int ix = 0; ix < BENCH_NCOUNTERS; ix++) {
+        if (c->ok) {
+            printf("  %8.2f %s", (double)c->values[ix] / n, counter_names[ix]);
+        } else {
+            printf("  %8s %s", "-", counter_names[ix]);
+        }
+    }
+    printf("\n");
+
+}
+
+
+// splitmix64, so runs are repeatable without depending on rand()
+static uint64_t next_random(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// fills {sorted} with {n} distinct sorted keys, and {shuffled} with the same
+// keys in random order.
+static void make_keys(l64 *sorted, l64 *shuffled, int n) {
+
+    uint64_t state = 511;
+    l64 *scratch = (l64 *)malloc(sizeof(l64) * n), tmp;
+    int m = 0, ix, jx;
+
+    // draw until there are {n} distinct keys; collisions in 64 bits are rare
+    while (m < n) {
+        for (ix = m; ix < n; ix++) {
+            sorted[ix] = (l64)next_random(&state);
+        }
+        sort_keyed(sorted, scratch, n, sizeof(l64));
+        for (ix = 1, m = 1; ix < n; ix++) {
+            if (sorted[ix] != sorted[m-1]) {
+                sorted[m++] = sorted[ix];
+            }
+        }
+    }
+    free(scratch);
+
+    memcpy(shuffled, sorted, sizeof(l64) * n);
+    for (ix = n - 1; ix > 0; ix--) {
+        jx = (int)(next_random(&state) % (uint64_t)(ix + 1));
+        tmp = shuffled[ix];
+        shuffled[ix] = shuffled[jx];
+        shuffled[jx] = tmp;
+    }
+
+}
+
+// inserts {key} into the tree at {*root}, splitting as BPlusTree_insert()
+// does for an uncompressed tree.
+// Returns 0 on success, -1 if out of memory.
+static int insert(BPlusHeap *heap, BPlusNode **root, int b, l64 key, BPlusPath *path) {
+
+    BPlusNode *leaf, *left, *right, *spares;
+    int ix, size, mid;
+
+    if ((leaf = BPlusNode_search(*root, key, path)) == NULL) {
+        return -1;
+    }
+
+    ix = BPlusLeaf_bisect_left(leaf, key);
+    if (ix < leaf->indices->size && BPlusLeaf_key(leaf, ix) == key) {
+        return 0;
+    }
+
+    BPlusLeaf_insert_key(leaf, ix, key);
+    insert_pointer(leaf->values, ix, NULL);
+
+    if (leaf->values->size > b) {
+        size = leaf->values->size;
+        mid = size / 2;
+        if (BPlusBranch_init_spares(heap, b, path, &spares) == -1) {
+            return -1;
+        }
+        left = BPlusLeaf_init(heap, b);
+        right = BPlusLeaf_init(heap, b);
+        if (left == NULL || right == NULL) {
+            return -1;
+        }
+        BPlusLeaf_set_keys(left, (l64 *)leaf->indices->arr, mid, 0);
+        BPlusLeaf_set_keys(right, ((l64 *)leaf->indices->arr)+mid, size - mid, 0);
+        BPlusNode_split_up(heap, root, b, path, spares, left, right, BPlusLeaf_split_at(heap, leaf, left, right));
+    }
+
+    return 0;
+
+}
+
+static int run(int n, int b, l64 *sorted, l64 *shuffled) {
+
+    BPlusBuild build;
+    BPlusNode *root, *leaf;
+    BPlusPath path;
+    BPlusHeap heap = {0};
+    Counters c;
+    volatile l64 sink = 0;
+    l64 sum = 0;
+    int ix;
+
+    // load
+    counters_start();
+    if (BPlusBuild_init(&build, b, 0, sorted, NULL, n, 1.0, 1) == -1) {
+        return -1;
+    }
+    for (ix = 0; ix < build.ntasks; ix++) {
+        BPlusBuild_leaves(&build, ix);
+    }
+    root = BPlusBuild_finish(&build);
+    counters_stop(&c);
+    report("load", n, b, &c);
+
+    // descent
+    counters_start();
+    for (ix = 0; ix < n; ix++) {
+        leaf = BPlusNode_search(root, shuffled[ix], NULL);
+        sum += BPlusLeaf_bisect_left(leaf, shuffled[ix]);
+    }
+    counters_stop(&c);
+    sink = sum;
+    report("descent", n, b, &c);
+
+    // scan
+    leaf = root;
+    while (leaf->children != NULL) leaf = ((BPlusNode **)leaf->children->arr)[0];
+    counters_start();
+    for (sum = 0; leaf != NULL; leaf = leaf->next) {
+        for (ix = 0; ix < leaf->indices->size; ix++) {
+            sum += BPlusLeaf_key(leaf, ix);
+        }
+    }
+    counters_stop(&c);
+    sink = sum;
+    report("scan", n, b, &c);
+
+    // every node of the loaded tree lives in its arena
+    BPlusHeap_allocator.free(build.mem);
+
+    // insert
+    BPlusPath_init(&path);
+    if ((root = BPlusLeaf_init(&heap, b)) == NULL) {
+        return -1;
+    }
+    counters_start();
+    for (ix = 0; ix < n; ix++) {
+        if (insert(&heap, &root, b, shuffled[ix], &path) == -1) {
+            return -1;
+        }
+    }
+    counters_stop(&c);
+    report("insert", n, b, &c);
+    BPlusPath_free(&path);
+    BPlusNode_free_tree(&heap, root);
+
+    (void)sink;
+    return 0;
+
+}
+
+int main(int argc, char **argv) {
+
+    int sizes[64], nsizes = 0, bs[64], nbs = 0, max_n = 0;
+    l64 *sorted, *shuffled;
+
+    for (int ix = 1; ix < argc; ix++) {
+        if (strcmp(argv[ix], "-n") == 0 && ix + 1 < argc && nsizes < 64) {
+            sizes[nsizes++] = atoi(argv[++ix]);
+        } else if (strcmp(argv[ix], "-b") == 0 && ix + 1 < argc && nbs < 64) {
+            bs[nbs++] = atoi(argv[++ix]);
+        } else {
+            fprintf(stderr, "usage: %s [-n size]... [-b b]...\n", argv[0]);
+            return 2;
+        }
+    }
+    if (nsizes == 0) {
+        sizes[nsizes++] = 100000;
+        sizes[nsizes++] = 1000000;
+    }
+    if (nbs == 0) {
+        bs[nbs++] = 16;
+        bs[nbs++] = 64;
+    }
+
+    for (int ix = 0; ix < nsizes; ix++) {
+        if (sizes[ix] < 1) {
+            fprintf(stderr, "sizes must be at least 1\n");
+            return 2;
+        }
+        if (sizes[ix] > max_n) max_n = sizes[ix];
+    }
+    for (int ix = 0; ix < nbs; ix++) {
+        if (bs[ix] < 2 || 255 < bs[ix]) {
+            fprintf(stderr, "b must be in [2, 255]\n");
+            return 2;
+        }
+    }
+
+    sorted = (l64 *)malloc(sizeof(l64) * max_n);
+    shuffled = (l64 *)malloc(sizeof(l64) * max_n);
+    if (sorted == NULL || shuffled == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    counters_open();
+    if (fds[0] == -1) {
+        printf("hardware counters unavailable, reporting times only\n");
+    }
+
+    for (int ix = 0; ix < nsizes; ix++) {
+        make_keys(sorted, shuffled, sizes[ix]);
+        for (int jx = 0; jx < nbs; jx++) {
+            if (run(sizes[ix], bs[jx], sorted, shuffled) == -1) {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+        }
+    }
+
+    free(sorted);
+    free(shuffled);
+
+    return 0;
+
+}
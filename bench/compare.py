@@ -0,0 +1,66 @@
+"""
+Compares two result files written by bench/bench.py.
+
+For every benchmark found in both files, prints the time of each and their
+ratio (new / old), and marks those that got slower by more than
+{--threshold}. Exits with status 1 if any did, so that a regression between
+two versions can fail a build:
+
+    python bench/compare.py before.json after.json --threshold 0.1
+"""
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    return data.get("meta", {}), {
+        (r["impl"], r["op"], r["key"], r["n"], r["b"]): r["seconds"]
+        for r in data["results"]
+    }
+
+
+def compare(old, new, threshold, impls=None):
+    """
+    Returns a list of (key, old seconds, new seconds, ratio, regressed) for
+    every benchmark in both {old} and {new}, sorted by key.
+    """
+    rows = []
+    for key in sorted(old.keys() & new.keys(), key=lambda k: tuple(str(x) for x in k)):
+        if impls is not None and key[0] not in impls:
+            continue
+        ratio = new[key] / old[key] if old[key] > 0 else float("inf")
+        rows.append((key, old[key], new[key], ratio, ratio > 1 + threshold))
+    return rows
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("old", help="results of the baseline run")
+    parser.add_argument("new", help="results of the run to check")
+    parser.add_argument("--threshold", type=float, default=0.1, help="the fraction a benchmark may slow down by before it counts as a regression")
+    parser.add_argument("--impls", nargs="+", default=["BPlusSet"], help="the containers to compare (the builtins only show noise between runs)")
+    parser.add_argument("--all", action="store_true", help="print every benchmark, not just the regressions")
+    args = parser.parse_args(argv)
+
+    old_meta, old = load(args.old)
+    new_meta, new = load(args.new)
+    rows = compare(old, new, args.threshold, set(args.impls))
+
+    print(f"old: {old_meta.get('revision')} {old_meta.get('time')}")
+    print(f"new: {new_meta.get('revision')} {new_meta.get('time')}")
+    regressions = 0
+    for (impl, op, key, n, b), t_old, t_new, ratio, regressed in rows:
+        regressions += regressed
+        if regressed or args.all:
+            mark = "REGRESSED" if regressed else ""
+            print(f"{impl:>8} {op:>13} {key:>15} n={n:<10} b={str(b):<4} {t_old:.6f}s -> {t_new:.6f}s x{ratio:.2f} {mark}")
+    print(f"{len(rows)} benchmarks compared, {regressions} regressed by more than {args.threshold:.0%}")
+
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
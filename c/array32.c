@@ -1,9 +1,12 @@
 // Definition of array type and helper methods related to it.
-#include <Python.h>
-#include "bplustypes.h"
-#include "general.h"
+#include "bpluscore.h"
 #include "array32.h"
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define ARRAY32_SSE2 1
+#endif
+
 
 // basically ripped from the Python bisect module
 // {a} is an array of {l64} assumed to be in sorted order.
@@ -53,48 +56,258 @@ int bisect_right(Array32 *a, l64 x) {
 
 }
 
-// convenience method for inserting {x} into an array of {l64} at {index}.
-int insert_l64(Array32 *a, int index, l64 x) {
-    l64 *arr = (l64 *)a->arr;
-    for (int i = a->size - 1; i >= index; i--) {
-        arr[i+1] = arr[i];
-    }
-    arr[index] = x;
-    a->size++;
+// moves the elements of {a}, which are {width} bytes each, to the middle of
+// its buffer so that there are free slots on both sides of them.
+static void recenter(Array32 *a, int width) {
+    char *buffer = (char *)a->arr - (size_t)width * a->head;
+    int head = (a->capacity - a->size) / 2;
 
-    return 1;
+    memmove(buffer + (size_t)width * head, a->arr, (size_t)width * a->size);
+    a->arr = buffer + (size_t)width * head;
+    a->head = head;
 }
 
-// convenience method for inserting {x} into an array of {PyObject *} at {index}.
-int insert_PyObject(Array32 *a, int index, PyObject *x) {
-    PyObject **arr = (PyObject **)a->arr;
-    for (int i = a->size - 1; i >= index; i--) {
-        arr[i+1] = arr[i];
+// opens a one element gap at {index} in {a}, an array of {width}-byte
+// elements, and returns a pointer to it.
+// Whichever side of {index} is shorter is shifted towards its end of the
+// buffer, so an insert moves at most half of the elements. If that end has no
+// room left but the other end has plenty, the elements are re-centered first.
+// Assumes {a} is not full.
+static char *open_gap(Array32 *a, int index, int width) {
+
+    int front = index < a->size - index,
+        tail = a->capacity - a->head - a->size;
+    char *arr;
+
+    if ((front && a->head == 0 && tail > 1) || (!front && tail == 0 && a->head > 1)) {
+        recenter(a, width);
+        tail = a->capacity - a->head - a->size;
+    }
+
+    arr = (char *)a->arr;
+    if (a->head > 0 && (front || tail == 0)) {
+        // shift the elements before {index} one slot towards the front
+        memmove(arr - width, arr, (size_t)width * index);
+        a->arr = arr - width;
+        a->head--;
+    } else {
+        // shift the elements from {index} on one slot towards the back
+        memmove(arr + (size_t)width * (index+1), arr + (size_t)width * index, (size_t)width * (a->size - index));
     }
-    arr[index] = x;
     a->size++;
-    
-    #if DEBUG >= 2
-    printRefCount("insert_PyObject(): x before Py_INCREF:", x);
-    #endif
 
-    Py_INCREF(x);
+    return (char *)a->arr + (size_t)width * index;
 
-    #if DEBUG >= 2
-    printRefCount("insert_PyObject(): x after Py_INCREF:", x);
-    #endif
+}
+
+// sets {a}, an array of {width}-byte elements, to hold {n} elements centered
+// in its buffer.
+// The contents of the {n} elements are left to the caller to fill in through
+// {a->arr}.
+void place_array(Array32 *a, int n, int width) {
+    char *buffer = (char *)a->arr - (size_t)width * a->head;
+
+    a->head = (a->capacity - n) / 2;
+    a->arr = buffer + (size_t)width * a->head;
+    a->size = n;
+}
+
+// convenience method for inserting {x} into an array of {l64} at {index}.
+int insert_l64(Array32 *a, int index, l64 x) {
+    *(l64 *)open_gap(a, index, sizeof(l64)) = x;
+
+    return 1;
+}
+
+// convenience method for inserting {x} into an array of pointers (such as the
+// value slots of a leaf) at {index}.
+int insert_pointer(Array32 *a, int index, void *x) {
+    *(void **)open_gap(a, index, sizeof(void *)) = x;
 
     return 1;
 }
 
 // convenience method for inserting {x} into an array of {BPlusNode *} at {index}.
 int insert_BPlusNode(Array32 *a, int index, BPlusNode *x) {
-    BPlusNode **arr = (BPlusNode **)a->arr;
-    for (int i = a->size - 1; i >= index; i--) {
-        arr[i+1] = arr[i];
+    *(BPlusNode **)open_gap(a, index, sizeof(BPlusNode *)) = x;
+
+    return 1;
+}
+
+// returns the number of bytes (1, 2, 4 or 8) needed to store unsigned offsets
+// no larger than {range}.
+int packed_width(unsigned long long range) {
+    if (range <= 0xffULL) {
+        return 1;
+    } else if (range <= 0xffffULL) {
+        return 2;
+    } else if (range <= 0xffffffffULL) {
+        return 4;
     }
-    arr[index] = x;
-    a->size++;
+    return 8;
+}
+
+// returns the largest offset that can be stored in {width} bytes
+unsigned long long packed_max(int width) {
+    if (width >= 8) {
+        return ~0ULL;
+    }
+    return (1ULL << (8 * width)) - 1;
+}
+
+// returns the offset at {index} in {a}, an array of {width}-byte offsets.
+unsigned long long get_packed(Array32 *a, int width, int index) {
+    switch (width) {
+        case 1:
+            return ((unsigned char *)a->arr)[index];
+        case 2:
+            return ((unsigned short *)a->arr)[index];
+        case 4:
+            return ((unsigned int *)a->arr)[index];
+        default:
+            return ((unsigned long long *)a->arr)[index];
+    }
+}
+
+// stores offset {x} at {index} in {a}, an array of {width}-byte offsets.
+void set_packed(Array32 *a, int width, int index, unsigned long long x) {
+    switch (width) {
+        case 1:
+            ((unsigned char *)a->arr)[index] = (unsigned char)x;
+            break;
+        case 2:
+            ((unsigned short *)a->arr)[index] = (unsigned short)x;
+            break;
+        case 4:
+            ((unsigned int *)a->arr)[index] = (unsigned int)x;
+            break;
+        default:
+            ((unsigned long long *)a->arr)[index] = x;
+            break;
+    }
+}
+
+// {a} is an array of {width}-byte unsigned offsets assumed to be in sorted
+// order.
+// Returns the number of offsets less than {t}, which (because {a} is sorted)
+// is the leftmost index at which {t} can be inserted, as with bisect_left().
+// The offsets are compared 16 bytes at a time when SSE2 is available; since
+// {a} holds at most a few hundred bytes this beats a branchy binary search.
+int count_less_packed(Array32 *a, int width, unsigned long long t) {
+
+    int i = 0, count = 0, n = a->size;
+
+    #ifdef ARRAY32_SSE2
+    if (width == 1) {
+        const unsigned char *arr = (const unsigned char *)a->arr;
+        __m128i bias = _mm_set1_epi8((char)0x80);
+        __m128i vt = _mm_xor_si128(_mm_set1_epi8((char)t), bias);
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(arr + i)), bias);
+            count += __builtin_popcount(_mm_movemask_epi8(_mm_cmplt_epi8(v, vt)));
+        }
+    } else if (width == 2) {
+        const unsigned short *arr = (const unsigned short *)a->arr;
+        __m128i bias = _mm_set1_epi16((short)0x8000);
+        __m128i vt = _mm_xor_si128(_mm_set1_epi16((short)t), bias);
+        for (; i + 8 <= n; i += 8) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(arr + i)), bias);
+            // each 16 bit lane sets 2 bits of the mask
+            count += __builtin_popcount(_mm_movemask_epi8(_mm_cmplt_epi16(v, vt))) / 2;
+        }
+    } else if (width == 4) {
+        const unsigned int *arr = (const unsigned int *)a->arr;
+        __m128i bias = _mm_set1_epi32((int)0x80000000);
+        __m128i vt = _mm_xor_si128(_mm_set1_epi32((int)t), bias);
+        for (; i + 4 <= n; i += 4) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(arr + i)), bias);
+            // each 32 bit lane sets 4 bits of the mask
+            count += __builtin_popcount(_mm_movemask_epi8(_mm_cmplt_epi32(v, vt))) / 4;
+        }
+    }
+    #endif
+
+    for (; i < n; i++) {
+        count += get_packed(a, width, i) < t;
+    }
+
+    return count;
+
+}
+
+// sorts the {n} elements of {a} by hash, in ascending order, using {scratch}
+// (which has room for {n} more) as working space.
+// Each element is {width} bytes and starts with its {l64} hash: {a} is either
+// an array of {l64} ({width} of 8) or of {BPlusPair} ({width} of 16). Elements
+// with equal hashes are left in no particular order.
+// This is a least significant byte first radix sort. Passes over bytes that
+// every hash has in common are skipped, so hashes drawn from a narrow range
+// only take a pass or two.
+// No Python objects are touched, so this may run without the GIL.
+void sort_keyed(void *a, void *scratch, ptrdiff_t n, int width) {
+
+    // laid out like a {BPlusPair}, without needing its {PyObject}
+    typedef struct { l64 key; void *value; } keyed;
+    // counts[d][v] is the number of hashes whose byte {d} is {v}
+    ptrdiff_t counts[8][256], offset;
+    unsigned long long x;
+    char *src = (char *)a, *dst = (char *)scratch, *tmp;
+
+    if (n < 2) {
+        return;
+    }
+
+    memset(counts, 0, sizeof(counts));
+    for (ptrdiff_t ix = 0; ix < n; ix++) {
+        // flip the sign bit so that negative hashes sort first
+        x = (unsigned long long)*(l64 *)(src + ix * width) ^ (1ULL << 63);
+        for (int d = 0; d < 8; d++) {
+            counts[d][(x >> (8 * d)) & 0xff]++;
+        }
+    }
+
+    for (int d = 0; d < 8; d++) {
+
+        x = (unsigned long long)*(l64 *)src ^ (1ULL << 63);
+        if (counts[d][(x >> (8 * d)) & 0xff] == n) {
+            continue;
+        }
+
+        // turn the counts into the offset of the first hash with each byte
+        offset = 0;
+        for (int v = 0; v < 256; v++) {
+            ptrdiff_t count = counts[d][v];
+            counts[d][v] = offset;
+            offset += count;
+        }
+
+        for (ptrdiff_t ix = 0; ix < n; ix++) {
+            x = (unsigned long long)*(l64 *)(src + ix * width) ^ (1ULL << 63);
+            offset = counts[d][(x >> (8 * d)) & 0xff]++;
+            if (width == sizeof(l64)) {
+                ((l64 *)dst)[offset] = ((l64 *)src)[ix];
+            } else {
+                ((keyed *)dst)[offset] = ((keyed *)src)[ix];
+            }
+        }
+
+        tmp = src;
+        src = dst;
+        dst = tmp;
+
+    }
+
+    if (src != (char *)a) {
+        memcpy(a, src, (size_t)width * n);
+    }
+
+}
+
+// convenience method for inserting offset {x} into an array of {width}-byte
+// offsets at {index}.
+int insert_packed(Array32 *a, int width, int index, unsigned long long x) {
+    open_gap(a, index, width);
+    set_packed(a, width, index, x);
 
     return 1;
 }
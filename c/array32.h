@@ -1,21 +1,28 @@
 // Definition of array type and helper methods related to it.
+// Like bpluscore.h, this does not need Python.h.
 // See array32.c for documentation on the methods declared in this file.
 
 #ifndef ARRAY32_H
 #define ARRAY32_H
 
 
-#include <Python.h>
-#include "bplustypes.h"
-#include "general.h"
+#include "bpluscore.h"
 
 
 // BEGIN Array32 helper function headers
 int bisect_left(Array32 *a, l64 x);
 int bisect_right(Array32 *a, l64 x);
+void place_array(Array32 *a, int n, int width);
 int insert_l64(Array32 *a, int index, l64 x);
-int insert_PyObject(Array32 *a, int index, PyObject *x);
+int insert_pointer(Array32 *a, int index, void *x);
 int insert_BPlusNode(Array32 *a, int index, BPlusNode *x);
+int packed_width(unsigned long long range);
+unsigned long long packed_max(int width);
+unsigned long long get_packed(Array32 *a, int width, int index);
+void set_packed(Array32 *a, int width, int index, unsigned long long x);
+int count_less_packed(Array32 *a, int width, unsigned long long t);
+int insert_packed(Array32 *a, int width, int index, unsigned long long x);
+void sort_keyed(void *a, void *scratch, ptrdiff_t n, int width);
 
 
 #endif
@@ -0,0 +1,87 @@
+// The C API of five_one_one_bplus.c, for use by other C extensions.
+// PyInit_c() in bplustree.c exports a {BPlusCAPI} of function pointers in a
+// capsule, so that other extensions can drive a BPlusTree directly at the
+// cost of a C call, passing in hashes they have already computed, without
+// going through method lookup and argument parsing.
+//
+// To use it, copy this header into your extension and, once the GIL is held:
+//
+//     BPlusCAPI *bplus = BPlusCAPI_import(1);
+//     if (bplus == NULL) return NULL;
+//     if (PyObject_TypeCheck(s, bplus->TreeType)) {
+//         res = bplus->insert(s, o, PyObject_Hash(o));
+//     }
+//
+// Every function expects a BPlusTree (such as a BPlusSet) and must be called
+// with the GIL held. {hash} is always hash(o), as from PyObject_Hash(); it is
+// not checked against {o}.
+//
+// {version} is bumped whenever a function is added, and new functions are
+// only ever added to the end of the struct, so a table of a later version
+// can always be used as an earlier one.
+
+
+#ifndef BPLUSAPI_H
+#define BPLUSAPI_H
+
+
+#include <Python.h>
+
+
+#define BPLUS_CAPI_VERSION 1
+#define BPLUS_CAPI_NAME "five_one_one_bplus.c._C_API"
+
+
+// called by {visit} for each element {o} (a borrowed reference) of a tree,
+// with its hash and the {arg} passed to {visit}.
+// Returning nonzero stops the walk; return -1 with an exception set on error.
+typedef int (*BPlusVisitFunc)(PyObject *o, Py_hash_t hash, void *arg);
+
+
+typedef struct BPlusCAPI {
+    // {BPLUS_CAPI_VERSION} of the module, and sizeof(BPlusCAPI) in it
+    int version;
+    size_t size;
+    // version 1
+    // the type of BPlusTree (the base class of BPlusSet)
+    PyTypeObject *TreeType;
+    // adds {o} to {tree}. Returns 1 if it was added, 0 if it was already in
+    // the tree, -1 with an exception set on error.
+    int (*insert)(PyObject *tree, PyObject *o, Py_hash_t hash);
+    // returns 1 if {o} is in {tree}, 0 if not, -1 with an exception set on
+    // error.
+    int (*contains)(PyObject *tree, PyObject *o, Py_hash_t hash);
+    // adds the {n} objects in {items}, with the hashes in {hashes}, to
+    // {tree}. Returns the number added, -1 with an exception set on error.
+    Py_ssize_t (*insert_many)(PyObject *tree, PyObject *const *items, const Py_hash_t *hashes, Py_ssize_t n);
+    // looks up the {n} objects in {items}, with the hashes in {hashes}, in
+    // {tree}, setting bit i % 8 of byte i / 8 of {out} if items[i] is in it
+    // and clearing it otherwise. Returns the number found, -1 with an
+    // exception set on error.
+    Py_ssize_t (*contains_many)(PyObject *tree, PyObject *const *items, const Py_hash_t *hashes, Py_ssize_t n, unsigned char *out);
+    // walks the leaf chain of {tree}, calling {visit} for each element in
+    // iteration order. Returns 0 once every element has been visited, or
+    // what {visit} returned if it stopped the walk. The tree cannot be
+    // changed during the walk; trying to raises RuntimeError.
+    int (*visit)(PyObject *tree, BPlusVisitFunc visit, void *arg);
+} BPlusCAPI;
+
+
+// imports the C API, failing with ImportError if the module's is older than
+// {version}.
+// Returns NULL with an exception set on failure.
+static inline BPlusCAPI *BPlusCAPI_import(int version) {
+
+    BPlusCAPI *api = (BPlusCAPI *)PyCapsule_Import(BPLUS_CAPI_NAME, 0);
+
+    if (api != NULL && api->version < version) {
+        PyErr_Format(PyExc_ImportError, "five_one_one_bplus C API version %d is older than the required %d.", api->version, version);
+        return NULL;
+    }
+
+    return api;
+
+}
+
+
+#endif
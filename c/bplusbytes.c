@@ -0,0 +1,706 @@
+// BPlusBytesTree method definitions.
+// A BPlusBytesTree is a set of bytes and strs that keeps no Python objects.
+// The bytes of each element (the UTF-8 encoding of a str) are copied into an
+// arena owned by the tree, and its leaves hold a {BPlusBytesEntry} for each
+// element: the element's hash and where its bytes are in the arena. Entries
+// are compared by hash first, and then with memcmp(), so a lookup never calls
+// back into Python once it has the hash and bytes of the object it is looking
+// for; the elements are only created again when they are iterated over.
+#include <Python.h>
+#include "structmember.h"
+#include "bplustypes.h"
+#include "general.h"
+#include "bplusbytes.h"
+
+
+// the bytes allocated for a leaf, or for a branch with its children
+#define BPLUSBYTES_NODE_NBYTES(leaf) (sizeof(BPlusBytesNode) + ((leaf) ? 0 : sizeof(BPlusBytesNode *) * BPLUSBYTES_SLOTS))
+
+
+// define our subslot for BPlusBytesTree sequence methods
+static PySequenceMethods BPlusBytesTree_sq_methods = {
+    (lenfunc)BPlusBytesTree_sq_length,          /*sq_length*/
+    0,                                          /*sq_concat*/
+    0,                                          /*sq_repeat*/
+    0,                                          /*sq_item*/
+    0,                                          /*was_sq_slice*/
+    0,                                          /*sq_ass_item (???)*/
+    0,                                          /*was_sq_ass_slice (???)*/
+    BPlusBytesTree_sq_contains,                 /*sq_contains*/
+    0,                                          /*sq_inplace_concat*/
+    0,                                          /*sq_inplace_repeat*/
+};
+
+
+// define our subslot for BPlusBytesTree public methods
+static PyMethodDef BPlusBytesTree_tp_methods[] = {
+    {"add", BPlusBytesTree_method_add, METH_VARARGS, "Copies the bytes or str {o} into the tree."},
+    {"update", BPlusBytesTree_method_update, METH_VARARGS, "Copies every bytes or str in {iterable} into the tree."},
+    {"get_nbytes", BPlusBytesTree_method_get_nbytes, METH_NOARGS, "Returns a tuple of the bytes used by the nodes of the tree and by its arena."},
+    {"__sizeof__", BPlusBytesTree_method_sizeof, METH_NOARGS, "Returns the size of the tree in memory, in bytes, including its nodes and its arena."},
+    {NULL, NULL, 0, NULL}
+};
+
+
+// define our BPlusBytesTreeType type object
+PyTypeObject BPlusBytesTreeType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "five_one_one_bplus.c.BPlusBytesTree",      /*tp_name*/
+    sizeof(BPlusBytesTree),                     /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)BPlusBytesTree_tp_dealloc,      /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    &BPlusBytesTree_sq_methods,                 /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   /*tp_flags*/
+    0,                                          /*tp_doc*/
+    0,                                          /*tp_traverse*/
+    0,                                          /*tp_clear*/
+    0,                                          /*tp_richcompare*/
+    0,                                          /*tp_weaklistoffset*/
+    (getiterfunc)BPlusBytesTree_tp_iter,        /*tp_iter*/
+    0,                                          /*tp_iternext*/
+    BPlusBytesTree_tp_methods,                  /*tp_methods*/
+    0,                                          /*tp_members*/
+    0,                                          /*tp_getsets*/
+    0,                                          /*tp_base*/
+    0,                                          /*tp_dict*/
+    0,                                          /*tp_descr_get*/
+    0,                                          /*tp_descr_set*/
+    0,                                          /*tp_dictoffset*/
+    (initproc)BPlusBytesTree_tp_init,           /*tp_init*/
+    0,                                          /*tp_alloc*/
+    BPlusBytesTree_tp_new,                      /*tp_new*/
+};
+
+
+// define our BPlusBytesIterType type object
+PyTypeObject BPlusBytesIterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "five_one_one_bplus.c.BPlusBytesIter",      /*tp_name*/
+    sizeof(BPlusBytesIter),                     /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)BPlusBytesIter_tp_dealloc,      /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,                         /*tp_flags*/
+    0,                                          /*tp_doc*/
+    0,                                          /*tp_traverse*/
+    0,                                          /*tp_clear*/
+    0,                                          /*tp_richcompare*/
+    0,                                          /*tp_weaklistoffset*/
+    PyObject_SelfIter,                          /*tp_iter*/
+    (iternextfunc)BPlusBytesIter_tp_iternext,   /*tp_iternext*/
+};
+
+
+// BEGIN tp method definitions
+// the root leaf is made here, so that a tree made by __new__() alone is still
+// a valid empty tree.
+static PyObject *BPlusBytesTree_tp_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs) {
+    BPlusBytesTree *self;
+
+    if ((self = (BPlusBytesTree *)subtype->tp_alloc(subtype, 0)) == NULL) {
+        return NULL;
+    }
+
+    if ((self->root = self->first = BPlusBytes_new_node(self, 1)) == NULL) {
+        Py_DECREF(self);
+        return NULL;
+    }
+
+    return (PyObject *)self;
+}
+
+static void BPlusBytesTree_tp_dealloc(BPlusBytesTree *self) {
+    BPlusBytes_clear(self);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static int BPlusBytesTree_tp_init(BPlusBytesTree *self, PyObject *args, PyObject *kwargs) {
+
+    PyObject *initializer = Py_None;
+    BPlusBytesNode *root;
+    static char *kwlist[] = {"initializer", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwlist, &initializer)) {
+        return -1;
+    }
+
+    // empty a tree that is being re-initialized, taking its new root first
+    // so that running out of memory leaves it as it was
+    if ((root = BPlusBytes_new_node(self, 1)) == NULL) {
+        return -1;
+    }
+    BPlusBytes_clear(self);
+    self->root = self->first = root;
+    self->nodes_nbytes = BPLUSBYTES_NODE_NBYTES(1);
+
+    if (initializer != Py_None) {
+        return BPlusBytes_update(self, initializer);
+    }
+
+    return 0;
+
+}
+
+static PyObject *BPlusBytesTree_tp_iter(PyObject *self) {
+
+    BPlusBytesTree *tree = (BPlusBytesTree *)self;
+    BPlusBytesIter *iter;
+
+    if ((iter = PyObject_New(BPlusBytesIter, &BPlusBytesIterType)) == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(self);
+    iter->tree = tree;
+    iter->leaf = tree->first;
+    iter->ix = 0;
+    iter->version = tree->version;
+    iter->started = 0;
+
+    return (PyObject *)iter;
+
+}
+
+static void BPlusBytesIter_tp_dealloc(BPlusBytesIter *self) {
+    Py_XDECREF(self->tree);
+    PyObject_Free(self);
+}
+
+// returns the next element of the tree, created from its entry, or NULL
+// (with no error set) at the end.
+// If the tree has changed since the last element was returned, the leaf it
+// was in may have split, so the iterator finds that element again and carries
+// on from there.
+static PyObject *BPlusBytesIter_tp_iternext(PyObject *self) {
+
+    BPlusBytesIter *iter = (BPlusBytesIter *)self;
+    BPlusBytesTree *tree = iter->tree;
+    BPlusBytesNode *path[BPLUSBYTES_MAX_DEPTH];
+    int slots[BPLUSBYTES_MAX_DEPTH], depth;
+    const char *data;
+
+    // an exhausted iterator lets go of its tree
+    if (tree == NULL) {
+        return NULL;
+    }
+
+    if (iter->version != tree->version) {
+        iter->version = tree->version;
+        if (!iter->started) {
+            iter->leaf = tree->first;
+            iter->ix = 0;
+        } else if (iter->last.offset + iter->last.len > tree->arena_nbytes) {
+            // the tree was emptied and re-initialized under the iterator
+            iter->leaf = NULL;
+        } else {
+            data = tree->arena + iter->last.offset;
+            iter->leaf = BPlusBytes_descend(tree, &iter->last, data, path, slots, &depth);
+            iter->ix = BPlusBytes_bisect(tree, iter->leaf, &iter->last, data);
+            if (iter->ix < iter->leaf->n && BPlusBytes_cmp(tree, iter->leaf->entries + iter->ix, &iter->last, data) == 0) {
+                iter->ix++;
+            }
+        }
+    }
+
+    while (iter->leaf != NULL) {
+        if (iter->ix < iter->leaf->n) {
+            iter->started = 1;
+            iter->last = iter->leaf->entries[iter->ix++];
+            return BPlusBytes_element(tree, &iter->last);
+        }
+        iter->leaf = iter->leaf->next;
+        iter->ix = 0;
+    }
+
+    Py_CLEAR(iter->tree);
+    return NULL;
+
+}
+
+
+// BEGIN sequence method definitions
+// this is called on call to len()
+Py_ssize_t BPlusBytesTree_sq_length(PyObject *self) {
+    return ((BPlusBytesTree *)self)->n;
+}
+
+// this is called on use of the `in` keyword.
+// Anything other than a bytes or a str is never equal to an element, so is
+// simply not in the tree. Neither is a str that cannot be encoded as UTF-8
+// (one holding a lone surrogate), which add() refuses.
+int BPlusBytesTree_sq_contains(PyObject *self, PyObject *value) {
+
+    BPlusBytesTree *tree = (BPlusBytesTree *)self;
+    BPlusBytesNode *leaf, *path[BPLUSBYTES_MAX_DEPTH];
+    BPlusBytesEntry probe;
+    const char *data;
+    int slots[BPLUSBYTES_MAX_DEPTH], depth, pos, res;
+
+    if ((res = BPlusBytes_probe(value, &probe, &data)) != 1) {
+        if (res == -1 && PyErr_ExceptionMatches(PyExc_UnicodeEncodeError)) {
+            PyErr_Clear();
+            return 0;
+        }
+        return res;
+    }
+
+    leaf = BPlusBytes_descend(tree, &probe, data, path, slots, &depth);
+    pos = BPlusBytes_bisect(tree, leaf, &probe, data);
+
+    return pos < leaf->n && BPlusBytes_cmp(tree, leaf->entries + pos, &probe, data) == 0;
+
+}
+
+
+// BEGIN public method definitions
+static PyObject *BPlusBytesTree_method_add(PyObject *self, PyObject *args) {
+
+    PyObject *o;
+
+    if (!PyArg_ParseTuple(args, "O", &o)) {
+        return NULL;
+    }
+
+    if (BPlusBytes_insert((BPlusBytesTree *)self, o) == -1) {
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+
+}
+
+static PyObject *BPlusBytesTree_method_update(PyObject *self, PyObject *args) {
+
+    PyObject *iterable;
+
+    if (!PyArg_ParseTuple(args, "O", &iterable)) {
+        return NULL;
+    }
+
+    if (BPlusBytes_update((BPlusBytesTree *)self, iterable) == -1) {
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+
+}
+
+static PyObject *BPlusBytesTree_method_get_nbytes(PyObject *self, PyObject *args) {
+
+    BPlusBytesTree *tree = (BPlusBytesTree *)self;
+
+    return Py_BuildValue("(nn)", (Py_ssize_t)tree->nodes_nbytes, (Py_ssize_t)tree->arena_capacity);
+
+}
+
+static PyObject *BPlusBytesTree_method_sizeof(PyObject *self, PyObject *args) {
+
+    BPlusBytesTree *tree = (BPlusBytesTree *)self;
+
+    return PyLong_FromSize_t((size_t)Py_TYPE(self)->tp_basicsize + tree->nodes_nbytes + tree->arena_capacity);
+
+}
+
+
+// BEGIN helper function definitions
+
+// fills {probe} with the hash, tag and length of {o}, and points {data} at
+// its bytes (the UTF-8 encoding of a str, cached on the str by Python).
+// Returns 1 if {o} is a bytes or a str, 0 if it is neither, or -1 with an
+// error set.
+// The hash is always that of the base type, so that a subclass that overrides
+// __hash__ still finds the elements it is equal to.
+int BPlusBytes_probe(PyObject *o, BPlusBytesEntry *probe, const char **data) {
+
+    Py_ssize_t len;
+
+    if (PyUnicode_Check(o)) {
+        if ((*data = PyUnicode_AsUTF8AndSize(o, &len)) == NULL) {
+            return -1;
+        }
+        probe->tag = BPLUSBYTES_STR;
+        probe->hash = PyUnicode_Type.tp_hash(o);
+    } else if (PyBytes_Check(o)) {
+        *data = PyBytes_AS_STRING(o);
+        len = PyBytes_GET_SIZE(o);
+        probe->tag = BPLUSBYTES_BYTES;
+        probe->hash = PyBytes_Type.tp_hash(o);
+    } else {
+        return 0;
+    }
+
+    if (len > UINT_MAX) {
+        Py_INCREF(PyExc_OverflowError);
+        PyErr_SetString(PyExc_OverflowError, "BPlusBytesTree got an element too large to hold.");
+        return -1;
+    }
+
+    probe->len = (unsigned int)len;
+    probe->offset = 0;
+
+    return 1;
+
+}
+
+// compares {entry} of {tree} with {probe}, whose bytes are at {data}, in the
+// order described at {BPlusBytesEntry}. Returns a negative number, 0 or a
+// positive number as {entry} is below, equal to or above {probe}.
+int BPlusBytes_cmp(BPlusBytesTree *tree, BPlusBytesEntry *entry, BPlusBytesEntry *probe, const char *data) {
+
+    if (entry->hash != probe->hash) {
+        return entry->hash < probe->hash ? -1 : 1;
+    }
+    if (entry->tag != probe->tag) {
+        return entry->tag < probe->tag ? -1 : 1;
+    }
+    if (entry->len != probe->len) {
+        return entry->len < probe->len ? -1 : 1;
+    }
+
+    return memcmp(tree->arena + entry->offset, data, entry->len);
+
+}
+
+// returns the index of the first entry of {leaf} that is at least {probe}.
+int BPlusBytes_bisect(BPlusBytesTree *tree, BPlusBytesNode *leaf, BPlusBytesEntry *probe, const char *data) {
+
+    int lo = 0, hi = leaf->n, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (BPlusBytes_cmp(tree, leaf->entries + mid, probe, data) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+
+}
+
+// returns the index of the child of {branch} that {probe} belongs beneath: the
+// last child whose lowest entry is at most {probe}, or the first child.
+int BPlusBytes_search(BPlusBytesTree *tree, BPlusBytesNode *branch, BPlusBytesEntry *probe, const char *data) {
+
+    int lo = 1, hi = branch->n, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (BPlusBytes_cmp(tree, branch->entries + mid, probe, data) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo - 1;
+
+}
+
+// returns the leaf that {probe} belongs in, recording the branches passed
+// through in {path} and the child taken from each in {slots}, {depth} deep.
+BPlusBytesNode *BPlusBytes_descend(BPlusBytesTree *tree, BPlusBytesEntry *probe, const char *data, BPlusBytesNode **path, int *slots, int *depth) {
+
+    BPlusBytesNode *node = tree->root;
+
+    for (*depth = 0; !node->leaf; (*depth)++) {
+        path[*depth] = node;
+        slots[*depth] = BPlusBytes_search(tree, node, probe, data);
+        node = node->children[slots[*depth]];
+    }
+
+    return node;
+
+}
+
+// copies the bytes or str {o} into {tree}. Returns 1 if it was added, 0 if it
+// was already there, or -1 with an error set.
+// A full leaf is split in half, except that an element past the end of the
+// last leaf starts a new leaf. Every node a split will need, and room in the
+// arena, is allocated before anything is changed, so a failure leaves the
+// tree as it was.
+int BPlusBytes_insert(BPlusBytesTree *tree, PyObject *o) {
+
+    BPlusBytesNode *leaf, *right = NULL, *path[BPLUSBYTES_MAX_DEPTH], *spares[BPLUSBYTES_MAX_DEPTH + 1] = {NULL};
+    BPlusBytesEntry probe;
+    const char *data;
+    int slots[BPLUSBYTES_MAX_DEPTH], depth, pos, half, nspares = 0, d, res;
+
+    if ((res = BPlusBytes_probe(o, &probe, &data)) != 1) {
+        if (res == 0) {
+            Py_INCREF(PyExc_TypeError);
+            PyErr_SetString(PyExc_TypeError, "A BPlusBytesTree can only hold bytes and strs.");
+        }
+        return -1;
+    }
+
+    leaf = BPlusBytes_descend(tree, &probe, data, path, slots, &depth);
+    pos = BPlusBytes_bisect(tree, leaf, &probe, data);
+    if (pos < leaf->n && BPlusBytes_cmp(tree, leaf->entries + pos, &probe, data) == 0) {
+        return 0;
+    }
+
+    if (leaf->n == BPLUSBYTES_SLOTS) {
+        // one spare for every full branch on the way up, and one for a new
+        // root if they are all full
+        for (d = depth - 1; d >= 0 && path[d]->n == BPLUSBYTES_SLOTS; d--) {
+            nspares++;
+        }
+        nspares += d < 0;
+        if (depth + 1 >= BPLUSBYTES_MAX_DEPTH) {
+            Py_INCREF(PyExc_OverflowError);
+            PyErr_SetString(PyExc_OverflowError, "BPlusBytesTree is too deep to split.");
+            return -1;
+        }
+        for (d = 0; d < nspares; d++) {
+            if ((spares[d] = BPlusBytes_new_node(tree, 0)) == NULL) {
+                goto fail;
+            }
+        }
+        if ((right = BPlusBytes_new_node(tree, 1)) == NULL) {
+            goto fail;
+        }
+    }
+
+    if (BPlusBytes_reserve(tree, probe.len) == -1) {
+        goto fail;
+    }
+    probe.offset = tree->arena_nbytes;
+    memcpy(tree->arena + probe.offset, data, probe.len);
+    tree->arena_nbytes += probe.len;
+
+    if (right == NULL) {
+        BPlusBytes_insert_at(leaf, pos, &probe, NULL);
+    } else {
+        half = pos == leaf->n && leaf->next == NULL ? leaf->n : leaf->n / 2;
+        memcpy(right->entries, leaf->entries + half, sizeof(BPlusBytesEntry) * (leaf->n - half));
+        right->n = leaf->n - half;
+        leaf->n = half;
+        right->next = leaf->next;
+        leaf->next = right;
+        if (pos < half) {
+            BPlusBytes_insert_at(leaf, pos, &probe, NULL);
+        } else {
+            BPlusBytes_insert_at(right, pos - half, &probe, NULL);
+        }
+        BPlusBytes_insert_child(tree, path, slots, depth, right, spares + nspares);
+    }
+
+    tree->n++;
+    tree->version++;
+    return 1;
+
+fail:
+    for (int ix = 0; ix < nspares; ix++) {
+        if (spares[ix] != NULL) {
+            PyMem_RawFree(spares[ix]);
+            tree->nodes_nbytes -= BPLUSBYTES_NODE_NBYTES(0);
+        }
+    }
+    if (right != NULL) {
+        PyMem_RawFree(right);
+        tree->nodes_nbytes -= BPLUSBYTES_NODE_NBYTES(1);
+    }
+    return -1;
+
+}
+
+// inserts {child}, split off to the right of the child taken from the bottom
+// branch of {path}, into that branch. Each full branch is split in half, with
+// the right half taken from {spares} (counting down) and inserted into the
+// branch above in turn; if the root splits, a new root is taken from
+// {spares} too.
+void BPlusBytes_insert_child(BPlusBytesTree *tree, BPlusBytesNode **path, int *slots, int depth, BPlusBytesNode *child, BPlusBytesNode **spares) {
+
+    BPlusBytesNode *branch, *right;
+    int at, half = BPLUSBYTES_SLOTS / 2;
+
+    for (int d = depth - 1; d >= 0; d--) {
+
+        branch = path[d];
+        at = slots[d] + 1;
+
+        if (branch->n < BPLUSBYTES_SLOTS) {
+            BPlusBytes_insert_at(branch, at, child->entries, child);
+            return;
+        }
+
+        right = *--spares;
+        right->n = branch->n - half;
+        memcpy(right->entries, branch->entries + half, sizeof(BPlusBytesEntry) * right->n);
+        memcpy(right->children, branch->children + half, sizeof(BPlusBytesNode *) * right->n);
+        branch->n = half;
+
+        if (at <= half) {
+            BPlusBytes_insert_at(branch, at, child->entries, child);
+        } else {
+            BPlusBytes_insert_at(right, at - half, child->entries, child);
+        }
+
+        child = right;
+
+    }
+
+    branch = *--spares;
+    branch->n = 2;
+    branch->entries[0] = tree->root->entries[0];
+    branch->children[0] = tree->root;
+    branch->entries[1] = child->entries[0];
+    branch->children[1] = child;
+    tree->root = branch;
+
+}
+
+// inserts {entry} at index {at} of {node}, which must have room for it,
+// along with {child} if {node} is a branch.
+void BPlusBytes_insert_at(BPlusBytesNode *node, int at, BPlusBytesEntry *entry, BPlusBytesNode *child) {
+
+    memmove(node->entries + at + 1, node->entries + at, sizeof(BPlusBytesEntry) * (node->n - at));
+    node->entries[at] = *entry;
+
+    if (!node->leaf) {
+        memmove(node->children + at + 1, node->children + at, sizeof(BPlusBytesNode *) * (node->n - at));
+        node->children[at] = child;
+    }
+
+    node->n++;
+
+}
+
+// copies every bytes or str in {iterable} into {tree}. Returns 0, or -1 with
+// an error set (after copying everything before the bad element).
+int BPlusBytes_update(BPlusBytesTree *tree, PyObject *iterable) {
+
+    PyObject *iterator, *o;
+    int res = 0;
+
+    if ((iterator = PyObject_GetIter(iterable)) == NULL) {
+        return -1;
+    }
+
+    while (res == 0 && (o = PyIter_Next(iterator)) != NULL) {
+        if (BPlusBytes_insert(tree, o) == -1) {
+            res = -1;
+        }
+        Py_DECREF(o);
+    }
+    Py_DECREF(iterator);
+
+    return PyErr_Occurred() ? -1 : res;
+
+}
+
+// makes room in the arena of {tree} for {nbytes} more bytes, growing it by
+// half again as needed.
+int BPlusBytes_reserve(BPlusBytesTree *tree, size_t nbytes) {
+
+    size_t capacity = tree->arena_capacity;
+    char *arena;
+
+    if (tree->arena_nbytes + nbytes <= capacity) {
+        return 0;
+    }
+
+    while (capacity < tree->arena_nbytes + nbytes) {
+        capacity = capacity < 256 ? 256 : capacity + capacity / 2;
+    }
+
+    if ((arena = (char *)PyMem_RawRealloc(tree->arena, capacity)) == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    tree->arena = arena;
+    tree->arena_capacity = capacity;
+
+    return 0;
+
+}
+
+// returns a new empty leaf, or branch if not {leaf}, or NULL with an error
+// set.
+BPlusBytesNode *BPlusBytes_new_node(BPlusBytesTree *tree, int leaf) {
+
+    BPlusBytesNode *node;
+
+    if ((node = (BPlusBytesNode *)PyMem_RawCalloc(1, BPLUSBYTES_NODE_NBYTES(leaf))) == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    node->leaf = leaf;
+    tree->nodes_nbytes += BPLUSBYTES_NODE_NBYTES(leaf);
+
+    return node;
+
+}
+
+// returns a new bytes or str holding the element of {entry}, or NULL with an
+// error set.
+PyObject *BPlusBytes_element(BPlusBytesTree *tree, BPlusBytesEntry *entry) {
+
+    if (entry->tag == BPLUSBYTES_STR) {
+        return PyUnicode_DecodeUTF8(tree->arena + entry->offset, entry->len, "strict");
+    }
+
+    return PyBytes_FromStringAndSize(tree->arena + entry->offset, entry->len);
+
+}
+
+void BPlusBytes_free(BPlusBytesNode *node) {
+
+    if (!node->leaf) {
+        for (int ix = 0; ix < node->n; ix++) {
+            BPlusBytes_free(node->children[ix]);
+        }
+    }
+
+    PyMem_RawFree(node);
+
+}
+
+// frees every node and the arena of {tree}, leaving it with no root.
+void BPlusBytes_clear(BPlusBytesTree *tree) {
+
+    if (tree->root != NULL) {
+        BPlusBytes_free(tree->root);
+    }
+    PyMem_RawFree(tree->arena);
+
+    tree->root = NULL;
+    tree->first = NULL;
+    tree->n = 0;
+    tree->arena = NULL;
+    tree->arena_nbytes = 0;
+    tree->arena_capacity = 0;
+    tree->nodes_nbytes = 0;
+    tree->version++;
+
+}
@@ -0,0 +1,59 @@
+// Definitions of public and private methods used by BPlusBytesTree.
+// See bplusbytes.c for documentation on the methods declared in this file.
+
+
+#ifndef BPLUSBYTES_H
+#define BPLUSBYTES_H
+
+
+#include <Python.h>
+#include "structmember.h"
+#include "bplustypes.h"
+#include "general.h"
+
+
+// the type objects are registered with the module by PyInit_c() in
+// bplustree.c
+extern PyTypeObject BPlusBytesTreeType;
+extern PyTypeObject BPlusBytesIterType;
+
+
+// BEGIN BPlusBytesTree private helper method headers
+static int BPlusBytes_probe(PyObject *o, BPlusBytesEntry *probe, const char **data);
+static int BPlusBytes_cmp(BPlusBytesTree *tree, BPlusBytesEntry *entry, BPlusBytesEntry *probe, const char *data);
+static int BPlusBytes_bisect(BPlusBytesTree *tree, BPlusBytesNode *leaf, BPlusBytesEntry *probe, const char *data);
+static int BPlusBytes_search(BPlusBytesTree *tree, BPlusBytesNode *branch, BPlusBytesEntry *probe, const char *data);
+static BPlusBytesNode *BPlusBytes_descend(BPlusBytesTree *tree, BPlusBytesEntry *probe, const char *data, BPlusBytesNode **path, int *slots, int *depth);
+static int BPlusBytes_insert(BPlusBytesTree *tree, PyObject *o);
+static void BPlusBytes_insert_child(BPlusBytesTree *tree, BPlusBytesNode **path, int *slots, int depth, BPlusBytesNode *child, BPlusBytesNode **spares);
+static void BPlusBytes_insert_at(BPlusBytesNode *node, int at, BPlusBytesEntry *entry, BPlusBytesNode *child);
+static int BPlusBytes_update(BPlusBytesTree *tree, PyObject *iterable);
+static int BPlusBytes_reserve(BPlusBytesTree *tree, size_t nbytes);
+static BPlusBytesNode *BPlusBytes_new_node(BPlusBytesTree *tree, int leaf);
+static PyObject *BPlusBytes_element(BPlusBytesTree *tree, BPlusBytesEntry *entry);
+static void BPlusBytes_free(BPlusBytesNode *node);
+static void BPlusBytes_clear(BPlusBytesTree *tree);
+
+
+// BEGIN tp method headers
+static PyObject *BPlusBytesTree_tp_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs);
+static void BPlusBytesTree_tp_dealloc(BPlusBytesTree *self);
+static int BPlusBytesTree_tp_init(BPlusBytesTree *self, PyObject *args, PyObject *kwargs);
+static PyObject *BPlusBytesTree_tp_iter(PyObject *self);
+static void BPlusBytesIter_tp_dealloc(BPlusBytesIter *self);
+static PyObject *BPlusBytesIter_tp_iternext(PyObject *self);
+
+
+// BEGIN sequence method headers
+static Py_ssize_t BPlusBytesTree_sq_length(PyObject *self);
+static int BPlusBytesTree_sq_contains(PyObject *self, PyObject *value);
+
+
+// BEGIN public method headers
+static PyObject *BPlusBytesTree_method_add(PyObject *self, PyObject *args);
+static PyObject *BPlusBytesTree_method_update(PyObject *self, PyObject *args);
+static PyObject *BPlusBytesTree_method_get_nbytes(PyObject *self, PyObject *args);
+static PyObject *BPlusBytesTree_method_sizeof(PyObject *self, PyObject *args);
+
+
+#endif
@@ -0,0 +1,917 @@
+// The CPython-independent core of the B-Plus Tree.
+// Everything here works on {l64} keys and opaque value slots ({void *}): node
+// layout, descent, splits and bulk loading. Nothing in this file touches a
+// Python object or needs the GIL, so it can also be built on its own, as by
+// the benchmark in bench/bench_core.c. What the value slots of a BPlusTree
+// hold, and how they are compared, is up to bplusnode.c.
+#include "bpluscore.h"
+#include "array32.h"
+
+
+
+// number of bytes needed to lay out a node (leaf or branch) with room for
+// {b}+1 entries in a single block of memory, with {width} bytes per entry of
+// {indices}.
+size_t BPlusNode_nbytes(int b, int width) {
+    return sizeof(BPlusNode)
+        + 2 * sizeof(Array32)
+        + ((width * (b+1) + 7) & ~(size_t)7)
+        + sizeof(void *) * (b+1);
+}
+
+// returns an upper bound on the number of nodes in a tree of at most {b}
+// entries per node after {n} elements have been inserted into it one at a
+// time, counting the one node that is briefly left over by each split.
+// Every node but the root holds at least (b+1) / 2 entries once it has been
+// split, so each level has at most that many times fewer nodes than the level
+// below it. With {b} of 2 a split can leave a single entry behind, and
+// branches are counted as holding 2 regardless, so there the count is only an
+// estimate.
+size_t BPlusNode_count_for(int b, size_t n) {
+
+    size_t half = (b+1) / 2, count = n / half + 1, total = count + 1;
+
+    if (half < 2) {
+        half = 2;
+    }
+
+    while (count > 1) {
+        count = (count + half - 1) / half;
+        total += count;
+    }
+
+    return total;
+
+}
+
+// lays out a node in the {BPlusNode_nbytes(b, width)} bytes at {mem}.
+// the node struct is followed by its {Array32} headers, its {indices}, and
+// then either its {values} (if {is_leaf}) or its {children}.
+BPlusNode *BPlusNode_layout(void *mem, int b, int is_leaf, int width) {
+
+    BPlusNode *node = (BPlusNode *)mem;
+    Array32 *arrays = (Array32 *)(node + 1);
+    char *keys = (char *)(arrays + 2);
+    void **slots = (void **)(keys + ((width * (b+1) + 7) & ~(size_t)7));
+
+    node->indices = &arrays[0];
+    node->indices->size = 0;
+    node->indices->head = 0;
+    node->indices->capacity = b+1;
+    node->indices->arr = keys;
+
+    arrays[1].size = 0;
+    arrays[1].head = 0;
+    arrays[1].capacity = b+1;
+    arrays[1].arr = slots;
+    if (is_leaf) {
+        node->values = &arrays[1];
+        node->children = NULL;
+    } else {
+        node->values = NULL;
+        node->children = &arrays[1];
+    }
+
+    // initialize everything else to 0
+    node->prev = NULL;
+    node->next = NULL;
+    node->counts = NULL;
+    node->flags = 0;
+    node->width = width;
+    node->base = 0;
+
+    return node;
+
+}
+
+// where node memory comes from; PyInit_c() in bplustree.c points it at
+// Python's allocators so that tracemalloc sees the nodes.
+BPlusAllocator BPlusHeap_allocator = {malloc, free, NULL, NULL, 0};
+
+
+// takes a block of {nbytes} bytes of node memory for {heap}: one of its
+// reserved blocks if it has one of that size, or else from the small
+// allocator if {nbytes} is small enough for it (see {BPlusAllocator}). {*flags}
+// is set to the BPLUSNODE_POOL or BPLUSNODE_SMALL flag to give the block back
+// with (see BPlusHeap_give()), or 0.
+// Returns NULL if out of memory.
+void *BPlusHeap_alloc(BPlusHeap *heap, size_t nbytes, int *flags) {
+
+    void *mem;
+
+    if (nbytes == heap->pool_nbytes && heap->pool != NULL) {
+        mem = heap->pool;
+        heap->pool = *(void **)mem;
+        heap->pool_free--;
+        heap->pool_used++;
+        *flags = BPLUSNODE_POOL;
+        return mem;
+    }
+
+    *flags = nbytes <= BPlusHeap_allocator.small_nbytes ? BPLUSNODE_SMALL : 0;
+    mem = *flags ? BPlusHeap_allocator.small_malloc(nbytes) : BPlusHeap_allocator.malloc(nbytes);
+    if (mem != NULL) {
+        heap->nbytes += nbytes;
+    }
+
+    return mem;
+
+}
+
+// gives the block of {nbytes} bytes at {mem}, taken from {heap} with {flags},
+// back to where it came from.
+void BPlusHeap_give(BPlusHeap *heap, void *mem, size_t nbytes, int flags) {
+
+    if (flags & BPLUSNODE_POOL) {
+        *(void **)mem = heap->pool;
+        heap->pool = mem;
+        heap->pool_free++;
+        heap->pool_used--;
+        return;
+    }
+
+    heap->nbytes -= nbytes;
+    if (flags & BPLUSNODE_SMALL) {
+        BPlusHeap_allocator.small_free(mem);
+    } else {
+        BPlusHeap_allocator.free(mem);
+    }
+
+}
+
+// sets aside blocks of {nbytes} bytes in {heap} so that it has at least {n}
+// free ones, all taken from {BPlusHeap_allocator} in a single chunk. Once
+// they are set aside, taking and giving back nodes of {nbytes} bytes costs no
+// calls to the allocator.
+// A heap only reserves blocks of one size: if it already has blocks of
+// another size in use, nothing is reserved.
+// Returns 0 on success, or -1 if out of memory.
+int BPlusHeap_reserve(BPlusHeap *heap, size_t nbytes, size_t n) {
+
+    // each chunk starts with the next chunk and its own size
+    size_t header = 2 * sizeof(void *), chunk_nbytes;
+    char *chunk;
+
+    if (nbytes != heap->pool_nbytes) {
+        if (heap->pool_used > 0) {
+            return 0;
+        }
+        BPlusHeap_trim(heap);
+        heap->pool_nbytes = nbytes;
+    }
+
+    if (n <= heap->pool_free) {
+        return 0;
+    }
+    n -= heap->pool_free;
+
+    chunk_nbytes = header + nbytes * n;
+    if ((chunk = (char *)BPlusHeap_allocator.malloc(chunk_nbytes)) == NULL) {
+        return -1;
+    }
+    ((void **)chunk)[0] = heap->chunks;
+    ((size_t *)chunk)[1] = chunk_nbytes;
+    heap->chunks = chunk;
+    heap->nbytes += chunk_nbytes;
+
+    for (size_t ix = n; ix > 0; ix--) {
+        void *block = chunk + header + nbytes * (ix - 1);
+        *(void **)block = heap->pool;
+        heap->pool = block;
+    }
+    heap->pool_free += n;
+
+    return 0;
+
+}
+
+// releases the blocks reserved in {heap}, if none of them are in use.
+void BPlusHeap_trim(BPlusHeap *heap) {
+
+    void *chunk;
+
+    if (heap->pool_used > 0) {
+        return;
+    }
+
+    while ((chunk = heap->chunks) != NULL) {
+        heap->chunks = ((void **)chunk)[0];
+        heap->nbytes -= ((size_t *)chunk)[1];
+        BPlusHeap_allocator.free(chunk);
+    }
+    heap->pool = NULL;
+    heap->pool_nbytes = 0;
+    heap->pool_free = 0;
+
+}
+
+// helper for the node constructors: takes a node of {nbytes} bytes from
+// {heap} and lays it out with BPlusNode_layout().
+// Returns NULL if out of memory.
+static BPlusNode *BPlusHeap_node(BPlusHeap *heap, size_t nbytes, int b, int is_leaf, int width) {
+
+    int flags;
+    void *mem = BPlusHeap_alloc(heap, nbytes, &flags);
+    BPlusNode *node;
+
+    if (mem == NULL) {
+        return NULL;
+    }
+
+    node = BPlusNode_layout(mem, b, is_leaf, width);
+    node->flags |= flags;
+
+    return node;
+
+}
+
+// returns the number of bytes in the block holding {node}.
+size_t BPlusNode_size(BPlusNode *node) {
+
+    size_t nbytes = BPlusNode_nbytes(node->indices->capacity - 1, node->width);
+
+    if (node->counts != NULL) {
+        nbytes += sizeof(Array32) + sizeof(l64) * node->counts->capacity;
+    }
+
+    return nbytes;
+
+}
+
+// Leaf Constructor
+// construct a node that will have value slots and no children
+BPlusNode *BPlusLeaf_init(BPlusHeap *heap, int b) {
+    return BPlusHeap_node(heap, BPlusNode_nbytes(b, sizeof(l64)), b, 1, sizeof(l64));
+}
+
+// Packed Leaf Constructor
+// construct a leaf whose hashes are stored as {width}-byte offsets from {base}
+BPlusNode *BPlusLeaf_init_packed(BPlusHeap *heap, int b, l64 base, int width) {
+
+    BPlusNode *node = BPlusHeap_node(heap, BPlusNode_nbytes(b, width), b, 1, width);
+
+    if (node != NULL) {
+        node->base = base;
+    }
+
+    return node;
+
+}
+
+// helper for the counted constructors: takes a node from {heap} with its
+// {counts} laid out after the rest of the node in the same block.
+// Returns NULL if out of memory.
+static BPlusNode *BPlusHeap_counted_node(BPlusHeap *heap, int b, int is_leaf) {
+
+    size_t nbytes = BPlusNode_nbytes(b, sizeof(l64));
+    BPlusNode *node = BPlusHeap_node(heap, nbytes + sizeof(Array32) + sizeof(l64) * (b+1), b, is_leaf, sizeof(l64));
+
+    if (node == NULL) {
+        return NULL;
+    }
+
+    node->counts = (Array32 *)((char *)node + nbytes);
+    node->counts->size = 0;
+    node->counts->head = 0;
+    node->counts->capacity = b+1;
+    node->counts->arr = node->counts + 1;
+
+    return node;
+
+}
+
+// Counted Leaf Constructor
+// construct a leaf of a {BPlusCountedTree}, with a count for each value
+BPlusNode *BPlusLeaf_init_counted(BPlusHeap *heap, int b) {
+    return BPlusHeap_counted_node(heap, b, 1);
+}
+
+// Branch Constructor
+// construct a node that will have leaves or other nodes beneath it
+BPlusNode *BPlusBranch_init(BPlusHeap *heap, int b) {
+    return BPlusHeap_node(heap, BPlusNode_nbytes(b, sizeof(l64)), b, 0, sizeof(l64));
+}
+
+// Counted Branch Constructor
+// construct a branch of a {BPlusSortedTree}, with a count for each child of
+// the elements beneath it
+BPlusNode *BPlusBranch_init_counted(BPlusHeap *heap, int b) {
+    return BPlusHeap_counted_node(heap, b, 0);
+}
+
+// release the memory held by {node} itself back to {heap}.
+// does not touch its children or the reference counts of its values.
+void BPlusNode_free(BPlusHeap *heap, BPlusNode *node) {
+
+    if (node->flags & (BPLUSNODE_ARENA | BPLUSNODE_INLINE)) {
+        return;
+    }
+
+    BPlusHeap_give(heap, node, BPlusNode_size(node), node->flags);
+
+}
+
+// release the memory held by {node} and every node beneath it.
+// unlike BPlusNode_dealloc(), reference counts of values are left untouched;
+// this is used when the values have been handed off to other nodes.
+void BPlusNode_free_tree(BPlusHeap *heap, BPlusNode *node) {
+
+    if (node->children != NULL) {
+        for (int i = 0; i < node->children->size; i++) {
+            BPlusNode_free_tree(heap, ((BPlusNode **)node->children->arr)[i]);
+        }
+    }
+
+    BPlusNode_free(heap, node);
+
+}
+
+// returns the number of nodes in the tree at {node} that were taken from a
+// heap, leaving out those laid out in an arena or inline.
+size_t BPlusNode_count_heap(BPlusNode *node) {
+
+    size_t count = (node->flags & (BPLUSNODE_ARENA | BPLUSNODE_INLINE)) ? 0 : 1;
+
+    if (node->children != NULL) {
+        for (int i = 0; i < node->children->size; i++) {
+            count += BPlusNode_count_heap(((BPlusNode **)node->children->arr)[i]);
+        }
+    }
+
+    return count;
+
+}
+
+// prepares {path} for use by BPlusNode_search()
+void BPlusPath_init(BPlusPath *path) {
+    path->nodes = path->nodes_inline;
+    path->slots = path->slots_inline;
+    path->depth = 0;
+    path->capacity = BPLUS_PATH_INLINE;
+}
+
+// releases any memory {path} allocated to record a deep tree
+void BPlusPath_free(BPlusPath *path) {
+    if (path->nodes != path->nodes_inline) {
+        free(path->nodes);
+        free(path->slots);
+    }
+    BPlusPath_init(path);
+}
+
+// doubles the number of levels {path} can record.
+// Returns 1 on success, 0 if out of memory.
+int BPlusPath_grow(BPlusPath *path) {
+
+    int capacity = path->capacity * 2;
+    BPlusNode **nodes = (BPlusNode **)malloc(sizeof(BPlusNode *) * capacity);
+    int *slots = (int *)malloc(sizeof(int) * capacity);
+
+    if (nodes == NULL || slots == NULL) {
+        free(nodes);
+        free(slots);
+        return 0;
+    }
+
+    memcpy(nodes, path->nodes, sizeof(BPlusNode *) * path->depth);
+    memcpy(slots, path->slots, sizeof(int) * path->depth);
+    if (path->nodes != path->nodes_inline) {
+        free(path->nodes);
+        free(path->slots);
+    }
+    path->nodes = nodes;
+    path->slots = slots;
+    path->capacity = capacity;
+
+    return 1;
+
+}
+
+// helper function that takes root node {root} and index value {key}, and returns
+// a pointer to the leaf node that either:
+//  1. contains {key}
+//  2. would contain {key} if it existed in the tree
+// If {path} is not NULL, the branches passed through on the way down (and the
+// index of the child taken in each) are recorded in it; {path} must have been
+// set up with BPlusPath_init() and should be released with BPlusPath_free().
+// Returns NULL if {path} could not grow; no Python error is set, so callers
+// that pass a {path} raise MemoryError themselves.
+BPlusNode *BPlusNode_search(BPlusNode *root, l64 key, BPlusPath *path) {
+
+    BPlusNode *current = root;
+    int ix;
+
+    if (path != NULL) {
+        path->depth = 0;
+    }
+
+    while (current->children != NULL) {
+        ix = bisect_right(current->indices, key);
+        if (path != NULL) {
+            if (path->depth == path->capacity && !BPlusPath_grow(path)) {
+                return NULL;
+            }
+            path->nodes[path->depth] = current;
+            path->slots[path->depth] = ix;
+            path->depth++;
+        }
+        current = ((BPlusNode **)current->children->arr)[ix];
+    }
+
+    return current;
+
+}
+
+// returns the number of bytes needed per hash to store hashes in [{lo}, {hi}]
+// as offsets from {lo}.
+int BPlusLeaf_width_for(l64 lo, l64 hi) {
+    return packed_width((unsigned long long)hi - (unsigned long long)lo);
+}
+
+// returns the hash at {ix} in {leaf}, decoding it if the leaf is packed.
+l64 BPlusLeaf_key(BPlusNode *leaf, int ix) {
+    if (leaf->width == sizeof(l64)) {
+        return ((l64 *)leaf->indices->arr)[ix];
+    }
+    return (l64)((unsigned long long)leaf->base + get_packed(leaf->indices, leaf->width, ix));
+}
+
+// decodes every hash in {leaf} into {out}.
+void BPlusLeaf_get_keys(BPlusNode *leaf, l64 *out) {
+    if (leaf->width == sizeof(l64)) {
+        memcpy(out, leaf->indices->arr, sizeof(l64) * leaf->indices->size);
+        return;
+    }
+    for (int ix = 0; ix < leaf->indices->size; ix++) {
+        out[ix] = BPlusLeaf_key(leaf, ix);
+    }
+}
+
+// replaces the hashes of {leaf} with the {n} sorted {keys}, encoding them as
+// offsets from {base} if the leaf is packed.
+// Assumes every hash in {keys} fits the leaf (see BPlusLeaf_fits()).
+void BPlusLeaf_set_keys(BPlusNode *leaf, l64 *keys, int n, l64 base) {
+    leaf->base = base;
+    place_array(leaf->indices, n, leaf->width);
+    if (leaf->width == sizeof(l64)) {
+        memcpy(leaf->indices->arr, keys, sizeof(l64) * n);
+    } else {
+        for (int ix = 0; ix < n; ix++) {
+            set_packed(
+                leaf->indices,
+                leaf->width,
+                ix,
+                (unsigned long long)keys[ix] - (unsigned long long)base
+            );
+        }
+    }
+}
+
+// returns 1 if {key} can be stored in {leaf} without re-encoding it, 0
+// otherwise.
+int BPlusLeaf_fits(BPlusNode *leaf, l64 key) {
+    if (leaf->width == sizeof(l64)) {
+        return 1;
+    }
+    return key >= leaf->base
+        && (unsigned long long)key - (unsigned long long)leaf->base <= packed_max(leaf->width);
+}
+
+// returns the leftmost index at which {key} can be inserted into {leaf} while
+// keeping it in sorted order.
+// Packed leaves are searched on their offsets directly, without decoding.
+int BPlusLeaf_bisect_left(BPlusNode *leaf, l64 key) {
+
+    unsigned long long t;
+
+    if (leaf->width == sizeof(l64)) {
+        return bisect_left(leaf->indices, key);
+    }
+
+    if (key <= leaf->base) {
+        return 0;
+    }
+
+    t = (unsigned long long)key - (unsigned long long)leaf->base;
+    if (t > packed_max(leaf->width)) {
+        return leaf->indices->size;
+    }
+
+    return count_less_packed(leaf->indices, leaf->width, t);
+
+}
+
+// convenience method for inserting {key} into the hashes of {leaf} at {ix}.
+// Assumes BPlusLeaf_fits(leaf, key).
+int BPlusLeaf_insert_key(BPlusNode *leaf, int ix, l64 key) {
+    if (leaf->width == sizeof(l64)) {
+        return insert_l64(leaf->indices, ix, key);
+    }
+    return insert_packed(
+        leaf->indices,
+        leaf->width,
+        ix,
+        (unsigned long long)key - (unsigned long long)leaf->base
+    );
+}
+
+// takes from {heap} the branches that BPlusNode_split_up() will need to split
+// a child of the last branch on {path}: two for each branch on {path} that is
+// already full, counting up from the bottom, and one more for a new root if
+// all of them are. They are chained through their {next} in {*spares}, which
+// is left NULL if none are needed.
+// Taking them all before anything is split means that running out of memory
+// leaves the tree untouched. If {counted}, they are made by
+// BPlusBranch_init_counted().
+// Returns 0 on success, or -1 if out of memory, in which case nothing is
+// taken.
+int BPlusBranch_init_spares(BPlusHeap *heap, int b, BPlusPath *path, int counted, BPlusNode **spares) {
+
+    int level = path->depth - 1, need = 0;
+    BPlusNode *branch;
+
+    while (level >= 0 && path->nodes[level]->children->size >= b) {
+        need += 2;
+        level--;
+    }
+    if (level < 0) {
+        need++;
+    }
+
+    *spares = NULL;
+    for (; need > 0; need--) {
+        if ((branch = counted ? BPlusBranch_init_counted(heap, b) : BPlusBranch_init(heap, b)) == NULL) {
+            BPlusBranch_free_spares(heap, *spares);
+            *spares = NULL;
+            return -1;
+        }
+        branch->next = *spares;
+        *spares = branch;
+    }
+
+    return 0;
+
+}
+
+// gives the chain of branches {spares} (see BPlusBranch_init_spares()) back
+// to {heap}.
+void BPlusBranch_free_spares(BPlusHeap *heap, BPlusNode *spares) {
+
+    BPlusNode *next;
+
+    for (; spares != NULL; spares = next) {
+        next = spares->next;
+        BPlusNode_free(heap, spares);
+    }
+
+}
+
+// takes the first of the chain of branches {*spares}.
+BPlusNode *BPlusBranch_take_spare(BPlusNode **spares) {
+
+    BPlusNode *branch = *spares;
+
+    *spares = branch->next;
+    branch->next = NULL;
+
+    return branch;
+
+}
+
+// helper function for splitting a saturated branch into 2 branches
+// expects that {branch} has {b}+1 children
+// Stores the two halves, taken from the chain {*spares} (see
+// BPlusBranch_init_spares()), in {*left} and {*right}, frees {branch} back to
+// {heap}, and returns
+// the index separating the halves; linking them into the parent of {branch}
+// is left to the caller (see BPlusNode_split_up()).
+l64 BPlusBranch_split(BPlusHeap *heap, BPlusNode **spares, BPlusNode *branch, BPlusNode **left, BPlusNode **right) {
+
+    // children size, children mid, indices size, indices mid
+    int csize, cmid, isize, imid;
+    l64 new_parent_ix;
+
+    // take our 2 new branches
+    *left = BPlusBranch_take_spare(spares);
+    *right = BPlusBranch_take_spare(spares);
+    csize = branch->children->size;
+    cmid = csize / 2;
+    isize = branch->indices->size;
+    imid = cmid - 1;
+
+    // copy half of {branch->children} each to left and right respectively
+    place_array((*left)->children, cmid, sizeof(BPlusNode *));
+    memcpy((*left)->children->arr, branch->children->arr, sizeof(BPlusNode *)*cmid);
+
+    place_array((*right)->children, csize - cmid, sizeof(BPlusNode *));
+    memcpy((*right)->children->arr, ((BPlusNode **)branch->children->arr)+cmid, sizeof(BPlusNode *) * (csize - cmid));
+
+    // copy half of {branch->indices} each to left and right respectively
+    place_array((*left)->indices, imid, sizeof(l64));
+    memcpy((*left)->indices->arr, branch->indices->arr, sizeof(l64)*imid);
+
+    place_array((*right)->indices, isize - imid - 1, sizeof(l64));
+    memcpy((*right)->indices->arr, ((l64 *)branch->indices->arr)+imid+1, sizeof(l64) * (isize - imid - 1));
+
+    new_parent_ix = ((l64 *)branch->indices->arr)[imid];
+
+    // free branch
+    BPlusNode_free(heap, branch);
+
+    return new_parent_ix;
+
+}
+
+// helper function for splitting a saturated leaf into the 2 empty leaves
+// {left} and {right}, which the caller has already given the first and second
+// halves of the hashes of {leaf} (see BPlusLeaf_set_keys()).
+// Moves the matching halves of {leaf->values} (and of {leaf->counts}, for a
+// counted leaf) into them, links them into the leaf chain in place of {leaf},
+// and frees {leaf} back to {heap}; linking them into the parent of {leaf} is
+// left to the caller (see BPlusNode_split_up()).
+// Returns the index separating the halves: the first hash of {right}.
+l64 BPlusLeaf_split_at(BPlusHeap *heap, BPlusNode *leaf, BPlusNode *left, BPlusNode *right) {
+
+    int vsize = leaf->values->size, vmid = left->indices->size;
+    l64 new_parent_ix = BPlusLeaf_key(leaf, vmid);
+
+    // copy half of {leaf->values} each to left and right respectively
+    place_array(left->values, vmid, sizeof(void *));
+    memcpy(left->values->arr, leaf->values->arr, sizeof(void *)*vmid);
+
+    place_array(right->values, vsize - vmid, sizeof(void *));
+    memcpy(right->values->arr, ((void **)leaf->values->arr)+vmid, sizeof(void *) * (vsize - vmid));
+
+    if (leaf->counts != NULL) {
+        place_array(left->counts, vmid, sizeof(l64));
+        memcpy(left->counts->arr, leaf->counts->arr, sizeof(l64)*vmid);
+
+        place_array(right->counts, vsize - vmid, sizeof(l64));
+        memcpy(right->counts->arr, ((l64 *)leaf->counts->arr)+vmid, sizeof(l64) * (vsize - vmid));
+    }
+
+    // set {next} of all relevant nodes
+    if (leaf->prev != NULL) {
+        leaf->prev->next = left;
+    }
+    left->next = right;
+    right->next = leaf->next;
+
+    // set {prev} of all relevant nodes
+    if (leaf->next != NULL) {
+        leaf->next->prev = right;
+    }
+    right->prev = left;
+    left->prev = leaf->prev;
+
+    // free leaf
+    BPlusNode_free(heap, leaf);
+
+    return new_parent_ix;
+
+}
+
+// helper function for replacing a node that has just been split, in the
+// tree at {*root} with at most {b} children per branch, by its halves {left}
+// and {right}, separated by {new_parent_ix}; every ancestor that overflows as
+// a result is split in turn, with new branches taken from {heap}.
+// {path} is the root-to-leaf path recorded by BPlusNode_search() when the
+// split node was found, and {spares} the branches taken for it by
+// BPlusBranch_init_spares() beforehand. If the root itself splits, the tree
+// grows a level and {*root} is replaced.
+// Returns the number of branches that were split.
+int BPlusNode_split_up(BPlusHeap *heap, BPlusNode **root, int b, BPlusPath *path, BPlusNode *spares, BPlusNode *left, BPlusNode *right, l64 new_parent_ix) {
+
+    BPlusNode *parent;
+    int level = path->depth - 1, ix, nsplits = 0;
+
+    while (1) {
+
+        if (level < 0) {
+            // we split the root, grow the tree by one level
+            *root = BPlusBranch_take_spare(&spares);
+            insert_BPlusNode((*root)->children, 0, left);
+            insert_BPlusNode((*root)->children, 1, right);
+            insert_l64((*root)->indices, 0, new_parent_ix);
+            return nsplits;
+        }
+
+        // replace the split node in its parent with its 2 halves
+        parent = path->nodes[level];
+        ix = path->slots[level];
+        ((BPlusNode **)parent->children->arr)[ix] = right;
+        insert_BPlusNode(parent->children, ix, left);
+        insert_l64(parent->indices, ix, new_parent_ix);
+
+        if (parent->children->size <= b) {
+            return nsplits;
+        }
+
+        new_parent_ix = BPlusBranch_split(heap, &spares, parent, &left, &right);
+        nsplits++;
+        level--;
+
+    }
+
+}
+
+// helper for BPlusBuild_init(): returns the number of branches needed at
+// height {h} and below to hold {nleaves} leaves.
+int BPlusBuild_count(BPlusBuild *build, int h, int nleaves) {
+
+    int c, count = 1;
+
+    if (h == 0) {
+        return 0;
+    }
+    if (h == 1) {
+        return 1;
+    }
+
+    c = (int)((nleaves + build->span[h-1] - 1) / build->span[h-1]);
+    for (int jx = 0; jx < c; jx++) {
+        count += BPlusBuild_count(
+            build,
+            h-1,
+            (int)((long long)nleaves*(jx+1)/c - (long long)nleaves*jx/c)
+        );
+    }
+
+    return count;
+
+}
+
+// helper for BPlusBuild_finish(): lays out the branch at height {h} covering
+// leaves [{lo}, {hi}), and all branches beneath it, in depth-first order.
+BPlusNode *BPlusBuild_branch(BPlusBuild *build, int h, int lo, int hi) {
+
+    BPlusNode *branch, *child;
+    int c, clo, chi, count = hi - lo;
+
+    if (h == 0) {
+        return build->leaves[lo];
+    }
+
+    branch = BPlusNode_layout(build->branches, build->b, 0, sizeof(l64));
+    branch->flags |= BPLUSNODE_ARENA;
+    build->branches += BPlusNode_nbytes(build->b, sizeof(l64));
+
+    c = (int)((count + build->span[h-1] - 1) / build->span[h-1]);
+    for (int jx = 0; jx < c; jx++) {
+        clo = lo + (int)((long long)count*jx/c);
+        chi = lo + (int)((long long)count*(jx+1)/c);
+        child = BPlusBuild_branch(build, h-1, clo, chi);
+        insert_BPlusNode(branch->children, jx, child);
+        if (jx > 0) {
+            // the separator is the first key of the leftmost leaf of {child}
+            insert_l64(branch->indices, jx-1, build->keys[(long long)build->n*clo/build->nleaves]);
+        }
+    }
+
+    return branch;
+
+}
+
+// helper for BPlusBuild_init(): returns the bytes per hash of leaf {ix},
+// which holds keys [{lo}, {hi}) of {build}, and sets {lo} and {hi}.
+// In a compressed tree each leaf is packed as tightly as its own keys allow,
+// so the leaves are not all the same size.
+int BPlusBuild_leaf_width(BPlusBuild *build, int ix, int *lo, int *hi) {
+
+    *lo = (int)((long long)build->n*ix/build->nleaves);
+    *hi = (int)((long long)build->n*(ix+1)/build->nleaves);
+
+    if (build->compress && *hi > *lo) {
+        return BPlusLeaf_width_for(build->keys[*lo], build->keys[*hi-1]);
+    }
+
+    return sizeof(l64);
+
+}
+
+// lays out run {task} of the {build->ntasks}
+// runs of leaves in the {BPlusBuild} {arg}.
+// Runs share nothing but read-only state, so they may be laid out by
+// different threads (see BPlusPool_run()); the leaves are linked together
+// once they are all done.
+void BPlusBuild_leaves(void *arg, int task) {
+
+    BPlusBuild *build = (BPlusBuild *)arg;
+    BPlusNode *leaf;
+    int lo, hi, width,
+        first = (int)((long long)build->nleaves*task/build->ntasks),
+        last = (int)((long long)build->nleaves*(task+1)/build->ntasks);
+
+    // fill the leaves, spreading the keys evenly between them
+    for (int ix = first; ix < last; ix++) {
+        width = BPlusBuild_leaf_width(build, ix, &lo, &hi);
+        leaf = BPlusNode_layout(build->leaf_mem + build->offsets[ix], build->b, 1, width);
+        leaf->flags |= BPLUSNODE_ARENA;
+        BPlusLeaf_set_keys(leaf, build->keys+lo, hi - lo, hi > lo ? build->keys[lo] : 0);
+        place_array(leaf->values, hi - lo, sizeof(void *));
+        if (build->values != NULL) {
+            memcpy(leaf->values->arr, build->values+lo, sizeof(void *) * (hi - lo));
+        } else {
+            // a tree built without values (an unboxed tree) has empty slots
+            memset(leaf->values->arr, 0, sizeof(void *) * (hi - lo));
+        }
+        build->leaves[ix] = leaf;
+    }
+
+}
+
+// sets up {build} to lay out a tree with at most {b} children per branch
+// from the {n} sorted, unique {keys} and their {values} (NULL to leave every
+// slot empty), filling each node to {fill_factor} of its capacity. With
+// {compress}, each leaf packs its hashes as tightly as its own keys allow.
+// Allocates the arena {build->mem}, of {build->nbytes} bytes, that every node
+// will be laid out in (with {BPlusHeap_allocator}, which must also free it),
+// and splits the leaves into runs for {nthreads} threads.
+// The leaves are then laid out by calling BPlusBuild_leaves() for each of the
+// {build->ntasks} runs, in any order and on any thread, and the tree is
+// finished by BPlusBuild_finish().
+// Returns 0 on success, or -1 if out of memory, with nothing left allocated.
+int BPlusBuild_init(BPlusBuild *build, int b, int compress, l64 *keys, void **values, int n, double fill_factor, int nthreads) {
+
+    int per_leaf, nleaves, nbranches, lo, hi;
+    size_t branch_nbytes, leaf_nbytes = 0;
+
+    per_leaf = (int)(b * fill_factor);
+    if (per_leaf < 1) per_leaf = 1;
+    if (per_leaf > b) per_leaf = b;
+
+    build->b = b;
+    build->fanout = per_leaf < 2 ? 2 : per_leaf;
+    build->keys = keys;
+    build->n = n;
+    build->values = values;
+    build->compress = compress;
+
+    nleaves = n == 0 ? 1 : (n + per_leaf - 1) / per_leaf;
+    build->nleaves = nleaves;
+
+    // the root is always a branch, even if there is only one leaf
+    build->span[0] = 1;
+    build->height = 1;
+    build->span[1] = build->fanout;
+    while (build->span[build->height] < nleaves) {
+        build->height++;
+        build->span[build->height] = build->span[build->height-1] * build->fanout;
+    }
+
+    nbranches = BPlusBuild_count(build, build->height, nleaves);
+    branch_nbytes = BPlusNode_nbytes(b, sizeof(l64)) * nbranches;
+
+    build->mem = NULL;
+    build->offsets = (size_t *)malloc(sizeof(size_t) * nleaves);
+    build->leaves = (BPlusNode **)malloc(sizeof(BPlusNode *) * nleaves);
+    if (build->offsets == NULL || build->leaves == NULL) {
+        goto fail;
+    }
+
+    for (int ix = 0; ix < nleaves; ix++) {
+        build->offsets[ix] = leaf_nbytes;
+        leaf_nbytes += BPlusNode_nbytes(b, BPlusBuild_leaf_width(build, ix, &lo, &hi));
+    }
+
+    build->nbytes = branch_nbytes + leaf_nbytes;
+    if ((build->mem = (char *)BPlusHeap_allocator.malloc(build->nbytes)) == NULL) {
+        goto fail;
+    }
+    build->branches = build->mem;
+    build->leaf_mem = build->mem + branch_nbytes;
+
+    // a few runs per thread, so that threads which finish early can pick up
+    // more work
+    build->ntasks = nthreads > 1 ? 4 * nthreads : 1;
+    if (build->ntasks > nleaves) build->ntasks = nleaves;
+
+    return 0;
+
+fail:
+    free(build->offsets);
+    free(build->leaves);
+    return -1;
+
+}
+
+// links the leaves laid out by BPlusBuild_leaves() together, lays out the
+// branches above them, and releases the scratch arrays of {build}.
+// Returns the root of the new tree, whose nodes all live in {build->mem}.
+BPlusNode *BPlusBuild_finish(BPlusBuild *build) {
+
+    BPlusNode *root;
+
+    for (int ix = 1; ix < build->nleaves; ix++) {
+        build->leaves[ix]->prev = build->leaves[ix-1];
+        build->leaves[ix-1]->next = build->leaves[ix];
+    }
+
+    root = BPlusBuild_branch(build, build->height, 0, build->nleaves);
+
+    free(build->offsets);
+    free(build->leaves);
+
+    return root;
+
+}
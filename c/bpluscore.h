@@ -0,0 +1,222 @@
+// The types and functions of the CPython-independent core of the B-Plus Tree.
+// See bpluscore.c for documentation on the methods declared in this file.
+// Nothing here needs Python.h, so the core can be built and measured without
+// the interpreter (see bench/bench_core.c).
+
+
+#ifndef BPLUSCORE_H
+#define BPLUSCORE_H
+
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// convenience type for storing hashes
+typedef long long int l64;
+
+
+// convenience type for representing arrays
+// we'll have {Array32} objects storing {l64}, value slots ({PyObject *} in a
+// BPlusTree), and {BPlusNode *}.
+// {arr} points at the first of {size} elements inside a buffer with room for
+// {capacity} elements. The buffer keeps {head} free slots before {arr} (and
+// {capacity} - {head} - {size} after it) so that inserts only need to shift
+// the shorter side of the array.
+typedef struct Array32 {
+    void *arr;
+    int size;
+    int head;
+    int capacity;
+} Array32;
+
+
+// Our basic node object.
+// May be either a "leaf node" (no child nodes) or a "branch node" (has child
+// nodes).
+//  1. All nodes have {indices} which is an {Array32} storing {l64} hashes.
+//  2. Nodes do not point back at their parent; operations that need to walk
+//      back up the tree use the {BPlusPath} recorded on the way down.
+//  3. "branches" have {children} which is an {Array32} storing {BPlusNode *}.
+//  4. "leaves" have {values} which is an {Array32} of opaque value slots; in
+//      a BPlusTree they hold the {PyObject *} elements (see bplusnode.c).
+//  5. "leaves" also have {prev} and {next}, which are pointers to the
+//      neighboring leaves.
+//  6. {flags} is a bitmask of the BPLUSNODE_* flags below.
+//  7. {width} is the number of bytes per entry of {indices}. Branches always
+//      store raw {l64} hashes ({width} of 8). A leaf of a compressed tree may
+//      instead store each hash as an unsigned offset from {base} in 1, 2 or 4
+//      bytes (see BPlusLeaf_key() in bpluscore.c).
+//  8. leaves of a {BPlusCountedTree} also have {counts}, an {Array32} storing
+//      an {l64} count for each of {values}. It is NULL for every other node.
+// A node and its arrays live in a single block of memory (see
+// BPlusNode_layout() in bpluscore.c).
+typedef struct BPlusNode {
+    Array32 *indices;
+    Array32 *values;
+    Array32 *children;
+    struct BPlusNode *prev;
+    struct BPlusNode *next;
+    Array32 *counts;
+    int flags;
+    int width;
+    l64 base;
+} BPlusNode;
+
+
+// set on nodes that were carved out of a tree's {arena} by compaction.
+// these must not be passed to free(); their memory is released along with the
+// arena.
+#define BPLUSNODE_ARENA 1
+// set on the root leaf stored inside a small {BPlusTree} object itself.
+// like arena nodes, it must not be passed to free().
+#define BPLUSNODE_INLINE 2
+// set on nodes taken from the small allocator of {BPlusHeap_allocator}, which
+// must be given back to it.
+#define BPLUSNODE_SMALL 4
+// set on nodes taken from the reserved blocks of their {BPlusHeap}, which go
+// back to it rather than to an allocator.
+#define BPLUSNODE_POOL 8
+
+
+// the functions node memory is taken from and given back to.
+// Blocks of at most {small_nbytes} bytes come from {small_malloc} and go back
+// to {small_free}; all others, and every arena, from {malloc} and {free}.
+// {small_nbytes} may change at any time, since each node records which
+// allocator it came from (see BPLUSNODE_SMALL); {malloc} may be called from
+// any thread.
+typedef struct BPlusAllocator {
+    void *(*malloc)(size_t nbytes);
+    void (*free)(void *mem);
+    void *(*small_malloc)(size_t nbytes);
+    void (*small_free)(void *mem);
+    size_t small_nbytes;
+} BPlusAllocator;
+
+
+// the node memory of a single tree: {nbytes} is the number of bytes of nodes
+// taken from it (see BPlusHeap_alloc() in bpluscore.c) and not yet given
+// back, so that the size of a tree can be read without walking it. Nodes laid
+// out in an arena or inline are not counted.
+// A heap may also hold blocks of {pool_nbytes} bytes set aside for nodes by
+// BPlusHeap_reserve(): {pool} is the list of the {pool_free} free ones, linked
+// through their first word, and {chunks} the list of the allocations they
+// were carved from, {pool_used} of whose blocks are in use. The chunks are
+// counted in {nbytes} in full.
+typedef struct BPlusHeap {
+    size_t nbytes;
+    void *pool;
+    void *chunks;
+    size_t pool_nbytes;
+    size_t pool_free;
+    size_t pool_used;
+} BPlusHeap;
+
+
+// number of levels a {BPlusPath} can record before it needs to allocate.
+// typical trees are only a handful of levels deep, but with {b} of 2 a tree
+// built from sorted input grows a level for every element.
+#define BPLUS_PATH_INLINE 32
+
+
+// root-to-leaf path recorded by BPlusNode_search().
+// {nodes}[i] is the branch at depth i (the root is at depth 0) and {slots}[i]
+// is the index of the child that was descended into from it. {depth} is the
+// number of branches on the path.
+// {nodes} and {slots} point at the inline arrays until the path outgrows
+// them; see BPlusPath_init() and BPlusPath_free() in bpluscore.c.
+typedef struct BPlusPath {
+    BPlusNode **nodes;
+    int *slots;
+    int depth;
+    int capacity;
+    BPlusNode *nodes_inline[BPLUS_PATH_INLINE];
+    int slots_inline[BPLUS_PATH_INLINE];
+} BPlusPath;
+
+
+// scratch state used while laying out a tree from sorted keys (see
+// BPlusBuild_init() in bpluscore.c).
+//  1. {span}[h] is the maximum number of leaves beneath a node at height {h}
+//      (leaves are at height 0).
+//  2. {branches} points into the arena; branches are handed out in
+//      depth-first order.
+//  3. {leaves} holds the already laid out leaves in key order, and {keys} and
+//      {n} are the keys being built from.
+//  4. leaf i is laid out at {offsets}[i] bytes into {leaf_mem}, from {keys}
+//      and {values} (NULL for an unboxed tree). The leaves are split into
+//      {ntasks} runs which may be laid out in parallel (see
+//      BPlusBuild_leaves() in bpluscore.c).
+//  5. every node is laid out in {mem}, of {nbytes} bytes, with the branches
+//      first; the root is at height {height}.
+typedef struct BPlusBuild {
+    int b;
+    int fanout;
+    long long span[64];
+    char *branches;
+    BPlusNode **leaves;
+    int nleaves;
+    l64 *keys;
+    int n;
+    void **values;
+    int compress;
+    char *leaf_mem;
+    size_t *offsets;
+    int ntasks;
+    int height;
+    char *mem;
+    size_t nbytes;
+} BPlusBuild;
+
+
+// BEGIN BPlusHeap globals and functions
+extern BPlusAllocator BPlusHeap_allocator;
+void *BPlusHeap_alloc(BPlusHeap *heap, size_t nbytes, int *flags);
+void BPlusHeap_give(BPlusHeap *heap, void *mem, size_t nbytes, int flags);
+int BPlusHeap_reserve(BPlusHeap *heap, size_t nbytes, size_t n);
+void BPlusHeap_trim(BPlusHeap *heap);
+
+
+// BEGIN BPlusNode helper functions
+size_t BPlusNode_nbytes(int b, int width);
+size_t BPlusNode_count_for(int b, size_t n);
+size_t BPlusNode_size(BPlusNode *node);
+BPlusNode *BPlusNode_layout(void *mem, int b, int is_leaf, int width);
+BPlusNode *BPlusLeaf_init(BPlusHeap *heap, int b);
+BPlusNode *BPlusLeaf_init_counted(BPlusHeap *heap, int b);
+BPlusNode *BPlusLeaf_init_packed(BPlusHeap *heap, int b, l64 base, int width);
+BPlusNode *BPlusBranch_init(BPlusHeap *heap, int b);
+BPlusNode *BPlusBranch_init_counted(BPlusHeap *heap, int b);
+void BPlusNode_free(BPlusHeap *heap, BPlusNode *node);
+void BPlusNode_free_tree(BPlusHeap *heap, BPlusNode *node);
+size_t BPlusNode_count_heap(BPlusNode *node);
+void BPlusPath_init(BPlusPath *path);
+void BPlusPath_free(BPlusPath *path);
+int BPlusPath_grow(BPlusPath *path);
+BPlusNode *BPlusNode_search(BPlusNode *root, l64 key, BPlusPath *path);
+int BPlusLeaf_width_for(l64 lo, l64 hi);
+l64 BPlusLeaf_key(BPlusNode *leaf, int ix);
+void BPlusLeaf_get_keys(BPlusNode *leaf, l64 *out);
+void BPlusLeaf_set_keys(BPlusNode *leaf, l64 *keys, int n, l64 base);
+int BPlusLeaf_fits(BPlusNode *leaf, l64 key);
+int BPlusLeaf_bisect_left(BPlusNode *leaf, l64 key);
+int BPlusLeaf_insert_key(BPlusNode *leaf, int ix, l64 key);
+int BPlusBranch_init_spares(BPlusHeap *heap, int b, BPlusPath *path, int counted, BPlusNode **spares);
+void BPlusBranch_free_spares(BPlusHeap *heap, BPlusNode *spares);
+BPlusNode *BPlusBranch_take_spare(BPlusNode **spares);
+l64 BPlusBranch_split(BPlusHeap *heap, BPlusNode **spares, BPlusNode *branch, BPlusNode **left, BPlusNode **right);
+l64 BPlusLeaf_split_at(BPlusHeap *heap, BPlusNode *leaf, BPlusNode *left, BPlusNode *right);
+int BPlusNode_split_up(BPlusHeap *heap, BPlusNode **root, int b, BPlusPath *path, BPlusNode *spares, BPlusNode *left, BPlusNode *right, l64 new_parent_ix);
+
+
+// BEGIN BPlusBuild functions
+int BPlusBuild_init(BPlusBuild *build, int b, int compress, l64 *keys, void **values, int n, double fill_factor, int nthreads);
+int BPlusBuild_count(BPlusBuild *build, int h, int nleaves);
+int BPlusBuild_leaf_width(BPlusBuild *build, int ix, int *lo, int *hi);
+void BPlusBuild_leaves(void *arg, int task);
+BPlusNode *BPlusBuild_branch(BPlusBuild *build, int h, int lo, int hi);
+BPlusNode *BPlusBuild_finish(BPlusBuild *build);
+
+
+#endif
@@ -0,0 +1,869 @@
+// BPlusCountedTree method definitions.
+// A BPlusCountedTree is a multiset laid out like a BPlusTree. Each leaf keeps
+// a count beside each of its values (see BPlusLeaf_init_counted() in
+// bpluscore.c), so adding an element that is already in the tree takes one
+// descent and an integer increment, and the element is stored only once no
+// matter how many times it is added.
+#include <Python.h>
+#include "structmember.h"
+#include "bplustypes.h"
+#include "general.h"
+#include "array32.h"
+#include "bplusnode.h"
+#include "bpluscounted.h"
+
+
+// define our subslot for BPlusCountedTree number methods
+static PyNumberMethods BPlusCountedTree_nb_methods = {
+    BPlusCountedTree_nb_add,                    /*nb_add*/
+    BPlusCountedTree_nb_subtract,               /*nb_subtract*/
+};
+
+
+// define our subslot for BPlusCountedTree sequence methods
+static PySequenceMethods BPlusCountedTree_sq_methods = {
+    (lenfunc)BPlusCountedTree_sq_length,        /*sq_length*/
+    0,                                          /*sq_concat*/
+    0,                                          /*sq_repeat*/
+    0,                                          /*sq_item*/
+    0,                                          /*was_sq_slice*/
+    0,                                          /*sq_ass_item (???)*/
+    0,                                          /*was_sq_ass_slice (???)*/
+    BPlusCountedTree_sq_contains,               /*sq_contains*/
+    0,                                          /*sq_inplace_concat*/
+    0,                                          /*sq_inplace_repeat*/
+};
+
+
+// define our subslot for BPlusCountedTree mapping methods
+static PyMappingMethods BPlusCountedTree_mp_methods = {
+    (lenfunc)BPlusCountedTree_sq_length,        /*mp_length*/
+    BPlusCountedTree_mp_subscript,              /*mp_subscript*/
+    0,                                          /*mp_ass_subscript*/
+};
+
+
+// define our subslot for BPlusCountedTree public methods
+static PyMethodDef BPlusCountedTree_tp_methods[] = {
+    {"get_b", BPlusCountedTree_method_get_b, METH_NOARGS, "Return the maximum child nodes per node in the tree."},
+    {"__sizeof__", BPlusCountedTree_method_sizeof, METH_NOARGS, "Returns the size of the tree in memory, in bytes, including its nodes but not its elements."},
+    {"add", (PyCFunction)BPlusCountedTree_method_add, METH_VARARGS | METH_KEYWORDS, "Takes object {o} and adds {n} to its count in the tree."},
+    {"update", BPlusCountedTree_method_update, METH_VARARGS, "Adds the counts of a mapping or multiset {iterable}, or 1 for each element of any other iterable."},
+    {"count", BPlusCountedTree_method_count, METH_VARARGS, "Return the number of times {o} has been added to the tree."},
+    {"total", BPlusCountedTree_method_total, METH_NOARGS, "Return the sum of the counts of every element in the tree."},
+    {"items", BPlusCountedTree_method_items, METH_NOARGS, "Return a list of (element, count) tuples, in iteration order."},
+    {"most_common", BPlusCountedTree_method_most_common, METH_VARARGS, "Return a list of the {n} most common (element, count) tuples, most common first; all of them if {n} is None."},
+    {NULL, NULL, 0, NULL}
+};
+
+
+// define our BPlusCountedTreeType type object
+PyTypeObject BPlusCountedTreeType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "five_one_one_bplus.c.BPlusCountedTree",    /*tp_name*/
+    sizeof(BPlusCountedTree),                   /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)BPlusCountedTree_tp_dealloc,    /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    &BPlusCountedTree_nb_methods,               /*tp_as_number*/
+    &BPlusCountedTree_sq_methods,               /*tp_as_sequence*/
+    &BPlusCountedTree_mp_methods,               /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   /*tp_flags*/
+    0,                                          /*tp_doc*/
+    0,                                          /*tp_traverse*/
+    0,                                          /*tp_clear*/
+    0,                                          /*tp_richcompare*/
+    0,                                          /*tp_weaklistoffset*/
+    (getiterfunc)BPlusCountedTree_tp_iter,      /*tp_iter*/
+    0,                                          /*tp_iternext*/
+    BPlusCountedTree_tp_methods,                /*tp_methods*/
+    0,                                          /*tp_members*/
+    0,                                          /*tp_getsets*/
+    0,                                          /*tp_base*/
+    0,                                          /*tp_dict*/
+    0,                                          /*tp_descr_get*/
+    0,                                          /*tp_descr_set*/
+    0,                                          /*tp_dictoffset*/
+    (initproc)BPlusCountedTree_tp_init,         /*tp_init*/
+    0,                                          /*tp_alloc*/
+    BPlusCountedTree_tp_new,                    /*tp_new*/
+};
+
+
+// BEGIN tp method definitions
+// the root is made here, with the default {b}, so that a tree made by
+// __new__() alone is still a valid empty tree; __init__() replaces it.
+static PyObject *BPlusCountedTree_tp_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs) {
+    BPlusCountedTree *self;
+
+    if ((self = (BPlusCountedTree *)subtype->tp_alloc(subtype, 0)) == NULL) {
+        return NULL;
+    }
+
+    self->b = BPLUS_DEFAULT_B;
+    if ((self->root = BPlusLeaf_init_counted(&self->heap, self->b)) == NULL) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+
+    return (PyObject *)self;
+}
+
+static void BPlusCountedTree_tp_dealloc(BPlusCountedTree *self) {
+    if (self->root != NULL) {
+        BPlusNode_dealloc(&self->heap, self->root);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static int BPlusCountedTree_tp_init(BPlusCountedTree *self, PyObject *args, PyObject *kwargs) {
+
+    int b = BPLUS_DEFAULT_B;
+    PyObject *initializer = Py_None;
+    BPlusNode *root;
+    static char *kwlist[] = {"initializer", "b", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|Oi", kwlist, &initializer, &b)) {
+        return -1;
+    }
+
+    if (b < 2 || 255 < b) {
+        Py_INCREF(PyExc_TypeError);
+        PyErr_SetString(PyExc_TypeError, "BPlusCountedTree Constructor got out of bounds b: needs to be in [2, 255].");
+        return -1;
+    }
+
+    if ((root = BPlusLeaf_init_counted(&self->heap, b)) == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    // release the contents of the tree made by tp_new(), or of a tree that
+    // is being re-initialized
+    BPlusNode_dealloc(&self->heap, self->root);
+    self->root = root;
+    self->size = 0;
+    self->total = 0;
+    self->version++;
+    self->b = b;
+
+    if (initializer != Py_None) {
+        return BPlusCounted_update(self, initializer);
+    }
+
+    return 0;
+
+}
+
+// like BPlusTree, iterates over a list of the distinct elements in hash order
+static PyObject *BPlusCountedTree_tp_iter(PyObject *self) {
+
+    BPlusCountedTree *tree = (BPlusCountedTree *)self;
+    PyObject *elements, *o, *iter;
+    Py_ssize_t jx, n, ix = 0;
+    l64 count;
+
+    if ((elements = PyList_New(tree->size)) == NULL) {
+        return NULL;
+    }
+
+    for (BPlusNode *leaf = BPlusCounted_first_leaf(tree->root); leaf != NULL; leaf = leaf->next) {
+        for (int slot = 0; slot < leaf->values->size; slot++) {
+            n = BPlusCounted_slot_size(leaf, slot);
+            for (jx = 0; jx < n; jx++) {
+                BPlusCounted_slot_item(leaf, slot, jx, &o, &count);
+                Py_INCREF(o);
+                PyList_SET_ITEM(elements, ix++, o);
+            }
+        }
+    }
+
+    iter = PyObject_GetIter(elements);
+    Py_DECREF(elements);
+
+    return iter;
+
+}
+
+
+// BEGIN number, sequence and mapping method definitions
+// this is called on use of the `+` operator
+static PyObject *BPlusCountedTree_nb_add(PyObject *a, PyObject *b) {
+    return BPlusCounted_merge(a, b, 0);
+}
+
+// this is called on use of the `-` operator
+static PyObject *BPlusCountedTree_nb_subtract(PyObject *a, PyObject *b) {
+    return BPlusCounted_merge(a, b, 1);
+}
+
+// this is called on call to len(); like Counter, it counts distinct elements
+Py_ssize_t BPlusCountedTree_sq_length(PyObject *self) {
+    return ((BPlusCountedTree *)self)->size;
+}
+
+// this is called on use of the `in` keyword.
+int BPlusCountedTree_sq_contains(PyObject *self, PyObject *value) {
+
+    l64 count;
+
+    if (BPlusCounted_count((BPlusCountedTree *)self, value, &count) == -1) {
+        return -1;
+    }
+
+    return count > 0;
+
+}
+
+// this is called on use of `tree[key]`, which is the count of {key} (0 if it
+// is not in the tree) as with Counter
+PyObject *BPlusCountedTree_mp_subscript(PyObject *self, PyObject *key) {
+
+    l64 count;
+
+    if (BPlusCounted_count((BPlusCountedTree *)self, key, &count) == -1) {
+        return NULL;
+    }
+
+    return PyLong_FromLongLong(count);
+
+}
+
+
+// BEGIN public method definitions
+static PyObject *BPlusCountedTree_method_get_b(PyObject *self, PyObject *args) {
+    return PyLong_FromLong(((BPlusCountedTree *)self)->b);
+}
+
+static PyObject *BPlusCountedTree_method_sizeof(PyObject *self, PyObject *args) {
+    return PyLong_FromSize_t((size_t)Py_TYPE(self)->tp_basicsize + ((BPlusCountedTree *)self)->heap.nbytes);
+}
+
+static PyObject *BPlusCountedTree_method_add(PyObject *self, PyObject *args, PyObject *kwargs) {
+
+    PyObject *o;
+    l64 n = 1;
+    static char *kwlist[] = {"o", "n", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|L", kwlist, &o, &n)) {
+        return NULL;
+    }
+
+    if (BPlusCounted_add_hashed((BPlusCountedTree *)self, o, n) == -1) {
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+
+}
+
+static PyObject *BPlusCountedTree_method_update(PyObject *self, PyObject *args) {
+
+    PyObject *iterable;
+
+    if (!PyArg_ParseTuple(args, "O", &iterable)) {
+        return NULL;
+    }
+
+    if (BPlusCounted_update((BPlusCountedTree *)self, iterable) == -1) {
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+
+}
+
+static PyObject *BPlusCountedTree_method_count(PyObject *self, PyObject *args) {
+
+    PyObject *o;
+
+    if (!PyArg_ParseTuple(args, "O", &o)) {
+        return NULL;
+    }
+
+    return BPlusCountedTree_mp_subscript(self, o);
+
+}
+
+static PyObject *BPlusCountedTree_method_total(PyObject *self, PyObject *args) {
+    return PyLong_FromLongLong(((BPlusCountedTree *)self)->total);
+}
+
+static PyObject *BPlusCountedTree_method_items(PyObject *self, PyObject *args) {
+
+    BPlusCountedTree *tree = (BPlusCountedTree *)self;
+    PyObject *items, *o, *item;
+    Py_ssize_t jx, n, ix = 0;
+    l64 count;
+
+    if ((items = PyList_New(tree->size)) == NULL) {
+        return NULL;
+    }
+
+    for (BPlusNode *leaf = BPlusCounted_first_leaf(tree->root); leaf != NULL; leaf = leaf->next) {
+        for (int slot = 0; slot < leaf->values->size; slot++) {
+            n = BPlusCounted_slot_size(leaf, slot);
+            for (jx = 0; jx < n; jx++) {
+                BPlusCounted_slot_item(leaf, slot, jx, &o, &count);
+                if ((item = Py_BuildValue("(OL)", o, count)) == NULL) {
+                    Py_DECREF(items);
+                    return NULL;
+                }
+                PyList_SET_ITEM(items, ix++, item);
+            }
+        }
+    }
+
+    return items;
+
+}
+
+// the elements are ordered by descending count with sort_keyed(), which is
+// stable, so elements with equal counts are left in iteration order.
+static PyObject *BPlusCountedTree_method_most_common(PyObject *self, PyObject *args) {
+
+    BPlusCountedTree *tree = (BPlusCountedTree *)self;
+    PyObject *n_obj = Py_None, *result = NULL, *item;
+    Py_ssize_t n = tree->size, jx, slot_size, ix = 0;
+    BPlusPair *pairs, *scratch;
+    l64 count;
+
+    if (!PyArg_ParseTuple(args, "|O", &n_obj)) {
+        return NULL;
+    }
+
+    if (n_obj != Py_None) {
+        if ((n = PyLong_AsSsize_t(n_obj)) == -1 && PyErr_Occurred()) {
+            return NULL;
+        }
+        if (n < 0) {
+            n = 0;
+        } else if (n > tree->size) {
+            n = tree->size;
+        }
+    }
+
+    pairs = (BPlusPair *)malloc(sizeof(BPlusPair) * (tree->size + 1));
+    scratch = (BPlusPair *)malloc(sizeof(BPlusPair) * (tree->size + 1));
+    if (pairs == NULL || scratch == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    // key each (borrowed) element by its negated count, which is at least 1
+    for (BPlusNode *leaf = BPlusCounted_first_leaf(tree->root); leaf != NULL; leaf = leaf->next) {
+        for (int slot = 0; slot < leaf->values->size; slot++) {
+            slot_size = BPlusCounted_slot_size(leaf, slot);
+            for (jx = 0; jx < slot_size; jx++) {
+                BPlusCounted_slot_item(leaf, slot, jx, &pairs[ix].value, &count);
+                pairs[ix++].key = -count;
+            }
+        }
+    }
+
+    sort_keyed(pairs, scratch, tree->size, sizeof(BPlusPair));
+
+    if ((result = PyList_New(n)) == NULL) {
+        goto done;
+    }
+    for (ix = 0; ix < n; ix++) {
+        if ((item = Py_BuildValue("(OL)", pairs[ix].value, -pairs[ix].key)) == NULL) {
+            Py_CLEAR(result);
+            goto done;
+        }
+        PyList_SET_ITEM(result, ix, item);
+    }
+
+done:
+    free(pairs);
+    free(scratch);
+    return result;
+
+}
+
+
+// BEGIN helper function definitions
+
+// returns the leftmost leaf beneath {root}
+BPlusNode *BPlusCounted_first_leaf(BPlusNode *root) {
+    while (root->children != NULL) {
+        root = ((BPlusNode **)root->children->arr)[0];
+    }
+    return root;
+}
+
+// returns the number of distinct elements in slot {ix} of {leaf}: 1, unless
+// their hashes collided, in which case the slot holds a list of them.
+Py_ssize_t BPlusCounted_slot_size(BPlusNode *leaf, int ix) {
+
+    PyObject *v = ((PyObject **)leaf->values->arr)[ix];
+
+    return PyList_CheckExact(v) ? PyList_GET_SIZE(v) : 1;
+
+}
+
+// points {o} at the {jx}th element of slot {ix} of {leaf} (a borrowed
+// reference), and stores its count in {count}.
+void BPlusCounted_slot_item(BPlusNode *leaf, int ix, Py_ssize_t jx, PyObject **o, l64 *count) {
+
+    PyObject *v = ((PyObject **)leaf->values->arr)[ix], *pair;
+
+    if (PyList_CheckExact(v)) {
+        // the counts of colliding elements are ints we made ourselves, so
+        // reading them back cannot fail
+        pair = PyList_GET_ITEM(v, jx);
+        *o = PyList_GET_ITEM(pair, 0);
+        *count = PyLong_AsLongLong(PyList_GET_ITEM(pair, 1));
+    } else {
+        *o = v;
+        *count = ((l64 *)leaf->counts->arr)[ix];
+    }
+
+}
+
+// returns 0 if {tree} has not changed since it was at {version}, or -1 with
+// a RuntimeError set if it has.
+// Comparing elements runs their __eq__, which may add to or re-initialize
+// {tree} and so free the leaves and collision lists its caller is holding
+// on to.
+int BPlusCounted_check_version(BPlusCountedTree *tree, unsigned long long version) {
+    if (tree->version != version) {
+        Py_INCREF(PyExc_RuntimeError);
+        PyErr_SetString(PyExc_RuntimeError, "BPlusCountedTree changed size during a comparison.");
+        return -1;
+    }
+    return 0;
+}
+
+// stores the count of {o} in slot {ix} of {leaf}, a leaf of {tree}, in
+// {count}, which is 0 if {o} is not in the slot.
+// Returns 0 on success, -1 if comparing {o} with an element raised or
+// changed {tree}.
+int BPlusCounted_slot_count(BPlusCountedTree *tree, BPlusNode *leaf, int ix, PyObject *o, l64 *count) {
+
+    Py_ssize_t n = BPlusCounted_slot_size(leaf, ix);
+    unsigned long long version = tree->version;
+    PyObject *element;
+    l64 c;
+    int res;
+
+    *count = 0;
+
+    for (Py_ssize_t jx = 0; jx < n; jx++) {
+        BPlusCounted_slot_item(leaf, ix, jx, &element, &c);
+        if ((res = BPlusNode_equals(o, element)) == -1
+            || BPlusCounted_check_version(tree, version) == -1) {
+            return -1;
+        }
+        if (res) {
+            *count = c;
+            return 0;
+        }
+    }
+
+    return 0;
+
+}
+
+// stores the count of {o} in {tree} in {count}.
+// Returns 0 on success, -1 (with an exception set) on failure.
+int BPlusCounted_count(BPlusCountedTree *tree, PyObject *o, l64 *count) {
+
+    BPlusNode *leaf;
+    l64 key;
+    int ix;
+
+    if ((key = PyObject_Hash(o)) == -1) {
+        Py_INCREF(PyExc_TypeError);
+        PyErr_SetString(PyExc_TypeError, "Got unhashable object.");
+        return -1;
+    }
+
+    leaf = BPlusNode_search(tree->root, key, NULL);
+    ix = BPlusLeaf_bisect_left(leaf, key);
+
+    if (ix < leaf->values->size && BPlusLeaf_key(leaf, ix) == key) {
+        return BPlusCounted_slot_count(tree, leaf, ix, o, count);
+    }
+
+    *count = 0;
+    return 0;
+
+}
+
+// adds {n} to the count of {o}, whose hash is {key}, in {tree}.
+// An element already in the tree costs the one descent to its leaf and an
+// increment of its count; a new one is inserted beside its count, splitting
+// the leaf (and its ancestors) if it overflows.
+// Returns 0 on success, -1 (with an exception set) on failure.
+int BPlusCounted_add(BPlusCountedTree *tree, PyObject *o, l64 key, l64 n) {
+
+    BPlusPath path;
+    BPlusNode *leaf;
+    PyObject **values, *v, *pair, *list;
+    l64 *counts, count;
+    Py_ssize_t jx;
+    unsigned long long version = tree->version;
+    int ix, res;
+
+    if (n < 0) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "BPlusCountedTree can only add a count of 0 or more.");
+        return -1;
+    }
+
+    if (n == 0) {
+        return 0;
+    }
+
+    // no count can exceed {total}, so this guards every count as well
+    if (n > LLONG_MAX - tree->total) {
+        Py_INCREF(PyExc_OverflowError);
+        PyErr_SetString(PyExc_OverflowError, "BPlusCountedTree total count would overflow a 64 bit int.");
+        return -1;
+    }
+
+    BPlusPath_init(&path);
+    if ((leaf = BPlusNode_search(tree->root, key, &path)) == NULL) {
+        BPlusPath_free(&path);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    // a leaf is left holding one more than {tree->b} elements when splitting
+    // it runs out of memory; split it before adding to it
+    if (leaf->values->size > tree->b) {
+        if (BPlusCounted_split(tree, leaf, &path) == -1) {
+            BPlusPath_free(&path);
+            return -1;
+        }
+        BPlusPath_free(&path);
+        BPlusPath_init(&path);
+        if ((leaf = BPlusNode_search(tree->root, key, &path)) == NULL) {
+            BPlusPath_free(&path);
+            PyErr_NoMemory();
+            return -1;
+        }
+    }
+
+    ix = BPlusLeaf_bisect_left(leaf, key);
+    values = (PyObject **)leaf->values->arr;
+    counts = (l64 *)leaf->counts->arr;
+
+    if (ix < leaf->values->size && BPlusLeaf_key(leaf, ix) == key) {
+
+        BPlusPath_free(&path);
+        v = values[ix];
+
+        if (PyList_CheckExact(v)) {
+
+            for (jx = 0; jx < PyList_GET_SIZE(v); jx++) {
+                pair = PyList_GET_ITEM(v, jx);
+                if ((res = BPlusNode_equals(o, PyList_GET_ITEM(pair, 0))) == -1
+                    || BPlusCounted_check_version(tree, version) == -1) {
+                    return -1;
+                }
+                if (res) {
+                    count = PyLong_AsLongLong(PyList_GET_ITEM(pair, 1));
+                    if (PyList_SetItem(pair, 1, PyLong_FromLongLong(count + n)) == -1) {
+                        return -1;
+                    }
+                    tree->total += n;
+                    return 0;
+                }
+            }
+
+            if ((pair = Py_BuildValue("[OL]", o, n)) == NULL) {
+                return -1;
+            }
+            res = PyList_Append(v, pair);
+            Py_DECREF(pair);
+            if (res == -1) {
+                return -1;
+            }
+
+        } else {
+
+            if ((res = BPlusNode_equals(o, v)) == -1
+                || BPlusCounted_check_version(tree, version) == -1) {
+                return -1;
+            }
+            if (res) {
+                counts[ix] += n;
+                tree->total += n;
+                return 0;
+            }
+
+            // a hash collision: the slot now holds a list of [element, count]
+            if ((list = Py_BuildValue("[[OL][OL]]", v, counts[ix], o, n)) == NULL) {
+                return -1;
+            }
+            Py_DECREF(v);
+            values[ix] = list;
+            counts[ix] = 0;
+
+        }
+
+        tree->size++;
+        tree->total += n;
+        tree->version++;
+        return 0;
+
+    }
+
+    insert_l64(leaf->indices, ix, key);
+    insert_PyObject(leaf->values, ix, o);
+    insert_l64(leaf->counts, ix, n);
+    tree->size++;
+    tree->total += n;
+    tree->version++;
+
+    // {o} stays in the tree even if the split fails
+    if (leaf->values->size > tree->b && BPlusCounted_split(tree, leaf, &path) == -1) {
+        BPlusPath_free(&path);
+        return -1;
+    }
+
+    BPlusPath_free(&path);
+    return 0;
+
+}
+
+// convenience method for hashing {o} and adding {n} to its count
+int BPlusCounted_add_hashed(BPlusCountedTree *tree, PyObject *o, l64 n) {
+
+    l64 key;
+
+    if ((key = PyObject_Hash(o)) == -1) {
+        Py_INCREF(PyExc_TypeError);
+        PyErr_SetString(PyExc_TypeError, "Got unhashable object.");
+        return -1;
+    }
+
+    return BPlusCounted_add(tree, o, key, n);
+
+}
+
+// adds the counts of {iterable} to {tree}: each element of another
+// BPlusCountedTree with its count, each key of a dict (such as a Counter)
+// with its value, and each element of any other iterable once.
+// Returns 0 on success, -1 (with an exception set) on failure.
+int BPlusCounted_update(BPlusCountedTree *tree, PyObject *iterable) {
+
+    PyObject *o, *value, *iterator;
+    Py_ssize_t pos = 0, jx, n;
+    l64 count;
+
+    if (PyObject_TypeCheck(iterable, &BPlusCountedTreeType)) {
+
+        // the source is already grouped by hash, so no element is hashed
+        // again. Adding an element compares it with those of {tree}, which
+        // may change the source under us.
+        BPlusCountedTree *source = (BPlusCountedTree *)iterable;
+        unsigned long long version = source->version;
+        BPlusNode *leaf = BPlusCounted_first_leaf(source->root);
+        for (; leaf != NULL; leaf = leaf->next) {
+            for (int slot = 0; slot < leaf->values->size; slot++) {
+                n = BPlusCounted_slot_size(leaf, slot);
+                for (jx = 0; jx < n; jx++) {
+                    BPlusCounted_slot_item(leaf, slot, jx, &o, &count);
+                    if (BPlusCounted_add(tree, o, BPlusLeaf_key(leaf, slot), count) == -1
+                        || BPlusCounted_check_version(source, version) == -1) {
+                        return -1;
+                    }
+                }
+            }
+        }
+
+        return 0;
+
+    }
+
+    if (PyDict_Check(iterable)) {
+
+        while (PyDict_Next(iterable, &pos, &o, &value)) {
+            if ((count = PyLong_AsLongLong(value)) == -1 && PyErr_Occurred()) {
+                return -1;
+            }
+            if (BPlusCounted_add_hashed(tree, o, count) == -1) {
+                return -1;
+            }
+        }
+
+        return 0;
+
+    }
+
+    if ((iterator = PyObject_GetIter(iterable)) == NULL) {
+        return -1;
+    }
+
+    while ((o = PyIter_Next(iterator)) != NULL) {
+        if (BPlusCounted_add_hashed(tree, o, 1) == -1) {
+            Py_DECREF(o);
+            Py_DECREF(iterator);
+            return -1;
+        }
+        Py_DECREF(o);
+    }
+
+    Py_DECREF(iterator);
+
+    return PyErr_Occurred() ? -1 : 0;
+
+}
+
+// helper function for splitting a saturated counted leaf into 2 leaves (see
+// BPlusLeaf_split_at() in bpluscore.c, which carries the counts along with
+// the values) and then, walking back up {path}, every ancestor that
+// overflows as a result.
+// Returns 0 on success, or -1 with a MemoryError set, in which case the tree
+// is left as it was.
+int BPlusCounted_split(BPlusCountedTree *tree, BPlusNode *leaf, BPlusPath *path) {
+
+    BPlusNode *left = NULL, *right = NULL, *spares;
+    int size = leaf->values->size, mid = size / 2;
+    l64 new_parent_ix;
+
+    if (BPlusBranch_init_spares(&tree->heap, tree->b, path, 0, &spares) == -1) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    if ((left = BPlusLeaf_init_counted(&tree->heap, tree->b)) == NULL
+        || (right = BPlusLeaf_init_counted(&tree->heap, tree->b)) == NULL) {
+        if (left != NULL) {
+            BPlusNode_free(&tree->heap, left);
+        }
+        BPlusBranch_free_spares(&tree->heap, spares);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    BPlusLeaf_set_keys(left, (l64 *)leaf->indices->arr, mid, 0);
+    BPlusLeaf_set_keys(right, ((l64 *)leaf->indices->arr)+mid, size - mid, 0);
+    new_parent_ix = BPlusLeaf_split_at(&tree->heap, leaf, left, right);
+
+    BPlusNode_split_up(&tree->heap, &tree->root, tree->b, path, spares, left, right, new_parent_ix);
+
+    return 0;
+
+}
+
+// adds each element in slot {ix} of {leaf} to {result} with its count, less
+// its count in slot {minus_ix} of {minus} if {minus} is not NULL. Elements
+// left with a count below 1 are skipped.
+// {leaf} and {minus} are leaves of the trees {a} and {b} being merged (see
+// BPlusCounted_merge()); either may be changed by the comparisons made here.
+// Returns 0 on success, -1 (with an exception set) on failure.
+int BPlusCounted_emit(BPlusCountedTree *result, BPlusCountedTree *a, BPlusCountedTree *b, BPlusNode *leaf, int ix, BPlusNode *minus, int minus_ix) {
+
+    Py_ssize_t n = BPlusCounted_slot_size(leaf, ix);
+    unsigned long long version_a = a->version, version_b = b->version;
+    PyObject *o;
+    l64 count, other;
+
+    for (Py_ssize_t jx = 0; jx < n; jx++) {
+        BPlusCounted_slot_item(leaf, ix, jx, &o, &count);
+        if (minus != NULL) {
+            if (BPlusCounted_slot_count(b, minus, minus_ix, o, &other) == -1) {
+                return -1;
+            }
+            count -= other;
+        }
+        if (count > 0 && BPlusCounted_add(result, o, BPlusLeaf_key(leaf, ix), count) == -1) {
+            return -1;
+        }
+        if (BPlusCounted_check_version(a, version_a) == -1 || BPlusCounted_check_version(b, version_b) == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+
+}
+
+// returns a new tree of the type of {a} holding the sum ({subtract} of 0) or
+// the difference ({subtract} of 1, dropping counts below 1) of {a} and {b}.
+// Both leaf chains are walked together in hash order, so only slots whose
+// hashes match in both trees compare any elements, and the result is built
+// in hash order too.
+PyObject *BPlusCounted_merge(PyObject *a, PyObject *b, int subtract) {
+
+    BPlusCountedTree *result, *ta = (BPlusCountedTree *)a, *tb = (BPlusCountedTree *)b;
+    BPlusNode *la, *lb;
+    int ia = 0, ib = 0, res;
+    l64 ka, kb;
+
+    if (!PyObject_TypeCheck(a, &BPlusCountedTreeType) || !PyObject_TypeCheck(b, &BPlusCountedTreeType)) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+
+    // the result is allocated without calling __init__, so that subclasses
+    // with other constructor signatures still get a result of their own type
+    if ((result = (BPlusCountedTree *)Py_TYPE(a)->tp_alloc(Py_TYPE(a), 0)) == NULL) {
+        return NULL;
+    }
+    result->b = ((BPlusCountedTree *)a)->b;
+    if ((result->root = BPlusLeaf_init_counted(&result->heap, result->b)) == NULL) {
+        Py_DECREF(result);
+        return PyErr_NoMemory();
+    }
+
+    la = BPlusCounted_first_leaf(ta->root);
+    lb = BPlusCounted_first_leaf(tb->root);
+
+    while (1) {
+
+        // step over the ends of leaves (and the empty root of an empty tree)
+        while (la != NULL && ia == la->values->size) {
+            la = la->next;
+            ia = 0;
+        }
+        while (lb != NULL && ib == lb->values->size) {
+            lb = lb->next;
+            ib = 0;
+        }
+
+        if (la == NULL && lb == NULL) {
+            break;
+        }
+
+        ka = la != NULL ? BPlusLeaf_key(la, ia) : 0;
+        kb = lb != NULL ? BPlusLeaf_key(lb, ib) : 0;
+
+        if (lb == NULL || (la != NULL && ka < kb)) {
+            res = BPlusCounted_emit(result, ta, tb, la, ia++, NULL, 0);
+        } else if (la == NULL || kb < ka) {
+            res = subtract ? 0 : BPlusCounted_emit(result, ta, tb, lb, ib, NULL, 0);
+            ib++;
+        } else if (subtract) {
+            res = BPlusCounted_emit(result, ta, tb, la, ia++, lb, ib++);
+        } else {
+            res = BPlusCounted_emit(result, ta, tb, la, ia++, NULL, 0);
+            if (res == 0) {
+                res = BPlusCounted_emit(result, ta, tb, lb, ib, NULL, 0);
+            }
+            ib++;
+        }
+
+        if (res == -1) {
+            Py_DECREF(result);
+            return NULL;
+        }
+
+    }
+
+    return (PyObject *)result;
+
+}
@@ -0,0 +1,63 @@
+// Definitions of public and private methods used by BPlusCountedTree.
+// See bpluscounted.c for documentation on the methods declared in this file.
+
+
+#ifndef BPLUSCOUNTED_H
+#define BPLUSCOUNTED_H
+
+
+#include <Python.h>
+#include "structmember.h"
+#include "bplustypes.h"
+#include "general.h"
+#include "array32.h"
+#include "bplusnode.h"
+
+
+// BEGIN types and functions defined in other files
+// the type object is registered with the module by PyInit_c() in bplustree.c
+extern PyTypeObject BPlusCountedTreeType;
+
+
+// BEGIN BPlusCountedTree private helper method headers
+static BPlusNode *BPlusCounted_first_leaf(BPlusNode *root);
+static Py_ssize_t BPlusCounted_slot_size(BPlusNode *leaf, int ix);
+static void BPlusCounted_slot_item(BPlusNode *leaf, int ix, Py_ssize_t jx, PyObject **o, l64 *count);
+static int BPlusCounted_check_version(BPlusCountedTree *tree, unsigned long long version);
+static int BPlusCounted_slot_count(BPlusCountedTree *tree, BPlusNode *leaf, int ix, PyObject *o, l64 *count);
+static int BPlusCounted_count(BPlusCountedTree *tree, PyObject *o, l64 *count);
+static int BPlusCounted_add(BPlusCountedTree *tree, PyObject *o, l64 key, l64 n);
+static int BPlusCounted_add_hashed(BPlusCountedTree *tree, PyObject *o, l64 n);
+static int BPlusCounted_update(BPlusCountedTree *tree, PyObject *iterable);
+static int BPlusCounted_split(BPlusCountedTree *tree, BPlusNode *leaf, BPlusPath *path);
+static int BPlusCounted_emit(BPlusCountedTree *result, BPlusCountedTree *a, BPlusCountedTree *b, BPlusNode *leaf, int ix, BPlusNode *minus, int minus_ix);
+static PyObject *BPlusCounted_merge(PyObject *a, PyObject *b, int subtract);
+
+
+// BEGIN tp method headers
+static PyObject *BPlusCountedTree_tp_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs);
+static void BPlusCountedTree_tp_dealloc(BPlusCountedTree *self);
+static int BPlusCountedTree_tp_init(BPlusCountedTree *self, PyObject *args, PyObject *kwargs);
+static PyObject *BPlusCountedTree_tp_iter(PyObject *self);
+
+
+// BEGIN number, sequence and mapping method headers
+static PyObject *BPlusCountedTree_nb_add(PyObject *a, PyObject *b);
+static PyObject *BPlusCountedTree_nb_subtract(PyObject *a, PyObject *b);
+static Py_ssize_t BPlusCountedTree_sq_length(PyObject *self);
+static int BPlusCountedTree_sq_contains(PyObject *self, PyObject *value);
+static PyObject *BPlusCountedTree_mp_subscript(PyObject *self, PyObject *key);
+
+
+// BEGIN public method headers
+static PyObject *BPlusCountedTree_method_get_b(PyObject *self, PyObject *args);
+static PyObject *BPlusCountedTree_method_sizeof(PyObject *self, PyObject *args);
+static PyObject *BPlusCountedTree_method_add(PyObject *self, PyObject *args, PyObject *kwargs);
+static PyObject *BPlusCountedTree_method_update(PyObject *self, PyObject *args);
+static PyObject *BPlusCountedTree_method_count(PyObject *self, PyObject *args);
+static PyObject *BPlusCountedTree_method_total(PyObject *self, PyObject *args);
+static PyObject *BPlusCountedTree_method_items(PyObject *self, PyObject *args);
+static PyObject *BPlusCountedTree_method_most_common(PyObject *self, PyObject *args);
+
+
+#endif
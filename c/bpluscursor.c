@@ -0,0 +1,516 @@
+// BPlusCursor method definitions.
+// A cursor walks the leaf chain of a BPlusTree a batch at a time, so that a
+// scan can be paged through (and picked back up later) without building a
+// list of the whole tree the way BPlusTree_tp_iter() does.
+#include <Python.h>
+#include "structmember.h"
+#include "bplustypes.h"
+#include "general.h"
+#include "array32.h"
+#include "bplusnode.h"
+#include "bpluscursor.h"
+
+
+// first byte of every token, bumped whenever the token format changes
+#define BPLUSCURSOR_TOKEN_FORMAT 1
+// format byte, {key}, {sub} and {at_end}
+#define BPLUSCURSOR_TOKEN_NBYTES (1 + 8 + 8 + 1)
+
+
+// define our subslot for BPlusCursor public methods
+static PyMethodDef BPlusCursor_tp_methods[] = {
+    {"seek", (PyCFunction)BPlusCursor_method_seek, METH_VARARGS | METH_KEYWORDS, "Moves the cursor to just before object {o}, or to just before the first element whose hash is at least {hash}."},
+    {"next_batch", BPlusCursor_method_next_batch, METH_VARARGS, "Returns a list of up to {n} elements following the cursor, in tree order, and moves the cursor past them."},
+    {"prev_batch", BPlusCursor_method_prev_batch, METH_VARARGS, "Returns a list of up to {n} elements preceding the cursor, nearest first, and moves the cursor back before them."},
+    {"token", BPlusCursor_method_token, METH_NOARGS, "Returns the position of the cursor as bytes, which can be passed to BPlusTree.cursor() to resume from it."},
+    {NULL, NULL, 0, NULL}
+};
+
+
+// define our BPlusCursorType type object
+PyTypeObject BPlusCursorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "five_one_one_bplus.c.BPlusCursor",         /*tp_name*/
+    sizeof(BPlusCursor),                        /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)BPlusCursor_tp_dealloc,         /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,                         /*tp_flags*/
+    0,                                          /*tp_doc*/
+    0,                                          /*tp_traverse*/
+    0,                                          /*tp_clear*/
+    0,                                          /*tp_richcompare*/
+    0,                                          /*tp_weaklistoffset*/
+    (getiterfunc)BPlusCursor_tp_iter,           /*tp_iter*/
+    (iternextfunc)BPlusCursor_tp_iternext,      /*tp_iternext*/
+    BPlusCursor_tp_methods,                     /*tp_methods*/
+};
+
+
+// creates a cursor over {tree}, positioned at the start of the tree or, if
+// {token} is not None, at the position saved in it by token().
+// Returns NULL with an error set if {token} is not a valid token.
+PyObject *BPlusCursor_new(BPlusTree *tree, PyObject *token) {
+
+    BPlusCursor *cursor = PyObject_New(BPlusCursor, &BPlusCursorType);
+
+    if (cursor == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(tree);
+    cursor->tree = tree;
+    cursor->version = tree->version;
+    cursor->key = 0;
+    cursor->at_end = 0;
+    cursor->chunk = 0;
+
+    if (token == Py_None) {
+        cursor->leaf = tree->root;
+        while (cursor->leaf->children != NULL) cursor->leaf = ((BPlusNode **)cursor->leaf->children->arr)[0];
+        cursor->ix = 0;
+        cursor->sub = 0;
+        BPlusCursor_settle(cursor);
+    } else if (BPlusCursor_load_token(cursor, token) == -1) {
+        Py_DECREF(cursor);
+        return NULL;
+    }
+
+    return (PyObject *)cursor;
+
+}
+
+
+// BEGIN tp method definitions
+static void BPlusCursor_tp_dealloc(BPlusCursor *self) {
+    Py_DECREF(self->tree);
+    PyObject_Free(self);
+}
+
+
+static PyObject *BPlusCursor_tp_iter(PyObject *self) {
+    Py_INCREF(self);
+    return self;
+}
+
+
+// returns the element following the cursor and moves past it, or NULL (with
+// no error set) to stop iteration at the end of the tree.
+// A cursor with a {chunk} size returns a tuple of up to {chunk} elements
+// instead; only the last tuple may be short.
+static PyObject *BPlusCursor_tp_iternext(PyObject *self) {
+
+    BPlusCursor *cursor = (BPlusCursor *)self;
+    PyObject *value, *chunk;
+    Py_ssize_t n;
+
+    BPlusCursor_sync(cursor);
+
+    if (cursor->at_end) {
+        return NULL;
+    }
+
+    if (cursor->chunk == 0) {
+        if ((value = BPlusCursor_current(cursor)) != NULL) {
+            BPlusCursor_advance(cursor);
+        }
+        return value;
+    }
+
+    n = cursor->chunk < cursor->tree->size ? cursor->chunk : cursor->tree->size;
+    if ((chunk = PyTuple_New(n)) == NULL) {
+        return NULL;
+    }
+
+    if ((n = BPlusCursor_fill(cursor, &PyTuple_GET_ITEM(chunk, 0), n)) == -1) {
+        Py_DECREF(chunk);
+        return NULL;
+    }
+    if (n < PyTuple_GET_SIZE(chunk) && _PyTuple_Resize(&chunk, n) == -1) {
+        return NULL;
+    }
+
+    return chunk;
+
+}
+
+
+// BEGIN public method definitions
+static PyObject *BPlusCursor_method_seek(PyObject *self, PyObject *args, PyObject *kwargs) {
+
+    BPlusCursor *cursor = (BPlusCursor *)self;
+    PyObject *o = NULL, *value;
+    l64 key;
+    static char *kwlist[] = {"o", "hash", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O$L", kwlist, &o, &key)) {
+        return NULL;
+    }
+
+    // exactly one of {o} and {hash} must be given
+    if (PyTuple_GET_SIZE(args) + (kwargs == NULL ? 0 : PyDict_GET_SIZE(kwargs)) != 1) {
+        Py_INCREF(PyExc_TypeError);
+        PyErr_SetString(PyExc_TypeError, "seek() takes exactly one of {o} and {hash}.");
+        return NULL;
+    }
+
+    if (o != NULL && (key = PyObject_Hash(o)) == -1) {
+        return NULL;
+    }
+
+    BPlusCursor_locate(cursor, key, 0);
+
+    if (o == NULL || cursor->at_end || cursor->key != key) {
+        Py_RETURN_NONE;
+    }
+
+    // {o} may be in the collision list at {key}.
+    // Comparing runs __eq__, which may change or re-initialize the tree and
+    // release the list, so we hold our own reference to it and find {leaf}
+    // and {ix} again afterwards.
+    value = ((PyObject **)cursor->leaf->values->arr)[cursor->ix];
+    if (value != NULL && PyList_Check(value)) {
+        Py_INCREF(value);
+        for (Py_ssize_t jx = 0; jx < PyList_GET_SIZE(value); jx++) {
+            int res = BPlusNode_equals(o, PyList_GET_ITEM(value, jx));
+            if (res == -1) {
+                Py_DECREF(value);
+                BPlusCursor_sync(cursor);
+                return NULL;
+            } else if (res == 1) {
+                cursor->sub = jx;
+                break;
+            }
+        }
+        Py_DECREF(value);
+        BPlusCursor_sync(cursor);
+    }
+
+    Py_RETURN_NONE;
+
+}
+
+static PyObject *BPlusCursor_method_next_batch(PyObject *self, PyObject *args) {
+
+    BPlusCursor *cursor = (BPlusCursor *)self;
+    PyObject *batch, *value = NULL;
+    Py_ssize_t n;
+
+    if (!PyArg_ParseTuple(args, "n", &n)) {
+        return NULL;
+    }
+
+    if ((batch = PyList_New(0)) == NULL) {
+        return NULL;
+    }
+
+    BPlusCursor_sync(cursor);
+
+    for (Py_ssize_t count = 0; count < n && !cursor->at_end; count++) {
+        if ((value = BPlusCursor_current(cursor)) == NULL || PyList_Append(batch, value) == -1) {
+            Py_XDECREF(value);
+            Py_DECREF(batch);
+            return NULL;
+        }
+        Py_DECREF(value);
+        BPlusCursor_advance(cursor);
+    }
+
+    return batch;
+
+}
+
+static PyObject *BPlusCursor_method_prev_batch(PyObject *self, PyObject *args) {
+
+    BPlusCursor *cursor = (BPlusCursor *)self;
+    PyObject *batch, *value = NULL;
+    Py_ssize_t n;
+
+    if (!PyArg_ParseTuple(args, "n", &n)) {
+        return NULL;
+    }
+
+    if ((batch = PyList_New(0)) == NULL) {
+        return NULL;
+    }
+
+    BPlusCursor_sync(cursor);
+
+    for (Py_ssize_t count = 0; count < n && BPlusCursor_retreat(cursor); count++) {
+        if ((value = BPlusCursor_current(cursor)) == NULL || PyList_Append(batch, value) == -1) {
+            Py_XDECREF(value);
+            Py_DECREF(batch);
+            return NULL;
+        }
+        Py_DECREF(value);
+    }
+
+    return batch;
+
+}
+
+// the token holds the hash and collision list index of the next element
+// rather than any pointers, so it stays valid across changes to the tree and
+// can be kept outside of the process.
+static PyObject *BPlusCursor_method_token(PyObject *self, PyObject *args) {
+
+    BPlusCursor *cursor = (BPlusCursor *)self;
+    unsigned char token[BPLUSCURSOR_TOKEN_NBYTES];
+    unsigned long long key = (unsigned long long)cursor->key, sub = (unsigned long long)cursor->sub;
+
+    // stored little endian, independent of the machine
+    token[0] = BPLUSCURSOR_TOKEN_FORMAT;
+    for (int ix = 0; ix < 8; ix++) {
+        token[1 + ix] = (unsigned char)(key >> (8 * ix));
+        token[9 + ix] = (unsigned char)(sub >> (8 * ix));
+    }
+    token[17] = (unsigned char)cursor->at_end;
+
+    return PyBytes_FromStringAndSize((char *)token, BPLUSCURSOR_TOKEN_NBYTES);
+
+}
+
+// BEGIN helper function definitions
+
+// returns the number of elements stored in slot {ix} of {leaf}: the length of
+// its collision list, if it has one, and 1 otherwise.
+Py_ssize_t BPlusCursor_slot_size(BPlusNode *leaf, int ix) {
+    PyObject *value = ((PyObject **)leaf->values->arr)[ix];
+    return value != NULL && PyList_Check(value) ? PyList_GET_SIZE(value) : 1;
+}
+
+// returns a new reference to the element following {cursor}, or NULL with an
+// error set if the element of an unboxed tree could not be created.
+// Assumes {cursor} is in sync with its tree and not at the end.
+PyObject *BPlusCursor_current(BPlusCursor *cursor) {
+    PyObject *value = ((PyObject **)cursor->leaf->values->arr)[cursor->ix];
+    if (value == NULL) {
+        return PyLong_FromLongLong(cursor->key);
+    }
+    value = PyList_Check(value) ? PyList_GET_ITEM(value, cursor->sub) : value;
+    Py_INCREF(value);
+    return value;
+}
+
+// copies new references to up to {n} of the elements following {cursor}
+// into {out}, and moves {cursor} past them.
+// Runs of plain values are copied straight out of each leaf's {values};
+// only collision lists are stepped through an element at a time.
+// Returns the number of elements copied, which is only less than {n} at the
+// end of the tree, or -1 with an error set (and nothing copied) if the
+// element of an unboxed tree could not be created.
+Py_ssize_t BPlusCursor_fill(BPlusCursor *cursor, PyObject **out, Py_ssize_t n) {
+
+    Py_ssize_t count = 0;
+    PyObject **values, *value;
+    int size;
+
+    BPlusCursor_sync(cursor);
+
+    while (count < n && !cursor->at_end) {
+
+        values = (PyObject **)cursor->leaf->values->arr;
+        size = cursor->leaf->values->size;
+
+        if (values[cursor->ix] == NULL) {
+            // the elements of an unboxed tree are created from their hashes
+            while (count < n && cursor->ix < size) {
+                if ((value = PyLong_FromLongLong(BPlusLeaf_key(cursor->leaf, cursor->ix))) == NULL) {
+                    while (count > 0) {
+                        Py_DECREF(out[--count]);
+                        out[count] = NULL;
+                    }
+                    return -1;
+                }
+                cursor->ix++;
+                out[count++] = value;
+            }
+            BPlusCursor_settle(cursor);
+            continue;
+        }
+
+        if (PyList_Check(values[cursor->ix])) {
+            value = PyList_GET_ITEM(values[cursor->ix], cursor->sub);
+            Py_INCREF(value);
+            out[count++] = value;
+            BPlusCursor_advance(cursor);
+            continue;
+        }
+
+        while (count < n && cursor->ix < size && values[cursor->ix] != NULL && !PyList_Check(values[cursor->ix])) {
+            value = values[cursor->ix++];
+            Py_INCREF(value);
+            out[count++] = value;
+        }
+        BPlusCursor_settle(cursor);
+
+    }
+
+    return count;
+
+}
+
+// moves {cursor} forward past any leaves it has run off the end of, updating
+// {key} to match, or marks it as at the end if there are none left.
+void BPlusCursor_settle(BPlusCursor *cursor) {
+
+    while (cursor->leaf != NULL && cursor->ix >= cursor->leaf->values->size) {
+        cursor->leaf = cursor->leaf->next;
+        cursor->ix = 0;
+        cursor->sub = 0;
+    }
+
+    if (cursor->leaf == NULL) {
+        cursor->at_end = 1;
+        return;
+    }
+
+    cursor->key = BPlusLeaf_key(cursor->leaf, cursor->ix);
+
+}
+
+// moves {cursor} to just before the {sub}th element with hash {key}, or to
+// just before the first element with a greater hash if there is no such
+// element.
+void BPlusCursor_locate(BPlusCursor *cursor, l64 key, Py_ssize_t sub) {
+
+    BPlusNode *leaf = BPlusNode_search(cursor->tree->root, key, NULL);
+    int ix = BPlusLeaf_bisect_left(leaf, key);
+
+    cursor->version = cursor->tree->version;
+    cursor->at_end = 0;
+    cursor->leaf = leaf;
+    cursor->ix = ix;
+    cursor->sub = 0;
+
+    if (ix < leaf->values->size && BPlusLeaf_key(leaf, ix) == key) {
+        if (sub < BPlusCursor_slot_size(leaf, ix)) {
+            cursor->sub = sub;
+        } else {
+            cursor->ix++;
+        }
+    }
+
+    BPlusCursor_settle(cursor);
+
+}
+
+// makes sure the {leaf} and {ix} of {cursor} can be trusted, finding them
+// again from {key} and {sub} if the tree has changed since they were set.
+void BPlusCursor_sync(BPlusCursor *cursor) {
+
+    if (cursor->version == cursor->tree->version) {
+        return;
+    }
+
+    if (cursor->at_end) {
+        cursor->version = cursor->tree->version;
+        return;
+    }
+
+    BPlusCursor_locate(cursor, cursor->key, cursor->sub);
+
+}
+
+// moves {cursor} past the element following it.
+// Assumes {cursor} is in sync with its tree and not at the end.
+void BPlusCursor_advance(BPlusCursor *cursor) {
+
+    cursor->sub++;
+
+    if (cursor->sub >= BPlusCursor_slot_size(cursor->leaf, cursor->ix)) {
+        cursor->sub = 0;
+        cursor->ix++;
+        BPlusCursor_settle(cursor);
+    }
+
+}
+
+// moves {cursor} back before the element preceding it.
+// Assumes {cursor} is in sync with its tree.
+// Returns 1 on success, or 0 (leaving {cursor} alone) if it is already at
+// the start of the tree.
+int BPlusCursor_retreat(BPlusCursor *cursor) {
+
+    BPlusNode *leaf;
+    int ix;
+
+    if (cursor->at_end) {
+        leaf = cursor->tree->root;
+        while (leaf->children != NULL) leaf = ((BPlusNode **)leaf->children->arr)[leaf->children->size - 1];
+        ix = leaf->values->size;
+    } else if (cursor->sub > 0) {
+        cursor->sub--;
+        return 1;
+    } else {
+        leaf = cursor->leaf;
+        ix = cursor->ix;
+    }
+
+    // step back one slot, skipping over any empty leaves
+    while (ix == 0) {
+        if ((leaf = leaf->prev) == NULL) {
+            return 0;
+        }
+        ix = leaf->values->size;
+    }
+    ix--;
+
+    cursor->leaf = leaf;
+    cursor->ix = ix;
+    cursor->sub = BPlusCursor_slot_size(leaf, ix) - 1;
+    cursor->key = BPlusLeaf_key(leaf, ix);
+    cursor->at_end = 0;
+
+    return 1;
+
+}
+
+// moves {cursor} to the position saved in {token} by token().
+// Returns 0 on success, or -1 with a ValueError set if {token} is not a
+// token.
+int BPlusCursor_load_token(BPlusCursor *cursor, PyObject *token) {
+
+    const unsigned char *bytes;
+    unsigned long long key = 0, sub = 0;
+
+    if (!PyBytes_Check(token)
+        || PyBytes_GET_SIZE(token) != BPLUSCURSOR_TOKEN_NBYTES
+        || (bytes = (const unsigned char *)PyBytes_AS_STRING(token))[0] != BPLUSCURSOR_TOKEN_FORMAT
+        || bytes[17] > 1) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "Got an invalid cursor token.");
+        return -1;
+    }
+
+    for (int ix = 7; ix >= 0; ix--) {
+        key = (key << 8) | bytes[1 + ix];
+        sub = (sub << 8) | bytes[9 + ix];
+    }
+
+    if (bytes[17]) {
+        cursor->at_end = 1;
+        cursor->key = (l64)key;
+        cursor->sub = 0;
+        cursor->version = cursor->tree->version;
+        return 0;
+    }
+
+    BPlusCursor_locate(cursor, (l64)key, (Py_ssize_t)sub);
+
+    return 0;
+
+}
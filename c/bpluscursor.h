@@ -0,0 +1,47 @@
+// Definitions of public and private methods used by BPlusTree cursors.
+// See bpluscursor.c for documentation on the methods declared in this file.
+
+
+#ifndef BPLUSCURSOR_H
+#define BPLUSCURSOR_H
+
+
+#include <Python.h>
+#include "structmember.h"
+#include "bplustypes.h"
+#include "general.h"
+#include "array32.h"
+#include "bplusnode.h"
+
+
+// the type object is registered with the module by PyInit_c() in bplustree.c
+extern PyTypeObject BPlusCursorType;
+PyObject *BPlusCursor_new(BPlusTree *tree, PyObject *token);
+
+
+// BEGIN BPlusCursor private helper method headers
+static Py_ssize_t BPlusCursor_slot_size(BPlusNode *leaf, int ix);
+static PyObject *BPlusCursor_current(BPlusCursor *cursor);
+static Py_ssize_t BPlusCursor_fill(BPlusCursor *cursor, PyObject **out, Py_ssize_t n);
+static void BPlusCursor_settle(BPlusCursor *cursor);
+static void BPlusCursor_locate(BPlusCursor *cursor, l64 key, Py_ssize_t sub);
+static void BPlusCursor_sync(BPlusCursor *cursor);
+static void BPlusCursor_advance(BPlusCursor *cursor);
+static int BPlusCursor_retreat(BPlusCursor *cursor);
+static int BPlusCursor_load_token(BPlusCursor *cursor, PyObject *token);
+
+
+// BEGIN tp method headers
+static void BPlusCursor_tp_dealloc(BPlusCursor *self);
+static PyObject *BPlusCursor_tp_iter(PyObject *self);
+static PyObject *BPlusCursor_tp_iternext(PyObject *self);
+
+
+// BEGIN public method headers
+static PyObject *BPlusCursor_method_seek(PyObject *self, PyObject *args, PyObject *kwargs);
+static PyObject *BPlusCursor_method_next_batch(PyObject *self, PyObject *args);
+static PyObject *BPlusCursor_method_prev_batch(PyObject *self, PyObject *args);
+static PyObject *BPlusCursor_method_token(PyObject *self, PyObject *args);
+
+
+#endif
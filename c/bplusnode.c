@@ -1,4 +1,7 @@
-// BPlusNode helper method definitions.
+// BPlusNode helper method definitions for the Python objects held in the
+// value slots of a BPlusTree's leaves: comparing, inserting and releasing
+// them. Everything else about nodes is in the CPython-independent core (see
+// bpluscore.c).
 #include <Python.h>
 #include "bplustypes.h"
 #include "general.h"
@@ -6,52 +9,18 @@
 #include "bplusnode.h"
 
 
-// basic BPlusNode constructor for common elements
-BPlusNode *BPlusNode_init(int b) {
-    // construct the node
-    BPlusNode *node = (BPlusNode *)malloc(sizeof(BPlusNode));
+// convenience method for inserting {x} into an array of {PyObject *} at {index}.
+int insert_PyObject(Array32 *a, int index, PyObject *x) {
+    insert_pointer(a, index, x);
 
-    // construct the indices
-    node->indices = (Array32 *)malloc(sizeof(Array32));
-    node->indices->size = 0;
-    node->indices->arr = (l64 *)malloc(sizeof(l64) * (b+1));
+    // {x} is NULL for the elements of an unboxed tree
+    Py_XINCREF(x);
 
-    // initialize everything else to 0
-    node->values = NULL;
-    node->children = NULL;
-    node->parent = NULL;
-    node->prev = NULL;
-    node->next = NULL;
-
-    return node;
-}
-
-// Leaf Constructor
-// construct a node that will have pointers to PyObjects and no children
-BPlusNode *BPlusLeaf_init(int b) {
-    // construct the node
-    BPlusNode *node = BPlusNode_init(b);
-    node->values = (Array32 *)malloc(sizeof(Array32));
-    node->values->size = 0;
-    node->values->arr = (PyObject **)malloc(sizeof(PyObject *) * (b+1));
-
-    return node;
-}
-
-// Branch Constructor
-// construct a node that will have leaves or other nodes beneath it
-BPlusNode *BPlusBranch_init(int b) {
-    // construct the node
-    BPlusNode *node = BPlusNode_init(b);
-    node->children = (Array32 *)malloc(sizeof(Array32));
-    node->children->size = 0;
-    node->children->arr = (BPlusNode **)malloc(sizeof(BPlusNode *) * (b+1));
-
-    return node;
+    return 1;
 }
 
-// deallocate memory for {node} and its members
-void BPlusNode_dealloc(BPlusNode *node) {
+// deallocate memory for {node} and its members, giving it back to {heap}
+void BPlusNode_dealloc(BPlusHeap *heap, BPlusNode *node) {
 
     int sz, i;
     PyObject **values_arr = NULL;
@@ -61,44 +30,110 @@ void BPlusNode_dealloc(BPlusNode *node) {
         sz = node->children->size;
         children_arr = (BPlusNode **)node->children->arr;
         for (i = 0; i < sz; i++) {
-            BPlusNode_dealloc(children_arr[i]);
+            BPlusNode_dealloc(heap, children_arr[i]);
         }
-        free(node->children->arr);
-        free(node->children);
     }
 
     if (node->values != NULL) {
         sz = node->values->size;
         values_arr = (PyObject **)node->values->arr;
         for (i = 0; i < sz; i++) {
-            Py_DECREF(values_arr[i]);
+            // the values of an unboxed tree are all NULL
+            Py_XDECREF(values_arr[i]);
         }
-        free(node->values->arr);
-        free(node->values);
     }
-    
-    free(node->indices->arr);
-    free(node->indices);
 
-    free(node);
+    BPlusNode_free(heap, node);
 
 }
 
-// helper function that takes root node {root} and index value {key}, and returns
-// a pointer to the leaf node that either:
-//  1. contains {key}
-//  2. would contain {key} if it existed in the tree
-BPlusNode *BPlusNode_search(BPlusNode *root, l64 key) {
+// returns 1 if {a} == {b}, 0 if not, or -1 with an error set if the
+// comparison raised.
+// Two objects of the same exact str, bytes, int or float type, or tuples of
+// them, are compared by their contents, without dispatching to their
+// __eq__. Everything else, including an int against a float, goes through
+// PyObject_RichCompareBool().
+int BPlusNode_equals(PyObject *a, PyObject *b) {
+
+    PyTypeObject *type = Py_TYPE(a);
+    int overflow_a, overflow_b, res;
+    l64 x, y;
+
+    if (a == b) {
+        return 1;
+    }
+
+    if (type != Py_TYPE(b)) {
+        return PyObject_RichCompareBool(a, b, Py_EQ);
+    }
+
+    if (type == &PyUnicode_Type) {
+        // both were hashed before getting here, so both are ready, and
+        // equal strings are always stored in the same kind
+        return PyUnicode_GET_LENGTH(a) == PyUnicode_GET_LENGTH(b)
+            && PyUnicode_KIND(a) == PyUnicode_KIND(b)
+            && memcmp(PyUnicode_DATA(a), PyUnicode_DATA(b), PyUnicode_GET_LENGTH(a) * PyUnicode_KIND(a)) == 0;
+    }
+
+    if (type == &PyBytes_Type) {
+        return PyBytes_GET_SIZE(a) == PyBytes_GET_SIZE(b)
+            && memcmp(PyBytes_AS_STRING(a), PyBytes_AS_STRING(b), PyBytes_GET_SIZE(a)) == 0;
+    }
+
+    if (type == &PyLong_Type) {
+        x = PyLong_AsLongLongAndOverflow(a, &overflow_a);
+        y = PyLong_AsLongLongAndOverflow(b, &overflow_b);
+        if (!overflow_a && !overflow_b) {
+            return x == y;
+        }
+        if (overflow_a != overflow_b) {
+            return 0;
+        }
+        // both are beyond 64 bits, with the same sign
+        return PyObject_RichCompareBool(a, b, Py_EQ);
+    }
 
-    BPlusNode *current = root;
-    int ix;
+    if (type == &PyFloat_Type) {
+        return PyFloat_AS_DOUBLE(a) == PyFloat_AS_DOUBLE(b);
+    }
 
-    while (current->children != NULL) {
-        ix = bisect_right(current->indices, key);
-        current = ((BPlusNode **)current->children->arr)[ix];
+    if (type == &PyTuple_Type) {
+        if (PyTuple_GET_SIZE(a) != PyTuple_GET_SIZE(b)) {
+            return 0;
+        }
+        for (Py_ssize_t ix = 0; ix < PyTuple_GET_SIZE(a); ix++) {
+            if ((res = BPlusNode_equals(PyTuple_GET_ITEM(a, ix), PyTuple_GET_ITEM(b, ix))) != 1) {
+                return res;
+            }
+        }
+        return 1;
     }
 
-    return current;
+    return PyObject_RichCompareBool(a, b, Py_EQ);
+
+}
+
+// returns 1 if {o} is equal to the integer {key}, 0 if it is not, or -1 with
+// an error set if the comparison raised.
+// Exact ints are compared without creating an int for {key}.
+int BPlusLeaf_equals_key(PyObject *o, l64 key) {
+
+    PyObject *boxed;
+    int overflow, res;
+    l64 x;
+
+    if (PyLong_CheckExact(o)) {
+        x = PyLong_AsLongLongAndOverflow(o, &overflow);
+        return !overflow && x == key;
+    }
+
+    if ((boxed = PyLong_FromLongLong(key)) == NULL) {
+        return -1;
+    }
+    res = PyObject_RichCompareBool(o, boxed, Py_EQ);
+    Py_DECREF(boxed);
+
+    return res;
 
 }
 
@@ -111,21 +146,30 @@ BPlusNode *BPlusNode_search(BPlusNode *root, l64 key) {
 //  3. If there is an error, -2
 int BPlusLeaf_search(BPlusNode *leaf, l64 key, PyObject *o) {
 
-    int ix = bisect_left(leaf->indices, key);
+    int ix = BPlusLeaf_bisect_left(leaf, key), res;
 
     if (ix >= leaf->indices->size) {
         return -1;
     }
 
-    if (((l64 *)leaf->indices->arr)[ix] != key) {
+    if (BPlusLeaf_key(leaf, ix) != key) {
         return -1;
     }
 
     PyObject *val_ix = ((PyObject **)leaf->values->arr)[ix];
 
-    if (PyObject_RichCompareBool(o, val_ix, Py_EQ) == 1) {
+    if (val_ix == NULL) {
+        // the leaf belongs to an unboxed tree, so the element is the
+        // integer {key} itself
+        res = BPlusLeaf_equals_key(o, key);
+        return res == 1 ? ix : (res == 0 ? -1 : -2);
+    }
+
+    if ((res = BPlusNode_equals(o, val_ix)) == 1) {
         // {o} is already contained in the BPlusTree
         return 1;
+    } else if (res == -1) {
+        return -2;
     }
 
     // We have a collision!
@@ -133,7 +177,7 @@ int BPlusLeaf_search(BPlusNode *leaf, l64 key, PyObject *o) {
     // with a list, and add all items with the same hash to the list
     // This works because lists are an unhashable type and therefore cannot
     // be mistaken for an object intentionally in the tree
-    int res = PyObject_IsInstance(val_ix, (PyObject *)&PyList_Type);
+    res = PyObject_IsInstance(val_ix, (PyObject *)&PyList_Type);
     PyObject *collision_container;
 
     if (res == -1) {
@@ -150,63 +194,43 @@ int BPlusLeaf_search(BPlusNode *leaf, l64 key, PyObject *o) {
     // iterate through the list and check if {o} is contained
     for (int jx = 0; jx < PyList_Size(collision_container); jx++) {
         val_ix = PyList_GetItem(collision_container, jx);
-        if (PyObject_RichCompareBool(o, val_ix, Py_EQ) == 1) {
+        if ((res = BPlusNode_equals(o, val_ix)) == 1) {
             return 1;
+        } else if (res == -1) {
+            return -2;
         }
     }
 
     // {o} is not in the list
-    return 0;
+    return -1;
 
 }
 
 // Helper method for inserting {key}/{o} into the leaf.
-// Assumes {leaf} is the proper leaf within the tree to insert {o}.
+// Assumes {leaf} is the proper leaf within the tree to insert {o}, and that
+// BPlusLeaf_fits(leaf, key).
 // Returns one of the following:
 //  1. If {o} was not already in the tree and the insert operation was
 //      successful, returns 1
-//  2. If {o} was already in the tree, does nothing and returns 0
-//  3. On an error, returns -1
+//  2. If {o} was inserted by turning the slot for {key} into a new collision
+//      list, returns 2
+//  3. If {o} was inserted by adding it to the collision list already in the
+//      slot for {key}, returns 3
+//  4. If {o} was already in the tree, does nothing and returns 0
+//  5. On an error, returns -1
 int BPlusLeaf_insert(BPlusNode *leaf, l64 key, PyObject *o) {
 
-    int ix = bisect_left(leaf->indices, key);
+    int ix = BPlusLeaf_bisect_left(leaf, key), equal;
 
     if (ix >= leaf->indices->size) {
-        #if DEBUG >= 1
-        PyObject *msg0 = PyUnicode_FromString("BPlusLeaf_insert: Appending object in leaf");
-        if (PyObject_CallFunctionObjArgs(_print, msg0, o, NULL) == NULL) {
-            Py_DECREF(msg0);
-            Py_INCREF(PyExc_RuntimeError);
-            PyErr_SetString(PyExc_RuntimeError, "Got error calling print statement.");
-            return -1;
-        }
-        Py_DECREF(msg0);
-        #endif
-        insert_l64(leaf->indices, ix, key);
+        BPlusLeaf_insert_key(leaf, ix, key);
         insert_PyObject(leaf->values, ix, o);
 
         return 1;
     }
 
-    if (((l64 *)leaf->indices->arr)[ix] != key) {
-        #if DEBUG >= 1
-        PyObject
-            *msg1 = PyUnicode_FromString("BPlusLeaf_insert: inserting object in leaf"),
-            *msg2 = PyUnicode_FromString("at index"),
-            *pyobj_ix = PyLong_FromLong(ix);
-        if (PyObject_CallFunctionObjArgs(_print, msg1, o, msg2, pyobj_ix, NULL) == NULL) {
-            Py_DECREF(msg1);
-            Py_DECREF(msg2);
-            Py_DECREF(pyobj_ix);
-            Py_INCREF(PyExc_RuntimeError);
-            PyErr_SetString(PyExc_RuntimeError, "Got error calling print statement.");
-            return -1;
-        }
-        Py_DECREF(msg1);
-        Py_DECREF(msg2);
-        Py_DECREF(pyobj_ix);
-        #endif
-        insert_l64(leaf->indices, ix, key);
+    if (BPlusLeaf_key(leaf, ix) != key) {
+        BPlusLeaf_insert_key(leaf, ix, key);
         insert_PyObject(leaf->values, ix, o);
 
         return 1;
@@ -214,20 +238,17 @@ int BPlusLeaf_insert(BPlusNode *leaf, l64 key, PyObject *o) {
 
     PyObject *val_ix = ((PyObject **)leaf->values->arr)[ix];
 
-    if (PyObject_RichCompareBool(o, val_ix, Py_EQ) == 1) {
+    if (o == NULL) {
+        // inserting into an unboxed tree, where equal hashes mean equal
+        // elements
+        return 0;
+    }
+
+    if ((equal = BPlusNode_equals(o, val_ix)) == 1) {
         // {o} is already contained in the BPlusTree
-        #if DEBUG >= 1
-        PyObject
-            *msg4 = PyUnicode_FromString("BPlusLeaf_insert: object already exists in leaf");
-        if (PyObject_CallFunctionObjArgs(_print, msg4, o, NULL) == NULL) {
-            Py_DECREF(msg4);
-            Py_INCREF(PyExc_RuntimeError);
-            PyErr_SetString(PyExc_RuntimeError, "Got error calling print statement.");
-            return -1;
-        }
-        Py_DECREF(msg4);
-        #endif
         return 0;
+    } else if (equal == -1) {
+        return -1;
     }
 
     // We have a collision!
@@ -244,17 +265,6 @@ int BPlusLeaf_insert(BPlusNode *leaf, l64 key, PyObject *o) {
         PyErr_SetString(PyExc_RuntimeError, "Got error checking if existing value is a list.");
         return -1;
     } else if (res == 0) {
-        #if DEBUG >= 1
-        PyObject
-            *msg5 = PyUnicode_FromString("BPlusLeaf_insert: got collision: creating new collision container");
-        if (PyObject_CallFunctionObjArgs(_print, msg5, NULL) == NULL) {
-            Py_DECREF(msg5);
-            Py_INCREF(PyExc_RuntimeError);
-            PyErr_SetString(PyExc_RuntimeError, "Got error calling print statement.");
-            return -1;
-        }
-        Py_DECREF(msg5);
-        #endif
         // not already a list, create one
         collision_container = PyList_New(1);
         ((PyObject **)leaf->values->arr)[ix] = collision_container;
@@ -262,29 +272,21 @@ int BPlusLeaf_insert(BPlusNode *leaf, l64 key, PyObject *o) {
         // we're removing it from the leaf container
         PyList_SetItem(collision_container, 0, val_ix);
     } else {
-        #if DEBUG >= 1
-        PyObject
-            *msg6 = PyUnicode_FromString("BPlusLeaf_insert: got collision: already exists a collision container:");
-        if (PyObject_CallFunctionObjArgs(_print, msg6, val_ix, NULL) == NULL) {
-            Py_DECREF(msg6);
-            Py_INCREF(PyExc_RuntimeError);
-            PyErr_SetString(PyExc_RuntimeError, "Got error calling print statement.");
-            return -1;
-        }
-        Py_DECREF(msg6);
-        #endif
         // there is already a list, check if {o} is contained in it
         collision_container = val_ix;
         for (int jx = 0; jx < PyList_Size(collision_container); jx++) {
             PyObject *subval = PyList_GetItem(collision_container, jx);
-            if (PyObject_RichCompareBool(o, subval, Py_EQ) == 1) {
+            if ((equal = BPlusNode_equals(o, subval)) == 1) {
                 return 0;
+            } else if (equal == -1) {
+                return -1;
             }
         }
     }
 
     // if we get to this point, it means we have a {collision_container} that
     // does not currently contain {o}
+    int created = res == 0;
 
     // the append operation increases refcount of {o}
     if (PyList_Append(collision_container, o) == -1) {
@@ -300,18 +302,6 @@ int BPlusLeaf_insert(BPlusNode *leaf, l64 key, PyObject *o) {
         return -1;
     }
 
-    #if DEBUG >= 1
-    PyObject
-        *msg7 = PyUnicode_FromString("BPlusLeaf_insert: collision container directly before return:");
-    if (PyObject_CallFunctionObjArgs(_print, msg7, collision_container, NULL) == NULL) {
-        Py_DECREF(msg7);
-        Py_INCREF(PyExc_RuntimeError);
-        PyErr_SetString(PyExc_RuntimeError, "Got error calling print statement.");
-        return -1;
-    }
-    Py_DECREF(msg7);
-    #endif
-
-    return 1;
+    return created ? 2 : 3;
  
 }
@@ -1,4 +1,6 @@
-// Definition of the BPlusNode type and methods related to it.
+// Definition of the methods that deal with the Python objects held by a
+// BPlusNode. The rest of the node methods are in the CPython-independent
+// core, declared in bpluscore.h.
 // See bplusnode.c for documentation on the methods declared in this file.
 
 #ifndef BPLUSNODE_H
@@ -9,14 +11,14 @@
 #include "bplustypes.h"
 #include "general.h"
 #include "array32.h"
+#include "bpluscore.h"
 
 
 // BEGIN BPlusNode helper functions
-BPlusNode *BPlusNode_init(int b);
-BPlusNode *BPlusLeaf_init(int b);
-BPlusNode *BPlusBranch_init(int b);
-void BPlusNode_dealloc(BPlusNode *node);
-BPlusNode *BPlusNode_search(BPlusNode *root, l64 key);
+void BPlusNode_dealloc(BPlusHeap *heap, BPlusNode *node);
+int insert_PyObject(Array32 *a, int index, PyObject *x);
+int BPlusNode_equals(PyObject *a, PyObject *b);
+int BPlusLeaf_equals_key(PyObject *o, l64 key);
 int BPlusLeaf_search(BPlusNode *leaf, l64 key, PyObject *o);
 int BPlusLeaf_insert(BPlusNode *leaf, l64 key, PyObject *o);
 
@@ -0,0 +1,1149 @@
+// BPlusPagedTree method definitions.
+// A BPlusPagedTree is a set of int64 too large to keep in memory. Its leaves
+// are {BPLUSPAGED_PAGE_SIZE} byte pages of a file, chained in key order, and
+// are read through a cache of a fixed number of pages: when the cache is full
+// the CLOCK algorithm picks a page to evict, writing it back first if it has
+// changed. Only the branches stay in memory (one per {BPLUSPAGED_FANOUT}
+// leaves, so about 1/500th of the size of the file), and are rebuilt from the
+// leaf chain when an existing file is opened.
+#include <Python.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "structmember.h"
+#include "bplustypes.h"
+#include "general.h"
+#include "bpluspaged.h"
+
+
+// bumped whenever the layout of the file changes
+#define BPLUSPAGED_FORMAT 1
+// see {BPlusPagedHeader}
+#define BPLUSPAGED_BYTE_ORDER 0x01020304
+// splitting a leaf needs two pages pinned at once; a few more keep the
+// branches' most recent leaves from evicting each other
+#define BPLUSPAGED_MIN_FRAMES 4
+
+
+// define our subslot for BPlusPagedTree sequence methods
+static PySequenceMethods BPlusPagedTree_sq_methods = {
+    (lenfunc)BPlusPagedTree_sq_length,          /*sq_length*/
+    0,                                          /*sq_concat*/
+    0,                                          /*sq_repeat*/
+    0,                                          /*sq_item*/
+    0,                                          /*was_sq_slice*/
+    0,                                          /*sq_ass_item (???)*/
+    0,                                          /*was_sq_ass_slice (???)*/
+    BPlusPagedTree_sq_contains,                 /*sq_contains*/
+    0,                                          /*sq_inplace_concat*/
+    0,                                          /*sq_inplace_repeat*/
+};
+
+
+// define our subslot for BPlusPagedTree public methods
+static PyMethodDef BPlusPagedTree_tp_methods[] = {
+    {"add", BPlusPagedTree_method_add, METH_VARARGS, "Inserts the int64 {o} into the tree."},
+    {"update", BPlusPagedTree_method_update, METH_VARARGS, "Inserts every int64 in {iterable} into the tree."},
+    {"flush", BPlusPagedTree_method_flush, METH_NOARGS, "Writes every changed page and the header to the file, and syncs it to disk."},
+    {"close", BPlusPagedTree_method_close, METH_NOARGS, "Flushes the tree and closes its file. The tree cannot be used afterwards."},
+    {"get_cache_stats", BPlusPagedTree_method_get_cache_stats, METH_NOARGS, "Returns a dict of the page cache's hits, misses, evictions, writes and hit_rate, with the number of cache_pages, cached_pages and file pages."},
+    {NULL, NULL, 0, NULL}
+};
+
+
+// define our BPlusPagedTreeType type object
+PyTypeObject BPlusPagedTreeType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "five_one_one_bplus.c.BPlusPagedTree",      /*tp_name*/
+    sizeof(BPlusPagedTree),                     /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)BPlusPagedTree_tp_dealloc,      /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    &BPlusPagedTree_sq_methods,                 /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   /*tp_flags*/
+    0,                                          /*tp_doc*/
+    0,                                          /*tp_traverse*/
+    0,                                          /*tp_clear*/
+    0,                                          /*tp_richcompare*/
+    0,                                          /*tp_weaklistoffset*/
+    (getiterfunc)BPlusPagedTree_tp_iter,        /*tp_iter*/
+    0,                                          /*tp_iternext*/
+    BPlusPagedTree_tp_methods,                  /*tp_methods*/
+    0,                                          /*tp_members*/
+    0,                                          /*tp_getsets*/
+    0,                                          /*tp_base*/
+    0,                                          /*tp_dict*/
+    0,                                          /*tp_descr_get*/
+    0,                                          /*tp_descr_set*/
+    0,                                          /*tp_dictoffset*/
+    (initproc)BPlusPagedTree_tp_init,           /*tp_init*/
+    0,                                          /*tp_alloc*/
+    PyType_GenericNew,                          /*tp_new*/
+};
+
+
+// define our BPlusPagedIterType type object
+PyTypeObject BPlusPagedIterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "five_one_one_bplus.c.BPlusPagedIter",      /*tp_name*/
+    sizeof(BPlusPagedIter),                     /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)BPlusPagedIter_tp_dealloc,      /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,                         /*tp_flags*/
+    0,                                          /*tp_doc*/
+    0,                                          /*tp_traverse*/
+    0,                                          /*tp_clear*/
+    0,                                          /*tp_richcompare*/
+    0,                                          /*tp_weaklistoffset*/
+    PyObject_SelfIter,                          /*tp_iter*/
+    (iternextfunc)BPlusPagedIter_tp_iternext,   /*tp_iternext*/
+};
+
+
+// BEGIN tp method definitions
+// flushes the tree on its way out. There is no one left to raise an error
+// to, so a failed flush is reported as unraisable.
+static void BPlusPagedTree_tp_dealloc(BPlusPagedTree *self) {
+
+    if (BPlusPaged_close(self) == -1) {
+        PyErr_WriteUnraisable((PyObject *)self);
+    }
+
+    Py_TYPE(self)->tp_free((PyObject *)self);
+
+}
+
+// opens the file at {path}, creating it if it does not exist or is empty, with
+// a page cache of {cache_bytes} (rounded down to whole pages, and at least
+// {BPLUSPAGED_MIN_FRAMES} of them). The ints in {initializer} are then added.
+static int BPlusPagedTree_tp_init(BPlusPagedTree *self, PyObject *args, PyObject *kwargs) {
+
+    PyObject *path, *path_bytes, *initializer = Py_None;
+    Py_ssize_t cache_bytes = 1 << 26;
+    struct stat st;
+    static char *kwlist[] = {"path", "initializer", "cache_bytes", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|On", kwlist, &path, &initializer, &cache_bytes)) {
+        return -1;
+    }
+
+    if (cache_bytes < 0) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "BPlusPagedTree got negative cache_bytes.");
+        return -1;
+    }
+
+    // close the file of a tree that is being re-initialized
+    if (BPlusPaged_close(self) == -1) {
+        return -1;
+    }
+
+    if (!PyUnicode_FSConverter(path, &path_bytes)) {
+        return -1;
+    }
+    self->fd = open(PyBytes_AS_STRING(path_bytes), O_RDWR | O_CREAT, 0644);
+    Py_DECREF(path_bytes);
+    if (self->fd == -1) {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+        return -1;
+    }
+    Py_INCREF(path);
+    self->path = path;
+
+    self->nframes = cache_bytes / BPLUSPAGED_PAGE_SIZE < BPLUSPAGED_MIN_FRAMES ? BPLUSPAGED_MIN_FRAMES : (cache_bytes / BPLUSPAGED_PAGE_SIZE > BPLUSPAGED_NONE - 1 ? BPLUSPAGED_NONE - 1 : (unsigned int)(cache_bytes / BPLUSPAGED_PAGE_SIZE));
+    self->frames = (char *)PyMem_RawCalloc(self->nframes, BPLUSPAGED_PAGE_SIZE);
+    self->frame_pages = (unsigned int *)PyMem_RawMalloc(sizeof(unsigned int) * self->nframes);
+    self->frame_refs = (unsigned char *)PyMem_RawCalloc(self->nframes, 1);
+    self->frame_dirty = (unsigned char *)PyMem_RawCalloc(self->nframes, 1);
+    self->frame_pins = (unsigned int *)PyMem_RawCalloc(self->nframes, sizeof(unsigned int));
+    if (self->frames == NULL || self->frame_pages == NULL || self->frame_refs == NULL || self->frame_dirty == NULL || self->frame_pins == NULL) {
+        BPlusPaged_close(self);
+        PyErr_NoMemory();
+        return -1;
+    }
+    memset(self->frame_pages, 0xff, sizeof(unsigned int) * self->nframes);
+
+    if (fstat(self->fd, &st) == -1) {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+        BPlusPaged_close(self);
+        return -1;
+    }
+
+    if ((st.st_size == 0 ? BPlusPaged_create(self) : BPlusPaged_load(self, st.st_size)) == -1) {
+        BPlusPaged_close(self);
+        return -1;
+    }
+
+    if (initializer != Py_None) {
+        return BPlusPaged_update(self, initializer);
+    }
+
+    return 0;
+
+}
+
+static PyObject *BPlusPagedTree_tp_iter(PyObject *self) {
+
+    BPlusPagedTree *tree = (BPlusPagedTree *)self;
+    BPlusPagedIter *iter;
+
+    if (BPlusPaged_check_open(tree) == -1) {
+        return NULL;
+    }
+
+    if ((iter = PyObject_New(BPlusPagedIter, &BPlusPagedIterType)) == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(self);
+    iter->tree = tree;
+    iter->page = tree->first_page;
+    iter->ix = 0;
+    iter->version = tree->version;
+    iter->started = 0;
+    iter->last = 0;
+
+    return (PyObject *)iter;
+
+}
+
+static void BPlusPagedIter_tp_dealloc(BPlusPagedIter *self) {
+    Py_XDECREF(self->tree);
+    PyObject_Free(self);
+}
+
+// returns the next key of the tree, fetching leaves through the cache one at
+// a time, or NULL (with no error set) at the end.
+// If the tree has changed since the last key was returned, the leaf that key
+// was in may have split, so the iterator finds its place again by searching
+// for the key after it.
+static PyObject *BPlusPagedIter_tp_iternext(PyObject *self) {
+
+    BPlusPagedIter *iter = (BPlusPagedIter *)self;
+    BPlusPagedTree *tree = iter->tree;
+    BPlusPagedBranch *path[BPLUSPAGED_MAX_DEPTH];
+    int slots[BPLUSPAGED_MAX_DEPTH], depth;
+    BPlusPage *leaf;
+    l64 key;
+
+    // an exhausted iterator lets go of its tree
+    if (tree == NULL) {
+        return NULL;
+    }
+
+    if (BPlusPaged_check_open(tree) == -1) {
+        return NULL;
+    }
+
+    if (iter->version != tree->version) {
+        iter->version = tree->version;
+        if (!iter->started) {
+            iter->page = tree->first_page;
+            iter->ix = 0;
+        } else if (iter->last == LLONG_MAX) {
+            iter->page = 0;
+        } else {
+            iter->page = BPlusPaged_descend(tree, iter->last + 1, path, slots, &depth);
+            if ((leaf = BPlusCache_fetch(tree, iter->page, 0)) == NULL) {
+                return NULL;
+            }
+            iter->ix = BPlusPage_bisect(leaf, iter->last + 1);
+            BPlusCache_release(tree, leaf, 0);
+        }
+    }
+
+    // page 0 is the header, so it ends the leaf chain
+    while (iter->page != 0) {
+
+        if ((leaf = BPlusCache_fetch(tree, iter->page, 0)) == NULL) {
+            return NULL;
+        }
+
+        if (iter->ix < leaf->count) {
+            key = leaf->keys[iter->ix++];
+            BPlusCache_release(tree, leaf, 0);
+            iter->started = 1;
+            iter->last = key;
+            return PyLong_FromLongLong(key);
+        }
+
+        iter->page = leaf->next;
+        iter->ix = 0;
+        BPlusCache_release(tree, leaf, 0);
+
+    }
+
+    Py_CLEAR(iter->tree);
+    return NULL;
+
+}
+
+
+// BEGIN sequence method definitions
+// this is called on call to len()
+Py_ssize_t BPlusPagedTree_sq_length(PyObject *self) {
+    return ((BPlusPagedTree *)self)->n;
+}
+
+// this is called on use of the `in` keyword.
+// As with a set, anything that is not an int64 (or a float equal to one) is
+// simply not in the tree.
+int BPlusPagedTree_sq_contains(PyObject *self, PyObject *value) {
+
+    BPlusPagedTree *tree = (BPlusPagedTree *)self;
+    int overflow;
+    double d;
+    l64 key;
+
+    if (BPlusPaged_check_open(tree) == -1) {
+        return -1;
+    }
+
+    if (PyLong_Check(value)) {
+        key = PyLong_AsLongLongAndOverflow(value, &overflow);
+        if (overflow) {
+            return 0;
+        }
+    } else if (PyFloat_Check(value)) {
+        d = PyFloat_AS_DOUBLE(value);
+        // 2**63 is the first double past the largest int64, and NaN fails
+        // both bounds
+        if (!(d >= -9223372036854775808.0 && d < 9223372036854775808.0) || d != (double)(l64)d) {
+            return 0;
+        }
+        key = (l64)d;
+    } else {
+        return 0;
+    }
+
+    return BPlusPaged_contains(tree, key);
+
+}
+
+
+// BEGIN public method definitions
+static PyObject *BPlusPagedTree_method_add(PyObject *self, PyObject *args) {
+
+    BPlusPagedTree *tree = (BPlusPagedTree *)self;
+    PyObject *o;
+    l64 key;
+
+    if (!PyArg_ParseTuple(args, "O", &o)) {
+        return NULL;
+    }
+
+    if (BPlusPaged_check_open(tree) == -1 || BPlusPaged_key(o, &key) == -1) {
+        return NULL;
+    }
+
+    if (BPlusPaged_insert(tree, key) == -1) {
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+
+}
+
+static PyObject *BPlusPagedTree_method_update(PyObject *self, PyObject *args) {
+
+    BPlusPagedTree *tree = (BPlusPagedTree *)self;
+    PyObject *iterable;
+
+    if (!PyArg_ParseTuple(args, "O", &iterable)) {
+        return NULL;
+    }
+
+    if (BPlusPaged_check_open(tree) == -1 || BPlusPaged_update(tree, iterable) == -1) {
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+
+}
+
+static PyObject *BPlusPagedTree_method_flush(PyObject *self, PyObject *args) {
+
+    BPlusPagedTree *tree = (BPlusPagedTree *)self;
+
+    if (BPlusPaged_check_open(tree) == -1 || BPlusPaged_flush(tree) == -1) {
+        return NULL;
+    }
+
+    if (fsync(tree->fd) == -1) {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, tree->path);
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+
+}
+
+// closing a closed tree does nothing, as with files
+static PyObject *BPlusPagedTree_method_close(PyObject *self, PyObject *args) {
+
+    if (BPlusPaged_close((BPlusPagedTree *)self) == -1) {
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+
+}
+
+static PyObject *BPlusPagedTree_method_get_cache_stats(PyObject *self, PyObject *args) {
+
+    BPlusPagedTree *tree = (BPlusPagedTree *)self;
+    unsigned int cached = 0;
+
+    for (unsigned int f = 0; f < tree->nframes; f++) {
+        cached += tree->frame_pages[f] != BPLUSPAGED_NONE;
+    }
+
+    return Py_BuildValue(
+        "{s:K,s:K,s:K,s:K,s:d,s:I,s:I,s:I}",
+        "hits", tree->hits,
+        "misses", tree->misses,
+        "evictions", tree->evictions,
+        "writes", tree->writes,
+        "hit_rate", tree->hits + tree->misses == 0 ? 0.0 : (double)tree->hits / (double)(tree->hits + tree->misses),
+        "cache_pages", tree->nframes,
+        "cached_pages", cached,
+        "pages", tree->npages
+    );
+
+}
+
+
+// BEGIN helper function definitions
+
+// sets {key} to the int64 {o}, or returns -1 with an error set if {o} is not
+// an int or does not fit in an int64.
+int BPlusPaged_key(PyObject *o, l64 *key) {
+
+    if (!PyLong_Check(o)) {
+        Py_INCREF(PyExc_TypeError);
+        PyErr_SetString(PyExc_TypeError, "A BPlusPagedTree can only hold ints.");
+        return -1;
+    }
+
+    *key = PyLong_AsLongLong(o);
+    if (*key == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+
+    return 0;
+
+}
+
+// returns -1 with an error set if {tree} has been closed.
+int BPlusPaged_check_open(BPlusPagedTree *tree) {
+
+    if (tree->root == NULL) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "I/O operation on a closed BPlusPagedTree.");
+        return -1;
+    }
+
+    return 0;
+
+}
+
+// sets up an empty tree in a new file: the header, written by the first
+// flush, and one empty leaf.
+int BPlusPaged_create(BPlusPagedTree *tree) {
+
+    BPlusPage *leaf;
+
+    if (BPlusCache_grow(tree, 2) == -1) {
+        return -1;
+    }
+    tree->npages = 2;
+    tree->first_page = 1;
+
+    if ((leaf = BPlusCache_fetch(tree, 1, 1)) == NULL) {
+        return -1;
+    }
+    BPlusCache_release(tree, leaf, 1);
+
+    if ((tree->root = (BPlusPagedBranch *)PyMem_RawCalloc(1, sizeof(BPlusPagedBranch))) == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    tree->root->leaves = 1;
+    tree->root->n = 1;
+    tree->root->keys[0] = LLONG_MIN;
+    tree->root->child.pages[0] = 1;
+
+    return 0;
+
+}
+
+// checks the header of the existing file of {nbytes} bytes, then walks its
+// leaf chain to collect the lowest key of every leaf and rebuilds the
+// branches from them.
+int BPlusPaged_load(BPlusPagedTree *tree, off_t nbytes) {
+
+    BPlusPagedHeader header;
+    BPlusPage *leaf;
+    l64 *keys = NULL;
+    unsigned int *pages = NULL, page;
+    Py_ssize_t nleaves = 0, capacity = 0, n = 0;
+    ssize_t nread;
+    int res = -1;
+
+    if ((nread = pread(tree->fd, &header, sizeof(header), 0)) == -1) {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, tree->path);
+        return -1;
+    }
+
+    if (nread != sizeof(header)
+        || memcmp(header.magic, "BPLUSPGD", 8) != 0
+        || header.format != BPLUSPAGED_FORMAT
+        || header.byte_order != BPLUSPAGED_BYTE_ORDER
+        || header.page_size != BPLUSPAGED_PAGE_SIZE
+        || header.npages < 2 || header.npages == BPLUSPAGED_NONE
+        || header.first_page == 0 || header.first_page >= header.npages
+        || nbytes < (off_t)header.npages * BPLUSPAGED_PAGE_SIZE) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "BPlusPagedTree got a file that is not a paged tree, or was written by an incompatible version.");
+        return -1;
+    }
+
+    tree->npages = header.npages;
+    tree->first_page = header.first_page;
+    if (BPlusCache_grow(tree, tree->npages) == -1) {
+        return -1;
+    }
+
+    for (page = tree->first_page; page != 0; ) {
+
+        // a chain longer than the file has pages must loop back on itself
+        if (nleaves == (Py_ssize_t)tree->npages - 1) {
+            Py_INCREF(PyExc_ValueError);
+            PyErr_SetString(PyExc_ValueError, "BPlusPagedTree found a loop in the leaves of its file.");
+            goto done;
+        }
+
+        if (nleaves == capacity) {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            keys = (l64 *)PyMem_Realloc(keys, sizeof(l64) * capacity);
+            pages = (unsigned int *)PyMem_Realloc(pages, sizeof(unsigned int) * capacity);
+            if (keys == NULL || pages == NULL) {
+                PyErr_NoMemory();
+                goto done;
+            }
+        }
+
+        if ((leaf = BPlusCache_fetch(tree, page, 0)) == NULL) {
+            goto done;
+        }
+        keys[nleaves] = leaf->count > 0 ? leaf->keys[0] : LLONG_MIN;
+        pages[nleaves++] = page;
+        n += leaf->count;
+        page = leaf->next;
+        BPlusCache_release(tree, leaf, 0);
+
+    }
+
+    if ((unsigned long long)n != header.n) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "BPlusPagedTree found a different number of keys in its file than its header records.");
+        goto done;
+    }
+    tree->n = n;
+
+    res = BPlusPaged_build(tree, keys, pages, nleaves);
+
+done:
+    PyMem_Free(keys);
+    PyMem_Free(pages);
+    return res;
+
+}
+
+// builds the branches over the {n} leaves at {pages}, whose lowest keys are
+// {keys}, filling every branch but the last of each level.
+// Each level is built over the one below it, in place in {level}, until one
+// branch is left.
+int BPlusPaged_build(BPlusPagedTree *tree, l64 *keys, unsigned int *pages, Py_ssize_t n) {
+
+    BPlusPagedBranch **level, *branch = NULL;
+    Py_ssize_t size = 0, below = n;
+    int leaves = 1;
+
+    if ((level = (BPlusPagedBranch **)PyMem_Calloc(n, sizeof(BPlusPagedBranch *))) == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    do {
+
+        size = 0;
+        for (Py_ssize_t ix = 0; ix < below; ix++) {
+            if (ix % BPLUSPAGED_FANOUT == 0) {
+                if ((branch = (BPlusPagedBranch *)PyMem_RawCalloc(1, sizeof(BPlusPagedBranch))) == NULL) {
+                    // the branches below {ix} now belong to those built so
+                    // far on this level
+                    for (Py_ssize_t jx = ix; !leaves && jx < below; jx++) {
+                        BPlusPagedBranch_free(level[jx]);
+                    }
+                    for (Py_ssize_t jx = 0; jx < size; jx++) {
+                        BPlusPagedBranch_free(level[jx]);
+                    }
+                    PyMem_Free(level);
+                    PyErr_NoMemory();
+                    return -1;
+                }
+                branch->leaves = leaves;
+            }
+            if (leaves) {
+                branch->keys[branch->n] = keys[ix];
+                branch->child.pages[branch->n++] = pages[ix];
+            } else {
+                branch->keys[branch->n] = level[ix]->keys[0];
+                branch->child.branches[branch->n++] = level[ix];
+            }
+            // a level has no more branches than the one below it has
+            // children, so {level} is overwritten behind {ix}
+            if (ix % BPLUSPAGED_FANOUT == 0) {
+                level[size++] = branch;
+            }
+        }
+
+        below = size;
+        leaves = 0;
+
+    } while (size > 1);
+
+    tree->root = level[0];
+    PyMem_Free(level);
+    return 0;
+
+}
+
+// returns the page id of the leaf that {key} belongs in, recording the
+// branches passed through in {path} and the child taken from each in
+// {slots}, {depth} deep.
+unsigned int BPlusPaged_descend(BPlusPagedTree *tree, l64 key, BPlusPagedBranch **path, int *slots, int *depth) {
+
+    BPlusPagedBranch *branch = tree->root;
+    int ix;
+
+    for (*depth = 0; ; branch = branch->child.branches[ix]) {
+        ix = BPlusPagedBranch_search(branch, key);
+        path[*depth] = branch;
+        slots[(*depth)++] = ix;
+        if (branch->leaves) {
+            return branch->child.pages[ix];
+        }
+    }
+
+}
+
+// inserts {key} into {tree}. Returns 1 if it was added, 0 if it was already
+// there, or -1 with an error set.
+// A full leaf is split in half, except that a key past the end of the last
+// leaf starts a new leaf, so keys added in ascending order fill their pages.
+// The branches a split will need are allocated before any page is touched, so
+// a failure leaves the tree as it was.
+// Raises ValueError if {tree} is closed, which the iterable passed to
+// BPlusPaged_update() may have done between inserts.
+int BPlusPaged_insert(BPlusPagedTree *tree, l64 key) {
+
+    BPlusPagedBranch *path[BPLUSPAGED_MAX_DEPTH], *spares[BPLUSPAGED_MAX_DEPTH + 1] = {NULL};
+    BPlusPage *leaf, *right, *target;
+    unsigned int page, pos, half, newpage;
+    int slots[BPLUSPAGED_MAX_DEPTH], depth, nspares = 0, d;
+
+    if (BPlusPaged_check_open(tree) == -1) {
+        return -1;
+    }
+
+    page = BPlusPaged_descend(tree, key, path, slots, &depth);
+    if ((leaf = BPlusCache_fetch(tree, page, 0)) == NULL) {
+        return -1;
+    }
+
+    pos = BPlusPage_bisect(leaf, key);
+    if (pos < leaf->count && leaf->keys[pos] == key) {
+        BPlusCache_release(tree, leaf, 0);
+        return 0;
+    }
+
+    if (leaf->count < BPLUSPAGED_LEAF_CAPACITY) {
+        memmove(leaf->keys + pos + 1, leaf->keys + pos, sizeof(l64) * (leaf->count - pos));
+        leaf->keys[pos] = key;
+        leaf->count++;
+        BPlusCache_release(tree, leaf, 1);
+        tree->n++;
+        tree->version++;
+        return 1;
+    }
+
+    // one spare for every full branch on the way up, and one for a new root
+    // if they are all full
+    for (d = depth - 1; d >= 0 && path[d]->n == BPLUSPAGED_FANOUT; d--) {
+        nspares++;
+    }
+    nspares += d < 0;
+    for (int ix = 0; ix < nspares; ix++) {
+        if ((spares[ix] = (BPlusPagedBranch *)PyMem_RawCalloc(1, sizeof(BPlusPagedBranch))) == NULL) {
+            goto fail;
+        }
+    }
+
+    if (tree->npages == BPLUSPAGED_NONE - 1) {
+        Py_INCREF(PyExc_OverflowError);
+        PyErr_SetString(PyExc_OverflowError, "BPlusPagedTree has no more page ids to give out.");
+        goto fail;
+    }
+    if (BPlusCache_grow(tree, tree->npages + 1) == -1) {
+        goto fail;
+    }
+    newpage = tree->npages;
+    if ((right = BPlusCache_fetch(tree, newpage, 1)) == NULL) {
+        goto fail;
+    }
+    tree->npages++;
+
+    half = pos == leaf->count && leaf->next == 0 ? leaf->count : leaf->count / 2;
+    memcpy(right->keys, leaf->keys + half, sizeof(l64) * (leaf->count - half));
+    right->count = leaf->count - half;
+    leaf->count = half;
+    right->next = leaf->next;
+    leaf->next = newpage;
+
+    if (pos < half) {
+        target = leaf;
+    } else {
+        target = right;
+        pos -= half;
+    }
+    memmove(target->keys + pos + 1, target->keys + pos, sizeof(l64) * (target->count - pos));
+    target->keys[pos] = key;
+    target->count++;
+
+    key = right->keys[0];
+    BPlusCache_release(tree, leaf, 1);
+    BPlusCache_release(tree, right, 1);
+    BPlusPaged_insert_child(tree, path, slots, depth, key, newpage, spares + nspares);
+
+    tree->n++;
+    tree->version++;
+    return 1;
+
+fail:
+    BPlusCache_release(tree, leaf, 0);
+    for (int ix = 0; ix < nspares; ix++) {
+        PyMem_RawFree(spares[ix]);
+    }
+    if (!PyErr_Occurred()) {
+        PyErr_NoMemory();
+    }
+    return -1;
+
+}
+
+// inserts the leaf {page}, whose lowest key is {key}, after the child taken
+// from the bottom branch of {path}. Each full branch is split in half, with
+// the right half taken from {spares} (counting down), and its lowest key
+// inserted into the branch above; if the root splits, a new root is taken
+// from {spares} too.
+void BPlusPaged_insert_child(BPlusPagedTree *tree, BPlusPagedBranch **path, int *slots, int depth, l64 key, unsigned int page, BPlusPagedBranch **spares) {
+
+    BPlusPagedBranch *branch, *right, *child = NULL;
+    int at, half = BPLUSPAGED_FANOUT / 2;
+
+    for (int d = depth - 1; d >= 0; d--) {
+
+        branch = path[d];
+        at = slots[d] + 1;
+
+        if (branch->n < BPLUSPAGED_FANOUT) {
+            BPlusPagedBranch_insert(branch, at, key, child, page);
+            return;
+        }
+
+        right = *--spares;
+        right->leaves = branch->leaves;
+        right->n = branch->n - half;
+        memcpy(right->keys, branch->keys + half, sizeof(l64) * right->n);
+        if (branch->leaves) {
+            memcpy(right->child.pages, branch->child.pages + half, sizeof(unsigned int) * right->n);
+        } else {
+            memcpy(right->child.branches, branch->child.branches + half, sizeof(BPlusPagedBranch *) * right->n);
+        }
+        branch->n = half;
+
+        if (at <= half) {
+            BPlusPagedBranch_insert(branch, at, key, child, page);
+        } else {
+            BPlusPagedBranch_insert(right, at - half, key, child, page);
+        }
+
+        key = right->keys[0];
+        child = right;
+
+    }
+
+    branch = *--spares;
+    branch->leaves = 0;
+    branch->n = 2;
+    branch->keys[0] = LLONG_MIN;
+    branch->child.branches[0] = tree->root;
+    branch->keys[1] = key;
+    branch->child.branches[1] = child;
+    tree->root = branch;
+
+}
+
+// returns 1 if {key} is in {tree}, 0 if not, or -1 with an error set.
+int BPlusPaged_contains(BPlusPagedTree *tree, l64 key) {
+
+    BPlusPagedBranch *path[BPLUSPAGED_MAX_DEPTH];
+    BPlusPage *leaf;
+    unsigned int pos;
+    int slots[BPLUSPAGED_MAX_DEPTH], depth, res;
+
+    if ((leaf = BPlusCache_fetch(tree, BPlusPaged_descend(tree, key, path, slots, &depth), 0)) == NULL) {
+        return -1;
+    }
+
+    pos = BPlusPage_bisect(leaf, key);
+    res = pos < leaf->count && leaf->keys[pos] == key;
+    BPlusCache_release(tree, leaf, 0);
+
+    return res;
+
+}
+
+// inserts every int in {iterable} into {tree}. Returns 0, or -1 with an error
+// set (after inserting everything before the bad element).
+int BPlusPaged_update(BPlusPagedTree *tree, PyObject *iterable) {
+
+    PyObject *iterator, *o;
+    l64 key;
+    int res = 0;
+
+    if ((iterator = PyObject_GetIter(iterable)) == NULL) {
+        return -1;
+    }
+
+    while (res == 0 && (o = PyIter_Next(iterator)) != NULL) {
+        if (BPlusPaged_key(o, &key) == -1 || BPlusPaged_insert(tree, key) == -1) {
+            res = -1;
+        }
+        Py_DECREF(o);
+    }
+    Py_DECREF(iterator);
+
+    return PyErr_Occurred() ? -1 : res;
+
+}
+
+// writes every changed page in the cache, and then the header, to the file.
+int BPlusPaged_flush(BPlusPagedTree *tree) {
+
+    char page[BPLUSPAGED_PAGE_SIZE] = {0};
+    BPlusPagedHeader *header = (BPlusPagedHeader *)page;
+
+    for (unsigned int f = 0; f < tree->nframes; f++) {
+        if (tree->frame_dirty[f] && BPlusCache_write(tree, f) == -1) {
+            return -1;
+        }
+    }
+
+    memcpy(header->magic, "BPLUSPGD", 8);
+    header->format = BPLUSPAGED_FORMAT;
+    header->byte_order = BPLUSPAGED_BYTE_ORDER;
+    header->page_size = BPLUSPAGED_PAGE_SIZE;
+    header->first_page = tree->first_page;
+    header->npages = tree->npages;
+    header->n = tree->n;
+
+    if (pwrite(tree->fd, page, BPLUSPAGED_PAGE_SIZE, 0) != BPLUSPAGED_PAGE_SIZE) {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, tree->path);
+        return -1;
+    }
+
+    return 0;
+
+}
+
+// flushes {tree} if it is open, then closes its file and frees its branches
+// and cache. Safe to call on a tree in any state, including one that never
+// finished opening. Returns -1 with an error set if the flush failed (the
+// tree is closed regardless).
+int BPlusPaged_close(BPlusPagedTree *tree) {
+
+    int res = 0;
+
+    if (tree->root != NULL) {
+        res = BPlusPaged_flush(tree);
+        BPlusPagedBranch_free(tree->root);
+        tree->root = NULL;
+    }
+
+    // {path} is only set while {fd} is open
+    if (tree->path != NULL) {
+        close(tree->fd);
+        Py_CLEAR(tree->path);
+    }
+
+    PyMem_RawFree(tree->frames);
+    PyMem_RawFree(tree->frame_pages);
+    PyMem_RawFree(tree->frame_refs);
+    PyMem_RawFree(tree->frame_dirty);
+    PyMem_RawFree(tree->frame_pins);
+    PyMem_RawFree(tree->page_frames);
+    tree->frames = NULL;
+    tree->frame_pages = NULL;
+    tree->frame_refs = NULL;
+    tree->frame_dirty = NULL;
+    tree->frame_pins = NULL;
+    tree->page_frames = NULL;
+    tree->page_frames_size = 0;
+    tree->nframes = 0;
+    tree->hand = 0;
+    tree->n = 0;
+    tree->version++;
+
+    return res;
+
+}
+
+// returns the index of the first key of {leaf} that is at least {key}.
+unsigned int BPlusPage_bisect(BPlusPage *leaf, l64 key) {
+
+    unsigned int lo = 0, hi = leaf->count, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (leaf->keys[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+
+}
+
+// returns the index of the child of {branch} that {key} belongs beneath: the
+// last child whose lowest key is at most {key}, or the first child.
+int BPlusPagedBranch_search(BPlusPagedBranch *branch, l64 key) {
+
+    int lo = 1, hi = branch->n, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (branch->keys[mid] <= key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo - 1;
+
+}
+
+// inserts a child with lowest key {key} at index {at} of {branch}, which must
+// have room for it: the branch {child}, or the leaf {page} if {branch} holds
+// leaves.
+void BPlusPagedBranch_insert(BPlusPagedBranch *branch, int at, l64 key, BPlusPagedBranch *child, unsigned int page) {
+
+    memmove(branch->keys + at + 1, branch->keys + at, sizeof(l64) * (branch->n - at));
+    branch->keys[at] = key;
+
+    if (branch->leaves) {
+        memmove(branch->child.pages + at + 1, branch->child.pages + at, sizeof(unsigned int) * (branch->n - at));
+        branch->child.pages[at] = page;
+    } else {
+        memmove(branch->child.branches + at + 1, branch->child.branches + at, sizeof(BPlusPagedBranch *) * (branch->n - at));
+        branch->child.branches[at] = child;
+    }
+
+    branch->n++;
+
+}
+
+void BPlusPagedBranch_free(BPlusPagedBranch *branch) {
+
+    if (branch == NULL) {
+        return;
+    }
+
+    if (!branch->leaves) {
+        for (int ix = 0; ix < branch->n; ix++) {
+            BPlusPagedBranch_free(branch->child.branches[ix]);
+        }
+    }
+
+    PyMem_RawFree(branch);
+
+}
+
+// returns the leaf {page} pinned in the cache, reading it from the file if it
+// is not there already, or NULL with an error set. A {fresh} page has never
+// been written and is zeroed instead of read.
+// To make room, the CLOCK hand sweeps the frames: a frame used since the last
+// sweep gets its reference bit cleared and a second chance, and the first
+// unpinned frame without one is evicted.
+// Every fetch must be matched by a BPlusCache_release().
+BPlusPage *BPlusCache_fetch(BPlusPagedTree *tree, unsigned int page, int fresh) {
+
+    unsigned int f = tree->page_frames[page], old;
+    BPlusPage *leaf;
+    ssize_t nread;
+
+    if (f != BPLUSPAGED_NONE) {
+        tree->hits++;
+        tree->frame_refs[f] = 1;
+        tree->frame_pins[f]++;
+        return (BPlusPage *)(tree->frames + (size_t)f * BPLUSPAGED_PAGE_SIZE);
+    }
+
+    // two sweeps clear every reference bit, so a third finds a frame unless
+    // they are all pinned
+    for (unsigned int scanned = 0; ; scanned++) {
+        if (scanned == 3 * tree->nframes) {
+            Py_INCREF(PyExc_RuntimeError);
+            PyErr_SetString(PyExc_RuntimeError, "BPlusPagedTree has every page of its cache pinned.");
+            return NULL;
+        }
+        f = tree->hand;
+        tree->hand = (tree->hand + 1) % tree->nframes;
+        if (tree->frame_pins[f] > 0) {
+            continue;
+        }
+        if (tree->frame_refs[f]) {
+            tree->frame_refs[f] = 0;
+            continue;
+        }
+        break;
+    }
+
+    if ((old = tree->frame_pages[f]) != BPLUSPAGED_NONE) {
+        if (tree->frame_dirty[f] && BPlusCache_write(tree, f) == -1) {
+            return NULL;
+        }
+        tree->page_frames[old] = BPLUSPAGED_NONE;
+        tree->frame_pages[f] = BPLUSPAGED_NONE;
+        tree->evictions++;
+    }
+
+    leaf = (BPlusPage *)(tree->frames + (size_t)f * BPLUSPAGED_PAGE_SIZE);
+    if (fresh) {
+        memset(leaf, 0, BPLUSPAGED_PAGE_SIZE);
+    } else {
+        tree->misses++;
+        if ((nread = pread(tree->fd, leaf, BPLUSPAGED_PAGE_SIZE, (off_t)page * BPLUSPAGED_PAGE_SIZE)) == -1) {
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, tree->path);
+            return NULL;
+        }
+        if (nread != BPLUSPAGED_PAGE_SIZE || leaf->count > BPLUSPAGED_LEAF_CAPACITY || leaf->next >= tree->npages) {
+            Py_INCREF(PyExc_ValueError);
+            PyErr_SetString(PyExc_ValueError, "BPlusPagedTree found a corrupt page in its file.");
+            return NULL;
+        }
+    }
+
+    tree->frame_pages[f] = page;
+    tree->page_frames[page] = f;
+    tree->frame_refs[f] = 1;
+    tree->frame_dirty[f] = (unsigned char)fresh;
+    tree->frame_pins[f] = 1;
+
+    return leaf;
+
+}
+
+// unpins {leaf}, marking it to be written back if {dirty}.
+void BPlusCache_release(BPlusPagedTree *tree, BPlusPage *leaf, int dirty) {
+
+    unsigned int f = (unsigned int)(((char *)leaf - tree->frames) / BPLUSPAGED_PAGE_SIZE);
+
+    tree->frame_pins[f]--;
+    tree->frame_dirty[f] |= (unsigned char)dirty;
+
+}
+
+// writes the page in {frame} to its place in the file.
+int BPlusCache_write(BPlusPagedTree *tree, unsigned int frame) {
+
+    ssize_t nwritten = pwrite(
+        tree->fd,
+        tree->frames + (size_t)frame * BPLUSPAGED_PAGE_SIZE,
+        BPLUSPAGED_PAGE_SIZE,
+        (off_t)tree->frame_pages[frame] * BPLUSPAGED_PAGE_SIZE
+    );
+
+    if (nwritten != BPLUSPAGED_PAGE_SIZE) {
+        if (nwritten >= 0) {
+            errno = EIO;
+        }
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, tree->path);
+        return -1;
+    }
+
+    tree->frame_dirty[frame] = 0;
+    tree->writes++;
+
+    return 0;
+
+}
+
+// makes room in the page table for {npages} pages, doubling it as needed.
+int BPlusCache_grow(BPlusPagedTree *tree, unsigned int npages) {
+
+    unsigned int size = tree->page_frames_size, *page_frames;
+
+    if (npages <= size) {
+        return 0;
+    }
+
+    while (size < npages) {
+        size = size < 64 ? 64 : (size > BPLUSPAGED_NONE / 2 ? BPLUSPAGED_NONE : size * 2);
+    }
+
+    if ((page_frames = (unsigned int *)PyMem_RawRealloc(tree->page_frames, sizeof(unsigned int) * size)) == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    memset(page_frames + tree->page_frames_size, 0xff, sizeof(unsigned int) * (size - tree->page_frames_size));
+
+    tree->page_frames = page_frames;
+    tree->page_frames_size = size;
+
+    return 0;
+
+}
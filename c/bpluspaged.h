@@ -0,0 +1,65 @@
+// Definitions of public and private methods used by BPlusPagedTree.
+// See bpluspaged.c for documentation on the methods declared in this file.
+
+
+#ifndef BPLUSPAGED_H
+#define BPLUSPAGED_H
+
+
+#include <Python.h>
+#include "structmember.h"
+#include "bplustypes.h"
+#include "general.h"
+
+
+// the type objects are registered with the module by PyInit_c() in
+// bplustree.c
+extern PyTypeObject BPlusPagedTreeType;
+extern PyTypeObject BPlusPagedIterType;
+
+
+// BEGIN BPlusPagedTree private helper method headers
+static int BPlusPaged_key(PyObject *o, l64 *key);
+static int BPlusPaged_check_open(BPlusPagedTree *tree);
+static int BPlusPaged_create(BPlusPagedTree *tree);
+static int BPlusPaged_load(BPlusPagedTree *tree, off_t nbytes);
+static int BPlusPaged_build(BPlusPagedTree *tree, l64 *keys, unsigned int *pages, Py_ssize_t n);
+static unsigned int BPlusPaged_descend(BPlusPagedTree *tree, l64 key, BPlusPagedBranch **path, int *slots, int *depth);
+static int BPlusPaged_insert(BPlusPagedTree *tree, l64 key);
+static void BPlusPaged_insert_child(BPlusPagedTree *tree, BPlusPagedBranch **path, int *slots, int depth, l64 key, unsigned int page, BPlusPagedBranch **spares);
+static int BPlusPaged_contains(BPlusPagedTree *tree, l64 key);
+static int BPlusPaged_update(BPlusPagedTree *tree, PyObject *iterable);
+static int BPlusPaged_flush(BPlusPagedTree *tree);
+static int BPlusPaged_close(BPlusPagedTree *tree);
+static unsigned int BPlusPage_bisect(BPlusPage *leaf, l64 key);
+static int BPlusPagedBranch_search(BPlusPagedBranch *branch, l64 key);
+static void BPlusPagedBranch_insert(BPlusPagedBranch *branch, int at, l64 key, BPlusPagedBranch *child, unsigned int page);
+static void BPlusPagedBranch_free(BPlusPagedBranch *branch);
+static BPlusPage *BPlusCache_fetch(BPlusPagedTree *tree, unsigned int page, int fresh);
+static void BPlusCache_release(BPlusPagedTree *tree, BPlusPage *leaf, int dirty);
+static int BPlusCache_write(BPlusPagedTree *tree, unsigned int frame);
+static int BPlusCache_grow(BPlusPagedTree *tree, unsigned int npages);
+
+
+// BEGIN tp method headers
+static void BPlusPagedTree_tp_dealloc(BPlusPagedTree *self);
+static int BPlusPagedTree_tp_init(BPlusPagedTree *self, PyObject *args, PyObject *kwargs);
+static PyObject *BPlusPagedTree_tp_iter(PyObject *self);
+static void BPlusPagedIter_tp_dealloc(BPlusPagedIter *self);
+static PyObject *BPlusPagedIter_tp_iternext(PyObject *self);
+
+
+// BEGIN sequence method headers
+static Py_ssize_t BPlusPagedTree_sq_length(PyObject *self);
+static int BPlusPagedTree_sq_contains(PyObject *self, PyObject *value);
+
+
+// BEGIN public method headers
+static PyObject *BPlusPagedTree_method_add(PyObject *self, PyObject *args);
+static PyObject *BPlusPagedTree_method_update(PyObject *self, PyObject *args);
+static PyObject *BPlusPagedTree_method_flush(PyObject *self, PyObject *args);
+static PyObject *BPlusPagedTree_method_close(PyObject *self, PyObject *args);
+static PyObject *BPlusPagedTree_method_get_cache_stats(PyObject *self, PyObject *args);
+
+
+#endif
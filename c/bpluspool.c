@@ -0,0 +1,297 @@
+// BPlusPool method definitions.
+// Once the elements of a large initializer have been hashed, sorting them and
+// laying out the leaves needs no Python objects at all. Those phases run with
+// the GIL released, and are split between the threads of a small worker pool
+// here. Each call to BPlusPool_run() starts its own threads and joins them
+// before returning, so nothing is left running between builds.
+#include <Python.h>
+#include <unistd.h>
+#include "bplustypes.h"
+#include "general.h"
+#include "array32.h"
+#include "bpluspool.h"
+
+
+// number of threads to use for large builds, or 0 if it has not been set yet
+// (see BPlusPool_method_get_threads())
+static int BPlusPool_threads = 0;
+
+// the default number of threads, used until set_threads() is called
+#define BPLUSPOOL_DEFAULT_THREADS 8
+
+// the most buckets BPlusPool_sort() splits its input into
+#define BPLUSPOOL_MAX_BUCKETS 256
+// the number of hashes sampled for each bucket when choosing splitters
+#define BPLUSPOOL_OVERSAMPLE 32
+
+
+// returns the number of threads the pool is set to use, defaulting to the
+// number of online processors (up to {BPLUSPOOL_DEFAULT_THREADS}).
+int BPlusPool_get_threads(void) {
+
+    long online;
+
+    if (BPlusPool_threads == 0) {
+        online = sysconf(_SC_NPROCESSORS_ONLN);
+        BPlusPool_threads = online < 1 ? 1 : (online > BPLUSPOOL_DEFAULT_THREADS ? BPLUSPOOL_DEFAULT_THREADS : (int)online);
+    }
+
+    return BPlusPool_threads;
+
+}
+
+// returns the number of threads worth using on {n} elements: never more than
+// the pool is set to use, and only one for every {BPLUSPOOL_GRAIN} elements.
+int BPlusPool_workers(Py_ssize_t n) {
+
+    int threads = BPlusPool_get_threads();
+    Py_ssize_t useful = n / BPLUSPOOL_GRAIN;
+
+    if (useful < 1) {
+        return 1;
+    }
+
+    return useful < threads ? (int)useful : threads;
+
+}
+
+// runs {task}({arg}, ix) for every ix in [0, {ntasks}), spread over up to
+// {nthreads} threads, one of which is the calling thread. Returns once every
+// task has finished.
+// If threads cannot be started the remaining tasks are run by the calling
+// thread, so this never fails.
+// No Python objects are touched, so this may (and should) run without the
+// GIL, as long as {task} does not touch any either.
+void BPlusPool_run(void (*task)(void *arg, int ix), void *arg, int ntasks, int nthreads) {
+
+    BPlusJob job;
+    pthread_t threads[BPLUSPOOL_MAX_THREADS];
+    int started = 0;
+
+    if (nthreads > ntasks) nthreads = ntasks;
+    if (nthreads > BPLUSPOOL_MAX_THREADS) nthreads = BPLUSPOOL_MAX_THREADS;
+
+    job.task = task;
+    job.arg = arg;
+    job.ntasks = ntasks;
+    job.next = 0;
+
+    if (nthreads <= 1) {
+        for (int ix = 0; ix < ntasks; ix++) {
+            task(arg, ix);
+        }
+        return;
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+
+    for (; started < nthreads - 1; started++) {
+        if (pthread_create(&threads[started], NULL, BPlusPool_worker, &job) != 0) {
+            break;
+        }
+    }
+
+    BPlusPool_worker(&job);
+
+    for (int ix = 0; ix < started; ix++) {
+        pthread_join(threads[ix], NULL);
+    }
+
+    pthread_mutex_destroy(&job.lock);
+
+}
+
+// thread body for BPlusPool_run(): takes tasks from the {BPlusJob} {arg}
+// until there are none left.
+void *BPlusPool_worker(void *arg) {
+
+    BPlusJob *job = (BPlusJob *)arg;
+    int ix;
+
+    while (1) {
+
+        pthread_mutex_lock(&job->lock);
+        ix = job->next++;
+        pthread_mutex_unlock(&job->lock);
+
+        if (ix >= job->ntasks) {
+            return NULL;
+        }
+
+        job->task(job->arg, ix);
+
+    }
+
+}
+
+// sorts the {n} elements of {a} by hash, like sort_keyed() in array32.c (and
+// with the same arguments), splitting the work between the threads of the
+// pool when {n} is large enough.
+// This is a sample sort: a sample of the hashes picks splitters that divide
+// the elements into buckets of about equal size, every chunk of {a} is
+// counted and then moved into {scratch} bucket by bucket, and each bucket is
+// then sorted on its own.
+// No Python objects are touched, so this may run without the GIL.
+void BPlusPool_sort(void *a, void *scratch, Py_ssize_t n, int width) {
+
+    BPlusSort sort;
+    int nthreads = BPlusPool_workers(n), nsamples;
+    l64 *samples;
+    Py_ssize_t offset, count;
+
+    if (nthreads <= 1) {
+        sort_keyed(a, scratch, n, width);
+        return;
+    }
+
+    sort.a = (char *)a;
+    sort.scratch = (char *)scratch;
+    sort.n = n;
+    sort.width = width;
+    // a few buckets per thread evens out threads that draw smaller buckets
+    sort.nbuckets = 4 * nthreads < BPLUSPOOL_MAX_BUCKETS ? 4 * nthreads : BPLUSPOOL_MAX_BUCKETS;
+
+    nsamples = sort.nbuckets * BPLUSPOOL_OVERSAMPLE;
+    samples = (l64 *)malloc(sizeof(l64) * 2 * nsamples);
+    sort.splitters = (l64 *)malloc(sizeof(l64) * sort.nbuckets);
+    sort.counts = (Py_ssize_t *)calloc((size_t)sort.nbuckets * sort.nbuckets, sizeof(Py_ssize_t));
+    sort.starts = (Py_ssize_t *)malloc(sizeof(Py_ssize_t) * (sort.nbuckets + 1));
+    if (samples == NULL || sort.splitters == NULL || sort.counts == NULL || sort.starts == NULL) {
+        // fall back on sorting in this thread
+        free(samples);
+        free(sort.splitters);
+        free(sort.counts);
+        free(sort.starts);
+        sort_keyed(a, scratch, n, width);
+        return;
+    }
+
+    // take evenly spaced samples and use every {BPLUSPOOL_OVERSAMPLE}th one
+    for (int ix = 0; ix < nsamples; ix++) {
+        samples[ix] = *(l64 *)(sort.a + (size_t)width * (n * ix / nsamples));
+    }
+    sort_keyed(samples, samples + nsamples, nsamples, sizeof(l64));
+    for (int ix = 0; ix < sort.nbuckets - 1; ix++) {
+        sort.splitters[ix] = samples[(ix + 1) * BPLUSPOOL_OVERSAMPLE];
+    }
+    free(samples);
+
+    BPlusPool_run(BPlusSort_count, &sort, sort.nbuckets, nthreads);
+
+    // lay the buckets out one after the other, each holding the elements of
+    // every chunk in order
+    offset = 0;
+    for (int k = 0; k < sort.nbuckets; k++) {
+        sort.starts[k] = offset;
+        for (int c = 0; c < sort.nbuckets; c++) {
+            count = sort.counts[c * sort.nbuckets + k];
+            sort.counts[c * sort.nbuckets + k] = offset;
+            offset += count;
+        }
+    }
+    sort.starts[sort.nbuckets] = n;
+
+    BPlusPool_run(BPlusSort_scatter, &sort, sort.nbuckets, nthreads);
+    BPlusPool_run(BPlusSort_bucket_sort, &sort, sort.nbuckets, nthreads);
+
+    free(sort.splitters);
+    free(sort.counts);
+    free(sort.starts);
+
+}
+
+// returns the bucket that an element with hash {key} belongs in: the number
+// of splitters that are not above {key}.
+int BPlusSort_bucket(BPlusSort *sort, l64 key) {
+
+    int lo = 0, hi = sort->nbuckets - 1, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (sort->splitters[mid] <= key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+
+}
+
+// task for BPlusPool_sort(): counts the elements of chunk {chunk} of the
+// {BPlusSort} {arg} that belong in each bucket.
+void BPlusSort_count(void *arg, int chunk) {
+
+    BPlusSort *sort = (BPlusSort *)arg;
+    Py_ssize_t
+        lo = sort->n * chunk / sort->nbuckets,
+        hi = sort->n * (chunk + 1) / sort->nbuckets,
+        *counts = sort->counts + (size_t)chunk * sort->nbuckets;
+
+    for (Py_ssize_t ix = lo; ix < hi; ix++) {
+        counts[BPlusSort_bucket(sort, *(l64 *)(sort->a + (size_t)sort->width * ix))]++;
+    }
+
+}
+
+// task for BPlusPool_sort(): moves the elements of chunk {chunk} of the
+// {BPlusSort} {arg} to their buckets in {scratch}.
+void BPlusSort_scatter(void *arg, int chunk) {
+
+    BPlusSort *sort = (BPlusSort *)arg;
+    Py_ssize_t
+        lo = sort->n * chunk / sort->nbuckets,
+        hi = sort->n * (chunk + 1) / sort->nbuckets,
+        *offsets = sort->counts + (size_t)chunk * sort->nbuckets,
+        offset;
+    char *element;
+
+    for (Py_ssize_t ix = lo; ix < hi; ix++) {
+        element = sort->a + (size_t)sort->width * ix;
+        offset = offsets[BPlusSort_bucket(sort, *(l64 *)element)]++;
+        memcpy(sort->scratch + (size_t)sort->width * offset, element, sort->width);
+    }
+
+}
+
+// task for BPlusPool_sort(): sorts bucket {bucket} of the {BPlusSort} {arg}
+// and moves it back into place in {a}.
+// The bucket's own range of {a} is free by now, so it is used as the working
+// space for the sort.
+void BPlusSort_bucket_sort(void *arg, int bucket) {
+
+    BPlusSort *sort = (BPlusSort *)arg;
+    size_t
+        start = (size_t)sort->width * sort->starts[bucket],
+        nbytes = (size_t)sort->width * (sort->starts[bucket + 1] - sort->starts[bucket]);
+
+    sort_keyed(sort->scratch + start, sort->a + start, sort->starts[bucket + 1] - sort->starts[bucket], sort->width);
+    memcpy(sort->a + start, sort->scratch + start, nbytes);
+
+}
+
+// BEGIN module method definitions
+PyObject *BPlusPool_method_get_threads(PyObject *module, PyObject *args) {
+    return PyLong_FromLong(BPlusPool_get_threads());
+}
+
+PyObject *BPlusPool_method_set_threads(PyObject *module, PyObject *args) {
+
+    int threads;
+
+    if (!PyArg_ParseTuple(args, "i", &threads)) {
+        return NULL;
+    }
+
+    if (threads < 1 || BPLUSPOOL_MAX_THREADS < threads) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "set_threads() got out of bounds threads: needs to be in [1, 64].");
+        return NULL;
+    }
+
+    BPlusPool_threads = threads;
+
+    Py_RETURN_NONE;
+
+}
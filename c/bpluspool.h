@@ -0,0 +1,33 @@
+// Definitions of the worker pool used to split up the GIL-free phases of
+// building a tree.
+// See bpluspool.c for documentation on the methods declared in this file.
+
+
+#ifndef BPLUSPOOL_H
+#define BPLUSPOOL_H
+
+
+#include <Python.h>
+#include "bplustypes.h"
+#include "general.h"
+#include "array32.h"
+
+
+// BEGIN public method headers
+int BPlusPool_workers(Py_ssize_t n);
+void BPlusPool_run(void (*task)(void *arg, int ix), void *arg, int ntasks, int nthreads);
+void BPlusPool_sort(void *a, void *scratch, Py_ssize_t n, int width);
+PyObject *BPlusPool_method_get_threads(PyObject *module, PyObject *args);
+PyObject *BPlusPool_method_set_threads(PyObject *module, PyObject *args);
+
+
+// BEGIN private helper method headers
+static int BPlusPool_get_threads(void);
+static void *BPlusPool_worker(void *arg);
+static int BPlusSort_bucket(BPlusSort *sort, l64 key);
+static void BPlusSort_count(void *arg, int chunk);
+static void BPlusSort_scatter(void *arg, int chunk);
+static void BPlusSort_bucket_sort(void *arg, int bucket);
+
+
+#endif
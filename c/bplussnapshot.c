@@ -0,0 +1,738 @@
+// BPlusSnapshot method definitions.
+// BPlusTree.save() writes the elements of a tree to a snapshot file, which a
+// BPlusSnapshot maps read-only. Nothing in the file is a pointer: the
+// elements are found through arrays of separators whose children are found
+// by their position (see {BPlusSnapshotHeader} in bplustypes.h), so opening
+// a snapshot only maps it, and every process that opens the same file shares
+// its pages through the page cache.
+// Python randomizes the hashes of str and bytes in every process, so a
+// snapshot orders its elements by a hash of its own instead (see
+// BPlusSnapshot_key()).
+#include <Python.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "structmember.h"
+#include "bplustypes.h"
+#include "general.h"
+#include "bplussnapshot.h"
+
+
+// bumped whenever the layout of snapshot files changes
+#define BPLUSSNAPSHOT_FORMAT 1
+// written to every file by the saving machine, to catch files moved between
+// machines of different byte order
+#define BPLUSSNAPSHOT_BYTE_ORDER 0x01020304
+
+
+// define our subslot for BPlusSnapshot sequence methods
+static PySequenceMethods BPlusSnapshot_sq_methods = {
+    (lenfunc)BPlusSnapshot_sq_length,           /*sq_length*/
+    0,                                          /*sq_concat*/
+    0,                                          /*sq_repeat*/
+    0,                                          /*sq_item*/
+    0,                                          /*was_sq_slice*/
+    0,                                          /*sq_ass_item (???)*/
+    0,                                          /*was_sq_ass_slice (???)*/
+    BPlusSnapshot_sq_contains,                  /*sq_contains*/
+    0,                                          /*sq_inplace_concat*/
+    0,                                          /*sq_inplace_repeat*/
+};
+
+
+// define our subslot for BPlusSnapshot public methods
+static PyMethodDef BPlusSnapshot_tp_methods[] = {
+    {"get_nbytes", BPlusSnapshot_method_get_nbytes, METH_NOARGS, "Return the size in bytes of the mapped snapshot file."},
+    {NULL, NULL, 0, NULL}
+};
+
+
+// define our BPlusSnapshotType type object
+PyTypeObject BPlusSnapshotType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "five_one_one_bplus.c.BPlusSnapshot",       /*tp_name*/
+    sizeof(BPlusSnapshot),                      /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)BPlusSnapshot_tp_dealloc,       /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    &BPlusSnapshot_sq_methods,                  /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   /*tp_flags*/
+    0,                                          /*tp_doc*/
+    0,                                          /*tp_traverse*/
+    0,                                          /*tp_clear*/
+    0,                                          /*tp_richcompare*/
+    0,                                          /*tp_weaklistoffset*/
+    (getiterfunc)BPlusSnapshot_tp_iter,         /*tp_iter*/
+    0,                                          /*tp_iternext*/
+    BPlusSnapshot_tp_methods,                   /*tp_methods*/
+    0,                                          /*tp_members*/
+    0,                                          /*tp_getsets*/
+    0,                                          /*tp_base*/
+    0,                                          /*tp_dict*/
+    0,                                          /*tp_descr_get*/
+    0,                                          /*tp_descr_set*/
+    0,                                          /*tp_dictoffset*/
+    (initproc)BPlusSnapshot_tp_init,            /*tp_init*/
+    0,                                          /*tp_alloc*/
+    PyType_GenericNew,                          /*tp_new*/
+};
+
+
+// define our BPlusSnapshotIterType type object
+PyTypeObject BPlusSnapshotIterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "five_one_one_bplus.c.BPlusSnapshotIter",   /*tp_name*/
+    sizeof(BPlusSnapshotIter),                  /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)BPlusSnapshotIter_tp_dealloc,   /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,                         /*tp_flags*/
+    0,                                          /*tp_doc*/
+    0,                                          /*tp_traverse*/
+    0,                                          /*tp_clear*/
+    0,                                          /*tp_richcompare*/
+    0,                                          /*tp_weaklistoffset*/
+    PyObject_SelfIter,                          /*tp_iter*/
+    (iternextfunc)BPlusSnapshotIter_tp_iternext, /*tp_iternext*/
+};
+
+
+// BEGIN tp method definitions
+static void BPlusSnapshot_tp_dealloc(BPlusSnapshot *self) {
+    BPlusSnapshot_unmap(self);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+// maps the snapshot file at {path}.
+// Only the header is read here; the rest of the file is paged in as lookups
+// and iteration reach it.
+static int BPlusSnapshot_tp_init(BPlusSnapshot *self, PyObject *args, PyObject *kwargs) {
+
+    PyObject *path, *path_bytes;
+    struct stat st;
+    void *map;
+    int fd;
+    static char *kwlist[] = {"path", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", kwlist, &path)) {
+        return -1;
+    }
+
+    if (!PyUnicode_FSConverter(path, &path_bytes)) {
+        return -1;
+    }
+
+    // release the mapping of a snapshot that is being re-initialized
+    BPlusSnapshot_unmap(self);
+
+    if ((fd = open(PyBytes_AS_STRING(path_bytes), O_RDONLY)) == -1) {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+        Py_DECREF(path_bytes);
+        return -1;
+    }
+    Py_DECREF(path_bytes);
+
+    if (fstat(fd, &st) == -1) {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+        close(fd);
+        return -1;
+    }
+
+    if ((size_t)st.st_size < sizeof(BPlusSnapshotHeader)) {
+        close(fd);
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "BPlusSnapshot got a file that is not a snapshot.");
+        return -1;
+    }
+
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+        return -1;
+    }
+
+    self->map = (char *)map;
+    self->nbytes = (size_t)st.st_size;
+    self->header = (BPlusSnapshotHeader *)map;
+
+    if (BPlusSnapshot_check(self) == -1) {
+        BPlusSnapshot_unmap(self);
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "BPlusSnapshot got a file that is not a snapshot, or was written by an incompatible version.");
+        return -1;
+    }
+
+    self->keys = (l64 *)(self->map + self->header->keys_offset);
+    self->entries = (BPlusSnapshotEntry *)(self->map + self->header->entries_offset);
+    self->data = self->map + self->header->data_offset;
+    self->n = (Py_ssize_t)self->header->n;
+
+    return 0;
+
+}
+
+static PyObject *BPlusSnapshot_tp_iter(PyObject *self) {
+
+    BPlusSnapshotIter *iter;
+
+    if (BPlusSnapshot_check_loaded((BPlusSnapshot *)self) == -1) {
+        return NULL;
+    }
+
+    if ((iter = PyObject_New(BPlusSnapshotIter, &BPlusSnapshotIterType)) == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(self);
+    iter->snapshot = (BPlusSnapshot *)self;
+    iter->ix = 0;
+
+    return (PyObject *)iter;
+
+}
+
+static void BPlusSnapshotIter_tp_dealloc(BPlusSnapshotIter *self) {
+    Py_XDECREF(self->snapshot);
+    PyObject_Free(self);
+}
+
+// returns the next element of the snapshot, created from the mapping, or
+// NULL (with no error set) at the end.
+static PyObject *BPlusSnapshotIter_tp_iternext(PyObject *self) {
+
+    BPlusSnapshotIter *iter = (BPlusSnapshotIter *)self;
+
+    // the snapshot may have failed to re-initialize under the iterator
+    if (BPlusSnapshot_check_loaded(iter->snapshot) == -1) {
+        return NULL;
+    }
+
+    if (iter->ix >= iter->snapshot->n) {
+        return NULL;
+    }
+
+    return BPlusSnapshot_element(iter->snapshot, iter->ix++);
+
+}
+
+
+// BEGIN sequence method definitions
+// this is called on call to len()
+Py_ssize_t BPlusSnapshot_sq_length(PyObject *self) {
+    if (BPlusSnapshot_check_loaded((BPlusSnapshot *)self) == -1) {
+        return -1;
+    }
+    return ((BPlusSnapshot *)self)->n;
+}
+
+// this is called on use of the `in` keyword.
+// Exact ints, bytes and strs are compared straight against the mapping; only
+// other objects whose hash matches an element need that element created.
+int BPlusSnapshot_sq_contains(PyObject *self, PyObject *value) {
+
+    BPlusSnapshot *snapshot = (BPlusSnapshot *)self;
+    const char *data;
+    Py_ssize_t len;
+    int tag, res;
+    l64 key;
+
+    if (BPlusSnapshot_check_loaded(snapshot) == -1) {
+        return -1;
+    }
+
+    if ((key = BPlusSnapshot_key(value, &tag, &data, &len)) == -1 && PyErr_Occurred()) {
+        // a str that cannot be encoded as UTF-8 can never have been saved
+        if (PyErr_ExceptionMatches(PyExc_UnicodeEncodeError)) {
+            PyErr_Clear();
+            return 0;
+        }
+        return -1;
+    }
+
+    for (Py_ssize_t ix = BPlusSnapshot_find(snapshot, key); ix < snapshot->n && snapshot->keys[ix] == key; ix++) {
+        if ((res = BPlusSnapshot_equals(snapshot, ix, value, tag, data, len)) != 0) {
+            return res;
+        }
+    }
+
+    return 0;
+
+}
+
+
+// BEGIN public method definitions
+static PyObject *BPlusSnapshot_method_get_nbytes(PyObject *self, PyObject *args) {
+    if (BPlusSnapshot_check_loaded((BPlusSnapshot *)self) == -1) {
+        return NULL;
+    }
+    return PyLong_FromSize_t(((BPlusSnapshot *)self)->nbytes);
+}
+
+
+// BEGIN helper function definitions
+
+// returns a 64 bit FNV-1a hash of the {len} bytes at {data}, seeded with
+// {tag} so that equal bytes and strs hash differently. Never returns -1.
+l64 BPlusSnapshot_hash_bytes(const char *data, Py_ssize_t len, int tag) {
+
+    unsigned long long hash = 0xcbf29ce484222325ULL ^ (unsigned long long)tag;
+
+    for (Py_ssize_t ix = 0; ix < len; ix++) {
+        hash ^= (unsigned char)data[ix];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return (l64)hash == -1 ? -2 : (l64)hash;
+
+}
+
+// returns the hash that orders {o} in a snapshot, which is the same in every
+// process: the hash of the UTF-8 encoding of a str, or of the contents of
+// bytes, and the Python hash of anything else (which for numbers does not
+// depend on the process).
+// Sets {tag} to the BPLUSSNAPSHOT_* tag {o} would be saved with, or 0 if it
+// cannot be saved. For a str or bytes, {data} and {len} are set to its
+// contents; for an int that does not fit in an {l64}, {len} is set to the
+// number of bytes it needs.
+// Returns -1 with an error set if {o} could not be hashed.
+l64 BPlusSnapshot_key(PyObject *o, int *tag, const char **data, Py_ssize_t *len) {
+
+    int overflow;
+
+    *data = NULL;
+    *len = 0;
+
+    if (PyUnicode_Check(o)) {
+        *tag = BPLUSSNAPSHOT_STR;
+        if ((*data = PyUnicode_AsUTF8AndSize(o, len)) == NULL) {
+            return -1;
+        }
+        return BPlusSnapshot_hash_bytes(*data, *len, *tag);
+    }
+
+    if (PyBytes_Check(o)) {
+        *tag = BPLUSSNAPSHOT_BYTES;
+        *data = PyBytes_AS_STRING(o);
+        *len = PyBytes_GET_SIZE(o);
+        return BPlusSnapshot_hash_bytes(*data, *len, *tag);
+    }
+
+    *tag = 0;
+    if (PyLong_Check(o)) {
+        PyLong_AsLongLongAndOverflow(o, &overflow);
+        if (overflow) {
+            *tag = BPLUSSNAPSHOT_BIGINT;
+            // room for the sign bit as well
+            *len = (Py_ssize_t)(_PyLong_NumBits(o) / 8 + 1);
+        } else {
+            *tag = BPLUSSNAPSHOT_INT;
+        }
+    }
+
+    return PyObject_Hash(o);
+
+}
+
+// returns a new reference to element {ix} of {snapshot}, created from the
+// mapping, or NULL with an error set.
+PyObject *BPlusSnapshot_element(BPlusSnapshot *snapshot, Py_ssize_t ix) {
+
+    BPlusSnapshotEntry *entry = snapshot->entries + ix;
+    const char *data = snapshot->data + entry->value;
+
+    if (entry->tag == BPLUSSNAPSHOT_INT) {
+        return PyLong_FromLongLong((l64)entry->value);
+    }
+
+    // the entries are only checked as they are used, so that opening a
+    // snapshot does not have to read all of them
+    if (entry->value > snapshot->header->data_nbytes || entry->len > snapshot->header->data_nbytes - entry->value) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "BPlusSnapshot found an element outside of its file.");
+        return NULL;
+    }
+
+    switch (entry->tag) {
+        case BPLUSSNAPSHOT_BIGINT:
+            return _PyLong_FromByteArray((const unsigned char *)data, entry->len, 1, 1);
+        case BPLUSSNAPSHOT_BYTES:
+            return PyBytes_FromStringAndSize(data, entry->len);
+        case BPLUSSNAPSHOT_STR:
+            return PyUnicode_DecodeUTF8(data, entry->len, "strict");
+    }
+
+    Py_INCREF(PyExc_ValueError);
+    PyErr_SetString(PyExc_ValueError, "BPlusSnapshot found an element of unknown type.");
+    return NULL;
+
+}
+
+// returns the index of the first element of {snapshot} whose hash is at
+// least {key} (or the number of elements, if there is none).
+// Each level of separators narrows the search down to the {fanout} entries
+// beneath one separator of the level above.
+Py_ssize_t BPlusSnapshot_find(BPlusSnapshot *snapshot, l64 key) {
+
+    BPlusSnapshotHeader *header = snapshot->header;
+    Py_ssize_t start = 0, lo = 0, hi, mid, size;
+    l64 *level;
+
+    hi = header->nlevels > 0 ? (Py_ssize_t)header->level_sizes[header->nlevels - 1] : snapshot->n;
+
+    for (int l = (int)header->nlevels - 1; l >= 0; l--) {
+
+        level = (l64 *)(snapshot->map + header->level_offsets[l]);
+
+        // find the last separator below {key}: a run of equal hashes may
+        // start at the end of the entries beneath it
+        while (lo < hi) {
+            mid = (lo + hi) / 2;
+            if (level[mid] < key) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo > start) {
+            lo--;
+        }
+
+        size = l > 0 ? (Py_ssize_t)header->level_sizes[l - 1] : snapshot->n;
+        start = lo = lo * header->fanout;
+        hi = lo + header->fanout < size ? lo + header->fanout : size;
+
+    }
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (snapshot->keys[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+
+}
+
+// returns 1 if element {ix} of {snapshot} is equal to {o}, 0 if it is not,
+// or -1 with an error set. {tag}, {data} and {len} are as set by
+// BPlusSnapshot_key() for {o}.
+int BPlusSnapshot_equals(BPlusSnapshot *snapshot, Py_ssize_t ix, PyObject *o, int tag, const char *data, Py_ssize_t len) {
+
+    BPlusSnapshotEntry *entry = snapshot->entries + ix;
+    PyObject *element;
+    int overflow, res;
+    l64 x;
+
+    // an exact int, bytes or str is only ever equal to an element of its own
+    // kind, and can be compared without creating the element
+    if (PyLong_CheckExact(o)) {
+        if (entry->tag == BPLUSSNAPSHOT_INT) {
+            x = PyLong_AsLongLongAndOverflow(o, &overflow);
+            return !overflow && x == (l64)entry->value;
+        }
+        if (entry->tag != BPLUSSNAPSHOT_BIGINT) {
+            return 0;
+        }
+    } else if (PyUnicode_CheckExact(o) || PyBytes_CheckExact(o)) {
+        if ((int)entry->tag != tag) {
+            return 0;
+        }
+        if (entry->value > snapshot->header->data_nbytes || entry->len > snapshot->header->data_nbytes - entry->value) {
+            Py_INCREF(PyExc_ValueError);
+            PyErr_SetString(PyExc_ValueError, "BPlusSnapshot found an element outside of its file.");
+            return -1;
+        }
+        return (Py_ssize_t)entry->len == len && memcmp(snapshot->data + entry->value, data, len) == 0;
+    }
+
+    if ((element = BPlusSnapshot_element(snapshot, ix)) == NULL) {
+        return -1;
+    }
+    res = PyObject_RichCompareBool(o, element, Py_EQ);
+    Py_DECREF(element);
+
+    return res;
+
+}
+
+// returns 0 if the header of the file mapped by {snapshot} is consistent with
+// the size of the file, and -1 otherwise.
+int BPlusSnapshot_check(BPlusSnapshot *snapshot) {
+
+    BPlusSnapshotHeader *header = snapshot->header;
+    unsigned long long nbytes = snapshot->nbytes, size;
+
+    if (memcmp(header->magic, "BPLUSSNP", 8) != 0
+        || header->format != BPLUSSNAPSHOT_FORMAT
+        || header->byte_order != BPLUSSNAPSHOT_BYTE_ORDER
+        || header->file_nbytes != nbytes
+        || header->fanout < 2
+        || header->nlevels > BPLUSSNAPSHOT_MAX_LEVELS
+        || header->n > nbytes / (sizeof(l64) + sizeof(BPlusSnapshotEntry))) {
+        return -1;
+    }
+
+    if (header->keys_offset % 8 != 0 || header->keys_offset > nbytes - header->n * sizeof(l64)
+        || header->entries_offset % 8 != 0 || header->entries_offset > nbytes - header->n * sizeof(BPlusSnapshotEntry)
+        || header->data_offset > nbytes || header->data_nbytes > nbytes - header->data_offset) {
+        return -1;
+    }
+
+    // every level must have exactly one separator for every {fanout} entries
+    // of the level below it, up to a top level of at most {fanout}
+    size = header->n;
+    for (unsigned int l = 0; l < header->nlevels; l++) {
+        if (size <= header->fanout
+            || header->level_sizes[l] != (size + header->fanout - 1) / header->fanout
+            || header->level_offsets[l] % 8 != 0
+            || header->level_offsets[l] > nbytes - header->level_sizes[l] * sizeof(l64)) {
+            return -1;
+        }
+        size = header->level_sizes[l];
+    }
+    if (size > header->fanout) {
+        return -1;
+    }
+
+    return 0;
+
+}
+
+// returns -1 with an error set if {snapshot} has no file mapped, because
+// __init__() was never called or failed.
+int BPlusSnapshot_check_loaded(BPlusSnapshot *snapshot) {
+
+    if (snapshot->header == NULL) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "BPlusSnapshot not loaded.");
+        return -1;
+    }
+
+    return 0;
+
+}
+
+// releases the mapping of {snapshot}, if it has one.
+void BPlusSnapshot_unmap(BPlusSnapshot *snapshot) {
+
+    if (snapshot->map != NULL) {
+        munmap(snapshot->map, snapshot->nbytes);
+    }
+
+    snapshot->map = NULL;
+    snapshot->nbytes = 0;
+    snapshot->header = NULL;
+    snapshot->keys = NULL;
+    snapshot->entries = NULL;
+    snapshot->data = NULL;
+    snapshot->n = 0;
+
+}
+
+// writes the ints, bytes and strs in the list {elements}, which must contain
+// no two equal objects, to a snapshot file at {path}.
+// The file is written next to {path} and then renamed over it, so that a
+// process opening {path} never sees half of a file.
+// Returns 0 on success, or -1 with an error set.
+int BPlusSnapshot_write(PyObject *elements, PyObject *path) {
+
+    PyObject *path_bytes = NULL, *tmp_path = NULL, *o;
+    BPlusPair *pairs = NULL, *scratch = NULL;
+    BPlusSnapshotHeader *header;
+    BPlusSnapshotEntry *entries;
+    Py_ssize_t n = PyList_GET_SIZE(elements), len;
+    size_t data_nbytes = 0, offset, nbytes = 0, written = 0;
+    char *image = NULL;
+    const char *data;
+    l64 *keys, *level, *below;
+    int tag, res = -1;
+    FILE *f;
+
+    if (!PyUnicode_FSConverter(path, &path_bytes)) {
+        return -1;
+    }
+
+    pairs = (BPlusPair *)malloc(sizeof(BPlusPair) * (n+1));
+    scratch = (BPlusPair *)malloc(sizeof(BPlusPair) * (n+1));
+    if (pairs == NULL || scratch == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    // hash every element and add up the room its data needs
+    for (Py_ssize_t ix = 0; ix < n; ix++) {
+
+        o = PyList_GET_ITEM(elements, ix);
+
+        if ((pairs[ix].key = BPlusSnapshot_key(o, &tag, &data, &len)) == -1 && PyErr_Occurred()) {
+            if (PyErr_ExceptionMatches(PyExc_UnicodeEncodeError)) {
+                PyErr_Clear();
+                Py_INCREF(PyExc_ValueError);
+                PyErr_SetString(PyExc_ValueError, "save() can only save strs that can be encoded as UTF-8.");
+            }
+            goto done;
+        }
+
+        if (tag == 0) {
+            Py_INCREF(PyExc_TypeError);
+            PyErr_SetString(PyExc_TypeError, "save() can only save ints, bytes and strs.");
+            goto done;
+        }
+
+        if (len > UINT_MAX) {
+            Py_INCREF(PyExc_OverflowError);
+            PyErr_SetString(PyExc_OverflowError, "save() got an element too large to save.");
+            goto done;
+        }
+
+        pairs[ix].value = o;
+        if (tag != BPLUSSNAPSHOT_INT) {
+            data_nbytes += ((size_t)len + 7) & ~(size_t)7;
+        }
+
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    BPlusPool_sort(pairs, scratch, n, sizeof(BPlusPair));
+    Py_END_ALLOW_THREADS
+
+    // lay the file out: header, hashes, entries, levels of separators, data
+    offset = (sizeof(BPlusSnapshotHeader) + 7) & ~(size_t)7;
+    offset += sizeof(l64) * n + sizeof(BPlusSnapshotEntry) * n;
+    for (size_t size = n; size > BPLUSSNAPSHOT_FANOUT; size = (size + BPLUSSNAPSHOT_FANOUT - 1) / BPLUSSNAPSHOT_FANOUT) {
+        offset += sizeof(l64) * ((size + BPLUSSNAPSHOT_FANOUT - 1) / BPLUSSNAPSHOT_FANOUT);
+    }
+    nbytes = offset + data_nbytes;
+
+    if ((image = (char *)calloc(nbytes, 1)) == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    header = (BPlusSnapshotHeader *)image;
+    memcpy(header->magic, "BPLUSSNP", 8);
+    header->format = BPLUSSNAPSHOT_FORMAT;
+    header->byte_order = BPLUSSNAPSHOT_BYTE_ORDER;
+    header->n = n;
+    header->file_nbytes = nbytes;
+    header->fanout = BPLUSSNAPSHOT_FANOUT;
+    header->keys_offset = (sizeof(BPlusSnapshotHeader) + 7) & ~(size_t)7;
+    header->entries_offset = header->keys_offset + sizeof(l64) * n;
+    offset = header->entries_offset + sizeof(BPlusSnapshotEntry) * n;
+
+    keys = (l64 *)(image + header->keys_offset);
+    entries = (BPlusSnapshotEntry *)(image + header->entries_offset);
+
+    // each level holds every {BPLUSSNAPSHOT_FANOUT}th hash of the one below
+    below = keys;
+    for (size_t size = n; size > BPLUSSNAPSHOT_FANOUT; size = header->level_sizes[header->nlevels - 1]) {
+        header->level_offsets[header->nlevels] = offset;
+        header->level_sizes[header->nlevels] = (size + BPLUSSNAPSHOT_FANOUT - 1) / BPLUSSNAPSHOT_FANOUT;
+        offset += sizeof(l64) * header->level_sizes[header->nlevels];
+        header->nlevels++;
+    }
+    header->data_offset = offset;
+    header->data_nbytes = data_nbytes;
+
+    offset = 0;
+    for (Py_ssize_t ix = 0; ix < n; ix++) {
+
+        o = pairs[ix].value;
+        keys[ix] = pairs[ix].key;
+        BPlusSnapshot_key(o, &tag, &data, &len);
+        entries[ix].tag = tag;
+        entries[ix].len = (unsigned int)len;
+
+        if (tag == BPLUSSNAPSHOT_INT) {
+            entries[ix].value = (unsigned long long)PyLong_AsLongLong(o);
+            continue;
+        }
+
+        entries[ix].value = offset;
+        if (tag == BPLUSSNAPSHOT_BIGINT) {
+            #if PY_VERSION_HEX >= 0x030D0000
+            if (_PyLong_AsByteArray((PyLongObject *)o, (unsigned char *)image + header->data_offset + offset, len, 1, 1, 1) == -1) {
+            #else
+            if (_PyLong_AsByteArray((PyLongObject *)o, (unsigned char *)image + header->data_offset + offset, len, 1, 1) == -1) {
+            #endif
+                goto done;
+            }
+        } else {
+            memcpy(image + header->data_offset + offset, data, len);
+        }
+        offset += ((size_t)len + 7) & ~(size_t)7;
+
+    }
+
+    // the levels are filled in last, from the bottom up
+    for (unsigned int l = 0; l < header->nlevels; l++) {
+        level = (l64 *)(image + header->level_offsets[l]);
+        for (unsigned long long jx = 0; jx < header->level_sizes[l]; jx++) {
+            level[jx] = below[jx * BPLUSSNAPSHOT_FANOUT];
+        }
+        below = level;
+    }
+
+    if ((tmp_path = PyBytes_FromFormat("%s.tmp", PyBytes_AS_STRING(path_bytes))) == NULL) {
+        goto done;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    if ((f = fopen(PyBytes_AS_STRING(tmp_path), "wb")) != NULL) {
+        written = fwrite(image, 1, nbytes, f);
+        if (fclose(f) != 0) {
+            written = 0;
+        }
+        if (written == nbytes && rename(PyBytes_AS_STRING(tmp_path), PyBytes_AS_STRING(path_bytes)) != 0) {
+            written = 0;
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    if (written != nbytes) {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+        remove(PyBytes_AS_STRING(tmp_path));
+        goto done;
+    }
+
+    res = 0;
+
+done:
+    Py_XDECREF(path_bytes);
+    Py_XDECREF(tmp_path);
+    free(pairs);
+    free(scratch);
+    free(image);
+    return res;
+
+}
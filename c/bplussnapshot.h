@@ -0,0 +1,55 @@
+// Definitions of public and private methods used by BPlusTree snapshot files.
+// See bplussnapshot.c for documentation on the methods declared in this file.
+
+
+#ifndef BPLUSSNAPSHOT_H
+#define BPLUSSNAPSHOT_H
+
+
+#include <Python.h>
+#include "structmember.h"
+#include "bplustypes.h"
+#include "general.h"
+
+
+// the type objects are registered with the module by PyInit_c() in
+// bplustree.c
+extern PyTypeObject BPlusSnapshotType;
+extern PyTypeObject BPlusSnapshotIterType;
+int BPlusSnapshot_write(PyObject *elements, PyObject *path);
+
+
+// BEGIN types and functions defined in other files
+// defined in bpluspool.c
+void BPlusPool_sort(void *a, void *scratch, Py_ssize_t n, int width);
+
+
+// BEGIN BPlusSnapshot private helper method headers
+static l64 BPlusSnapshot_hash_bytes(const char *data, Py_ssize_t len, int tag);
+static l64 BPlusSnapshot_key(PyObject *o, int *tag, const char **data, Py_ssize_t *len);
+static PyObject *BPlusSnapshot_element(BPlusSnapshot *snapshot, Py_ssize_t ix);
+static Py_ssize_t BPlusSnapshot_find(BPlusSnapshot *snapshot, l64 key);
+static int BPlusSnapshot_equals(BPlusSnapshot *snapshot, Py_ssize_t ix, PyObject *o, int tag, const char *data, Py_ssize_t len);
+static int BPlusSnapshot_check(BPlusSnapshot *snapshot);
+static int BPlusSnapshot_check_loaded(BPlusSnapshot *snapshot);
+static void BPlusSnapshot_unmap(BPlusSnapshot *snapshot);
+
+
+// BEGIN tp method headers
+static void BPlusSnapshot_tp_dealloc(BPlusSnapshot *self);
+static int BPlusSnapshot_tp_init(BPlusSnapshot *self, PyObject *args, PyObject *kwargs);
+static PyObject *BPlusSnapshot_tp_iter(PyObject *self);
+static void BPlusSnapshotIter_tp_dealloc(BPlusSnapshotIter *self);
+static PyObject *BPlusSnapshotIter_tp_iternext(PyObject *self);
+
+
+// BEGIN sequence method headers
+static Py_ssize_t BPlusSnapshot_sq_length(PyObject *self);
+static int BPlusSnapshot_sq_contains(PyObject *self, PyObject *value);
+
+
+// BEGIN public method headers
+static PyObject *BPlusSnapshot_method_get_nbytes(PyObject *self, PyObject *args);
+
+
+#endif
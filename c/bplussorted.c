@@ -0,0 +1,930 @@
+// BPlusSortedTree method definitions.
+// A BPlusSortedTree is laid out just like a BPlusTree, but it is ordered by
+// the elements themselves (or by {key} applied to them) rather than by their
+// hashes, so that its leaf chain can answer range queries.
+#include <Python.h>
+#include "structmember.h"
+#include "bplustypes.h"
+#include "general.h"
+#include "array32.h"
+#include "bplusnode.h"
+#include "bplussorted.h"
+
+
+// define our subslot for BPlusSortedTree sequence methods
+static PySequenceMethods BPlusSortedTree_sq_methods = {
+    (lenfunc)BPlusSortedTree_sq_length,         /*sq_length*/
+    0,                                          /*sq_concat*/
+    0,                                          /*sq_repeat*/
+    0,                                          /*sq_item*/
+    0,                                          /*was_sq_slice*/
+    0,                                          /*sq_ass_item (???)*/
+    0,                                          /*was_sq_ass_slice (???)*/
+    BPlusSortedTree_sq_contains,                /*sq_contains*/
+    0,                                          /*sq_inplace_concat*/
+    0,                                          /*sq_inplace_repeat*/
+};
+
+
+// define our subslot for BPlusSortedTree public methods
+static PyMethodDef BPlusSortedTree_tp_methods[] = {
+    {"get_b", BPlusSortedTree_method_get_b, METH_NOARGS, "Return the maximum child nodes per node in the tree."},
+    {"__sizeof__", BPlusSortedTree_method_sizeof, METH_NOARGS, "Returns the size of the tree in memory, in bytes, including its nodes but not its elements."},
+    {"get_key", BPlusSortedTree_method_get_key, METH_NOARGS, "Return the function mapping elements to sort keys, or None if the elements are their own sort keys."},
+    {"add", BPlusSortedTree_method_add, METH_VARARGS, "Takes object {o} and inserts it into the tree in sorted order, unless an element with an equal sort key is already in the tree."},
+    {"min", BPlusSortedTree_method_min, METH_NOARGS, "Return the smallest element in the tree. Raises ValueError if the tree is empty."},
+    {"max", BPlusSortedTree_method_max, METH_NOARGS, "Return the largest element in the tree. Raises ValueError if the tree is empty."},
+    {"floor", BPlusSortedTree_method_floor, METH_VARARGS, "Return the largest element less than or equal to {o}, or None if there is none."},
+    {"ceiling", BPlusSortedTree_method_ceiling, METH_VARARGS, "Return the smallest element greater than or equal to {o}, or None if there is none."},
+    {"bisect_left", BPlusSortedTree_method_bisect_left, METH_VARARGS, "Return the number of elements less than {o}."},
+    {"bisect_right", BPlusSortedTree_method_bisect_right, METH_VARARGS, "Return the number of elements less than or equal to {o}."},
+    {"irange", (PyCFunction)BPlusSortedTree_method_irange, METH_VARARGS | METH_KEYWORDS, "Return an iterator over the elements between {lo} and {hi}, in sorted order (or reversed if {reverse})."},
+    {NULL, NULL, 0, NULL}
+};
+
+
+// define our BPlusSortedTreeType type object
+PyTypeObject BPlusSortedTreeType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "five_one_one_bplus.c.BPlusSortedTree",     /*tp_name*/
+    sizeof(BPlusSortedTree),                    /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)BPlusSortedTree_tp_dealloc,     /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    &BPlusSortedTree_sq_methods,                /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   /*tp_flags*/
+    0,                                          /*tp_doc*/
+    0,                                          /*tp_traverse*/
+    0,                                          /*tp_clear*/
+    0,                                          /*tp_richcompare*/
+    0,                                          /*tp_weaklistoffset*/
+    (getiterfunc)BPlusSortedTree_tp_iter,       /*tp_iter*/
+    0,                                          /*tp_iternext*/
+    BPlusSortedTree_tp_methods,                 /*tp_methods*/
+    0,                                          /*tp_members*/
+    0,                                          /*tp_getsets*/
+    0,                                          /*tp_base*/
+    0,                                          /*tp_dict*/
+    0,                                          /*tp_descr_get*/
+    0,                                          /*tp_descr_set*/
+    0,                                          /*tp_dictoffset*/
+    (initproc)BPlusSortedTree_tp_init,          /*tp_init*/
+    0,                                          /*tp_alloc*/
+    BPlusSortedTree_tp_new,                     /*tp_new*/
+};
+
+
+// BEGIN tp method definitions
+// the root is made here, with the default {b}, so that a tree made by
+// __new__() alone is still a valid empty tree; __init__() replaces it.
+static PyObject *BPlusSortedTree_tp_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs) {
+    BPlusSortedTree *self;
+
+    if ((self = (BPlusSortedTree *)subtype->tp_alloc(subtype, 0)) == NULL) {
+        return NULL;
+    }
+
+    self->b = BPLUS_DEFAULT_B;
+    if ((self->root = BPlusLeaf_init(&self->heap, self->b)) == NULL) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+
+    return (PyObject *)self;
+}
+
+
+static void BPlusSortedTree_tp_dealloc(BPlusSortedTree *self) {
+    if (self->root != NULL) {
+        BPlusSortedNode_dealloc(&self->heap, self->root);
+    }
+    Py_XDECREF(self->key);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+static int BPlusSortedTree_tp_init(BPlusSortedTree *self, PyObject *args, PyObject *kwargs) {
+
+    int b;
+    PyObject *initializer, *key = Py_None, *iterable, *current_object;
+    BPlusNode *root;
+    static char *kwlist[] = {"initializer", "key", "b", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOi", kwlist, &initializer, &key, &b)) {
+        return -1;
+    }
+
+    if (b < 2 || 255 < b) {
+        Py_INCREF(PyExc_TypeError);
+        PyErr_SetString(PyExc_TypeError, "BPlusSortedTree Constructor got out of bounds b: needs to be in [2, 255].");
+        return -1;
+    }
+
+    if (key != Py_None && !PyCallable_Check(key)) {
+        Py_INCREF(PyExc_TypeError);
+        PyErr_SetString(PyExc_TypeError, "BPlusSortedTree Constructor got a key that is not callable.");
+        return -1;
+    }
+
+    // {PyObject *} sort keys take the place of {l64} hashes, which are the
+    // same width
+    if ((root = BPlusLeaf_init(&self->heap, b)) == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    // release the contents of the tree made by tp_new(), or of a tree that
+    // is being re-initialized
+    BPlusSortedNode_dealloc(&self->heap, self->root);
+    self->root = root;
+    self->size = 0;
+    self->version++;
+    Py_CLEAR(self->key);
+
+    self->b = b;
+    if (key != Py_None) {
+        Py_INCREF(key);
+        self->key = key;
+    }
+
+    if (initializer == Py_None) {
+        return 0;
+    }
+
+    if ((iterable = PyObject_GetIter(initializer)) == NULL) {
+        return -1;
+    }
+
+    while ((current_object = PyIter_Next(iterable)) != NULL) {
+
+        if (BPlusSorted_insert(self, current_object) == -1) {
+            Py_DECREF(current_object);
+            Py_DECREF(iterable);
+            return -1;
+        }
+
+        // the tree holds its own reference to {current_object}
+        Py_DECREF(current_object);
+
+    }
+
+    Py_DECREF(iterable);
+
+    if (PyErr_Occurred()) {
+        // the iterator raised something other than StopIteration
+        return -1;
+    }
+
+    return 0;
+
+}
+
+
+// return a {list_iterator} of the items in the tree, in sorted order
+// (see BPlusTree_tp_iter() for why this builds a list).
+static PyObject *BPlusSortedTree_tp_iter(PyObject *self) {
+
+    BPlusSortedTree *tree = (BPlusSortedTree *)self;
+    PyObject *container_list, *iterator, *value;
+    Py_ssize_t ix = 0;
+
+    if ((container_list = PyList_New(tree->size)) == NULL) {
+        return NULL;
+    }
+
+    for (BPlusNode *leaf = BPlusSorted_first_leaf(tree->root); leaf != NULL; leaf = leaf->next) {
+        for (int jx = 0; jx < leaf->values->size; jx++) {
+            value = ((PyObject **)leaf->values->arr)[jx];
+            Py_INCREF(value);
+            PyList_SET_ITEM(container_list, ix, value);
+            ix++;
+        }
+    }
+
+    iterator = PyObject_GetIter(container_list);
+    Py_DECREF(container_list);
+
+    return iterator;
+
+}
+
+
+// BEGIN sequence methods
+// this is called on call to len()
+static Py_ssize_t BPlusSortedTree_sq_length(PyObject *self) {
+    return ((BPlusSortedTree *)self)->size;
+}
+
+
+// this is called on use of the `in` keyword
+static int BPlusSortedTree_sq_contains(PyObject *self, PyObject *value) {
+
+    BPlusSortedTree *tree = (BPlusSortedTree *)self;
+    BPlusNode *leaf;
+    PyObject *key;
+    int ix, res = 0;
+
+    if ((key = BPlusSorted_key_of(tree, value)) == NULL) {
+        return -1;
+    }
+
+    if ((leaf = BPlusSorted_search(tree, key, NULL)) == NULL
+        || (ix = BPlusSorted_bisect(tree, leaf->indices, key, 0)) == -1) {
+        Py_DECREF(key);
+        return -1;
+    }
+
+    // every key from {ix} on is at least {key}, so the key at {ix} is equal
+    // to {key} unless {key} is less than it
+    if (ix < leaf->indices->size) {
+        res = PyObject_RichCompareBool(key, ((PyObject **)leaf->indices->arr)[ix], Py_LT);
+        if (res != -1) {
+            res = !res;
+        }
+    }
+
+    Py_DECREF(key);
+
+    return res;
+
+}
+
+
+// BEGIN public method definitions
+static PyObject *BPlusSortedTree_method_get_b(PyObject *self, PyObject *args) {
+    return PyLong_FromLong(((BPlusSortedTree *)self)->b);
+}
+
+static PyObject *BPlusSortedTree_method_sizeof(PyObject *self, PyObject *args) {
+    return PyLong_FromSize_t((size_t)Py_TYPE(self)->tp_basicsize + ((BPlusSortedTree *)self)->heap.nbytes);
+}
+
+static PyObject *BPlusSortedTree_method_get_key(PyObject *self, PyObject *args) {
+    PyObject *key = ((BPlusSortedTree *)self)->key;
+
+    if (key == NULL) {
+        Py_RETURN_NONE;
+    }
+    Py_INCREF(key);
+    return key;
+}
+
+static PyObject *BPlusSortedTree_method_add(PyObject *self, PyObject *args) {
+
+    PyObject *o;
+
+    if (!PyArg_ParseTuple(args, "O", &o)) {
+        return NULL;
+    }
+
+    if (BPlusSorted_insert((BPlusSortedTree *)self, o) == -1) {
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+
+}
+
+static PyObject *BPlusSortedTree_method_min(PyObject *self, PyObject *args) {
+
+    BPlusSortedTree *tree = (BPlusSortedTree *)self;
+    BPlusNode *leaf;
+    PyObject *value;
+
+    if (tree->size == 0) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "min() called on an empty BPlusSortedTree.");
+        return NULL;
+    }
+
+    leaf = BPlusSorted_first_leaf(tree->root);
+    value = ((PyObject **)leaf->values->arr)[0];
+    Py_INCREF(value);
+
+    return value;
+
+}
+
+static PyObject *BPlusSortedTree_method_max(PyObject *self, PyObject *args) {
+
+    BPlusSortedTree *tree = (BPlusSortedTree *)self;
+    BPlusNode *leaf;
+    PyObject *value;
+
+    if (tree->size == 0) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "max() called on an empty BPlusSortedTree.");
+        return NULL;
+    }
+
+    leaf = BPlusSorted_last_leaf(tree->root);
+    value = ((PyObject **)leaf->values->arr)[leaf->values->size - 1];
+    Py_INCREF(value);
+
+    return value;
+
+}
+
+// helper for floor() and ceiling(): returns the element nearest to {o} on
+// the side given by {upper}, or an element equal to {o} if there is one.
+// Returns None if there is no such element.
+PyObject *BPlusSorted_nearest(PyObject *self, PyObject *args, int upper) {
+
+    BPlusSortedTree *tree = (BPlusSortedTree *)self;
+    BPlusNode *leaf;
+    PyObject *o, *key, *value = Py_None;
+    int ix;
+
+    if (!PyArg_ParseTuple(args, "O", &o)) {
+        return NULL;
+    }
+
+    if ((key = BPlusSorted_key_of(tree, o)) == NULL) {
+        return NULL;
+    }
+
+    // for floor(), {ix} is the number of keys in {leaf} at most {key}; for
+    // ceiling() it is the number of keys less than {key}
+    if ((leaf = BPlusSorted_search(tree, key, NULL)) == NULL
+        || (ix = BPlusSorted_bisect(tree, leaf->indices, key, !upper)) == -1) {
+        Py_DECREF(key);
+        return NULL;
+    }
+    Py_DECREF(key);
+
+    // the answer is in {leaf} unless it is past one of its ends, in which
+    // case it is at the facing end of the neighboring leaf
+    if (upper) {
+        if (ix < leaf->values->size) {
+            value = ((PyObject **)leaf->values->arr)[ix];
+        } else if (leaf->next != NULL) {
+            value = ((PyObject **)leaf->next->values->arr)[0];
+        }
+    } else {
+        if (ix > 0) {
+            value = ((PyObject **)leaf->values->arr)[ix - 1];
+        } else if (leaf->prev != NULL) {
+            value = ((PyObject **)leaf->prev->values->arr)[leaf->prev->values->size - 1];
+        }
+    }
+
+    Py_INCREF(value);
+    return value;
+
+}
+
+static PyObject *BPlusSortedTree_method_floor(PyObject *self, PyObject *args) {
+    return BPlusSorted_nearest(self, args, 0);
+}
+
+static PyObject *BPlusSortedTree_method_ceiling(PyObject *self, PyObject *args) {
+    return BPlusSorted_nearest(self, args, 1);
+}
+
+// helper for bisect_left() and bisect_right(): returns the index at which
+// {o} would be inserted into the sorted elements of the tree.
+// On the way down to the leaf {o} belongs in, this adds up the counts of the
+// children to the left of each branch it passes through.
+PyObject *BPlusSorted_rank(PyObject *self, PyObject *args, int right) {
+
+    BPlusSortedTree *tree = (BPlusSortedTree *)self;
+    BPlusNode *node;
+    PyObject *o, *key;
+    Py_ssize_t rank = 0;
+    int ix;
+
+    if (!PyArg_ParseTuple(args, "O", &o)) {
+        return NULL;
+    }
+
+    if ((key = BPlusSorted_key_of(tree, o)) == NULL) {
+        return NULL;
+    }
+
+    for (node = tree->root; node->children != NULL; node = ((BPlusNode **)node->children->arr)[ix]) {
+        if ((ix = BPlusSorted_bisect(tree, node->indices, key, 1)) == -1) {
+            Py_DECREF(key);
+            return NULL;
+        }
+        for (int jx = 0; jx < ix; jx++) {
+            rank += ((l64 *)node->counts->arr)[jx];
+        }
+    }
+
+    if ((ix = BPlusSorted_bisect(tree, node->indices, key, right)) == -1) {
+        Py_DECREF(key);
+        return NULL;
+    }
+    Py_DECREF(key);
+
+    return PyLong_FromSsize_t(rank + ix);
+
+}
+
+static PyObject *BPlusSortedTree_method_bisect_left(PyObject *self, PyObject *args) {
+    return BPlusSorted_rank(self, args, 0);
+}
+
+static PyObject *BPlusSortedTree_method_bisect_right(PyObject *self, PyObject *args) {
+    return BPlusSorted_rank(self, args, 1);
+}
+
+// returns an iterator over the elements whose sort keys lie between the sort
+// keys of {lo} and {hi}.
+// Either bound may be None to leave that end of the range open, and
+// {inclusive} is a pair of flags saying whether elements equal to {lo} and
+// {hi} respectively are included.
+// Only the leaf the range starts in is searched; from there the leaf chain is
+// walked, and each further leaf is taken whole unless its last key is past
+// {hi}, so a range of {k} elements costs O(log n + k) with about {k}/{b}
+// comparisons against {hi}.
+static PyObject *BPlusSortedTree_method_irange(PyObject *self, PyObject *args, PyObject *kwargs) {
+
+    BPlusSortedTree *tree = (BPlusSortedTree *)self;
+    PyObject
+        *lo = Py_None,
+        *hi = Py_None,
+        *lo_key = NULL,
+        *hi_key = NULL,
+        *result,
+        *iterator,
+        **values;
+    int lo_inclusive = 1, hi_inclusive = 1, reverse = 0, ix = 0, end, n, res;
+    static char *kwlist[] = {"lo", "hi", "inclusive", "reverse", NULL};
+    unsigned long long version;
+    BPlusNode *leaf;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OO(pp)p", kwlist, &lo, &hi, &lo_inclusive, &hi_inclusive, &reverse)) {
+        return NULL;
+    }
+
+    if ((result = PyList_New(0)) == NULL) {
+        return NULL;
+    }
+
+    if (lo != Py_None && (lo_key = BPlusSorted_key_of(tree, lo)) == NULL) {
+        goto error;
+    }
+    if (hi != Py_None && (hi_key = BPlusSorted_key_of(tree, hi)) == NULL) {
+        goto error;
+    }
+
+    // the comparisons below may run code that changes the tree, which would
+    // free the leaves being walked
+    version = tree->version;
+
+    // find the first element in the range
+    if (lo_key == NULL) {
+        leaf = BPlusSorted_first_leaf(tree->root);
+    } else if ((leaf = BPlusSorted_search(tree, lo_key, NULL)) == NULL
+        || (ix = BPlusSorted_bisect(tree, leaf->indices, lo_key, !lo_inclusive)) == -1) {
+        goto error;
+    }
+
+    for (; leaf != NULL; leaf = leaf->next, ix = 0) {
+
+        n = leaf->values->size;
+        if (ix >= n) {
+            continue;
+        }
+        end = n;
+
+        if (hi_key != NULL) {
+            // is the last key of {leaf} still in range?
+            PyObject *last = ((PyObject **)leaf->indices->arr)[n - 1];
+            if (hi_inclusive) {
+                res = PyObject_RichCompareBool(hi_key, last, Py_LT);
+            } else {
+                res = PyObject_RichCompareBool(last, hi_key, Py_LT);
+                if (res != -1) {
+                    res = !res;
+                }
+            }
+            if (res == -1 || BPlusSorted_check_version(tree, version) == -1) {
+                goto error;
+            }
+            if (res && (end = BPlusSorted_bisect(tree, leaf->indices, hi_key, hi_inclusive)) == -1) {
+                goto error;
+            }
+        }
+
+        values = (PyObject **)leaf->values->arr;
+        for (int jx = ix; jx < end; jx++) {
+            if (PyList_Append(result, values[jx]) == -1) {
+                goto error;
+            }
+        }
+
+        if (end < n) {
+            break;
+        }
+
+    }
+
+    if (reverse && PyList_Reverse(result) == -1) {
+        goto error;
+    }
+
+    Py_XDECREF(lo_key);
+    Py_XDECREF(hi_key);
+
+    iterator = PyObject_GetIter(result);
+    Py_DECREF(result);
+
+    return iterator;
+
+error:
+    Py_XDECREF(lo_key);
+    Py_XDECREF(hi_key);
+    Py_DECREF(result);
+    return NULL;
+
+}
+
+// BEGIN helper function definitions
+
+// returns a new reference to the sort key of {o} in {tree}.
+// Returns NULL with an error set if {tree->key} raised.
+PyObject *BPlusSorted_key_of(BPlusSortedTree *tree, PyObject *o) {
+    if (tree->key == NULL) {
+        Py_INCREF(o);
+        return o;
+    }
+    return PyObject_CallOneArg(tree->key, o);
+}
+
+// returns 0 if {tree} has not changed since it was at {version}, or -1 with
+// a RuntimeError set if it has.
+// Comparing sort keys can run arbitrary code, which may add to or
+// re-initialize {tree} and so free the nodes its caller is holding on to.
+int BPlusSorted_check_version(BPlusSortedTree *tree, unsigned long long version) {
+    if (tree->version != version) {
+        Py_INCREF(PyExc_RuntimeError);
+        PyErr_SetString(PyExc_RuntimeError, "BPlusSortedTree changed size during a comparison.");
+        return -1;
+    }
+    return 0;
+}
+
+// {a} is an array of {PyObject *} sort keys of {tree} assumed to be in sorted
+// order.
+// Returns the leftmost (or, if {right}, the rightmost) index at which {key}
+// can be inserted while keeping {a} in sorted order, as with bisect_left()
+// and bisect_right() in array32.c.
+// Keys are compared with `<` only. Returns -1 with an error set if a
+// comparison raised or changed {tree}.
+int BPlusSorted_bisect(BPlusSortedTree *tree, Array32 *a, PyObject *key, int right) {
+
+    PyObject **arr = (PyObject **)a->arr;
+    unsigned long long version = tree->version;
+    int
+        lo = 0,
+        hi = a->size,
+        mid,
+        res;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (right) {
+            // go right unless {key} < arr[mid]
+            if ((res = PyObject_RichCompareBool(key, arr[mid], Py_LT)) == -1) {
+                return -1;
+            }
+            res = !res;
+        } else {
+            // go right if arr[mid] < {key}
+            if ((res = PyObject_RichCompareBool(arr[mid], key, Py_LT)) == -1) {
+                return -1;
+            }
+        }
+        if (BPlusSorted_check_version(tree, version) == -1) {
+            return -1;
+        }
+        if (res) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+
+}
+
+// same as BPlusNode_search(), but for a tree ordered by sort keys.
+// Returns NULL with an error set if a comparison raised or changed {tree}, or
+// if {path} could not grow.
+BPlusNode *BPlusSorted_search(BPlusSortedTree *tree, PyObject *key, BPlusPath *path) {
+
+    BPlusNode *current = tree->root;
+    int ix;
+
+    if (path != NULL) {
+        path->depth = 0;
+    }
+
+    while (current->children != NULL) {
+        if ((ix = BPlusSorted_bisect(tree, current->indices, key, 1)) == -1) {
+            return NULL;
+        }
+        if (path != NULL) {
+            if (path->depth == path->capacity && !BPlusPath_grow(path)) {
+                PyErr_NoMemory();
+                return NULL;
+            }
+            path->nodes[path->depth] = current;
+            path->slots[path->depth] = ix;
+            path->depth++;
+        }
+        current = ((BPlusNode **)current->children->arr)[ix];
+    }
+
+    return current;
+
+}
+
+// returns the leftmost leaf beneath {root}
+BPlusNode *BPlusSorted_first_leaf(BPlusNode *root) {
+    while (root->children != NULL) root = ((BPlusNode **)root->children->arr)[0];
+    return root;
+}
+
+// returns the rightmost leaf beneath {root}
+BPlusNode *BPlusSorted_last_leaf(BPlusNode *root) {
+    while (root->children != NULL) root = ((BPlusNode **)root->children->arr)[root->children->size - 1];
+    return root;
+}
+
+// returns the number of elements beneath {node}
+l64 BPlusSorted_count(BPlusNode *node) {
+
+    l64 count = 0;
+
+    if (node->children == NULL) {
+        return node->values->size;
+    }
+
+    for (int ix = 0; ix < node->counts->size; ix++) {
+        count += ((l64 *)node->counts->arr)[ix];
+    }
+
+    return count;
+
+}
+
+// helper function for splitting a saturated leaf into the 2 empty leaves
+// {left} and {right}
+// expects that {leaf} has {tree->b}+1 values
+// Links the halves into the leaf chain, frees {leaf}, and returns a new
+// reference to the first key of {right}; linking the halves into the parent
+// of {leaf} is left to the caller (see BPlusSorted_split()).
+PyObject *BPlusSortedLeaf_split(BPlusSortedTree *tree, BPlusNode *leaf, BPlusNode *left, BPlusNode *right) {
+
+    int size = leaf->values->size, mid = size / 2;
+    PyObject *separator;
+
+    // the references held by {leaf} move over to the halves
+    place_array(left->indices, mid, sizeof(PyObject *));
+    memcpy(left->indices->arr, leaf->indices->arr, sizeof(PyObject *) * mid);
+    place_array(left->values, mid, sizeof(PyObject *));
+    memcpy(left->values->arr, leaf->values->arr, sizeof(PyObject *) * mid);
+
+    place_array(right->indices, size - mid, sizeof(PyObject *));
+    memcpy(right->indices->arr, ((PyObject **)leaf->indices->arr)+mid, sizeof(PyObject *) * (size - mid));
+    place_array(right->values, size - mid, sizeof(PyObject *));
+    memcpy(right->values->arr, ((PyObject **)leaf->values->arr)+mid, sizeof(PyObject *) * (size - mid));
+
+    // set {next} and {prev} of all relevant nodes
+    if (leaf->prev != NULL) {
+        leaf->prev->next = left;
+    }
+    if (leaf->next != NULL) {
+        leaf->next->prev = right;
+    }
+    left->prev = leaf->prev;
+    left->next = right;
+    right->prev = left;
+    right->next = leaf->next;
+
+    BPlusNode_free(&tree->heap, leaf);
+
+    separator = ((PyObject **)right->indices->arr)[0];
+    Py_INCREF(separator);
+
+    return separator;
+
+}
+
+// helper function for splitting a saturated branch into 2 branches
+// expects that {branch} has {tree->b}+1 children
+// Stores the two halves, taken from the chain {*spares} (see
+// BPlusBranch_init_spares()), in {*left} and {*right}, frees {branch}, and
+// returns the key separating the halves, along with the reference {branch}
+// held to it; linking the halves into the parent of {branch} is left to the
+// caller (see BPlusSorted_split()).
+PyObject *BPlusSortedBranch_split(BPlusSortedTree *tree, BPlusNode **spares, BPlusNode *branch, BPlusNode **left, BPlusNode **right) {
+
+    // children size, children mid, indices size, indices mid
+    int csize, cmid, isize, imid;
+    PyObject *separator;
+
+    *left = BPlusBranch_take_spare(spares);
+    *right = BPlusBranch_take_spare(spares);
+
+    csize = branch->children->size;
+    cmid = csize / 2;
+    isize = branch->indices->size;
+    imid = cmid - 1;
+
+    place_array((*left)->children, cmid, sizeof(BPlusNode *));
+    memcpy((*left)->children->arr, branch->children->arr, sizeof(BPlusNode *) * cmid);
+
+    place_array((*right)->children, csize - cmid, sizeof(BPlusNode *));
+    memcpy((*right)->children->arr, ((BPlusNode **)branch->children->arr)+cmid, sizeof(BPlusNode *) * (csize - cmid));
+
+    // the counts follow their children
+    place_array((*left)->counts, cmid, sizeof(l64));
+    memcpy((*left)->counts->arr, branch->counts->arr, sizeof(l64) * cmid);
+
+    place_array((*right)->counts, csize - cmid, sizeof(l64));
+    memcpy((*right)->counts->arr, ((l64 *)branch->counts->arr)+cmid, sizeof(l64) * (csize - cmid));
+
+    place_array((*left)->indices, imid, sizeof(PyObject *));
+    memcpy((*left)->indices->arr, branch->indices->arr, sizeof(PyObject *) * imid);
+
+    place_array((*right)->indices, isize - imid - 1, sizeof(PyObject *));
+    memcpy((*right)->indices->arr, ((PyObject **)branch->indices->arr)+imid+1, sizeof(PyObject *) * (isize - imid - 1));
+
+    separator = ((PyObject **)branch->indices->arr)[imid];
+
+    BPlusNode_free(&tree->heap, branch);
+
+    return separator;
+
+}
+
+// helper function for splitting a saturated {leaf} into the empty leaves
+// {left} and {right} and then, walking back up {path}, every ancestor that
+// overflows as a result (see BPlusTree_split()).
+// The branches this needs are taken from {spares}, which BPlusSorted_insert()
+// fills before changing anything, so that the split itself cannot fail.
+void BPlusSorted_split(BPlusSortedTree *tree, BPlusNode *leaf, BPlusPath *path, BPlusNode *left, BPlusNode *right, BPlusNode *spares) {
+
+    BPlusNode *parent;
+    int level = path->depth - 1, ix;
+    PyObject *separator;
+
+    separator = BPlusSortedLeaf_split(tree, leaf, left, right);
+
+    while (1) {
+
+        if (level < 0) {
+            // we split the root, grow the tree by one level
+            tree->root = BPlusBranch_take_spare(&spares);
+            insert_BPlusNode(tree->root->children, 0, left);
+            insert_BPlusNode(tree->root->children, 1, right);
+            insert_l64(tree->root->counts, 0, BPlusSorted_count(left));
+            insert_l64(tree->root->counts, 1, BPlusSorted_count(right));
+            insert_PyObject(tree->root->indices, 0, separator);
+            Py_DECREF(separator);
+            return;
+        }
+
+        // replace the split node in its parent with its 2 halves
+        parent = path->nodes[level];
+        ix = path->slots[level];
+        ((BPlusNode **)parent->children->arr)[ix] = right;
+        insert_BPlusNode(parent->children, ix, left);
+        ((l64 *)parent->counts->arr)[ix] = BPlusSorted_count(right);
+        insert_l64(parent->counts, ix, BPlusSorted_count(left));
+        // the parent takes over our reference to {separator}
+        insert_PyObject(parent->indices, ix, separator);
+        Py_DECREF(separator);
+
+        if (parent->children->size <= tree->b) {
+            return;
+        }
+
+        separator = BPlusSortedBranch_split(tree, &spares, parent, &left, &right);
+        level--;
+
+    }
+
+}
+
+// helper function for inserting {o} into {tree}.
+// Returns 1 if {o} was inserted, 0 if an element with an equal sort key was
+// already in the tree, or -1 with an error set.
+int BPlusSorted_insert(BPlusSortedTree *tree, PyObject *o) {
+
+    BPlusNode *leaf, *left = NULL, *right = NULL, *spares = NULL;
+    BPlusPath path;
+    PyObject *key;
+    unsigned long long version;
+    int ix, res;
+
+    if ((key = BPlusSorted_key_of(tree, o)) == NULL) {
+        return -1;
+    }
+
+    BPlusPath_init(&path);
+    version = tree->version;
+
+    if ((leaf = BPlusSorted_search(tree, key, &path)) == NULL
+        || (ix = BPlusSorted_bisect(tree, leaf->indices, key, 0)) == -1) {
+        goto error;
+    }
+
+    if (ix < leaf->indices->size) {
+        // the key at {ix} is at least {key}; if it is not greater, they are
+        // equal and {o} is already in the tree
+        res = PyObject_RichCompareBool(key, ((PyObject **)leaf->indices->arr)[ix], Py_LT);
+        if (res == -1 || BPlusSorted_check_version(tree, version) == -1) {
+            goto error;
+        } else if (res == 0) {
+            Py_DECREF(key);
+            BPlusPath_free(&path);
+            return 0;
+        }
+    }
+
+    // take every node a split will need before changing anything, so that
+    // running out of memory leaves the tree as it was
+    if (leaf->values->size >= tree->b) {
+        left = BPlusLeaf_init(&tree->heap, tree->b);
+        right = BPlusLeaf_init(&tree->heap, tree->b);
+        if (left == NULL || right == NULL
+            || BPlusBranch_init_spares(&tree->heap, tree->b, &path, 1, &spares) == -1) {
+            if (left != NULL) {
+                BPlusNode_free(&tree->heap, left);
+            }
+            if (right != NULL) {
+                BPlusNode_free(&tree->heap, right);
+            }
+            PyErr_NoMemory();
+            goto error;
+        }
+    }
+
+    // the leaf takes over our reference to {key}
+    insert_PyObject(leaf->indices, ix, key);
+    Py_DECREF(key);
+    insert_PyObject(leaf->values, ix, o);
+    for (int level = 0; level < path.depth; level++) {
+        ((l64 *)path.nodes[level]->counts->arr)[path.slots[level]]++;
+    }
+
+    if (leaf->values->size > tree->b) {
+        BPlusSorted_split(tree, leaf, &path, left, right, spares);
+    }
+
+    BPlusPath_free(&path);
+
+    tree->size++;
+    tree->version++;
+    return 1;
+
+error:
+    Py_DECREF(key);
+    BPlusPath_free(&path);
+    return -1;
+
+}
+
+// deallocate {node}, every node beneath it, and the references they hold to
+// sort keys and elements.
+void BPlusSortedNode_dealloc(BPlusHeap *heap, BPlusNode *node) {
+
+    PyObject **keys = (PyObject **)node->indices->arr;
+
+    for (int ix = 0; ix < node->indices->size; ix++) {
+        Py_DECREF(keys[ix]);
+    }
+
+    if (node->children != NULL) {
+        for (int ix = 0; ix < node->children->size; ix++) {
+            BPlusSortedNode_dealloc(heap, ((BPlusNode **)node->children->arr)[ix]);
+        }
+    }
+
+    if (node->values != NULL) {
+        for (int ix = 0; ix < node->values->size; ix++) {
+            Py_DECREF(((PyObject **)node->values->arr)[ix]);
+        }
+    }
+
+    BPlusNode_free(heap, node);
+
+}
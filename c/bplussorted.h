@@ -0,0 +1,64 @@
+// Definitions of public and private methods used by the sorted B-Plus Tree.
+// See bplussorted.c for documentation on the methods declared in this file.
+
+
+#ifndef BPLUSSORTED_H
+#define BPLUSSORTED_H
+
+
+#include <Python.h>
+#include "structmember.h"
+#include "bplustypes.h"
+#include "general.h"
+#include "array32.h"
+#include "bplusnode.h"
+
+
+// the type object is registered with the module by PyInit_c() in bplustree.c
+extern PyTypeObject BPlusSortedTreeType;
+
+
+// BEGIN BPlusSortedTree private helper method headers
+static PyObject *BPlusSorted_key_of(BPlusSortedTree *tree, PyObject *o);
+static int BPlusSorted_check_version(BPlusSortedTree *tree, unsigned long long version);
+static int BPlusSorted_bisect(BPlusSortedTree *tree, Array32 *a, PyObject *key, int right);
+static BPlusNode *BPlusSorted_search(BPlusSortedTree *tree, PyObject *key, BPlusPath *path);
+static BPlusNode *BPlusSorted_first_leaf(BPlusNode *root);
+static BPlusNode *BPlusSorted_last_leaf(BPlusNode *root);
+static l64 BPlusSorted_count(BPlusNode *node);
+static PyObject *BPlusSortedLeaf_split(BPlusSortedTree *tree, BPlusNode *leaf, BPlusNode *left, BPlusNode *right);
+static PyObject *BPlusSortedBranch_split(BPlusSortedTree *tree, BPlusNode **spares, BPlusNode *branch, BPlusNode **left, BPlusNode **right);
+static void BPlusSorted_split(BPlusSortedTree *tree, BPlusNode *leaf, BPlusPath *path, BPlusNode *left, BPlusNode *right, BPlusNode *spares);
+static int BPlusSorted_insert(BPlusSortedTree *tree, PyObject *o);
+static PyObject *BPlusSorted_nearest(PyObject *self, PyObject *args, int upper);
+static PyObject *BPlusSorted_rank(PyObject *self, PyObject *args, int right);
+static void BPlusSortedNode_dealloc(BPlusHeap *heap, BPlusNode *node);
+
+
+// BEGIN tp method headers
+static PyObject *BPlusSortedTree_tp_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs);
+static void BPlusSortedTree_tp_dealloc(BPlusSortedTree *self);
+static int BPlusSortedTree_tp_init(BPlusSortedTree *self, PyObject *args, PyObject *kwargs);
+static PyObject *BPlusSortedTree_tp_iter(PyObject *self);
+
+
+// BEGIN sequence method headers
+static Py_ssize_t BPlusSortedTree_sq_length(PyObject *self);
+static int BPlusSortedTree_sq_contains(PyObject *self, PyObject *value);
+
+
+// BEGIN public method headers
+static PyObject *BPlusSortedTree_method_get_b(PyObject *self, PyObject *args);
+static PyObject *BPlusSortedTree_method_sizeof(PyObject *self, PyObject *args);
+static PyObject *BPlusSortedTree_method_get_key(PyObject *self, PyObject *args);
+static PyObject *BPlusSortedTree_method_add(PyObject *self, PyObject *args);
+static PyObject *BPlusSortedTree_method_min(PyObject *self, PyObject *args);
+static PyObject *BPlusSortedTree_method_max(PyObject *self, PyObject *args);
+static PyObject *BPlusSortedTree_method_floor(PyObject *self, PyObject *args);
+static PyObject *BPlusSortedTree_method_ceiling(PyObject *self, PyObject *args);
+static PyObject *BPlusSortedTree_method_bisect_left(PyObject *self, PyObject *args);
+static PyObject *BPlusSortedTree_method_bisect_right(PyObject *self, PyObject *args);
+static PyObject *BPlusSortedTree_method_irange(PyObject *self, PyObject *args, PyObject *kwargs);
+
+
+#endif
@@ -0,0 +1,83 @@
+// The ring buffer of events kept by a traced BPlusTree (see bplustrace.h).
+// Events are only ever recorded and read with the GIL held, so the buffer
+// needs no lock: recording one is a clock read and a few stores.
+#include <Python.h>
+#include <time.h>
+#include "bplustypes.h"
+#include "bplustrace.h"
+
+
+// the names of the kinds of events, as returned by BPlusTree.get_trace()
+static const char *BPlusTrace_kinds[BPLUS_EVENT_KINDS] = {"insert", "split", "grow", "collision"};
+
+
+// returns a new, empty ring buffer for the last {capacity} events, rounded up
+// to a power of 2.
+// Returns NULL with a MemoryError set on failure.
+BPlusTrace *BPlusTrace_new(Py_ssize_t capacity) {
+
+    BPlusTrace *trace;
+    Py_ssize_t n = 1;
+
+    while (n < capacity) n <<= 1;
+
+    if ((trace = (BPlusTrace *)PyMem_RawMalloc(sizeof(BPlusTrace) + sizeof(BPlusEvent) * n)) == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    trace->count = 0;
+    trace->mask = (unsigned long long)n - 1;
+    trace->events = (BPlusEvent *)(trace + 1);
+
+    return trace;
+
+}
+
+void BPlusTrace_free(BPlusTrace *trace) {
+    PyMem_RawFree(trace);
+}
+
+// records an event of {kind} at the current time in {trace}, overwriting the
+// oldest one if it is full.
+void BPlusTrace_record(BPlusTrace *trace, int kind, l64 key, int arg) {
+
+    BPlusEvent *event = &trace->events[trace->count & trace->mask];
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    event->ns = (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+    event->key = key;
+    event->kind = kind;
+    event->arg = arg;
+    trace->count++;
+
+}
+
+// returns a new list of the events in {trace}, oldest first, as tuples of
+// (time, kind, key, arg). {time} is in nanoseconds on the same clock as
+// time.monotonic_ns(), and {kind} is one of the names in {BPlusTrace_kinds}.
+// Returns NULL with an error set on failure.
+PyObject *BPlusTrace_to_list(BPlusTrace *trace) {
+
+    unsigned long long first = trace->count > trace->mask ? trace->count - trace->mask - 1 : 0;
+    PyObject *list, *item;
+    BPlusEvent *event;
+
+    if ((list = PyList_New((Py_ssize_t)(trace->count - first))) == NULL) {
+        return NULL;
+    }
+
+    for (unsigned long long ix = first; ix < trace->count; ix++) {
+        event = &trace->events[ix & trace->mask];
+        item = Py_BuildValue("(KsLi)", event->ns, BPlusTrace_kinds[event->kind], event->key, event->arg);
+        if (item == NULL) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, (Py_ssize_t)(ix - first), item);
+    }
+
+    return list;
+
+}
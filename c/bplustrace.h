@@ -0,0 +1,73 @@
+// Definitions of the event tracing of a BPlusTree.
+// See bplustrace.c for documentation on the methods declared in this file.
+//
+// Each event is both:
+//  1. a USDT probe in the "five_one_one_bplus" provider, when built for ELF
+//      on x86-64 or aarch64 (see sdt.h), or elsewhere with a <sys/sdt.h>
+//      installed. A probe is a single nop until perf or bpftrace attaches to
+//      it, for example:
+//          bpftrace -e 'usdt:./c.so:five_one_one_bplus:split { @[arg1] = count(); }'
+//  2. a {BPlusEvent} in the ring buffer of the tree, if it has one (see
+//      BPlusTree.set_trace() in bplustree.c). Untraced trees pay a single
+//      test of {tree->trace}.
+
+
+#ifndef BPLUSTRACE_H
+#define BPLUSTRACE_H
+
+
+#include <Python.h>
+#include "bplustypes.h"
+
+
+// the kinds of {BPlusEvent}, with what their {key} and {arg} are
+// an element was added: its hash, and the number of branches above its leaf
+#define BPLUS_EVENT_INSERT 0
+// a leaf was split: the first hash of the right half, and the number of
+// branches split along with it
+#define BPLUS_EVENT_SPLIT 1
+// the root was split, growing the tree a level: the hash separating the
+// halves of the old root, and the new height
+#define BPLUS_EVENT_GROW 2
+// an element was added to a hash already in the tree: the hash, and 1 if this
+// started a new collision run or 0 if it joined one
+#define BPLUS_EVENT_COLLISION 3
+#define BPLUS_EVENT_KINDS 4
+
+// the most events a tree can be set to keep
+#define BPLUS_TRACE_MAX (1 << 24)
+
+
+#include "sdt.h"
+#ifdef BPLUS_SDT
+#define BPLUS_USDT 1
+#elif defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define BPLUS_USDT 1
+#endif
+#endif
+
+#ifdef BPLUS_USDT
+#define BPLUS_PROBE(name, key, arg) DTRACE_PROBE2(five_one_one_bplus, name, key, arg)
+#else
+#define BPLUS_PROBE(name, key, arg) do {} while (0)
+#endif
+
+// fires the probe {name} and records an event of {kind} in {tree}, if traced.
+#define BPLUS_TRACE(tree, name, kind, key, arg) do { \
+    BPLUS_PROBE(name, key, arg); \
+    if ((tree)->trace != NULL) { \
+        BPlusTrace_record((tree)->trace, kind, key, arg); \
+    } \
+} while (0)
+
+
+// BEGIN public method headers
+BPlusTrace *BPlusTrace_new(Py_ssize_t capacity);
+void BPlusTrace_free(BPlusTrace *trace);
+void BPlusTrace_record(BPlusTrace *trace, int kind, l64 key, int arg);
+PyObject *BPlusTrace_to_list(BPlusTrace *trace);
+
+
+#endif
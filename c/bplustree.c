@@ -4,6 +4,7 @@
 #include "general.h"
 #include "array32.h"
 #include "bplusnode.h"
+#include "bplustrace.h"
 #include "bplustree.h"
 
 
@@ -25,8 +26,22 @@ static PySequenceMethods BPlusTree_sq_methods = {
 // define our subslot for BPlusTree public methods
 static PyMethodDef BPlusTree_tp_methods[] = { 
     {"get_b", BPlusTree_method_get_b, METH_NOARGS, "Return the maximum child nodes per node in the tree."},
-    {"add", BPlusTree_method_add, METH_VARARGS, "Takes object {o}, computes the hash, and inserts {o} into the tree with index of the hash."},
-    {"get_indices", BPlusTree_method_get_indices, METH_NOARGS, "Traverses the tree and returns a list of lists, where each 2nd level list represents a node, and each item is an index."},
+    {"__sizeof__", BPlusTree_method_sizeof, METH_NOARGS, "Returns the size of the tree in memory, in bytes, including its nodes but not its elements."},
+    {"get_compress", BPlusTree_method_get_compress, METH_NOARGS, "Return True if the leaves of the tree store their hashes compressed."},
+    {"get_unboxed", BPlusTree_method_get_unboxed, METH_NOARGS, "Return True if the tree stores its integers unboxed, as their hashes alone."},
+    {"add", BPlusTree_method_add, METH_O, "Takes object {o}, computes the hash, and inserts {o} into the tree with index of the hash."},
+    {"reserve", BPlusTree_method_reserve, METH_VARARGS, "Sets aside enough nodes for the tree to grow to {n} elements without allocating any more."},
+    {"set_trace", BPlusTree_method_set_trace, METH_VARARGS, "Records the last {capacity} (rounded up to a power of 2) inserts, splits, root splits and collisions of the tree, discarding any recorded so far. A {capacity} of 0 stops recording."},
+    {"get_trace", BPlusTree_method_get_trace, METH_NOARGS, "Returns a list of the recorded events of the tree, oldest first, as tuples of (time in ns as from time.monotonic_ns(), kind, hash, arg)."},
+    {"stats", BPlusTree_method_stats, METH_NOARGS, "Walks the tree and returns a dict describing its shape: height, nodes per level, leaf fill, collision runs, bytes, splits and comparisons per lookup."},
+    {"compact", (PyCFunction)BPlusTree_method_compact, METH_VARARGS | METH_KEYWORDS, "Rebuilds the tree in place with its nodes filled to {fill_factor} and laid out contiguously. Returns a tuple of the bytes used by nodes before and after."},
+    {"cursor", (PyCFunction)BPlusTree_method_cursor, METH_VARARGS | METH_KEYWORDS, "Returns a cursor over the elements of the tree, starting at the beginning or at the position saved in {token}."},
+    {"to_list", BPlusTree_method_to_list, METH_NOARGS, "Returns a list of the elements of the tree, in iteration order."},
+    {"iter_chunks", BPlusTree_method_iter_chunks, METH_VARARGS, "Returns an iterator over the elements of the tree, in iteration order, as tuples of up to {n} elements."},
+    {"save", BPlusTree_method_save, METH_VARARGS, "Writes the elements of the tree, which must be ints, bytes or strs, to a snapshot file at {path} that BPlusSnapshot can map."},
+    {"hashes", BPlusTree_method_hashes, METH_VARARGS, "Writes the hash of each element of the tree, in iteration order, into the writable int64 {buffer}. Returns the number of hashes written."},
+    {"contains_many", (PyCFunction)BPlusTree_method_contains_many, METH_VARARGS | METH_KEYWORDS, "Sets bit i of the bitmap {out} if the ith integer in the int64 {buffer} is in the unboxed tree, on {threads} threads without the GIL. Returns {out}, a new bytearray if not given."},
+    {"from_buffer", (PyCFunction)BPlusTree_method_from_buffer, METH_CLASS | METH_VARARGS | METH_KEYWORDS, "Returns a new tree holding the distinct integers in the int64 {buffer}, sorted and deduplicated without the GIL."},
     {NULL, NULL, 0, NULL}
 };
 
@@ -74,6 +89,97 @@ static PyTypeObject BPlusTreeType = {
 };
 
 
+// the docstring of BPlusSet
+PyDoc_STRVAR(BPlusSet_doc,
+"BPlusSet(iterable=None, /, *, b=16, compress=False, unboxed=False, capacity=0)\n"
+"--\n"
+"\n"
+"{BPlusSet} is a class designed to be similar to the builtin {set} class.\n"
+"\"Under the hood\" it is implemented as a B Plus Tree in C.\n"
+"\n"
+":param iterable: An iterable containing objects to add to the set. May be\n"
+"    slightly faster than repeated calls to {BPlusSet::add()}.\n"
+":param int b: the maximum number of child nodes per parent nodes in the\n"
+"    underlying B Plus Tree. Defaults to 16. Must be between 2 and 255\n"
+"    inclusive. For optimal performance, b<8 is not recommended.\n"
+":param bool compress: if True, each leaf stores its hashes as small\n"
+"    offsets from the leaf's lowest hash where their range allows. This\n"
+"    saves memory for dense hashes (such as runs of integers) at a small\n"
+"    cost to insertion. Defaults to False.\n"
+":param bool unboxed: if True, the set only holds ints whose hash is the\n"
+"    int itself (every int strictly between -(2**61 - 1) and 2**61 - 1,\n"
+"    other than -1), and stores them as their hashes alone rather than as\n"
+"    objects. Adding anything else raises TypeError or ValueError. Defaults\n"
+"    to False.\n"
+":param int capacity: the number of elements the set is expected to grow\n"
+"    to. Nodes for that many are set aside up front, as by\n"
+"    {BPlusSet::reserve()}, so that adding them does not allocate. The\n"
+"    length hint of {iterable} is used as well. Defaults to 0.");
+
+
+// define our subslot for BPlusSet public methods, on top of those of
+// BPlusTree
+static PyMethodDef BPlusSet_tp_methods[] = {
+    {"open", BPlusSet_method_open, METH_O | METH_CLASS, "Maps the snapshot file at {path}, written by BPlusSet.save(), as a read-only BPlusSnapshot."},
+    {NULL, NULL, 0, NULL}
+};
+
+
+// define our BPlusSetType type object: a BPlusTree constructed like a set,
+// through vectorcall rather than tp_init where it can be
+static PyTypeObject BPlusSetType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "five_one_one_bplus.c.BPlusSet",            /*tp_name*/
+    sizeof(BPlusTree),                          /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    0,                                          /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   /*tp_flags*/
+    BPlusSet_doc,                               /*tp_doc*/
+    0,                                          /*tp_traverse*/
+    0,                                          /*tp_clear*/
+    0,                                          /*tp_richcompare*/
+    0,                                          /*tp_weaklistoffset*/
+    0,                                          /*tp_iter*/
+    0,                                          /*tp_iternext*/
+    BPlusSet_tp_methods,                        /*tp_methods*/
+    0,                                          /*tp_members*/
+    0,                                          /*tp_getsets*/
+    &BPlusTreeType,                             /*tp_base*/
+    0,                                          /*tp_dict*/
+    0,                                          /*tp_descr_get*/
+    0,                                          /*tp_descr_set*/
+    0,                                          /*tp_dictoffset*/
+    (initproc)BPlusSet_tp_init,                 /*tp_init*/
+    0,                                          /*tp_alloc*/
+    BPlusTree_tp_new,                           /*tp_new*/
+    0,                                          /*tp_free*/
+    0,                                          /*tp_is_gc*/
+    0,                                          /*tp_bases*/
+    0,                                          /*tp_mro*/
+    0,                                          /*tp_cache*/
+    0,                                          /*tp_subclasses*/
+    0,                                          /*tp_weaklist*/
+    0,                                          /*tp_del*/
+    0,                                          /*tp_version_tag*/
+    0,                                          /*tp_finalize*/
+    BPlusSet_tp_vectorcall,                     /*tp_vectorcall*/
+};
+
+
 // BEGIN tp method definitions
 static PyObject *BPlusTree_tp_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs) {
     BPlusTree *self;
@@ -92,149 +198,130 @@ static void BPlusTree_tp_clear(BPlusTree *self) {
 
 static void BPlusTree_tp_dealloc(BPlusTree *self) {
     BPlusTree_tp_clear(self);
-    BPlusNode_dealloc(self->root);
+    if (self->root != NULL) {
+        BPlusNode_dealloc(&self->heap, self->root);
+    }
+    BPlusHeap_trim(&self->heap);
+    BPlusHeap_allocator.free(self->arena);
+    if (self->trace != NULL) {
+        BPlusTrace_free(self->trace);
+    }
     Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
 
 static int BPlusTree_tp_init(BPlusTree *self, PyObject *args, PyObject *kwargs) {
 
-    // set _builtins, _hash, _iter, _next, etc (builtin methods)
-    if (setBuiltins() == 0) {
-        
-        Py_INCREF(PyExc_RuntimeError);
-        PyErr_SetString(PyExc_RuntimeError, "Got error setting builtins.");
+    int b, compress = 0, unboxed = 0;
+    Py_ssize_t capacity = 0;
+    PyObject *initializer;
+    static char *kwlist[] = {"initializer", "b", "compress", "unboxed", "capacity", NULL};
 
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oi|ppn", kwlist, &initializer, &b, &compress, &unboxed, &capacity)) {
         return -1;
-
     }
 
-    #if DEBUG >= 1
+    return BPlusTree_init(self, initializer, b, compress, unboxed, capacity);
 
-    PyObject
-        *debug = PyLong_FromLong(DEBUG),
-        *msg1 = PyUnicode_FromString("WARNING: this module was compiled in debug mode:"),
-        *msg2 = PyUnicode_FromString("; there will be extraneous print statements.");
+}
 
-    if (PyObject_CallFunctionObjArgs(_print, msg1, debug, msg2, NULL) == NULL) {
+// (re-)initializes {self} as an empty tree with the given {b}, {compress}
+// and {unboxed}, then adds the elements of {initializer} unless it is None.
+// Nodes are then reserved for the tree to grow to {capacity} elements (see
+// BPlusTree_reserve()).
+// Shared by the constructors of BPlusTree and BPlusSet.
+// Returns 0 on success, or -1 with an error set.
+static int BPlusTree_init(BPlusTree *self, PyObject *initializer, int b, int compress, int unboxed, Py_ssize_t capacity) {
+
+    Py_ssize_t hint;
+    int res;
 
-        Py_DECREF(debug);
-        Py_DECREF(msg1);
-        Py_DECREF(msg2);
+    // set _builtins, _hash, _iter, _next, etc (builtin methods)
+    if (setBuiltins() == 0) {
         
         Py_INCREF(PyExc_RuntimeError);
-        PyErr_SetString(PyExc_RuntimeError, "Got error calling print statement.");
+        PyErr_SetString(PyExc_RuntimeError, "Got error setting builtins.");
 
         return -1;
 
     }
 
-    Py_DECREF(debug);
-    Py_DECREF(msg1);
-    Py_DECREF(msg2);
-
-    #endif
-
-    int b;
-    PyObject *initializer;
-    static char *kwlist[] = {"initializer", "b", NULL};
-    BPlusNode *firstleaf;
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oi", kwlist, &initializer, &b)) {
-        return -1;
-    }
-
-    #if DEBUG >= 2
-    printRefCount("constructor: object directly after argparse:", initializer);
-    #endif
-
     if (b < 2 || 255 < b) {
         Py_INCREF(PyExc_TypeError);
         PyErr_SetString(PyExc_TypeError, "BPlusTree Constructor got out of bounds b: needs to be in [2, 255].");
         return -1;
     }
 
-    self->root = BPlusBranch_init(b);
+    if (capacity < 0) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "BPlusTree Constructor got negative capacity.");
+        return -1;
+    }
 
-    firstleaf = BPlusLeaf_init(b);
-    firstleaf->parent = self->root;
+    if (BPlusTree_check_writable(self) == -1) {
+        return -1;
+    }
 
-    insert_BPlusNode(self->root->children, 0, firstleaf);
+    // release the contents of a tree that is being re-initialized
+    if (self->root != NULL) {
+        BPlusNode_dealloc(&self->heap, self->root);
+        BPlusHeap_allocator.free(self->arena);
+        self->arena = NULL;
+        self->arena_nbytes = 0;
+        self->size = 0;
+        self->collisions = 0;
+        self->splits = 0;
+    }
+    self->version++;
+
+    // start out with a lone root leaf stored inside the tree object itself;
+    // it holds up to {BPLUS_INLINE_SLOTS} elements (or {b}, if smaller) before
+    // the tree has to allocate any nodes.
+    self->root = BPlusNode_layout(
+        self->inline_root,
+        b < BPLUS_INLINE_SLOTS ? b : BPLUS_INLINE_SLOTS - 1,
+        1,
+        sizeof(l64)
+    );
+    self->root->flags |= BPLUSNODE_INLINE;
 
     self->b = b;
+    self->compress = compress;
+    self->unboxed = unboxed;
 
     if (initializer == Py_None) {
-
-        // no need to decref because ref count is not increased by call to
-        // constructor
-        return 0;
-
+        return BPlusTree_reserve(self, capacity);
     }
 
-    PyObject
-        *iterable = PyObject_GetIter(initializer),
-        *current_object,
-        *insert_result;
-    l64 hash;
-
-    // we're done with our initializer
-    // again, no need to decref because ref count is not increased by call to
-    // constructor
-
-    #if DEBUG >= 2
-    printRefCount("constructor: iterable directly after creation:", iterable);
-    #endif
-
-    while ((current_object = PyIter_Next(iterable)) != NULL) {
-        
-        // calculate hash
-        if ((hash = PyObject_Hash(current_object)) == -1) {
-
-            Py_DECREF(iterable);
-
-            BPlusTree_tp_dealloc(self);
-
-            return -1;
-
-        }
-
-        // call self.insert(hash(o), o)
-        if ((insert_result = BPlusTree_insert(self, hash, current_object)) == NULL) {
-
-            Py_DECREF(iterable);
-
-            BPlusTree_tp_dealloc(self);
-
+    if (unboxed && PyObject_TypeCheck(initializer, &BPlusTreeType) && ((BPlusTree *)initializer)->unboxed) {
+        // another unboxed tree can hand over its hashes, which are its
+        // elements
+        res = BPlusTree_extend_unboxed(self, (BPlusTree *)initializer);
+    } else if (!unboxed
+        && ((BPLUS_STORED_HASHES && (PyAnySet_CheckExact(initializer) || PyDict_CheckExact(initializer)))
+            || PyObject_TypeCheck(initializer, &BPlusTreeType))) {
+        // sets, dicts and other trees already know the hash of every element
+        // (an unboxed tree needs to check that each element is an integer, so
+        // it takes the slower paths below)
+        res = BPlusTree_extend_hashed(self, initializer);
+    } else if (PyList_CheckExact(initializer) || PyTuple_CheckExact(initializer)) {
+        // lists and tuples are walked directly, without the iterator protocol
+        res = BPlusTree_extend_sequence(self, initializer);
+    } else {
+        // anything else is inserted one element at a time, into nodes
+        // reserved up front if it can tell how many elements it has
+        if ((hint = PyObject_LengthHint(initializer, 0)) == -1
+            || BPlusTree_reserve(self, hint > capacity ? hint : capacity) == -1) {
             return -1;
-
         }
-
-        #if DEBUG >= 2
-        printRefCount("constructor: insert_result directly after creation", insert_result);
-        #endif
-
-        Py_DECREF(insert_result);
-
-        #if DEBUG >= 2
-        printRefCount("constructor: insert_result directly after decref", insert_result);
-        #endif
-
+        res = BPlusTree_extend_iterable(self, initializer);
     }
 
-    // clear stop iteration exception
-    PyErr_Clear();
-
-    #if DEBUG >= 2
-    printRefCount("constructor: iterable directly before call to decref:", iterable);
-    #endif
-
-    Py_DECREF(iterable);
-
-    #if DEBUG >= 2
-    printRefCount("constructor: iterable directly before returning:", iterable);
-    #endif
+    if (res == -1) {
+        return -1;
+    }
 
-    return 0;
+    return BPlusTree_reserve(self, capacity);
 
 }
 
@@ -285,89 +372,20 @@ static PyObject *BPlusTree_tp_richcompare(PyObject *o1, PyObject *o2, int op) {
 //      iteration).
 //  3. to avoid needing to solve the problem of what to do when the user uses
 //      a {break} statement during iteration.
+// (a {BPlusCursor} from cursor() iterates without the list instead.)
 static PyObject *BPlusTree_tp_iter(PyObject *self) {
 
-    BPlusTree *tree = (BPlusTree *)self;
-    BPlusNode *current = tree->root;
     PyObject
-        *container_list = PyList_New(tree->size),
-        *iterator,
-        *value,
-        *subvalue;
-    int
-        ix = 0,
-        res;
-
-    #if DEBUG >= 2
-    printRefCount("BPlusTree_tp_iter: container_list directly after creation:", container_list);
-    #endif
-
-    if (setBuiltins() == 0) {
-
-        Py_DECREF(container_list);
-        Py_INCREF(PyExc_RuntimeError);
-        PyErr_SetString(PyExc_RuntimeError, "Error setting builtins.");
+        *container_list = BPlusTree_to_list((BPlusTree *)self),
+        *iterator;
 
+    if (container_list == NULL) {
         return NULL;
-
-    }
-
-    while (current->children != NULL) current = ((BPlusNode **)current->children->arr)[0];
-
-    while (current != NULL) {
-        for (int jx = 0; jx < current->values->size; jx++) {
-
-            value = ((PyObject **)current->values->arr)[jx];
-            res = PyObject_IsInstance(value, (PyObject *)&PyList_Type);
-
-            if (res == -1) {
-                // error determining if {value} is a list
-                Py_DECREF(container_list);
-                return NULL;
-            } else if (res == 0) {
-                // {value} is not a list, handle it normally
-                // update reference to item because PyList_SetItem steals a reference
-                Py_INCREF(value);
-                if (PyList_SetItem(container_list, ix, value) == -1) {
-                    Py_DECREF(container_list);
-                    return NULL;
-                };
-                ix++;
-            } else {
-                // {value} is a list representing objects with hash collisions
-                // add each element of it to our container
-                for (int kx = 0; kx < PyList_Size(value); kx++) {
-                    subvalue = PyList_GetItem(value, kx);
-                    // update reference to item because PyList_SetItem steals a reference
-                    Py_INCREF(subvalue);
-                    if (PyList_SetItem(container_list, ix, subvalue) == -1) {
-                        Py_DECREF(container_list);
-                        return NULL;
-                    };
-                    ix++;
-                }
-            }
-        }
-        current = current->next;
     }
 
     iterator = PyObject_GetIter(container_list);
     Py_DECREF(container_list);
 
-    if (iterator == NULL) {
-
-        Py_INCREF(PyExc_RuntimeError);
-        PyErr_SetString(PyExc_RuntimeError, "Error calling iter() on list object.");
-
-        return NULL;
-
-    }
-
-    #if DEBUG >= 2
-    printRefCount("BPlusTree_tp_iter: container_list directly after decref:", container_list);
-    printRefCount("BPlusTree_tp_iter: iterator directly after creation:", iterator);
-    #endif
-
     return iterator;
 
 }
@@ -382,29 +400,7 @@ Py_ssize_t BPlusTree_sq_length(PyObject *self) {
 
 // this is called on use of the `in` keyword
 int BPlusTree_sq_contains(PyObject *self, PyObject *value) {
-
-    BPlusTree *tree = (BPlusTree *)self;
-    l64 key;
-    BPlusNode *leaf = NULL;
-    int ix;
-
-    key = PyObject_Hash(value);
-
-    leaf = BPlusNode_search(tree->root, key);
-
-    ix = BPlusLeaf_search(leaf, key, value);
-
-    // see comments above BPlusLeaf_search for info about what -1 means
-    if (ix >= 0) {
-        // {value} is in the tree
-        return 1;
-    } else if (ix == -2) {
-        // there was an error in the search operation
-        return -1;
-    }
- 
-    return 0;
-
+    return BPlusTree_contains((BPlusTree *)self, PyObject_Hash(value), value);
 }
 
 
@@ -413,15 +409,24 @@ static PyObject *BPlusTree_method_get_b(PyObject *self, PyObject *args) {
     return PyLong_FromLong(((BPlusTree *)self)->b);
 }
 
-static PyObject *BPlusTree_method_add(PyObject *self, PyObject *args) {
+// the inline root leaf is part of the object itself; every other node is
+// counted by {tree->heap} or is in {tree->arena}.
+static PyObject *BPlusTree_method_sizeof(PyObject *self, PyObject *args) {
+    return PyLong_FromSize_t((size_t)Py_TYPE(self)->tp_basicsize + BPlusTree_nbytes((BPlusTree *)self));
+}
+
+static PyObject *BPlusTree_method_get_compress(PyObject *self, PyObject *args) {
+    return PyBool_FromLong(((BPlusTree *)self)->compress);
+}
+
+static PyObject *BPlusTree_method_get_unboxed(PyObject *self, PyObject *args) {
+    return PyBool_FromLong(((BPlusTree *)self)->unboxed);
+}
+
+static PyObject *BPlusTree_method_add(PyObject *self, PyObject *o) {
 
     BPlusTree *tree = (BPlusTree *)self;
     l64 key;
-    PyObject *o;
-
-    if (!PyArg_ParseTuple(args, "O", &o)) {
-        return NULL;
-    }
 
     if ((key = PyObject_Hash(o)) == -1) {
         Py_INCREF(PyExc_TypeError);
@@ -433,244 +438,1906 @@ static PyObject *BPlusTree_method_add(PyObject *self, PyObject *args) {
 
 }
 
-// following is for debugging purposes and is not expected to be useful generally.
-static PyObject *BPlusTree_method_get_indices(PyObject *self, PyObject *args) {
-
-    BPlusTree *tree = (BPlusTree *)self;
-    // stack is to be the top level list, indices is the current second level list
-    PyObject *stack, *indices;
-    // ix is the index of the current BPlusNode, max_ix is the number of BPlusNodes in {nodes}
-    int ix, max_ix;
-    // nodes is eventually going to contain pointers to every node in the tree
-    BPlusNode *nodes[1000];
-    // current is a pointer to the current node
-    BPlusNode *current;
-
-    stack = PyList_New(0);
-    ix = 0;
-    max_ix = 1;
-    nodes[0] = tree->root;
-    
-    while (ix < max_ix) {
-
-        // build the list of indices
-        indices = PyList_New(0);
-        current = nodes[ix];
-        for (int jx = 0; jx < current->indices->size; jx++) {
-            PyList_Append(indices, PyLong_FromLongLong(((l64 *)current->indices->arr)[jx]));
-        }
-        PyList_Append(stack, indices);
-        Py_DECREF(indices);
-
-        // update nodes
-        if (current->children != NULL) {
-            for (int jx = 0; jx < current->children->size; jx++) {
-                nodes[max_ix] = ((BPlusNode **)current->children->arr)[jx];
-                max_ix++;
-            }
-        }
+// sets aside nodes for the tree to grow to {n} elements (see
+// BPlusTree_reserve()). They are held until the tree is compacted or
+// deallocated.
+static PyObject *BPlusTree_method_reserve(PyObject *self, PyObject *args) {
 
-        ix++;
+    Py_ssize_t n;
 
+    if (!PyArg_ParseTuple(args, "n", &n)) {
+        return NULL;
     }
 
-    return stack;
-
-}
-
-// BEGIN helper function definitions
+    if (n < 0) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "reserve() got negative n.");
+        return NULL;
+    }
 
-// helper function for splitting a saturated branch into 2 branches
-// expects that {branch} has {self->b}+1 children
-void BPlusBranch_split(BPlusTree *self, BPlusNode *branch) {
+    if (BPlusTree_reserve((BPlusTree *)self, n) == -1) {
+        return NULL;
+    }
 
-    BPlusNode *left, *right;
-    // children size, children mid, indices size, indices mid
-    int csize, cmid, isize, imid, ix;
-    l64 new_parent_ix;
+    Py_RETURN_NONE;
 
-    // initialize our 2 new leaves
-    left = BPlusBranch_init(self->b);
-    right = BPlusBranch_init(self->b);
+}
 
-    csize = branch->children->size;
-    cmid = csize / 2;
-    isize = branch->indices->size;
-    imid = cmid - 1;
+// rebuild the tree with every node filled to {fill_factor} of its capacity and
+// laid out in a single block of memory: branches in depth-first order
+// followed by the leaves in key order.
+// Returns a tuple of the bytes used by nodes before and after the rebuild.
+static PyObject *BPlusTree_method_compact(PyObject *self, PyObject *args, PyObject *kwargs) {
 
-    // copy half of {branch->children} each to left and right respectively
-    memcpy(left->children->arr, branch->children->arr, sizeof(PyObject *)*cmid);
-    left->children->size = cmid;
+    BPlusTree *tree = (BPlusTree *)self;
+    double fill_factor = 1.0;
+    static char *kwlist[] = {"fill_factor", NULL};
+    BPlusNode *current, *old_root;
+    void *old_arena;
+    size_t bytes_before, old_arena_nbytes;
+    l64 *keys;
+    PyObject **values;
+    int n = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|d", kwlist, &fill_factor)) {
+        return NULL;
+    }
 
-    memcpy(right->children->arr, ((BPlusNode **)branch->children->arr)+cmid, sizeof(BPlusNode *) * (csize - cmid));
-    right->children->size = csize - cmid;
+    if (!(0.0 < fill_factor && fill_factor <= 1.0)) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "compact() got out of bounds fill_factor: needs to be in (0, 1].");
+        return NULL;
+    }
 
-    // copy half of {branch->indices} each to left and right respectively
-    memcpy(left->indices->arr, branch->indices->arr, sizeof(l64)*imid);
-    left->indices->size = imid;
+    if (BPlusTree_check_writable(tree) == -1) {
+        return NULL;
+    }
 
-    memcpy(right->indices->arr, ((l64 *)branch->indices->arr)+imid+1, sizeof(l64) * (isize - imid - 1));
-    right->indices->size = isize - imid - 1;
+    bytes_before = BPlusTree_nbytes(tree);
 
-    // set parent of children
-    for (ix = 0; ix < left->children->size; ix++) {
-        ((BPlusNode **)left->children->arr)[ix]->parent = left;
-    }
-    for (ix = 0; ix < right->children->size; ix++) {
-        ((BPlusNode **)right->children->arr)[ix]->parent = right;
+    // count the occupied leaf slots (a collision list takes up one slot)
+    current = tree->root;
+    while (current->children != NULL) current = ((BPlusNode **)current->children->arr)[0];
+    for (BPlusNode *leaf = current; leaf != NULL; leaf = leaf->next) {
+        n += leaf->values->size;
     }
 
-    // set parent of left and right
-    if (branch == self->root) {
-        self->root = BPlusBranch_init(self->b);
-        left->parent = self->root;
-        right->parent = self->root;
-    } else {
-        left->parent = branch->parent;
-        right->parent = branch->parent;
+    keys = (l64 *)malloc(sizeof(l64) * (n+1));
+    values = (PyObject **)malloc(sizeof(PyObject *) * (n+1));
+    if (keys == NULL || values == NULL) {
+        free(keys);
+        free(values);
+        return PyErr_NoMemory();
     }
 
-    // reset attributes of parent
-    new_parent_ix = ((l64 *)branch->indices->arr)[imid];
-    ix = bisect_left(left->parent->indices, new_parent_ix);
-    if (left->parent->children->size == 0) {
-        // parent is a new node, use insert() to handle size
-        insert_BPlusNode(left->parent->children, 0, right);
-        insert_BPlusNode(left->parent->children, 0, left);
-    } else {
-        // parent is an existing node
-        ((BPlusNode **)left->parent->children->arr)[ix] = right;
-        insert_BPlusNode(left->parent->children, ix, left);
+    n = 0;
+    for (BPlusNode *leaf = current; leaf != NULL; leaf = leaf->next) {
+        BPlusLeaf_get_keys(leaf, keys+n);
+        memcpy(values+n, leaf->values->arr, sizeof(PyObject *) * leaf->values->size);
+        n += leaf->values->size;
     }
-    insert_l64(left->parent->indices, ix, new_parent_ix);
 
-    if (left->parent->children->size > self->b) {
-        BPlusBranch_split(self, left->parent);
+    old_root = tree->root;
+    old_arena = tree->arena;
+    old_arena_nbytes = tree->arena_nbytes;
+
+    if (BPlusTree_build(tree, keys, values, n, fill_factor) == -1) {
+        // the old tree is untouched
+        tree->root = old_root;
+        tree->arena = old_arena;
+        tree->arena_nbytes = old_arena_nbytes;
+        free(keys);
+        free(values);
+        return NULL;
     }
 
-    // free branch indices
-    free(branch->indices->arr);
-    free(branch->indices);
-
-    // free branch children
-    free(branch->children->arr);
-    free(branch->children);
+    // the values now belong to the new leaves
+    tree->version++;
+    BPlusNode_free_tree(&tree->heap, old_root);
+    BPlusHeap_trim(&tree->heap);
+    BPlusHeap_allocator.free(old_arena);
+    free(keys);
+    free(values);
 
-    // free branch
-    free(branch);
+    return Py_BuildValue("(nn)", (Py_ssize_t)bytes_before, (Py_ssize_t)BPlusTree_nbytes(tree));
 
 }
 
-// helper function for splitting a saturated leaf into 2 leaves
-// expects that {leaf} has {self->b}+1 values
-void BPlusLeaf_split(BPlusTree *self, BPlusNode *leaf) {
+// returns a new cursor over {self}; see bpluscursor.c.
+static PyObject *BPlusTree_method_cursor(PyObject *self, PyObject *args, PyObject *kwargs) {
 
-    BPlusNode *left, *right;
-    // values size, values mid, indices size, indices mid
-    int vsize, vmid, isize, imid, ix;
-    l64 new_parent_ix;
+    PyObject *token = Py_None;
+    static char *kwlist[] = {"token", NULL};
 
-    // initialize our 2 new leaves
-    left = BPlusLeaf_init(self->b);
-    right = BPlusLeaf_init(self->b);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwlist, &token)) {
+        return NULL;
+    }
 
-    vsize = leaf->values->size;
-    vmid = vsize / 2;
-    isize = leaf->indices->size;
-    imid = vmid;
+    return BPlusCursor_new((BPlusTree *)self, token);
 
-    // copy half of {leaf->values} each to left and right respectively
-    memcpy(left->values->arr, leaf->values->arr, sizeof(PyObject *)*vmid);
-    left->values->size = vmid;
+}
 
-    memcpy(right->values->arr, ((PyObject **)leaf->values->arr)+vmid, sizeof(PyObject *) * (vsize - vmid));
-    right->values->size = vsize - vmid;
+static PyObject *BPlusTree_method_to_list(PyObject *self, PyObject *args) {
+    return BPlusTree_to_list((BPlusTree *)self);
+}
 
-    // copy half of {leaf->indices} each to left and right respectively
-    memcpy(left->indices->arr, leaf->indices->arr, sizeof(l64)*imid);
-    left->indices->size = imid;
+// writes the elements of {self} to a snapshot file at {path}; see
+// BPlusSnapshot_write().
+static PyObject *BPlusTree_method_save(PyObject *self, PyObject *args) {
 
-    memcpy(right->indices->arr, ((l64 *)leaf->indices->arr)+imid, sizeof(l64) * (isize - imid));
-    right->indices->size = isize - imid;
+    PyObject *path, *elements;
+    int res;
 
-    // set parents
-    left->parent = leaf->parent;
-    right->parent = leaf->parent;
+    if (!PyArg_ParseTuple(args, "O", &path)) {
+        return NULL;
+    }
 
-    // set {next} of all relevant nodes
-    if (leaf->prev != NULL) {
-        leaf->prev->next = left;
+    if ((elements = BPlusTree_to_list((BPlusTree *)self)) == NULL) {
+        return NULL;
     }
-    left->next = right;
-    right->next = leaf->next;
+    res = BPlusSnapshot_write(elements, path);
+    Py_DECREF(elements);
 
-    // set {prev} of all relevant nodes
-    if (leaf->next != NULL) {
-        leaf->next->prev = right;
+    if (res == -1) {
+        return NULL;
     }
-    right->prev = left;
-    left->prev = leaf->prev;
 
-    // reset attributes of parent
-    new_parent_ix = ((l64 *)right->indices->arr)[0];
-    ix = bisect_left(leaf->parent->indices, new_parent_ix);
-    ((BPlusNode **)leaf->parent->children->arr)[ix] = right;
-    insert_BPlusNode(leaf->parent->children, ix, left);
-    insert_l64(leaf->parent->indices, ix, new_parent_ix);
+    Py_RETURN_NONE;
+
+}
+
+// returns a cursor over {self} that yields tuples of {n} elements; see
+// BPlusCursor_tp_iternext().
+static PyObject *BPlusTree_method_iter_chunks(PyObject *self, PyObject *args) {
+
+    PyObject *cursor;
+    Py_ssize_t n;
 
-    if (leaf->parent->children->size > self->b) {
-        BPlusBranch_split(self, leaf->parent);
+    if (!PyArg_ParseTuple(args, "n", &n)) {
+        return NULL;
     }
 
-    // free leaf indices
-    free(leaf->indices->arr);
-    free(leaf->indices);
+    if (n < 1) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "iter_chunks() got out of bounds n: needs to be at least 1.");
+        return NULL;
+    }
 
-    // free leaf values
-    free(leaf->values->arr);
-    free(leaf->values);
+    if ((cursor = BPlusCursor_new((BPlusTree *)self, Py_None)) == NULL) {
+        return NULL;
+    }
+    ((BPlusCursor *)cursor)->chunk = n;
 
-    // free leaf
-    free(leaf);
+    return cursor;
 
 }
 
-PyObject *BPlusTree_insert(BPlusTree *tree, l64 key, PyObject *o) {
+// writes the hashes of the elements of {self} into a caller supplied buffer
+// of signed 64 bit integers (such as an array('q') or an int64 numpy array),
+// lined up with the elements returned by to_list(): each element of a
+// collision list gets its own copy of the shared hash.
+static PyObject *BPlusTree_method_hashes(PyObject *self, PyObject *args) {
 
-    BPlusNode *leaf = NULL;
-    int res;
+    BPlusTree *tree = (BPlusTree *)self;
+    BPlusNode *leaf;
+    Py_buffer view;
+    l64 *out;
+    PyObject *buffer, **values;
+    Py_ssize_t n = 0;
 
-    leaf = BPlusNode_search(tree->root, key);
+    if (!PyArg_ParseTuple(args, "O", &buffer)) {
+        return NULL;
+    }
 
-    res = BPlusLeaf_insert(leaf, key, o);
+    if (PyObject_GetBuffer(buffer, &view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) == -1) {
+        return NULL;
+    }
 
-    if (res == -1) {
-        // an error occurred in the insert operation
-        // an error should already be set
+    if (!BPlusTree_int64_buffer(&view)) {
+        PyBuffer_Release(&view);
+        Py_INCREF(PyExc_TypeError);
+        PyErr_SetString(PyExc_TypeError, "hashes() needs a buffer of native signed 64 bit integers.");
         return NULL;
-    } else if (res == 0) {
-        // {o} was already in the list, do nothing
-        Py_RETURN_NONE;
     }
 
-    if (leaf->values->size > tree->b) {
-        BPlusLeaf_split(tree, leaf);
+    if (view.len / view.itemsize < tree->size) {
+        PyBuffer_Release(&view);
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "hashes() got a buffer too small to hold a hash for every element.");
+        return NULL;
     }
 
-    tree->size++;
-    Py_RETURN_NONE;
+    out = (l64 *)view.buf;
+    leaf = tree->root;
+    while (leaf->children != NULL) leaf = ((BPlusNode **)leaf->children->arr)[0];
 
-}
+    for (; leaf != NULL; leaf = leaf->next) {
 
-// comparison helper function
-int BPlusTree_cmp(BPlusTree *tree1, BPlusTree *tree2) {
+        int size = leaf->values->size, plain = 1;
+        values = (PyObject **)leaf->values->arr;
 
-    BPlusNode 
-        *curr1 = tree1->root,
-        *curr2 = tree2->root;
-    l64
-        item1,
-        item2;
+        for (int ix = 0; ix < size && plain && tree->collisions > 0; ix++) {
+            plain = !PyList_Check(values[ix]);
+        }
+
+        if (plain) {
+            // decode the leaf's hashes straight into the buffer
+            BPlusLeaf_get_keys(leaf, out + n);
+            n += size;
+            continue;
+        }
+
+        // repeat each hash once for every element of its collision list
+        for (int ix = 0; ix < size; ix++) {
+            l64 key = BPlusLeaf_key(leaf, ix);
+            Py_ssize_t copies = PyList_Check(values[ix]) ? PyList_GET_SIZE(values[ix]) : 1;
+            for (Py_ssize_t kx = 0; kx < copies; kx++) {
+                out[n++] = key;
+            }
+        }
+
+    }
+
+    PyBuffer_Release(&view);
+
+    return PyLong_FromSsize_t(n);
+
+}
+
+// returns a new tree of type {cls} holding the distinct integers in the int64
+// {buffer}. The integers are copied, sorted and deduplicated without the GIL;
+// for an unboxed tree they are then laid out directly, without creating any
+// objects at all.
+static PyObject *BPlusTree_method_from_buffer(PyObject *cls, PyObject *args, PyObject *kwargs) {
+
+    BPlusTree *tree = NULL;
+    BPlusPair *pairs = NULL;
+    Py_buffer view;
+    PyObject *buffer;
+    l64 *keys = NULL, *scratch = NULL;
+    Py_ssize_t n, m = 0;
+    int b = 16, compress = 0, unboxed = 0, in_range = 1, sorted = 1;
+    static char *kwlist[] = {"buffer", "b", "compress", "unboxed", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ipp", kwlist, &buffer, &b, &compress, &unboxed)) {
+        return NULL;
+    }
+
+    if (PyObject_GetBuffer(buffer, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) == -1) {
+        return NULL;
+    }
+
+    if (!BPlusTree_int64_buffer(&view)) {
+        PyBuffer_Release(&view);
+        Py_INCREF(PyExc_TypeError);
+        PyErr_SetString(PyExc_TypeError, "from_buffer() needs a buffer of native signed 64 bit integers.");
+        return NULL;
+    }
+
+    n = view.len / view.itemsize;
+
+    // construct through {cls} so that subclasses come out as themselves
+    {
+        PyObject *init_args = Py_BuildValue("(O)", Py_None), *init_kwargs = Py_BuildValue(
+            "{sisOsO}", "b", b, "compress", compress ? Py_True : Py_False, "unboxed", unboxed ? Py_True : Py_False
+        );
+        if (init_args != NULL && init_kwargs != NULL) {
+            tree = (BPlusTree *)PyObject_Call(cls, init_args, init_kwargs);
+        }
+        Py_XDECREF(init_args);
+        Py_XDECREF(init_kwargs);
+    }
+    if (tree == NULL) {
+        goto error;
+    }
+    if (!PyObject_TypeCheck((PyObject *)tree, &BPlusTreeType) || tree->size != 0) {
+        Py_INCREF(PyExc_TypeError);
+        PyErr_SetString(PyExc_TypeError, "from_buffer() needs a class whose constructor returns an empty BPlusTree.");
+        goto error;
+    }
+
+    keys = (l64 *)malloc(sizeof(l64) * (n + 1));
+    scratch = (l64 *)malloc(sizeof(l64) * (n + 1));
+    if (keys == NULL || scratch == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+
+    memcpy(keys, view.buf, sizeof(l64) * n);
+    BPlusPool_sort(keys, scratch, n, sizeof(l64));
+
+    for (Py_ssize_t ix = 0; ix < n; ix++) {
+        if (m == 0 || keys[ix] != keys[m-1]) {
+            keys[m++] = keys[ix];
+        }
+    }
+
+    // every element of an unboxed tree must be its own hash (see
+    // BPlusTree_unbox())
+    if (m > 0 && (keys[0] <= -(l64)_PyHASH_MODULUS || (l64)_PyHASH_MODULUS <= keys[m-1])) {
+        in_range = 0;
+    }
+    for (Py_ssize_t ix = 0; ix < m && keys[ix] <= -1; ix++) {
+        if (keys[ix] == -1) {
+            in_range = 0;
+        }
+    }
+
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&view);
+
+    if (tree->unboxed) {
+
+        if (!in_range) {
+            Py_INCREF(PyExc_ValueError);
+            PyErr_SetString(PyExc_ValueError, "An unboxed BPlusTree can only hold ints whose hash is the int itself.");
+            goto error;
+        }
+
+        if (BPlusTree_load_keys(tree, keys, m) == -1) {
+            goto error;
+        }
+
+    } else {
+
+        if ((pairs = (BPlusPair *)malloc(sizeof(BPlusPair) * (m + 1))) == NULL) {
+            PyErr_NoMemory();
+            goto error;
+        }
+
+        for (Py_ssize_t ix = 0; ix < m; ix++) {
+            pairs[ix].key = BPlusTree_hash_l64(keys[ix]);
+            if ((pairs[ix].value = PyLong_FromLongLong(keys[ix])) == NULL) {
+                for (Py_ssize_t jx = 0; jx < ix; jx++) {
+                    Py_DECREF(pairs[jx].value);
+                }
+                goto error;
+            }
+            sorted = sorted && (ix == 0 || pairs[ix-1].key <= pairs[ix].key);
+        }
+
+        // only integers outside of the range where hash(x) == x are out of
+        // order once hashed
+        if (!sorted && BPlusPair_sort(pairs, m) == -1) {
+            for (Py_ssize_t jx = 0; jx < m; jx++) {
+                Py_DECREF(pairs[jx].value);
+            }
+            goto error;
+        }
+
+        if (BPlusTree_load_sorted(tree, pairs, m) == -1) {
+            goto error;
+        }
+
+    }
+
+    tree->version++;
+
+    free(keys);
+    free(scratch);
+    free(pairs);
+
+    return (PyObject *)tree;
+
+error:
+    if (view.obj != NULL) {
+        PyBuffer_Release(&view);
+    }
+    Py_XDECREF(tree);
+    free(keys);
+    free(scratch);
+    free(pairs);
+    return NULL;
+
+}
+
+// looks up every integer in the int64 {buffer} in the unboxed tree {self},
+// and sets bit i of the bitmap {out} (bit i % 8 of byte i / 8) if the ith
+// integer is in the tree, clearing it otherwise. {out} must be a writable
+// buffer of at least len({buffer}) / 8 bytes, rounded up; if it is not
+// given, a new bytearray is created.
+// The lookups need no Python objects, so they run with the GIL released,
+// split between {threads} threads (or as many as the pool is set to use, see
+// BPlusPool_workers()). Meanwhile the tree is marked as being read, so that
+// anything that would change it raises RuntimeError.
+// Returns {out}.
+static PyObject *BPlusTree_method_contains_many(PyObject *self, PyObject *args, PyObject *kwargs) {
+
+    BPlusTree *tree = (BPlusTree *)self;
+    BPlusProbe probe;
+    Py_buffer view, out_view;
+    PyObject *buffer, *out = Py_None, *threads = Py_None;
+    long threads_long;
+    int nthreads;
+    static char *kwlist[] = {"buffer", "out", "threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OO", kwlist, &buffer, &out, &threads)) {
+        return NULL;
+    }
+
+    if (!tree->unboxed) {
+        Py_INCREF(PyExc_TypeError);
+        PyErr_SetString(PyExc_TypeError, "contains_many() needs an unboxed BPlusTree.");
+        return NULL;
+    }
+
+    // range check as a long, so that huge counts are not narrowed into range
+    if (threads == Py_None) {
+        nthreads = 0;
+    } else if ((threads_long = PyLong_AsLong(threads)) == -1 && PyErr_Occurred()) {
+        return NULL;
+    } else if (threads_long < 1 || BPLUSPOOL_MAX_THREADS < threads_long) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "contains_many() got out of bounds threads: needs to be in [1, 64].");
+        return NULL;
+    } else {
+        nthreads = (int)threads_long;
+    }
+
+    if (tree->busy) {
+        Py_INCREF(PyExc_RuntimeError);
+        PyErr_SetString(PyExc_RuntimeError, "BPlusTree is being rebuilt by another thread.");
+        return NULL;
+    }
+
+    if (PyObject_GetBuffer(buffer, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) == -1) {
+        return NULL;
+    }
+
+    if (!BPlusTree_int64_buffer(&view)) {
+        PyBuffer_Release(&view);
+        Py_INCREF(PyExc_TypeError);
+        PyErr_SetString(PyExc_TypeError, "contains_many() needs a buffer of native signed 64 bit integers.");
+        return NULL;
+    }
+
+    probe.n = view.len / view.itemsize;
+
+    if (out == Py_None) {
+        if ((out = PyByteArray_FromStringAndSize(NULL, (probe.n + 7) / 8)) == NULL) {
+            PyBuffer_Release(&view);
+            return NULL;
+        }
+    } else {
+        Py_INCREF(out);
+    }
+
+    if (PyObject_GetBuffer(out, &out_view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) == -1) {
+        Py_DECREF(out);
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+
+    if (out_view.len < (probe.n + 7) / 8) {
+        PyBuffer_Release(&out_view);
+        Py_DECREF(out);
+        PyBuffer_Release(&view);
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "contains_many() got an out buffer too small to hold a bit for every integer.");
+        return NULL;
+    }
+
+    if (nthreads == 0) {
+        nthreads = BPlusPool_workers(probe.n);
+    }
+
+    probe.root = tree->root;
+    probe.keys = (l64 *)view.buf;
+    probe.out = (unsigned char *)out_view.buf;
+    // a few runs per thread, so that threads which finish early can pick up
+    // more work, but no run shorter than a byte of {out}
+    probe.ntasks = nthreads > 1 ? 4 * nthreads : 1;
+    if (probe.ntasks > (probe.n + 7) / 8) probe.ntasks = (int)((probe.n + 7) / 8);
+
+    tree->readers++;
+    Py_BEGIN_ALLOW_THREADS
+    BPlusPool_run(BPlusProbe_run, &probe, probe.ntasks, nthreads);
+    Py_END_ALLOW_THREADS
+    tree->readers--;
+
+    PyBuffer_Release(&out_view);
+    PyBuffer_Release(&view);
+
+    return out;
+
+}
+
+// starts recording the events of the tree in a new ring buffer of {capacity}
+// events (see bplustrace.c), or stops if {capacity} is 0.
+static PyObject *BPlusTree_method_set_trace(PyObject *self, PyObject *args) {
+
+    BPlusTree *tree = (BPlusTree *)self;
+    BPlusTrace *trace = NULL;
+    Py_ssize_t capacity;
+
+    if (!PyArg_ParseTuple(args, "n", &capacity)) {
+        return NULL;
+    }
+
+    if (capacity < 0 || BPLUS_TRACE_MAX < capacity) {
+        Py_INCREF(PyExc_ValueError);
+        PyErr_SetString(PyExc_ValueError, "set_trace() got out of bounds capacity: needs to be in [0, 2**24].");
+        return NULL;
+    }
+
+    if (capacity > 0 && (trace = BPlusTrace_new(capacity)) == NULL) {
+        return NULL;
+    }
+
+    if (tree->trace != NULL) {
+        BPlusTrace_free(tree->trace);
+    }
+    tree->trace = trace;
+
+    Py_RETURN_NONE;
+
+}
+
+static PyObject *BPlusTree_method_get_trace(PyObject *self, PyObject *args) {
+
+    BPlusTree *tree = (BPlusTree *)self;
+
+    if (tree->trace == NULL) {
+        return PyList_New(0);
+    }
+
+    return BPlusTrace_to_list(tree->trace);
+
+}
+
+// returns a dict describing the shape of the tree, for tuning {b} and spotting
+// degenerate trees:
+//  1. "height": the number of levels, 1 for a tree that is a lone leaf.
+//  2. "nodes_per_level": the number of nodes at each level, root first.
+//  3. "fill_histogram": item i is the number of leaves holding i hashes.
+//  4. "collision_runs": the number of hashes shared by more than 1 element.
+//  5. "nbytes": the bytes held by the nodes (see BPlusTree_nbytes()).
+//  6. "splits": the number of nodes split since the tree was created.
+//  7. "avg_comparisons": the mean number of comparisons made to find an
+//      element of the tree (see BPlusNode_search_cost()), 0 if it is empty.
+// The walk keeps its own stack of {height} branches, so trees of any size and
+// depth can be described.
+static PyObject *BPlusTree_method_stats(PyObject *self, PyObject *args) {
+
+    BPlusTree *tree = (BPlusTree *)self;
+    BPlusNode *node, **nodes;
+    PyObject *per_level = NULL, *fill = NULL, *value;
+    // {slots}[d] is the child of {nodes}[d] being walked; {costs}[d] is the
+    // number of hash comparisons made on the way down to depth {d}
+    int height = 1, depth = 0, *slots;
+    Py_ssize_t *level_counts, *fill_counts, runs = 0, k;
+    long long *costs;
+    double comparisons = 0, leaf_cost;
+    char *mem;
+
+    for (node = tree->root; node->children != NULL; node = ((BPlusNode **)node->children->arr)[0]) {
+        height++;
+    }
+
+    // a single block for the stack and the counters
+    mem = (char *)PyMem_Calloc(
+        1,
+        (sizeof(BPlusNode *) + sizeof(int) + sizeof(Py_ssize_t) + sizeof(long long)) * height
+            + sizeof(Py_ssize_t) * (tree->b + 1)
+    );
+    if (mem == NULL) {
+        return PyErr_NoMemory();
+    }
+    level_counts = (Py_ssize_t *)mem;
+    fill_counts = level_counts + height;
+    costs = (long long *)(fill_counts + tree->b + 1);
+    nodes = (BPlusNode **)(costs + height);
+    slots = (int *)(nodes + height);
+
+    node = tree->root;
+    while (1) {
+
+        level_counts[depth]++;
+
+        if (node->children != NULL) {
+            // descend into the first child of the branch
+            nodes[depth] = node;
+            slots[depth] = 0;
+            costs[depth+1] = costs[depth] + BPlusNode_search_cost(node);
+            depth++;
+            node = ((BPlusNode **)node->children->arr)[0];
+            continue;
+        }
+
+        fill_counts[node->values->size]++;
+        // the hash comparisons down to and in the leaf, plus 1 to check the
+        // hash found and 1 to compare the element with the one looked for
+        leaf_cost = (double)(costs[depth] + BPlusNode_search_cost(node) + 2);
+        for (int ix = 0; ix < node->values->size; ix++) {
+            value = ((PyObject **)node->values->arr)[ix];
+            if (value != NULL && PyList_Check(value)) {
+                // the {k} elements of a collision run are compared with the
+                // list and then with each of them in turn
+                runs++;
+                k = PyList_GET_SIZE(value);
+                comparisons += k * leaf_cost + (double)k * (k + 1) / 2;
+            } else {
+                comparisons += leaf_cost;
+            }
+        }
+
+        // climb back up to the nearest branch with a child left to walk
+        while (--depth >= 0 && ++slots[depth] == nodes[depth]->children->size);
+        if (depth < 0) {
+            break;
+        }
+        node = ((BPlusNode **)nodes[depth]->children->arr)[slots[depth]];
+        depth++;
+
+    }
+
+    if ((per_level = PyList_New(height)) == NULL || (fill = PyList_New(tree->b + 1)) == NULL) {
+        goto error;
+    }
+    for (int ix = 0; ix < height; ix++) {
+        if ((value = PyLong_FromSsize_t(level_counts[ix])) == NULL) {
+            goto error;
+        }
+        PyList_SET_ITEM(per_level, ix, value);
+    }
+    for (int ix = 0; ix <= tree->b; ix++) {
+        if ((value = PyLong_FromSsize_t(fill_counts[ix])) == NULL) {
+            goto error;
+        }
+        PyList_SET_ITEM(fill, ix, value);
+    }
+
+    PyMem_Free(mem);
+
+    return Py_BuildValue(
+        "{s:i,s:N,s:N,s:n,s:n,s:K,s:d}",
+        "height", height,
+        "nodes_per_level", per_level,
+        "fill_histogram", fill,
+        "collision_runs", runs,
+        "nbytes", (Py_ssize_t)BPlusTree_nbytes(tree),
+        "splits", tree->splits,
+        "avg_comparisons", tree->size == 0 ? 0.0 : comparisons / tree->size
+    );
+
+    error:
+    Py_XDECREF(per_level);
+    Py_XDECREF(fill);
+    PyMem_Free(mem);
+    return NULL;
+
+}
+
+// BEGIN BPlusSet method definitions
+// parses the arguments of BPlusSet(iterable=None, /, *, b=16, compress=False,
+// unboxed=False, capacity=0): like set(), at most one positional argument.
+// This is called when a subclass of BPlusSet is constructed, or when
+// BPlusSet.__init__() is called directly; BPlusSet() itself goes through
+// BPlusSet_tp_vectorcall().
+static int BPlusSet_tp_init(BPlusTree *self, PyObject *args, PyObject *kwargs) {
+
+    int b = 16, compress = 0, unboxed = 0;
+    Py_ssize_t capacity = 0;
+    PyObject *initializer = Py_None;
+    static char *kwlist[] = {"", "b", "compress", "unboxed", "capacity", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O$ippn:BPlusSet", kwlist, &initializer, &b, &compress, &unboxed, &capacity)) {
+        return -1;
+    }
+
+    return BPlusTree_init(self, initializer, b, compress, unboxed, capacity);
+
+}
+
+// constructs a BPlusSet straight from the vectorcall arguments, without
+// packing them into a tuple and dict for tp_new and tp_init.
+static PyObject *BPlusSet_tp_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames) {
+
+    Py_ssize_t nargs = PyVectorcall_NARGS(nargsf), nkwargs = kwnames == NULL ? 0 : PyTuple_GET_SIZE(kwnames);
+    PyObject *initializer = nargs == 1 ? args[0] : Py_None, *name, *value;
+    BPlusTree *self;
+    int b = 16, compress = 0, unboxed = 0, overflow;
+    Py_ssize_t capacity = 0;
+    long x;
+
+    if (nargs > 1) {
+        PyErr_Format(PyExc_TypeError, "BPlusSet expected at most 1 argument, got %zd", nargs);
+        return NULL;
+    }
+
+    for (Py_ssize_t ix = 0; ix < nkwargs; ix++) {
+        name = PyTuple_GET_ITEM(kwnames, ix);
+        value = args[nargs + ix];
+        if (PyUnicode_CompareWithASCIIString(name, "b") == 0) {
+            if (!PyLong_Check(value)) {
+                PyErr_Format(PyExc_TypeError, "BPlusSet() argument 'b' must be int, not %.200s", Py_TYPE(value)->tp_name);
+                return NULL;
+            }
+            x = PyLong_AsLongAndOverflow(value, &overflow);
+            if (x == -1 && PyErr_Occurred()) {
+                return NULL;
+            }
+            // anything out of the range of an int is out of bounds for {b}
+            b = overflow || x < INT_MIN || INT_MAX < x ? 0 : (int)x;
+        } else if (PyUnicode_CompareWithASCIIString(name, "compress") == 0) {
+            if ((compress = PyObject_IsTrue(value)) == -1) {
+                return NULL;
+            }
+        } else if (PyUnicode_CompareWithASCIIString(name, "unboxed") == 0) {
+            if ((unboxed = PyObject_IsTrue(value)) == -1) {
+                return NULL;
+            }
+        } else if (PyUnicode_CompareWithASCIIString(name, "capacity") == 0) {
+            if ((capacity = PyNumber_AsSsize_t(value, PyExc_OverflowError)) == -1 && PyErr_Occurred()) {
+                return NULL;
+            }
+        } else {
+            PyErr_Format(PyExc_TypeError, "BPlusSet() got an unexpected keyword argument '%U'", name);
+            return NULL;
+        }
+    }
+
+    if ((self = (BPlusTree *)((PyTypeObject *)type)->tp_alloc((PyTypeObject *)type, 0)) == NULL) {
+        return NULL;
+    }
+
+    if (BPlusTree_init(self, initializer, b, compress, unboxed, capacity) == -1) {
+        Py_DECREF(self);
+        return NULL;
+    }
+
+    return (PyObject *)self;
+
+}
+
+// returns the snapshot at {path} opened as a BPlusSnapshot, the Python class
+// that documents the mapped C type.
+static PyObject *BPlusSet_method_open(PyObject *cls, PyObject *path) {
+
+    PyObject *module, *snapshot_type, *snapshot;
+
+    if ((module = PyImport_ImportModule("five_one_one_bplus.b_plus_snapshot")) == NULL) {
+        return NULL;
+    }
+    snapshot_type = PyObject_GetAttrString(module, "BPlusSnapshot");
+    Py_DECREF(module);
+    if (snapshot_type == NULL) {
+        return NULL;
+    }
+
+    snapshot = PyObject_CallOneArg(snapshot_type, path);
+    Py_DECREF(snapshot_type);
+
+    return snapshot;
+
+}
+
+
+// BEGIN helper function definitions
+
+// helper function for splitting a saturated leaf into 2 leaves
+// expects that {leaf} has {self->b}+1 values
+// Stores the two halves in {*left} and {*right}, links them into the leaf
+// chain, frees {leaf}, and stores the index separating the halves in
+// {*new_parent_ix}; linking them into the parent of {leaf} is left to the
+// caller (see BPlusTree_split()).
+// Returns 0 on success, or -1 with a MemoryError set, in which case {leaf} is
+// untouched.
+int BPlusLeaf_split(BPlusTree *self, BPlusNode *leaf, BPlusNode **left, BPlusNode **right, l64 *new_parent_ix) {
+
+    int isize = leaf->indices->size, imid = leaf->values->size / 2;
+    // decoded copy of {leaf->indices}; a leaf never holds more than 256
+    l64 keys[256];
+
+    BPlusLeaf_get_keys(leaf, keys);
+
+    // initialize our 2 new leaves, re-encoding each half on its own
+    if ((*left = BPlusTree_leaf_for(self, keys, imid)) == NULL) {
+        return -1;
+    }
+    if ((*right = BPlusTree_leaf_for(self, keys+imid, isize - imid)) == NULL) {
+        BPlusNode_free(&self->heap, *left);
+        return -1;
+    }
+
+    *new_parent_ix = BPlusLeaf_split_at(&self->heap, leaf, *left, *right);
+
+    return 0;
+
+}
+
+// helper function for splitting a saturated {leaf} and then, walking back up
+// {path}, every ancestor that overflows as a result.
+// {path} is the root-to-leaf path recorded by BPlusNode_search() when {leaf}
+// was found.
+// Every node the split needs is taken before anything is changed, so if that
+// runs out of memory, -1 is returned with a MemoryError set and the tree is
+// left as it was, with {leaf} holding one more than {tree->b} elements (see
+// BPlusTree_insert()). Returns 0 on success.
+int BPlusTree_split(BPlusTree *tree, BPlusNode *leaf, BPlusPath *path) {
+
+    BPlusNode *left, *right, *spares;
+    l64 new_parent_ix;
+    int nsplits;
+
+    if (BPlusBranch_init_spares(&tree->heap, tree->b, path, 0, &spares) == -1) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    if (BPlusLeaf_split(tree, leaf, &left, &right, &new_parent_ix) == -1) {
+        BPlusBranch_free_spares(&tree->heap, spares);
+        return -1;
+    }
+
+    nsplits = BPlusNode_split_up(&tree->heap, &tree->root, tree->b, path, spares, left, right, new_parent_ix);
+
+    tree->splits += 1 + nsplits;
+    BPLUS_TRACE(tree, split, BPLUS_EVENT_SPLIT, new_parent_ix, nsplits);
+    if (nsplits == path->depth) {
+        // every branch on {path} was split, so the root was too, and the new
+        // one has just the 2 halves
+        BPLUS_TRACE(tree, grow, BPLUS_EVENT_GROW, ((l64 *)tree->root->indices->arr)[0], path->depth + 2);
+    }
+
+    return 0;
+
+}
+
+// helper for BPlusTree.stats(): returns the number of hash comparisons made to
+// find a hash in {node}, which is at most the bit length of the number of
+// hashes for the binary search over a branch or an unpacked leaf, and every
+// offset of a packed leaf (see count_less_packed() in array32.c).
+int BPlusNode_search_cost(BPlusNode *node) {
+
+    int n = node->indices->size, cost = 0;
+
+    if (node->width != sizeof(l64)) {
+        return n;
+    }
+
+    for (; n > 0; n >>= 1) {
+        cost++;
+    }
+
+    return cost;
+
+}
+
+// helper function for allocating a leaf of {tree} to hold the {n} sorted
+// {keys}; the keys are stored in the leaf, its values are left empty.
+// In a compressed tree, the keys are packed as tightly as their range allows.
+// Returns NULL with a MemoryError set if out of memory.
+BPlusNode *BPlusTree_leaf_for(BPlusTree *tree, l64 *keys, int n) {
+
+    BPlusNode *leaf;
+    int width = sizeof(l64);
+
+    if (tree->compress && n > 0) {
+        width = BPlusLeaf_width_for(keys[0], keys[n-1]);
+    }
+
+    if (width == sizeof(l64)) {
+        leaf = BPlusLeaf_init(&tree->heap, tree->b);
+    } else {
+        leaf = BPlusLeaf_init_packed(&tree->heap, tree->b, keys[0], width);
+    }
+
+    if (leaf == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    BPlusLeaf_set_keys(leaf, keys, n, width == sizeof(l64) ? 0 : keys[0]);
+
+    return leaf;
+
+}
+
+// helper function for re-encoding a packed {leaf} so that it can hold {key}.
+// If the wider range still fits the leaf's width, the offsets are rewritten in
+// place; otherwise {leaf} is replaced in the tree by a wider copy and freed.
+// {path} is the root-to-leaf path recorded when {leaf} was found.
+// Returns the leaf that {key} should now be inserted into, or NULL with a
+// MemoryError set if out of memory, in which case {leaf} is untouched.
+BPlusNode *BPlusLeaf_repack(BPlusTree *tree, BPlusNode *leaf, l64 key, BPlusPath *path) {
+
+    BPlusNode *wider, *parent;
+    l64 keys[256], lo = key, hi = key;
+    int n = leaf->indices->size;
+
+    BPlusLeaf_get_keys(leaf, keys);
+    if (n > 0) {
+        lo = keys[0] < key ? keys[0] : key;
+        hi = keys[n-1] > key ? keys[n-1] : key;
+    }
+
+    if (BPlusLeaf_width_for(lo, hi) <= leaf->width) {
+        BPlusLeaf_set_keys(leaf, keys, n, lo);
+        return leaf;
+    }
+
+    if (BPlusLeaf_width_for(lo, hi) == sizeof(l64)) {
+        wider = BPlusLeaf_init(&tree->heap, tree->b);
+    } else {
+        wider = BPlusLeaf_init_packed(&tree->heap, tree->b, lo, BPlusLeaf_width_for(lo, hi));
+    }
+    if (wider == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    BPlusLeaf_set_keys(wider, keys, n, lo);
+    place_array(wider->values, n, sizeof(PyObject *));
+    memcpy(wider->values->arr, leaf->values->arr, sizeof(PyObject *) * n);
+
+    // take {leaf}'s place in the leaf chain and in its parent
+    wider->prev = leaf->prev;
+    wider->next = leaf->next;
+    if (leaf->prev != NULL) {
+        leaf->prev->next = wider;
+    }
+    if (leaf->next != NULL) {
+        leaf->next->prev = wider;
+    }
+    if (path->depth == 0) {
+        tree->root = wider;
+    } else {
+        parent = path->nodes[path->depth - 1];
+        ((BPlusNode **)parent->children->arr)[path->slots[path->depth - 1]] = wider;
+    }
+
+    BPlusNode_free(&tree->heap, leaf);
+    tree->version++;
+
+    return wider;
+
+}
+
+// helper function for setting aside enough nodes in {tree->heap} for {tree}
+// to grow to {n} elements, so that inserting them takes and frees no node
+// memory: as many as BPlusNode_count_for() says a tree of {n} elements can
+// need, less those already in the tree. Only full-width nodes are set aside,
+// so a compressed tree still allocates its packed leaves.
+// Returns 0 on success, or -1 with a MemoryError set.
+int BPlusTree_reserve(BPlusTree *tree, Py_ssize_t n) {
+
+    size_t have, want;
+
+    if (n <= tree->size) {
+        return 0;
+    }
+
+    have = BPlusNode_count_heap(tree->root);
+    want = BPlusNode_count_for(tree->b, (size_t)n);
+    if (want <= have) {
+        return 0;
+    }
+
+    if (BPlusHeap_reserve(&tree->heap, BPlusNode_nbytes(tree->b, sizeof(l64)), want - have) == -1) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    return 0;
+
+}
+
+// adds the elements of the iterable {initializer} to {tree} one at a time.
+// Returns 0 on success, or -1 with an error set.
+int BPlusTree_extend_iterable(BPlusTree *tree, PyObject *initializer) {
+
+    PyObject
+        *iterable = PyObject_GetIter(initializer),
+        *current_object,
+        *insert_result;
+    l64 hash;
+
+    if (iterable == NULL) {
+        return -1;
+    }
+
+    // we're done with our initializer
+    // again, no need to decref because ref count is not increased by call to
+    // constructor
+
+    while ((current_object = PyIter_Next(iterable)) != NULL) {
+        
+        // calculate hash
+        if ((hash = PyObject_Hash(current_object)) == -1) {
+
+            Py_DECREF(current_object);
+            Py_DECREF(iterable);
+
+            return -1;
+
+        }
+
+        // call tree.insert(hash(o), o)
+        if ((insert_result = BPlusTree_insert(tree, hash, current_object)) == NULL) {
+
+            Py_DECREF(current_object);
+            Py_DECREF(iterable);
+
+            return -1;
+
+        }
+
+        Py_DECREF(insert_result);
+
+        // the tree holds its own reference to {current_object}
+        Py_DECREF(current_object);
+
+    }
+
+    if (PyErr_Occurred()) {
+        // the iterator raised something other than StopIteration
+        Py_DECREF(iterable);
+        return -1;
+    }
+
+    Py_DECREF(iterable);
+
+    return 0;
+
+}
+
+// helper function for inserting every item of {seq}, an exact list or tuple,
+// into the empty {tree}.
+// Every item is hashed first (which needs the GIL), then the (hash, item)
+// pairs are sorted without it and laid out in one go by
+// BPlusTree_load_sorted(), rather than inserted one at a time.
+// Returns 0 on success, -1 on error.
+int BPlusTree_extend_sequence(BPlusTree *tree, PyObject *seq) {
+
+    BPlusPair *pairs, *grown;
+    PyObject *o;
+    Py_ssize_t n = 0, capacity = PySequence_Fast_GET_SIZE(seq) + 1;
+    l64 hash;
+
+    if (tree->unboxed) {
+        return BPlusTree_extend_sequence_unboxed(tree, seq);
+    }
+
+    if ((pairs = (BPlusPair *)malloc(sizeof(BPlusPair) * capacity)) == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    // the size is re-read every time because hashing can run arbitrary code
+    for (Py_ssize_t ix = 0; ix < PySequence_Fast_GET_SIZE(seq); ix++) {
+
+        o = PySequence_Fast_GET_ITEM(seq, ix);
+        Py_INCREF(o);
+
+        if ((hash = PyObject_Hash(o)) == -1) {
+            Py_DECREF(o);
+            goto error;
+        }
+
+        if (n == capacity) {
+            if ((grown = (BPlusPair *)realloc(pairs, sizeof(BPlusPair) * capacity * 2)) == NULL) {
+                Py_DECREF(o);
+                PyErr_NoMemory();
+                goto error;
+            }
+            pairs = grown;
+            capacity *= 2;
+        }
+
+        pairs[n].key = hash;
+        pairs[n].value = o;
+        n++;
+
+    }
+
+    if (BPlusPair_sort(pairs, n) == -1) {
+        goto error;
+    }
+
+    if (BPlusPair_dedupe(pairs, &n) == -1 || BPlusTree_load_sorted(tree, pairs, n) == -1) {
+        // the references have already been released
+        free(pairs);
+        return -1;
+    }
+
+    free(pairs);
+
+    return 0;
+
+error:
+    for (Py_ssize_t jx = 0; jx < n; jx++) {
+        Py_DECREF(pairs[jx].value);
+    }
+    free(pairs);
+    return -1;
+
+}
+
+// helper function for inserting every item of {seq}, an exact list or tuple,
+// into the empty unboxed {tree}.
+// Like BPlusTree_extend_sequence(), but only the integers themselves are
+// kept, so they are sorted and deduplicated without any objects at all.
+// Returns 0 on success, -1 on error.
+int BPlusTree_extend_sequence_unboxed(BPlusTree *tree, PyObject *seq) {
+
+    l64 *keys, *scratch, key;
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq), m = 0;
+    int res;
+
+    keys = (l64 *)malloc(sizeof(l64) * (n+1));
+    scratch = (l64 *)malloc(sizeof(l64) * (n+1));
+    if (keys == NULL || scratch == NULL) {
+        free(keys);
+        free(scratch);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    // no arbitrary code runs here, so the size of {seq} cannot change
+    for (Py_ssize_t ix = 0; ix < n; ix++) {
+        if ((key = BPlusTree_unbox(PySequence_Fast_GET_ITEM(seq, ix))) == -1) {
+            free(keys);
+            free(scratch);
+            return -1;
+        }
+        keys[ix] = key;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+
+    BPlusPool_sort(keys, scratch, n, sizeof(l64));
+    for (Py_ssize_t ix = 0; ix < n; ix++) {
+        if (m == 0 || keys[ix] != keys[m-1]) {
+            keys[m++] = keys[ix];
+        }
+    }
+
+    Py_END_ALLOW_THREADS
+
+    res = BPlusTree_load_keys(tree, keys, m);
+
+    free(keys);
+    free(scratch);
+
+    return res;
+
+}
+
+// helper function for dropping repeated objects from the {n} {pairs}, which
+// are sorted by hash. Only pairs with equal hashes are compared, and of equal
+// objects the first is kept (as with repeated calls to BPlusTree_insert()).
+// The references held by dropped pairs are released, and {n} is updated to
+// the number of pairs kept.
+// Returns 0 on success, or -1 with an error set if a comparison raised, in
+// which case every reference held by {pairs} has been released.
+int BPlusPair_dedupe(BPlusPair *pairs, Py_ssize_t *n) {
+
+    Py_ssize_t ix = 0, jx, kx, lx, kept = 0, run;
+    int duplicate;
+
+    while (ix < *n) {
+
+        for (jx = ix+1; jx < *n && pairs[jx].key == pairs[ix].key; jx++);
+
+        // the objects kept so far from this run start at {run}
+        run = kept;
+        for (kx = ix; kx < jx; kx++) {
+            duplicate = 0;
+            for (lx = run; lx < kept && !duplicate; lx++) {
+                if ((duplicate = PyObject_RichCompareBool(pairs[kx].value, pairs[lx].value, Py_EQ)) == -1) {
+                    goto error;
+                }
+            }
+            if (duplicate) {
+                Py_DECREF(pairs[kx].value);
+            } else {
+                pairs[kept++] = pairs[kx];
+            }
+        }
+
+        ix = jx;
+
+    }
+
+    *n = kept;
+
+    return 0;
+
+error:
+    for (lx = 0; lx < kept; lx++) {
+        Py_DECREF(pairs[lx].value);
+    }
+    for (; kx < *n; kx++) {
+        Py_DECREF(pairs[kx].value);
+    }
+    return -1;
+
+}
+
+// helper function for sorting the {n} {pairs} by hash.
+// The sort itself runs without the GIL, on the worker pool for large inputs
+// (see BPlusPool_sort() in bpluspool.c).
+// Returns 0 on success, or -1 with a MemoryError set, in which case {pairs}
+// is left as it was.
+int BPlusPair_sort(BPlusPair *pairs, Py_ssize_t n) {
+
+    BPlusPair *scratch;
+
+    if ((scratch = (BPlusPair *)malloc(sizeof(BPlusPair) * (n+1))) == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    BPlusPool_sort(pairs, scratch, n, sizeof(BPlusPair));
+    Py_END_ALLOW_THREADS
+
+    free(scratch);
+
+    return 0;
+
+}
+
+// helper function for inserting the elements of {initializer} into the empty
+// {tree} using the hashes that {initializer} already stores, rather than
+// hashing every element again.
+// {initializer} must be an exact set, frozenset or dict (when
+// BPLUS_STORED_HASHES), or a BPlusTree.
+// Returns 0 on success, -1 on error.
+int BPlusTree_extend_hashed(BPlusTree *tree, PyObject *initializer) {
+
+    BPlusPair *pairs;
+    Py_ssize_t n = 0, capacity;
+    int sorted = 0;
+
+    if (PyObject_TypeCheck(initializer, &BPlusTreeType)) {
+        capacity = ((BPlusTree *)initializer)->size;
+    } else {
+        capacity = PyObject_Length(initializer);
+    }
+
+    if ((pairs = (BPlusPair *)malloc(sizeof(BPlusPair) * (capacity+1))) == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    if (PyObject_TypeCheck(initializer, &BPlusTreeType)) {
+
+        // copy the leaf chain, which is already in sorted order
+        BPlusNode *leaf = ((BPlusTree *)initializer)->root;
+        PyObject *value;
+        l64 key;
+
+        while (leaf->children != NULL) leaf = ((BPlusNode **)leaf->children->arr)[0];
+
+        for (; leaf != NULL; leaf = leaf->next) {
+            for (int ix = 0; ix < leaf->values->size; ix++) {
+                key = BPlusLeaf_key(leaf, ix);
+                value = ((PyObject **)leaf->values->arr)[ix];
+                if (value == NULL) {
+                    // an element of an unboxed tree, box it
+                    if ((pairs[n].value = PyLong_FromLongLong(key)) == NULL) {
+                        for (Py_ssize_t jx = 0; jx < n; jx++) {
+                            Py_DECREF(pairs[jx].value);
+                        }
+                        free(pairs);
+                        return -1;
+                    }
+                    pairs[n].key = key;
+                    n++;
+                } else if (PyList_CheckExact(value)) {
+                    // a collision list, unpack it
+                    for (Py_ssize_t jx = 0; jx < PyList_GET_SIZE(value); jx++) {
+                        pairs[n].key = key;
+                        pairs[n].value = PyList_GET_ITEM(value, jx);
+                        Py_INCREF(pairs[n].value);
+                        n++;
+                    }
+                } else {
+                    pairs[n].key = key;
+                    pairs[n].value = value;
+                    Py_INCREF(value);
+                    n++;
+                }
+            }
+        }
+
+        sorted = 1;
+
+    }
+    #if BPLUS_STORED_HASHES
+    else if (PyAnySet_CheckExact(initializer)) {
+
+        Py_ssize_t pos = 0;
+        PyObject *key;
+        Py_hash_t hash;
+
+        while (_PySet_NextEntry(initializer, &pos, &key, &hash)) {
+            pairs[n].key = hash;
+            pairs[n].value = key;
+            Py_INCREF(key);
+            n++;
+        }
+
+    } else {
+
+        Py_ssize_t pos = 0;
+        PyObject *key, *value;
+        Py_hash_t hash;
+
+        while (_PyDict_Next(initializer, &pos, &key, &value, &hash)) {
+            pairs[n].key = hash;
+            pairs[n].value = key;
+            Py_INCREF(key);
+            n++;
+        }
+
+    }
+    #endif
+
+    if (!sorted && BPlusPair_sort(pairs, n) == -1) {
+        for (Py_ssize_t jx = 0; jx < n; jx++) {
+            Py_DECREF(pairs[jx].value);
+        }
+        free(pairs);
+        return -1;
+    }
+
+    if (BPlusTree_load_sorted(tree, pairs, n) == -1) {
+        free(pairs);
+        return -1;
+    }
+
+    free(pairs);
+
+    return 0;
+
+}
+
+// helper function for loading the {n} {pairs}, sorted by hash and containing
+// no two equal objects, into the empty {tree}.
+// The references held by {pairs} are handed over to the tree (or released on
+// error); the array itself is left to the caller.
+// Small inputs are inserted one at a time so that they stay in the inline
+// root leaf; anything larger is bulk built with BPlusTree_build().
+// Returns 0 on success, -1 on error.
+int BPlusTree_load_sorted(BPlusTree *tree, BPlusPair *pairs, Py_ssize_t n) {
+
+    PyObject *insert_result, **values = NULL, *collision_container;
+    l64 *keys = NULL;
+    Py_ssize_t ix = 0, jx, m = 0;
+    int collisions = 0;
+
+    if (n <= BPLUS_INLINE_SLOTS) {
+        for (; ix < n; ix++) {
+            if ((insert_result = BPlusTree_insert(tree, pairs[ix].key, pairs[ix].value)) == NULL) {
+                for (; ix < n; ix++) {
+                    Py_DECREF(pairs[ix].value);
+                }
+                return -1;
+            }
+            Py_DECREF(insert_result);
+            Py_DECREF(pairs[ix].value);
+        }
+        return 0;
+    }
+
+    // sizes and node slots are {int}s
+    if (n > INT_MAX) {
+        Py_INCREF(PyExc_OverflowError);
+        PyErr_SetString(PyExc_OverflowError, "BPlusTree cannot hold more than INT_MAX elements.");
+        goto error;
+    }
+
+    keys = (l64 *)malloc(sizeof(l64) * n);
+    values = (PyObject **)malloc(sizeof(PyObject *) * n);
+    if (keys == NULL || values == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+
+    // collapse each run of equal hashes into one slot, using a sorted
+    // collision list for runs of more than one object (see
+    // BPlusLeaf_insert())
+    while (ix < n) {
+
+        for (jx = ix+1; jx < n && pairs[jx].key == pairs[ix].key; jx++);
+
+        if (jx - ix == 1) {
+            values[m] = pairs[ix].value;
+        } else {
+            if ((collision_container = PyList_New(jx - ix)) == NULL) {
+                goto error;
+            }
+            for (Py_ssize_t kx = ix; kx < jx; kx++) {
+                PyList_SET_ITEM(collision_container, kx - ix, pairs[kx].value);
+            }
+            if (PyList_Sort(collision_container) == -1) {
+                Py_DECREF(collision_container);
+                ix = jx;
+                goto error;
+            }
+            values[m] = collision_container;
+            collisions++;
+        }
+
+        keys[m] = pairs[ix].key;
+        m++;
+        ix = jx;
+
+    }
+
+    if (BPlusTree_build(tree, keys, values, (int)m, 1.0) == -1) {
+        goto error;
+    }
+
+    // only count the collision lists once the tree holds them
+    tree->size = (int)n;
+    tree->collisions += collisions;
+
+    free(keys);
+    free(values);
+
+    return 0;
+
+error:
+    // release whatever has not been handed over to the tree
+    for (jx = 0; jx < m; jx++) {
+        Py_DECREF(values[jx]);
+    }
+    for (; ix < n; ix++) {
+        Py_DECREF(pairs[ix].value);
+    }
+    free(keys);
+    free(values);
+    return -1;
+
+}
+
+// helper function for loading the {n} distinct {keys}, in ascending order,
+// into the empty unboxed {tree}.
+// Like BPlusTree_load_sorted(), small inputs stay in the inline root leaf and
+// anything larger is bulk built.
+// Returns 0 on success, -1 on error.
+int BPlusTree_load_keys(BPlusTree *tree, l64 *keys, Py_ssize_t n) {
+
+    PyObject *insert_result;
+
+    if (n <= BPLUS_INLINE_SLOTS) {
+        for (Py_ssize_t ix = 0; ix < n; ix++) {
+            if ((insert_result = BPlusTree_insert(tree, keys[ix], NULL)) == NULL) {
+                return -1;
+            }
+            Py_DECREF(insert_result);
+        }
+        return 0;
+    }
+
+    if (n > INT_MAX) {
+        Py_INCREF(PyExc_OverflowError);
+        PyErr_SetString(PyExc_OverflowError, "BPlusTree cannot hold more than INT_MAX elements.");
+        return -1;
+    }
+
+    if (BPlusTree_build(tree, keys, NULL, (int)n, 1.0) == -1) {
+        return -1;
+    }
+
+    tree->size = (int)n;
+
+    return 0;
+
+}
+
+// helper function for copying the unboxed tree {other} into the empty unboxed
+// {tree}. The hashes of {other} are its elements, so no objects are involved.
+// Returns 0 on success, -1 on error.
+int BPlusTree_extend_unboxed(BPlusTree *tree, BPlusTree *other) {
+
+    BPlusNode *leaf = other->root;
+    l64 *keys;
+    Py_ssize_t n = 0;
+    int res;
+
+    if ((keys = (l64 *)malloc(sizeof(l64) * (other->size + 1))) == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    while (leaf->children != NULL) leaf = ((BPlusNode **)leaf->children->arr)[0];
+    for (; leaf != NULL; leaf = leaf->next) {
+        BPlusLeaf_get_keys(leaf, keys + n);
+        n += leaf->values->size;
+    }
+
+    res = BPlusTree_load_keys(tree, keys, n);
+
+    free(keys);
+
+    return res;
+
+}
+
+// helper function for checking that {o} may be stored in an unboxed tree:
+// it must be an int whose hash is itself, which holds for every int strictly
+// between -{_PyHASH_MODULUS} and {_PyHASH_MODULUS} other than -1.
+// Returns {o} as an {l64}, or -1 with an error set.
+l64 BPlusTree_unbox(PyObject *o) {
+
+    int overflow;
+    l64 x;
+
+    if (!PyLong_Check(o)) {
+        Py_INCREF(PyExc_TypeError);
+        PyErr_SetString(PyExc_TypeError, "An unboxed BPlusTree can only hold ints.");
+        return -1;
+    }
+
+    x = PyLong_AsLongLongAndOverflow(o, &overflow);
+    if (overflow || x == -1 || x <= -(l64)_PyHASH_MODULUS || (l64)_PyHASH_MODULUS <= x) {
+        if (!PyErr_Occurred()) {
+            Py_INCREF(PyExc_ValueError);
+            PyErr_SetString(PyExc_ValueError, "An unboxed BPlusTree can only hold ints whose hash is the int itself.");
+        }
+        return -1;
+    }
+
+    return x;
+
+}
+
+// returns hash({x}) for the int {x} without creating it, following
+// long_hash() in CPython's Objects/longobject.c.
+l64 BPlusTree_hash_l64(l64 x) {
+
+    unsigned long long magnitude = x < 0 ? 0ULL - (unsigned long long)x : (unsigned long long)x;
+    l64 hash = (l64)(magnitude % _PyHASH_MODULUS);
+
+    if (x < 0) {
+        hash = -hash;
+    }
+
+    return hash == -1 ? -2 : hash;
+
+}
+
+// helper function for checking that {tree} may be changed: it must not be in
+// the middle of being rebuilt (see BPlusTree_build()), read by a batch
+// lookup (see BPlusTree_method_contains_many()) on another thread, or walked
+// through the C API (see BPlusCAPI_visit()).
+// Returns 0 if it may, or -1 with a RuntimeError set.
+int BPlusTree_check_writable(BPlusTree *tree) {
+
+    if (tree->busy) {
+        Py_INCREF(PyExc_RuntimeError);
+        PyErr_SetString(PyExc_RuntimeError, "BPlusTree is being rebuilt by another thread.");
+        return -1;
+    }
+
+    if (tree->readers > 0) {
+        Py_INCREF(PyExc_RuntimeError);
+        PyErr_SetString(PyExc_RuntimeError, "BPlusTree is being read by another thread or a C API walk.");
+        return -1;
+    }
+
+    return 0;
+
+}
+
+// helper function for checking that {view} holds signed 64 bit integers in
+// the byte order of this machine: a format of 'q' or 'l', bare or after '@',
+// '=' or an explicit byte order that happens to be native.
+// Returns 1 if it does, or 0 if not.
+int BPlusTree_int64_buffer(Py_buffer *view) {
+
+    const char *format = view->format == NULL ? "B" : view->format;
+
+    if (*format == '@' || *format == '=' || *format == (PY_LITTLE_ENDIAN ? '<' : '>') || (!PY_LITTLE_ENDIAN && *format == '!')) {
+        format++;
+    }
+
+    return view->itemsize == sizeof(l64) && (format[0] == 'q' || format[0] == 'l') && format[1] == '\0';
+
+}
+
+// helper function for moving the full inline root {leaf} of a small tree out
+// of the tree object and into a heap leaf with room for {tree->b} elements.
+// Returns the new root leaf, or NULL with a MemoryError set if out of
+// memory, in which case the inline root is left as it was.
+BPlusNode *BPlusLeaf_promote(BPlusTree *tree, BPlusNode *leaf) {
+
+    BPlusNode *root = BPlusLeaf_init(&tree->heap, tree->b);
+    int n = leaf->values->size;
+
+    if (root == NULL) {
+        // {leaf} still holds everything
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    place_array(root->indices, n, sizeof(l64));
+    memcpy(root->indices->arr, leaf->indices->arr, sizeof(l64) * n);
+    place_array(root->values, n, sizeof(PyObject *));
+    memcpy(root->values->arr, leaf->values->arr, sizeof(PyObject *) * n);
+
+    // the values now belong to {root}
+    leaf->indices->size = 0;
+    leaf->values->size = 0;
+    tree->root = root;
+    tree->version++;
+
+    return root;
+
+}
+
+PyObject *BPlusTree_insert(BPlusTree *tree, l64 key, PyObject *o) {
+
+    BPlusNode *leaf = NULL;
+    BPlusPath path;
+    int res;
+
+    if (BPlusTree_check_writable(tree) == -1) {
+        return NULL;
+    }
+
+    // the elements of an unboxed tree are not stored, only their hashes
+    if (tree->unboxed && o != NULL) {
+        if ((key = BPlusTree_unbox(o)) == -1) {
+            return NULL;
+        }
+        o = NULL;
+    }
+
+    BPlusPath_init(&path);
+
+    if ((leaf = BPlusNode_search(tree->root, key, &path)) == NULL) {
+        return PyErr_NoMemory();
+    }
+
+    // a leaf is left holding one more than {tree->b} elements when splitting
+    // it runs out of memory; split it before adding to it
+    if (leaf->values->size > tree->b) {
+        if (BPlusTree_split(tree, leaf, &path) == -1) {
+            BPlusPath_free(&path);
+            return NULL;
+        }
+        BPlusPath_free(&path);
+        BPlusPath_init(&path);
+        if ((leaf = BPlusNode_search(tree->root, key, &path)) == NULL) {
+            return PyErr_NoMemory();
+        }
+    }
+
+    // only the inline root leaf can be full before an insert; every other
+    // leaf is split as soon as it goes over {tree->b}
+    if (leaf->values->size == leaf->values->capacity) {
+        if ((leaf = BPlusLeaf_promote(tree, leaf)) == NULL) {
+            BPlusPath_free(&path);
+            return NULL;
+        }
+    }
+
+    if (!BPlusLeaf_fits(leaf, key)) {
+        if ((leaf = BPlusLeaf_repack(tree, leaf, key, &path)) == NULL) {
+            BPlusPath_free(&path);
+            return NULL;
+        }
+    }
+
+    res = BPlusLeaf_insert(leaf, key, o);
+
+    if (res == -1) {
+        // an error occurred in the insert operation
+        // an error should already be set
+        BPlusPath_free(&path);
+        return NULL;
+    } else if (res == 0) {
+        // {o} was already in the list, do nothing
+        BPlusPath_free(&path);
+        Py_RETURN_NONE;
+    }
+
+    if (res >= 2) {
+        BPLUS_TRACE(tree, collision, BPLUS_EVENT_COLLISION, key, res == 2);
+        if (res == 2) {
+            tree->collisions++;
+        }
+    }
+    BPLUS_TRACE(tree, insert, BPLUS_EVENT_INSERT, key, path.depth);
+
+    tree->size++;
+    tree->version++;
+
+    // {o} stays in the tree even if the split fails
+    if (leaf->values->size > tree->b && BPlusTree_split(tree, leaf, &path) == -1) {
+        BPlusPath_free(&path);
+        return NULL;
+    }
+
+    BPlusPath_free(&path);
+
+    Py_RETURN_NONE;
+
+}
+
+// returns 1 if {o}, whose hash is {key}, is in {tree}, 0 if not, or -1 with
+// an error set.
+// A {key} of -1 with an error set means hashing {o} failed, and is passed on.
+int BPlusTree_contains(BPlusTree *tree, l64 key, PyObject *o) {
+
+    BPlusNode *leaf;
+    int ix;
+
+    if (key == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+
+    leaf = BPlusNode_search(tree->root, key, NULL);
+    ix = BPlusLeaf_search(leaf, key, o);
+
+    // see comments above BPlusLeaf_search for info about what -1 means
+    if (ix >= 0) {
+        // {o} is in the tree
+        return 1;
+    } else if (ix == -2) {
+        // there was an error in the search operation
+        return -1;
+    }
+
+    return 0;
+
+}
+
+// returns a new list of the elements of {tree}, in iteration order (by hash,
+// with the elements of each collision list in their sorted order).
+// Returns NULL with an error set if the list could not be allocated.
+PyObject *BPlusTree_to_list(BPlusTree *tree) {
+
+    BPlusNode *leaf = tree->root;
+    PyObject *container_list, **items, **values, *value;
+    Py_ssize_t ix = 0;
+
+    if ((container_list = PyList_New(tree->size)) == NULL) {
+        return NULL;
+    }
+    items = PySequence_Fast_ITEMS(container_list);
+
+    while (leaf->children != NULL) leaf = ((BPlusNode **)leaf->children->arr)[0];
+
+    for (; leaf != NULL; leaf = leaf->next) {
+        values = (PyObject **)leaf->values->arr;
+        for (int jx = 0; jx < leaf->values->size; jx++) {
+            value = values[jx];
+            if (value == NULL) {
+                // an element of an unboxed tree, box it
+                if ((items[ix++] = PyLong_FromLongLong(BPlusLeaf_key(leaf, jx))) == NULL) {
+                    Py_DECREF(container_list);
+                    return NULL;
+                }
+            } else if (PyList_Check(value)) {
+                // {value} is a list representing objects with hash
+                // collisions, add each element of it to our container
+                for (Py_ssize_t kx = 0; kx < PyList_GET_SIZE(value); kx++) {
+                    Py_INCREF(PyList_GET_ITEM(value, kx));
+                    items[ix++] = PyList_GET_ITEM(value, kx);
+                }
+            } else {
+                Py_INCREF(value);
+                items[ix++] = value;
+            }
+        }
+    }
+
+    return container_list;
+
+}
+
+// returns the number of bytes currently held by the nodes of {tree}, kept
+// up to date by {tree->heap} as nodes are allocated and freed.
+// the arena is counted in full, including nodes in it that have since been
+// replaced by splits.
+size_t BPlusTree_nbytes(BPlusTree *tree) {
+    return tree->heap.nbytes + tree->arena_nbytes;
+}
+
+// task for BPlusTree_method_contains_many(): looks up run {task} of the
+// {probe->ntasks} runs of keys in the {BPlusProbe} {arg}.
+// Runs of ascending keys often land in the same leaf one after another, so
+// the leaf of the last key is checked before searching from the root again.
+void BPlusProbe_run(void *arg, int task) {
+
+    BPlusProbe *probe = (BPlusProbe *)arg;
+    BPlusNode *leaf = NULL;
+    Py_ssize_t
+        nbytes = (probe->n + 7) / 8,
+        lo = 8 * (nbytes * task / probe->ntasks),
+        hi = 8 * (nbytes * (task + 1) / probe->ntasks);
+    unsigned char bits = 0;
+    int ix, size;
+    l64 key;
+
+    if (hi > probe->n) hi = probe->n;
+
+    for (Py_ssize_t jx = lo; jx < hi; jx++) {
+
+        key = probe->keys[jx];
+
+        size = leaf == NULL ? 0 : leaf->values->size;
+        if (size == 0 || key < BPlusLeaf_key(leaf, 0) || BPlusLeaf_key(leaf, size - 1) < key) {
+            leaf = BPlusNode_search(probe->root, key, NULL);
+            size = leaf->values->size;
+        }
+
+        ix = BPlusLeaf_bisect_left(leaf, key);
+        if (ix < size && BPlusLeaf_key(leaf, ix) == key) {
+            bits |= (unsigned char)(1 << (jx & 7));
+        }
+
+        if ((jx & 7) == 7 || jx == hi - 1) {
+            probe->out[jx >> 3] = bits;
+            bits = 0;
+        }
+
+    }
+
+}
+
+// builds a new set of nodes for {tree} from the {n} sorted, unique {keys} and
+// their {values}, filling each node to {fill_factor} of its capacity.
+// Ownership of the references in {values} passes to the new leaves. {values}
+// is NULL when building an unboxed tree.
+// All nodes are laid out in a single new arena, which replaces {tree->root}
+// and {tree->arena}; the caller is responsible for releasing the old ones.
+// None of this needs Python objects, so for large trees the GIL is released
+// and the leaves are laid out by the worker pool (see bpluspool.c) while
+// {tree} is marked {busy}.
+// Returns 0 on success, or -1 with a MemoryError set.
+int BPlusTree_build(BPlusTree *tree, l64 *keys, PyObject **values, int n, double fill_factor) {
+
+    BPlusBuild build;
+    PyThreadState *released = NULL;
+    BPlusNode *root = NULL;
+    int nthreads = BPlusPool_workers(n);
+
+    if (n >= BPLUSPOOL_GRAIN) {
+        tree->busy = 1;
+        released = PyEval_SaveThread();
+    }
+
+    if (BPlusBuild_init(&build, tree->b, tree->compress, keys, (void **)values, n, fill_factor, nthreads) == 0) {
+        BPlusPool_run(BPlusBuild_leaves, &build, build.ntasks, nthreads);
+        root = BPlusBuild_finish(&build);
+    }
+
+    if (released != NULL) {
+        PyEval_RestoreThread(released);
+        tree->busy = 0;
+    }
+
+    if (root == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    tree->root = root;
+    tree->arena = build.mem;
+    tree->arena_nbytes = build.nbytes;
+
+    return 0;
+
+}
+
+// comparison helper function
+int BPlusTree_cmp(BPlusTree *tree1, BPlusTree *tree2) {
+
+    BPlusNode 
+        *curr1 = tree1->root,
+        *curr2 = tree2->root;
+    l64
+        item1,
+        item2;
     PyObject
         *value1,
         *value2;
@@ -701,8 +2368,8 @@ int BPlusTree_cmp(BPlusTree *tree1, BPlusTree *tree2) {
             break;
         }
 
-        item1 = ((l64 *)curr1->indices->arr)[ix1];
-        item2 = ((l64 *)curr2->indices->arr)[ix2];
+        item1 = BPlusLeaf_key(curr1, ix1);
+        item2 = BPlusLeaf_key(curr2, ix2);
 
         if (item1 != item2) {
             return 0;
@@ -711,7 +2378,12 @@ int BPlusTree_cmp(BPlusTree *tree1, BPlusTree *tree2) {
         value1 = ((PyObject **)curr1->values->arr)[ix1];
         value2 = ((PyObject **)curr2->values->arr)[ix2];
 
-        if (PyObject_RichCompareBool(value1, value2, Py_EQ) != 1) {
+        // an unboxed element is the integer {item1} (which is {item2}) itself
+        if (value1 == NULL || value2 == NULL) {
+            if (value1 != value2 && BPlusLeaf_equals_key(value1 == NULL ? value2 : value1, item1) != 1) {
+                return 0;
+            }
+        } else if (PyObject_RichCompareBool(value1, value2, Py_EQ) != 1) {
             return 0;
         }
 
@@ -728,9 +2400,147 @@ int BPlusTree_cmp(BPlusTree *tree1, BPlusTree *tree2) {
 
 }
 
+// BEGIN C API function definitions
+// These are exported to other extensions through the {BPlusCAPI} capsule
+// made by PyInit_c(); see bplusapi.h for what each of them promises.
+
+int BPlusCAPI_insert(PyObject *tree, PyObject *o, Py_hash_t hash) {
+
+    BPlusTree *t = (BPlusTree *)tree;
+    int size = t->size;
+    PyObject *res;
+
+    if ((res = BPlusTree_insert(t, hash, o)) == NULL) {
+        return -1;
+    }
+    Py_DECREF(res);
+
+    return t->size > size;
+
+}
+
+int BPlusCAPI_contains(PyObject *tree, PyObject *o, Py_hash_t hash) {
+    return BPlusTree_contains((BPlusTree *)tree, hash, o);
+}
+
+Py_ssize_t BPlusCAPI_insert_many(PyObject *tree, PyObject *const *items, const Py_hash_t *hashes, Py_ssize_t n) {
+
+    BPlusTree *t = (BPlusTree *)tree;
+    int size = t->size;
+    PyObject *res;
+
+    for (Py_ssize_t ix = 0; ix < n; ix++) {
+        if ((res = BPlusTree_insert(t, hashes[ix], items[ix])) == NULL) {
+            return -1;
+        }
+        Py_DECREF(res);
+    }
+
+    return t->size - size;
+
+}
+
+Py_ssize_t BPlusCAPI_contains_many(PyObject *tree, PyObject *const *items, const Py_hash_t *hashes, Py_ssize_t n, unsigned char *out) {
+
+    BPlusTree *t = (BPlusTree *)tree;
+    Py_ssize_t found = 0;
+    int res;
+
+    for (Py_ssize_t ix = 0; ix < n; ix++) {
+        if ((res = BPlusTree_contains(t, hashes[ix], items[ix])) == -1) {
+            return -1;
+        }
+        if (res) {
+            out[ix / 8] |= (unsigned char)(1 << (ix % 8));
+            found++;
+        } else {
+            out[ix / 8] &= (unsigned char)~(1 << (ix % 8));
+        }
+    }
+
+    return found;
+
+}
+
+// the walk counts as a reader of {tree} (see BPlusTree_check_writable()), so
+// that {visit} cannot split or free the leaf being walked.
+int BPlusCAPI_visit(PyObject *tree, BPlusVisitFunc visit, void *arg) {
+
+    BPlusTree *t = (BPlusTree *)tree;
+    BPlusNode *leaf = t->root;
+    PyObject *value, *boxed;
+    l64 key;
+    int res = 0;
+
+    while (leaf->children != NULL) leaf = ((BPlusNode **)leaf->children->arr)[0];
+
+    t->readers++;
+
+    for (; leaf != NULL && res == 0; leaf = leaf->next) {
+        for (int ix = 0; ix < leaf->values->size && res == 0; ix++) {
+            value = ((PyObject **)leaf->values->arr)[ix];
+            key = BPlusLeaf_key(leaf, ix);
+            if (value == NULL) {
+                // an element of an unboxed tree, which is its own hash
+                if ((boxed = PyLong_FromLongLong(key)) == NULL) {
+                    res = -1;
+                    break;
+                }
+                res = visit(boxed, key, arg);
+                Py_DECREF(boxed);
+            } else if (PyList_Check(value)) {
+                for (Py_ssize_t jx = 0; jx < PyList_GET_SIZE(value) && res == 0; jx++) {
+                    res = visit(PyList_GET_ITEM(value, jx), key, arg);
+                }
+            } else {
+                res = visit(value, key, arg);
+            }
+        }
+    }
+
+    t->readers--;
+
+    return res;
+
+}
+
+// the table of the C API, exported by PyInit_c()
+static BPlusCAPI BPlusCAPI_table = {
+    BPLUS_CAPI_VERSION,
+    sizeof(BPlusCAPI),
+    &BPlusTreeType,
+    BPlusCAPI_insert,
+    BPlusCAPI_contains,
+    BPlusCAPI_insert_many,
+    BPlusCAPI_contains_many,
+    BPlusCAPI_visit,
+};
+
+// BEGIN module method definitions
+static PyObject *BPlusHeap_method_get_pymalloc(PyObject *module, PyObject *args) {
+    return PyBool_FromLong(BPlusHeap_allocator.small_nbytes > 0);
+}
+
+static PyObject *BPlusHeap_method_set_pymalloc(PyObject *module, PyObject *args) {
+
+    int enabled;
+
+    if (!PyArg_ParseTuple(args, "p", &enabled)) {
+        return NULL;
+    }
+
+    BPlusHeap_allocator.small_nbytes = enabled ? BPLUS_SMALL_NBYTES : 0;
+
+    Py_RETURN_NONE;
+
+}
+
 // define our module methods
-// currently no module methods
 static PyMethodDef bplus_method_def[] = {
+    {"get_threads", BPlusPool_method_get_threads, METH_NOARGS, "Returns the most threads used to sort and lay out large trees."},
+    {"set_threads", BPlusPool_method_set_threads, METH_VARARGS, "Sets the most threads used to sort and lay out large trees to {threads}, between 1 and 64."},
+    {"get_pymalloc", BPlusHeap_method_get_pymalloc, METH_NOARGS, "Returns True if small nodes are taken from pymalloc rather than the raw allocator."},
+    {"set_pymalloc", BPlusHeap_method_set_pymalloc, METH_VARARGS, "Takes small nodes from pymalloc if {enabled}, or from the raw allocator otherwise. Nodes already allocated are unaffected."},
     {NULL, NULL, 0, NULL}
 };
 // define our module
@@ -742,9 +2552,33 @@ static struct PyModuleDef bplus_module_def = {
     bplus_method_def,
 };
 
-// register our module and add the BPlusTree type to it
+// register our module and add the BPlusTree types to it
 PyMODINIT_FUNC PyInit_c(void) {
-    PyObject *bplus = PyModule_Create(&bplus_module_def);
+    PyObject *bplus = PyModule_Create(&bplus_module_def), *capi;
+    // take nodes from the traced raw domain, so that they show up in
+    // tracemalloc; small nodes only go to pymalloc once set_pymalloc() is
+    // called, since it needs the GIL
+    BPlusHeap_allocator.malloc = PyMem_RawMalloc;
+    BPlusHeap_allocator.free = PyMem_RawFree;
+    BPlusHeap_allocator.small_malloc = PyObject_Malloc;
+    BPlusHeap_allocator.small_free = PyObject_Free;
     PyModule_AddType(bplus, &BPlusTreeType);
+    PyModule_AddType(bplus, &BPlusSetType);
+    PyModule_AddType(bplus, &BPlusSortedTreeType);
+    PyModule_AddType(bplus, &BPlusCursorType);
+    PyModule_AddType(bplus, &BPlusSnapshotType);
+    PyType_Ready(&BPlusSnapshotIterType);
+    PyModule_AddType(bplus, &BPlusPagedTreeType);
+    PyType_Ready(&BPlusPagedIterType);
+    PyModule_AddType(bplus, &BPlusBytesTreeType);
+    PyType_Ready(&BPlusBytesIterType);
+    PyModule_AddType(bplus, &BPlusCountedTreeType);
+    // the C API for other extensions, see bplusapi.h
+    capi = PyCapsule_New(&BPlusCAPI_table, BPLUS_CAPI_NAME, NULL);
+    if (capi == NULL || PyModule_AddObject(bplus, "_C_API", capi) == -1) {
+        Py_XDECREF(capi);
+        Py_DECREF(bplus);
+        return NULL;
+    }
     return bplus;
 }
@@ -12,13 +12,64 @@
 #include "general.h"
 #include "array32.h"
 #include "bplusnode.h"
+#include "bplustrace.h"
+#include "bplusapi.h"
+
+
+// BEGIN types and functions defined in other files
+// defined in bplussorted.c
+extern PyTypeObject BPlusSortedTreeType;
+// defined in bpluscursor.c
+extern PyTypeObject BPlusCursorType;
+PyObject *BPlusCursor_new(BPlusTree *tree, PyObject *token);
+// defined in bpluspool.c
+int BPlusPool_workers(Py_ssize_t n);
+void BPlusPool_run(void (*task)(void *arg, int ix), void *arg, int ntasks, int nthreads);
+void BPlusPool_sort(void *a, void *scratch, Py_ssize_t n, int width);
+PyObject *BPlusPool_method_get_threads(PyObject *module, PyObject *args);
+PyObject *BPlusPool_method_set_threads(PyObject *module, PyObject *args);
+// defined in bplussnapshot.c
+extern PyTypeObject BPlusSnapshotType;
+extern PyTypeObject BPlusSnapshotIterType;
+int BPlusSnapshot_write(PyObject *elements, PyObject *path);
+// defined in bpluspaged.c
+extern PyTypeObject BPlusPagedTreeType;
+extern PyTypeObject BPlusPagedIterType;
+// defined in bplusbytes.c
+extern PyTypeObject BPlusBytesTreeType;
+extern PyTypeObject BPlusBytesIterType;
+// defined in bpluscounted.c
+extern PyTypeObject BPlusCountedTreeType;
 
 
 // BEGIN BPlusTree private helper method headers
-static void BPlusBranch_split(BPlusTree *self, BPlusNode *branch);
-static void BPlusLeaf_split(BPlusTree *self, BPlusNode *leaf);
+static int BPlusLeaf_split(BPlusTree *self, BPlusNode *leaf, BPlusNode **left, BPlusNode **right, l64 *new_parent_ix);
+static int BPlusTree_split(BPlusTree *tree, BPlusNode *leaf, BPlusPath *path);
+static int BPlusNode_search_cost(BPlusNode *node);
+static BPlusNode *BPlusTree_leaf_for(BPlusTree *tree, l64 *keys, int n);
+static BPlusNode *BPlusLeaf_repack(BPlusTree *tree, BPlusNode *leaf, l64 key, BPlusPath *path);
+static int BPlusTree_reserve(BPlusTree *tree, Py_ssize_t n);
+static int BPlusTree_extend_iterable(BPlusTree *tree, PyObject *initializer);
+static int BPlusTree_extend_sequence(BPlusTree *tree, PyObject *seq);
+static int BPlusTree_extend_sequence_unboxed(BPlusTree *tree, PyObject *seq);
+static int BPlusPair_dedupe(BPlusPair *pairs, Py_ssize_t *n);
+static int BPlusPair_sort(BPlusPair *pairs, Py_ssize_t n);
+static int BPlusTree_extend_hashed(BPlusTree *tree, PyObject *initializer);
+static int BPlusTree_load_sorted(BPlusTree *tree, BPlusPair *pairs, Py_ssize_t n);
+static BPlusNode *BPlusLeaf_promote(BPlusTree *tree, BPlusNode *leaf);
+static int BPlusTree_load_keys(BPlusTree *tree, l64 *keys, Py_ssize_t n);
+static int BPlusTree_extend_unboxed(BPlusTree *tree, BPlusTree *other);
+static l64 BPlusTree_unbox(PyObject *o);
+static l64 BPlusTree_hash_l64(l64 x);
 static PyObject *BPlusTree_insert(BPlusTree *tree, l64 key, PyObject *o);
+static int BPlusTree_contains(BPlusTree *tree, l64 key, PyObject *o);
 static int BPlusTree_cmp(BPlusTree *tree1, BPlusTree *tree2);
+static int BPlusTree_check_writable(BPlusTree *tree);
+static int BPlusTree_int64_buffer(Py_buffer *view);
+static void BPlusProbe_run(void *arg, int task);
+static size_t BPlusTree_nbytes(BPlusTree *tree);
+static PyObject *BPlusTree_to_list(BPlusTree *tree);
+static int BPlusTree_build(BPlusTree *tree, l64 *keys, PyObject **values, int n, double fill_factor);
 
 
 // BEGIN tp method headers
@@ -28,6 +79,7 @@ static void BPlusTree_tp_dealloc(BPlusTree *self);
 static int BPlusTree_tp_init(BPlusTree *self, PyObject *args, PyObject *kwargs);
 static PyObject *BPlusTree_tp_richcompare(PyObject *o1, PyObject *o2, int op);
 static PyObject *BPlusTree_tp_iter(PyObject *self);
+static int BPlusTree_init(BPlusTree *self, PyObject *initializer, int b, int compress, int unboxed, Py_ssize_t capacity);
 
 
 // BEGIN sequence method headers
@@ -37,8 +89,41 @@ static int BPlusTree_sq_contains(PyObject *self, PyObject *value);
 
 // BEGIN public method headers
 static PyObject *BPlusTree_method_get_b(PyObject *self, PyObject *args);
-static PyObject *BPlusTree_method_add(PyObject *self, PyObject *args);
-static PyObject *BPlusTree_method_get_indices(PyObject *self, PyObject *args);
+static PyObject *BPlusTree_method_sizeof(PyObject *self, PyObject *args);
+static PyObject *BPlusTree_method_get_compress(PyObject *self, PyObject *args);
+static PyObject *BPlusTree_method_get_unboxed(PyObject *self, PyObject *args);
+static PyObject *BPlusTree_method_add(PyObject *self, PyObject *o);
+static PyObject *BPlusTree_method_reserve(PyObject *self, PyObject *args);
+static PyObject *BPlusTree_method_set_trace(PyObject *self, PyObject *args);
+static PyObject *BPlusTree_method_get_trace(PyObject *self, PyObject *args);
+static PyObject *BPlusTree_method_stats(PyObject *self, PyObject *args);
+static PyObject *BPlusTree_method_compact(PyObject *self, PyObject *args, PyObject *kwargs);
+static PyObject *BPlusTree_method_cursor(PyObject *self, PyObject *args, PyObject *kwargs);
+static PyObject *BPlusTree_method_to_list(PyObject *self, PyObject *args);
+static PyObject *BPlusTree_method_save(PyObject *self, PyObject *args);
+static PyObject *BPlusTree_method_iter_chunks(PyObject *self, PyObject *args);
+static PyObject *BPlusTree_method_hashes(PyObject *self, PyObject *args);
+static PyObject *BPlusTree_method_contains_many(PyObject *self, PyObject *args, PyObject *kwargs);
+static PyObject *BPlusTree_method_from_buffer(PyObject *cls, PyObject *args, PyObject *kwargs);
+
+
+// BEGIN BPlusSet method headers
+static int BPlusSet_tp_init(BPlusTree *self, PyObject *args, PyObject *kwargs);
+static PyObject *BPlusSet_tp_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames);
+static PyObject *BPlusSet_method_open(PyObject *cls, PyObject *path);
+
+
+// BEGIN C API function headers (see bplusapi.h)
+static int BPlusCAPI_insert(PyObject *tree, PyObject *o, Py_hash_t hash);
+static int BPlusCAPI_contains(PyObject *tree, PyObject *o, Py_hash_t hash);
+static Py_ssize_t BPlusCAPI_insert_many(PyObject *tree, PyObject *const *items, const Py_hash_t *hashes, Py_ssize_t n);
+static Py_ssize_t BPlusCAPI_contains_many(PyObject *tree, PyObject *const *items, const Py_hash_t *hashes, Py_ssize_t n, unsigned char *out);
+static int BPlusCAPI_visit(PyObject *tree, BPlusVisitFunc visit, void *arg);
+
+
+// BEGIN module method headers
+static PyObject *BPlusHeap_method_get_pymalloc(PyObject *module, PyObject *args);
+static PyObject *BPlusHeap_method_set_pymalloc(PyObject *module, PyObject *args);
 
 
 #endif
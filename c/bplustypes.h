@@ -5,36 +5,94 @@
 #define BPLUSTYPES_H
 
 
-// convenience type for storing hashes
-typedef long long int l64;
+#include <pthread.h>
+#include "bpluscore.h"
 
 
-// convenience type for representing arrays
-// we'll have {Array32} objects storing {l64}, {PyObject *}, and {BPlusNode *}.
-typedef struct Array32 {
-    void *arr;
-    int size;
-} Array32;
-
-
-// Our basic node object.
-// May be either a "leaf node" (no child nodes) or a "branch node" (has child
-// nodes).
-//  1. All nodes have {indices} which is an {Array32} storing {l64} hashes.
-//  2. All nodes besides the root node have a {parent} which is a pointer to
-//      the parent node.
-//  3. "branches" have {children} which is an {Array32} storing {BPlusNode *}.
-//  4. "leaves" have {values} which is an {Array32} storing {PyObject *}.
-//  5. "leaves" also have {prev} and {next}, which are pointers to the
-//      neighboring leaves.
-typedef struct BPlusNode {
-    Array32 *indices;
-    Array32 *values;
-    Array32 *children;
-    struct BPlusNode *parent;
-    struct BPlusNode *prev;
-    struct BPlusNode *next;
-} BPlusNode;
+// convenience type for sorting hashes along with the objects they belong to
+typedef struct BPlusPair {
+    l64 key;
+    PyObject *value;
+} BPlusPair;
+
+
+// the most elements a tree can hold before its root leaf moves out of the
+// {BPlusTree} object and onto the heap.
+#define BPLUS_INLINE_SLOTS 16
+
+// the {b} of a tree made by __new__() without __init__(), matching the
+// default of the Python classes
+#define BPLUS_DEFAULT_B 16
+
+// the largest node taken from pymalloc once set_pymalloc() has been called;
+// pymalloc hands larger blocks on to the raw allocator anyway
+#define BPLUS_SMALL_NBYTES 512
+
+// bytes needed to lay out the inline root leaf (see BPlusNode_nbytes())
+#define BPLUS_INLINE_NBYTES (sizeof(BPlusNode) + 2 * sizeof(Array32) + (sizeof(l64) + sizeof(void *)) * BPLUS_INLINE_SLOTS)
+
+
+// the fewest elements worth handing to a thread of their own; builds of at
+// least this many elements also release the GIL (see bpluspool.c)
+#define BPLUSPOOL_GRAIN (1 << 15)
+// the most threads the pool will run at once
+#define BPLUSPOOL_MAX_THREADS 64
+
+
+// a batch of independent tasks shared out between threads by BPlusPool_run()
+// in bpluspool.c.
+// {task} is called once for each index in [0, {ntasks}), with {arg} passed
+// along. {next} is the lowest index not yet taken by a thread, and is only
+// read or written while holding {lock}.
+typedef struct BPlusJob {
+    void (*task)(void *arg, int ix);
+    void *arg;
+    int ntasks;
+    int next;
+    pthread_mutex_t lock;
+} BPlusJob;
+
+
+// scratch state used by the parallel sample sort in BPlusPool_sort().
+// The {n} elements of {a} are {width} bytes each and start with their {l64}
+// hash (see sort_keyed() in array32.c).
+//  1. {splitters} divide the hashes into {nbuckets} buckets; an element goes
+//      in the bucket given by the number of splitters not above its hash.
+//  2. {a} is cut into {nbuckets} chunks of equal size, and {counts}[c *
+//      {nbuckets} + k] is the number of elements of chunk c in bucket k,
+//      which then becomes the offset in {scratch} that they are moved to.
+//  3. {starts}[k] is the offset of bucket k in {scratch}.
+typedef struct BPlusSort {
+    char *a;
+    char *scratch;
+    Py_ssize_t n;
+    int width;
+    int nbuckets;
+    l64 *splitters;
+    Py_ssize_t *counts;
+    Py_ssize_t *starts;
+} BPlusSort;
+
+
+// an event recorded by a traced {BPlusTree} (see bplustrace.h): when it
+// happened, in nanoseconds on the monotonic clock, and its BPLUS_EVENT_*
+// {kind}, with the {key} and {arg} documented alongside it.
+typedef struct BPlusEvent {
+    unsigned long long ns;
+    l64 key;
+    int kind;
+    int arg;
+} BPlusEvent;
+
+
+// ring buffer of the last {mask}+1 events of a traced tree.
+// {count} events have been recorded in all; event i is at {events}[i & {mask}],
+// so once {count} passes {mask} each new event overwrites the oldest.
+typedef struct BPlusTrace {
+    unsigned long long count;
+    unsigned long long mask;
+    BPlusEvent *events;
+} BPlusTrace;
 
 
 // define our python type
@@ -43,9 +101,405 @@ typedef struct BPlusTree {
     BPlusNode *root;
     int b;
     int size;
+    // if nonzero, leaves store their hashes as packed offsets where possible
+    int compress;
+    // if nonzero, the tree only holds integers whose hash is the integer
+    // itself. These are not stored as objects at all: every leaf value is
+    // NULL, and the element is read back from its hash (see BPlusTree_unbox())
+    int unboxed;
     BPlusNode *iter_current_node;
     int iter_current_index;
+    // single block holding every node laid out by the last call to compact()
+    void *arena;
+    size_t arena_nbytes;
+    // storage for the root leaf while the tree is small enough to fit in it,
+    // so that small trees need no allocations of their own
+    l64 inline_root[BPLUS_INLINE_NBYTES / sizeof(l64)];
+    // number of collision lists in the tree; while it is 0, every value in a
+    // leaf is an element and no leaf needs to be checked for lists
+    int collisions;
+    // bumped on every change to the contents or shape of the tree, so that
+    // anything holding on to a node (see {BPlusCursor}) can tell when it may
+    // have been split or freed
+    unsigned long long version;
+    // set while the tree is being rebuilt with the GIL released (see
+    // BPlusTree_build()). Other threads may still read the old nodes, but
+    // anything that would change the tree raises RuntimeError instead.
+    int busy;
+    // number of batch lookups reading the tree with the GIL released (see
+    // BPlusTree.contains_many()) and of C API walks over its leaves (see
+    // bplusapi.h). The tree may not be changed while it is nonzero. See
+    // BPlusTree_check_writable() in bplustree.c
+    int readers;
+    // number of leaves and branches split since the tree was created (see
+    // BPlusTree.stats())
+    unsigned long long splits;
+    // where the nodes of the tree outside its {arena} come from; its byte
+    // count backs __sizeof__()
+    BPlusHeap heap;
+    // the events of the tree, or NULL if it is not being traced (see
+    // BPlusTree.set_trace())
+    BPlusTrace *trace;
 } BPlusTree;
 
 
+// state shared by the threads of a batch lookup (see
+// BPlusTree.contains_many() in bplustree.c).
+// {keys} holds the {n} integers being looked for in the tree at {root}. Bit i
+// of {out} (bit i % 8 of byte i / 8) is set if keys[i] is in the tree. The
+// keys are split into {ntasks} runs, each starting on a multiple of 8 so that
+// no two runs write to the same byte of {out}.
+typedef struct BPlusProbe {
+    BPlusNode *root;
+    l64 *keys;
+    unsigned char *out;
+    Py_ssize_t n;
+    int ntasks;
+} BPlusProbe;
+
+
+// define our python type for cursors over the leaf chain of a {BPlusTree}
+// A cursor sits just before the element it will return next:
+//  1. {key} is the hash of that element and {sub} is its index within the
+//      collision list at {key} (0 if there is no collision list).
+//  2. {leaf} and {ix} are the leaf and slot holding {key}. They are only
+//      trusted while {version} matches {tree->version}; otherwise they are
+//      found again from {key} (see BPlusCursor_sync() in bpluscursor.c).
+//  3. {at_end} is set once the cursor is past the last element, in which
+//      case the other fields are meaningless.
+//  4. {chunk} is 0 for a cursor that iterates over single elements, or the
+//      size of the tuples it yields instead (see BPlusTree.iter_chunks()).
+typedef struct BPlusCursor {
+    PyObject_HEAD
+    BPlusTree *tree;
+    BPlusNode *leaf;
+    int ix;
+    Py_ssize_t sub;
+    l64 key;
+    int at_end;
+    unsigned long long version;
+    Py_ssize_t chunk;
+} BPlusCursor;
+
+
+// define our python type for trees ordered by the elements themselves
+// rather than by their hashes.
+// Its nodes are ordinary {BPlusNode}s, but {indices} stores {PyObject *}
+// sort keys instead of {l64} hashes (both are 8 bytes wide), and each of
+// those keys holds a reference:
+//  1. leaves store the sort key of each element in {indices}, and the
+//      element itself in {values}
+//  2. branches store a copy of the first sort key of each child after the
+//      first in {indices}, and the number of elements beneath each child in
+//      {counts} (see BPlusBranch_init_counted()), so that an element's rank
+//      is found on the way down to its leaf
+// {key} is the function mapping elements to sort keys, or NULL if the
+// elements are their own sort keys.
+typedef struct BPlusSortedTree {
+    PyObject_HEAD
+    BPlusNode *root;
+    int b;
+    int size;
+    PyObject *key;
+    // bumped by every change, so that a comparison that changes the tree can
+    // be caught (see BPlusSorted_check_version())
+    unsigned long long version;
+    // where the nodes of the tree come from
+    BPlusHeap heap;
+} BPlusSortedTree;
+
+
+// define our python type for multisets
+// Laid out like a {BPlusTree}, except that its leaves are made by
+// BPlusLeaf_init_counted() and keep a count for each element in {counts}.
+// Two elements with the same hash share a slot whose value is a list of
+// [element, count] lists (lists are unhashable, so cannot be elements), and
+// whose own count is unused.
+// {size} is the number of distinct elements, and {total} the sum of their
+// counts.
+typedef struct BPlusCountedTree {
+    PyObject_HEAD
+    BPlusNode *root;
+    int b;
+    Py_ssize_t size;
+    l64 total;
+    // bumped by every change to the elements of the tree (but not to their
+    // counts, which frees nothing), so that a comparison that changes the
+    // tree can be caught (see BPlusCounted_check_version())
+    unsigned long long version;
+    // where the nodes of the tree come from
+    BPlusHeap heap;
+} BPlusCountedTree;
+
+
+
+// the most levels of separators a snapshot file may have. With a fanout of
+// {BPLUSSNAPSHOT_FANOUT} this covers any number of elements that fits in a
+// {Py_ssize_t}.
+#define BPLUSSNAPSHOT_MAX_LEVELS 16
+// the number of keys beneath each separator of a snapshot file
+#define BPLUSSNAPSHOT_FANOUT 32
+
+
+// the header at the start of a snapshot file written by BPlusTree.save() (see
+// bplussnapshot.c). Everything after it is found by its offset in bytes from
+// the start of the file, so the file can be mapped at any address.
+//  1. {magic} is "BPLUSSNP" and {format} is bumped whenever the layout of the
+//      file changes. {byte_order} is 0x01020304 as written by the saving
+//      machine; a file is only opened on machines with the same byte order.
+//  2. {keys_offset} locates the {n} stable hashes of the elements in
+//      ascending order (see BPlusSnapshot_key()), and {entries_offset} the
+//      {BPlusSnapshotEntry} of each element, in the same order.
+//  3. {level_offsets}[i] and {level_sizes}[i] locate the separators of level
+//      i+1 of {nlevels}. Level 1 holds every {fanout}th hash, and each level
+//      above it every {fanout}th separator of the level below, up to a top
+//      level of at most {fanout} separators.
+//  4. {data_offset} locates the bytes of the elements that are not stored
+//      in their entry.
+typedef struct BPlusSnapshotHeader {
+    char magic[8];
+    unsigned int format;
+    unsigned int byte_order;
+    unsigned long long n;
+    unsigned long long file_nbytes;
+    unsigned int fanout;
+    unsigned int nlevels;
+    unsigned long long keys_offset;
+    unsigned long long entries_offset;
+    unsigned long long data_offset;
+    unsigned long long data_nbytes;
+    unsigned long long level_offsets[BPLUSSNAPSHOT_MAX_LEVELS];
+    unsigned long long level_sizes[BPLUSSNAPSHOT_MAX_LEVELS];
+} BPlusSnapshotHeader;
+
+
+// one element of a snapshot file.
+// {tag} is one of the BPLUSSNAPSHOT_* tags below. An int that fits in an
+// {l64} is stored in {value} itself; anything else is {len} bytes at offset
+// {value} in the data section of the file.
+typedef struct BPlusSnapshotEntry {
+    unsigned long long value;
+    unsigned int len;
+    unsigned int tag;
+} BPlusSnapshotEntry;
+
+
+// an int that fits in an {l64}
+#define BPLUSSNAPSHOT_INT 1
+// any other int, as signed little endian bytes
+#define BPLUSSNAPSHOT_BIGINT 2
+// a bytes object
+#define BPLUSSNAPSHOT_BYTES 3
+// a str, encoded as UTF-8
+#define BPLUSSNAPSHOT_STR 4
+
+
+// define our python type for read-only sets mapped from snapshot files
+// {map} is the whole file, {nbytes} long, mapped read-only and shared, and
+// the other pointers point into it (see {BPlusSnapshotHeader}).
+typedef struct BPlusSnapshot {
+    PyObject_HEAD
+    char *map;
+    size_t nbytes;
+    BPlusSnapshotHeader *header;
+    l64 *keys;
+    BPlusSnapshotEntry *entries;
+    char *data;
+    Py_ssize_t n;
+} BPlusSnapshot;
+
+
+// define our python type for iterators over a {BPlusSnapshot}
+// {ix} is the index of the next element to create.
+typedef struct BPlusSnapshotIter {
+    PyObject_HEAD
+    BPlusSnapshot *snapshot;
+    Py_ssize_t ix;
+} BPlusSnapshotIter;
+
+
+// the size in bytes of each page of the file behind a {BPlusPagedTree}
+#define BPLUSPAGED_PAGE_SIZE 4096
+// the most keys a leaf page holds
+#define BPLUSPAGED_LEAF_CAPACITY ((BPLUSPAGED_PAGE_SIZE - 2 * sizeof(unsigned int)) / sizeof(l64))
+// the most children of a branch of a {BPlusPagedTree}
+#define BPLUSPAGED_FANOUT 64
+// deep enough for more pages than a file can number
+#define BPLUSPAGED_MAX_DEPTH 16
+// marks a page that is not in any frame of the cache, or a frame that holds
+// no page
+#define BPLUSPAGED_NONE 0xffffffffU
+
+
+// the first page of the file behind a {BPlusPagedTree}.
+// {magic} is "BPLUSPGD", {format} is bumped whenever the layout of the file
+// changes, and {byte_order} is 0x01020304 as written by the saving machine.
+// The file holds {npages} pages of {page_size} bytes, page 0 being this
+// header; the {n} keys are in the chain of leaf pages starting at
+// {first_page}.
+typedef struct BPlusPagedHeader {
+    char magic[8];
+    unsigned int format;
+    unsigned int byte_order;
+    unsigned int page_size;
+    unsigned int first_page;
+    unsigned int npages;
+    unsigned int reserved;
+    unsigned long long n;
+} BPlusPagedHeader;
+
+
+// a leaf page of a {BPlusPagedTree}, as stored in the file and in a frame of
+// its cache: {count} ascending keys, and the page id of the next leaf (0 for
+// the last leaf).
+typedef struct BPlusPage {
+    unsigned int count;
+    unsigned int next;
+    l64 keys[BPLUSPAGED_LEAF_CAPACITY];
+} BPlusPage;
+
+
+// a branch of a {BPlusPagedTree}. Branches only live in memory, and are
+// rebuilt from the leaf chain when a file is opened.
+// {keys}[i] is the lowest key beneath child i ({keys}[0] is never compared).
+// If {leaves} is set the children are the page ids of leaves, and otherwise
+// pointers to branches.
+typedef struct BPlusPagedBranch {
+    int leaves;
+    int n;
+    l64 keys[BPLUSPAGED_FANOUT];
+    union {
+        struct BPlusPagedBranch *branches[BPLUSPAGED_FANOUT];
+        unsigned int pages[BPLUSPAGED_FANOUT];
+    } child;
+} BPlusPagedBranch;
+
+
+// define our python type for sets of int64 whose leaves live in a file
+//  1. {fd} is the open file at {path}, which holds {npages} pages once
+//      flushed. {root} is NULL once the tree is closed.
+//  2. the leaves are read through a cache of {nframes} pages at {frames}.
+//      {frame_pages}[f] is the page in frame f, and {page_frames}[p] (for the
+//      first {page_frames_size} pages) the frame holding page p. A frame's
+//      {frame_refs} bit is cleared by the CLOCK {hand} sweeping past it, and
+//      a frame with {frame_pins} is never evicted.
+//  3. {hits}, {misses}, {evictions} and {writes} count cache lookups that
+//      found their page, lookups that read it from the file, pages dropped
+//      from the cache to make room, and pages written to the file.
+//  4. {version} is bumped by every change, so iterators can tell when to
+//      find their place again.
+typedef struct BPlusPagedTree {
+    PyObject_HEAD
+    int fd;
+    PyObject *path;
+    BPlusPagedBranch *root;
+    unsigned int first_page;
+    unsigned int npages;
+    Py_ssize_t n;
+    unsigned long long version;
+    char *frames;
+    unsigned int nframes;
+    unsigned int hand;
+    unsigned int *frame_pages;
+    unsigned char *frame_refs;
+    unsigned char *frame_dirty;
+    unsigned int *frame_pins;
+    unsigned int *page_frames;
+    unsigned int page_frames_size;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    unsigned long long writes;
+} BPlusPagedTree;
+
+
+// define our python type for iterators over a {BPlusPagedTree}
+// {page} and {ix} locate the next key while the tree is at {version};
+// otherwise iteration picks up after {last}, the last key returned (if
+// {started}).
+typedef struct BPlusPagedIter {
+    PyObject_HEAD
+    BPlusPagedTree *tree;
+    unsigned int page;
+    unsigned int ix;
+    unsigned long long version;
+    int started;
+    l64 last;
+} BPlusPagedIter;
+
+
+// the most elements of a leaf, and children of a branch, of a
+// {BPlusBytesTree}
+#define BPLUSBYTES_SLOTS 32
+// deep enough for more elements than fit in memory
+#define BPLUSBYTES_MAX_DEPTH 32
+// a bytes element of a {BPlusBytesTree}
+#define BPLUSBYTES_BYTES 1
+// a str element of a {BPlusBytesTree}, stored as UTF-8
+#define BPLUSBYTES_STR 2
+
+
+// one element of a {BPlusBytesTree}: its Python hash, whether it is a bytes
+// or a str ({tag}), and its {len} bytes at {offset} in the tree's arena.
+// Entries are ordered by {hash}, then {tag}, then {len}, then their bytes, so
+// two entries are equal only if their elements are.
+typedef struct BPlusBytesEntry {
+    l64 hash;
+    size_t offset;
+    unsigned int len;
+    unsigned int tag;
+} BPlusBytesEntry;
+
+
+// a node of a {BPlusBytesTree}.
+// A leaf holds {n} ascending entries and points to the {next} leaf. A branch
+// holds {n} {children}, with {entries}[i] a copy of the lowest entry beneath
+// child i ({entries}[0] is never compared); only branches are allocated with
+// room for {children}.
+typedef struct BPlusBytesNode {
+    int leaf;
+    int n;
+    struct BPlusBytesNode *next;
+    BPlusBytesEntry entries[BPLUSBYTES_SLOTS];
+    struct BPlusBytesNode *children[];
+} BPlusBytesNode;
+
+
+// define our python type for sets of bytes and strs stored in an arena
+//  1. the bytes of every element are copied once into {arena}, which holds
+//      {arena_nbytes} of {arena_capacity} bytes. Elements are never removed,
+//      so the arena only grows, and entries refer to it by offset so that it
+//      can be moved as it grows.
+//  2. {first} is the leftmost leaf, and {nodes_nbytes} the bytes allocated
+//      for nodes.
+//  3. {version} is bumped by every change, so iterators can tell when to
+//      find their place again.
+typedef struct BPlusBytesTree {
+    PyObject_HEAD
+    BPlusBytesNode *root;
+    BPlusBytesNode *first;
+    Py_ssize_t n;
+    char *arena;
+    size_t arena_nbytes;
+    size_t arena_capacity;
+    size_t nodes_nbytes;
+    unsigned long long version;
+} BPlusBytesTree;
+
+
+// define our python type for iterators over a {BPlusBytesTree}
+// {leaf} and {ix} locate the next entry while the tree is at {version};
+// otherwise iteration picks up after {last}, the last entry returned (if
+// {started}).
+typedef struct BPlusBytesIter {
+    PyObject_HEAD
+    BPlusBytesTree *tree;
+    BPlusBytesNode *leaf;
+    int ix;
+    unsigned long long version;
+    int started;
+    BPlusBytesEntry last;
+} BPlusBytesIter;
+
+
 #endif
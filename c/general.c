@@ -9,8 +9,7 @@ PyObject
     *_builtins = NULL,
     *_iter = NULL,
     *_next = NULL,
-    *_hash = NULL,
-    *_print = NULL;
+    *_hash = NULL;
 
 // sets builtin functions.
 // returns 1 on success, 0 otherwise.
@@ -33,35 +32,8 @@ int setBuiltins() {
         if (_hash == NULL) {
             return 0;
         }
-        _print = PyDict_GetItemString(_builtins, "print");
-        if (_print == NULL) {
-            return 0;
-        }
     }
     
     return 1;
 
 }
-
-// debugging function for printing reference count.
-void printRefCount(char *label, PyObject *x) {
-
-    PyObject
-        *py_label = PyUnicode_FromString(label),
-        *py_refcnt = PyLong_FromLong(x->ob_refcnt);
-
-    setBuiltins();
-
-    PyObject_CallFunctionObjArgs(
-        _print,
-        py_label,
-        x,
-        py_refcnt,
-        NULL
-    );
-
-    Py_DECREF(py_label);
-    Py_DECREF(py_refcnt);
-
-}
-
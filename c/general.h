@@ -1,10 +1,6 @@
 // Header file for general-use helper functions used by the B-Plus Tree code.
 // See general.c for documentation on the methods declared in this file.
 
-// set DEBUG to an integer greater than 0 to enable debug print statements.
-// set DEBUG to 0 to disable debug print statements.
-#define DEBUG 0
-
 #ifndef GENERAL_H
 #define GENERAL_H
 
@@ -12,8 +8,17 @@
 #include <Python.h>
 
 
+// CPython keeps the hash of every entry of a set or dict. The functions that
+// hand them out along with the entries are private, and _PySet_NextEntry() is
+// no longer exported from 3.13 on, so only use them on older versions.
+#if PY_VERSION_HEX < 0x030D0000
+#define BPLUS_STORED_HASHES 1
+#else
+#define BPLUS_STORED_HASHES 0
+#endif
+
+
 int setBuiltins();
-void printRefCount(char *label, PyObject *x);
 
 
 #endif
@@ -0,0 +1,65 @@
+// A header-only stand-in for the <sys/sdt.h> of systemtap, so the USDT probes
+// of bplustrace.h are built without systemtap-sdt-dev installed. It only
+// provides DTRACE_PROBE2() (all bplustrace.h needs) for ELF on x86-64 and
+// aarch64, emitting the same version 3 ".note.stapsdt" notes that perf,
+// bpftrace and systemtap read. Like <sys/sdt.h>, this file is in the public
+// domain.
+//
+// A probe is a nop at the probe site, plus a note naming its provider, its
+// name, the address of the nop, and where each argument lives at the nop (as
+// "<size>@<operand>", a negative size meaning signed). Tracers patch the nop
+// when they attach, so an unattached probe costs one nop.
+
+
+#ifndef BPLUS_SDT_H
+#define BPLUS_SDT_H
+
+
+#if defined(__GNUC__) && defined(__ELF__) && (defined(__x86_64__) || defined(__aarch64__))
+#define BPLUS_SDT 1
+
+#define BPLUS_SDT_STR(x) #x
+#define BPLUS_SDT_XSTR(x) BPLUS_SDT_STR(x)
+
+// 1 if the integer {x} is of a signed type
+#define BPLUS_SDT_SIGNED(x) ((__typeof__(x))-1 < (__typeof__(x))1)
+
+// the operands of argument {n}: its size, printed negated by %n when signed,
+// and its value, wherever the compiler has it
+#define BPLUS_SDT_ARG(n, x) \
+    [bplus_sdt_s##n] "n" ((BPLUS_SDT_SIGNED(x) ? 1 : -1) * (int)sizeof(x)), \
+    [bplus_sdt_a##n] "nor" (x)
+
+#define BPLUS_SDT_PROBE(provider, name, args, ...) __asm__ __volatile__ ( \
+    "990: nop\n" \
+    ".pushsection .note.stapsdt,\"\",\"note\"\n" \
+    ".balign 4\n" \
+    ".4byte 992f-991f, 994f-993f, 3\n" \
+    "991: .asciz \"stapsdt\"\n" \
+    "992: .balign 4\n" \
+    "993: .8byte 990b\n" \
+    ".8byte _.stapsdt.base\n" \
+    ".8byte 0\n" \
+    ".asciz \"" BPLUS_SDT_XSTR(provider) "\"\n" \
+    ".asciz \"" BPLUS_SDT_XSTR(name) "\"\n" \
+    ".asciz \"" args "\"\n" \
+    "994: .balign 4\n" \
+    ".popsection\n" \
+    ".ifndef _.stapsdt.base\n" \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+    ".weak _.stapsdt.base\n" \
+    ".hidden _.stapsdt.base\n" \
+    "_.stapsdt.base: .space 1\n" \
+    ".size _.stapsdt.base, 1\n" \
+    ".popsection\n" \
+    ".endif\n" \
+    : : __VA_ARGS__)
+
+#define DTRACE_PROBE2(provider, name, arg1, arg2) BPLUS_SDT_PROBE(provider, name, \
+    "%n[bplus_sdt_s1]@%[bplus_sdt_a1] %n[bplus_sdt_s2]@%[bplus_sdt_a2]", \
+    BPLUS_SDT_ARG(1, arg1), BPLUS_SDT_ARG(2, arg2))
+
+#endif
+
+
+#endif
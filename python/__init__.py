@@ -1,3 +1,9 @@
 # dunder init
 
+from .b_plus_bytes_set import BPlusBytesSet
+from .b_plus_multiset import BPlusMultiset
+from .b_plus_paged_set import BPlusPagedSet
 from .b_plus_set import BPlusSet
+from .b_plus_snapshot import BPlusSnapshot
+from .b_plus_sorted_set import BPlusSortedSet
+from .c import get_pymalloc, get_threads, set_pymalloc, set_threads
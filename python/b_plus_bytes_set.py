@@ -0,0 +1,24 @@
+import five_one_one_bplus.c
+
+class BPlusBytesSet(five_one_one_bplus.c.BPlusBytesTree):
+    """
+    {BPlusBytesSet} is a set of bytes and strs that stores no Python objects.
+    The bytes of each element are copied into an arena owned by the set, and
+    its B Plus Tree holds just the hash, length and arena offset of each. This
+    takes a fraction of the memory of a {BPlusSet} of short strings, and
+    lookups compare bytes directly instead of calling {__eq__}. Elements are
+    created anew each time they are iterated over, in hash order.
+
+    :param iterable: An iterable containing bytes and strs to add to the set.
+    """
+
+    def __init__(self, *args):
+        if len(args) == 0:
+            initializer = None
+        elif len(args) == 1:
+            initializer = args[0]
+        else:
+            raise TypeError(
+                f"BPlusBytesSet expects at most 1 argument, got {len(args)}.",
+            )
+        super().__init__(initializer=initializer)
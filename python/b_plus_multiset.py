@@ -0,0 +1,30 @@
+import five_one_one_bplus.c
+
+class BPlusMultiset(five_one_one_bplus.c.BPlusCountedTree):
+    """
+    {BPlusMultiset} is a multiset, similar to {collections.Counter}.
+    "Under the hood" it is implemented as a B Plus Tree in C whose leaves
+    keep a count beside each element, so each distinct element is stored
+    once however many times it is added. As with {Counter}, {len()} is the
+    number of distinct elements, {m[x]} is the count of {x} (0 if it is not
+    in the multiset), and {+} and {-} add and subtract counts, dropping any
+    that fall below 1.
+
+    :param iterable: A mapping of elements to counts (such as a {Counter} or
+        another {BPlusMultiset}), or an iterable whose elements are each
+        counted once.
+    :param int b: the maximum number of child nodes per parent nodes in the
+        underlying B Plus Tree. Defaults to 16. Must be between 2 and 255
+        inclusive.
+    """
+
+    def __init__(self, *args, b=16):
+        if len(args) == 0:
+            initializer = None
+        elif len(args) == 1:
+            initializer = args[0]
+        else:
+            raise TypeError(
+                f"BPlusMultiset expects at most 1 argument, got {len(args)}.",
+            )
+        super().__init__(initializer=initializer, b=b)
@@ -0,0 +1,38 @@
+import five_one_one_bplus.c
+
+class BPlusPagedSet(five_one_one_bplus.c.BPlusPagedTree):
+    """
+    {BPlusPagedSet} is a set of int64 that can be larger than memory. The
+    leaves of its B Plus Tree are pages of a file, read through a page cache
+    of bounded size; only the branches of the tree are kept in memory.
+    Changes reach the file when pages are evicted from the cache, and all of
+    them on {BPlusPagedSet::flush()} or {BPlusPagedSet::close()}. Can be used
+    as a context manager, which closes the set on exit.
+
+    :param path: the file holding the set. It is created if it does not
+        exist, and otherwise opened with the elements it holds.
+    :param iterable: An iterable containing ints to add to the set.
+    :param int cache_bytes: the most memory used to cache pages of the file.
+        Defaults to 64 MiB. At least 4 pages are always cached.
+    """
+
+    def __init__(self, path, *args, cache_bytes=1 << 26):
+        if len(args) == 0:
+            initializer = None
+        elif len(args) == 1:
+            initializer = args[0]
+        else:
+            raise TypeError(
+                f"BPlusPagedSet expects at most 2 arguments, got {len(args) + 1}.",
+            )
+        super().__init__(
+            path,
+            initializer=initializer,
+            cache_bytes=cache_bytes,
+        )
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info):
+        self.close()
@@ -0,0 +1,15 @@
+import five_one_one_bplus.c
+
+class BPlusSnapshot(five_one_one_bplus.c.BPlusSnapshot):
+    """
+    {BPlusSnapshot} is a read-only set mapped from a snapshot file written by
+    {BPlusSet::save()}. Opening a snapshot only maps the file, so it takes the
+    same time however large the set is, and processes that open the same file
+    share its memory. Supports `in`, `len()` and iteration, which yields the
+    elements in the order of their stable hashes.
+
+    :param path: the path of the snapshot file.
+    """
+
+    def __init__(self, path):
+        super().__init__(path)
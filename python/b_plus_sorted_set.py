@@ -0,0 +1,33 @@
+import five_one_one_bplus.c
+
+class BPlusSortedSet(five_one_one_bplus.c.BPlusSortedTree):
+    """
+    {BPlusSortedSet} is a set whose elements are kept in sorted order.
+    "Under the hood" it is implemented as a B Plus Tree in C whose leaves are
+    ordered by the elements themselves rather than by their hashes, so that
+    the elements between two bounds can be found without sorting the set.
+
+    :param iterable: An iterable containing objects to add to the set.
+    :param key: a function of one argument used to extract a sort key from
+        each element, as with {sorted()}. Two elements with equal sort keys
+        are considered equal, so only the first of them is kept. Defaults to
+        None, which sorts the elements themselves.
+    :param int b: the maximum number of child nodes per parent nodes in the
+        underlying B Plus Tree. Defaults to 16. Must be between 2 and 255
+        inclusive.
+    """
+
+    def __init__(self, *args, key=None, b=16):
+        if len(args) == 0:
+            initializer = None
+        elif len(args) == 1:
+            initializer = args[0]
+        else:
+            raise TypeError(
+                f"BPlusSortedSet expects at most 1 argument, got {len(args)}.",
+            )
+        super().__init__(
+            initializer=initializer,
+            key=key,
+            b=b,
+        )
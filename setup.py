@@ -1,6 +1,7 @@
 """
 B-Plus Tree Functionality as a C extension
 """
+import glob
 import setuptools
 
 with open("README.md", "r") as f:
@@ -27,9 +28,20 @@ setuptools.setup(
             [
                 "c/general.c",
                 "c/array32.c",
+                "c/bpluscore.c",
                 "c/bplusnode.c",
                 "c/bplustree.c",
+                "c/bplussorted.c",
+                "c/bpluscursor.c",
+                "c/bpluspool.c",
+                "c/bplussnapshot.c",
+                "c/bpluspaged.c",
+                "c/bplusbytes.c",
+                "c/bpluscounted.c",
+                "c/bplustrace.c",
             ],
+            # rebuild when only a header changed, e.g. sdt.h
+            depends=glob.glob("c/*.h"),
         ),
     ],
     python_requires=">=3.10",
@@ -47,3 +47,46 @@ def test_basic_initializer_none_assert_not_contains(bplusset_factory):
 def test_basic_initializer_empty_list_assert_not_contains(bplusset_factory):
     res = bplusset_factory([])
     assert "foo" not in res
+
+def test_basic_constructor_arguments():
+    s = BPlusSet(range(10), b=8, compress=True, unboxed=True)
+    assert len(s) == 10
+    assert s.get_b() == 8
+    assert s.get_compress()
+    assert s.get_unboxed()
+    assert BPlusSet().get_b() == 16
+
+def test_basic_constructor_bad_arguments():
+    with pytest.raises(TypeError):
+        BPlusSet([1], [2])
+    with pytest.raises(TypeError):
+        BPlusSet(initializer=[1])
+    with pytest.raises(TypeError):
+        BPlusSet(b="8")
+    with pytest.raises(TypeError):
+        BPlusSet(b=1 << 70)
+    with pytest.raises(TypeError):
+        BPlusSet(1)
+
+def test_basic_subclass():
+    class MySet(BPlusSet):
+        def __init__(self, *args, extra=None, **kwargs):
+            super().__init__(*args, **kwargs)
+            self.extra = extra
+
+    s = MySet([1, 2, 2], b=4, extra="x")
+    assert isinstance(s, MySet)
+    assert len(s) == 2
+    assert s.get_b() == 4
+    assert s.extra == "x"
+    with pytest.raises(TypeError):
+        MySet([1], [2])
+
+def test_basic_add_arguments():
+    s = BPlusSet()
+    with pytest.raises(TypeError):
+        s.add()
+    with pytest.raises(TypeError):
+        s.add(1, 2)
+    with pytest.raises(TypeError):
+        s.add([1])
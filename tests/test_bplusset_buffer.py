@@ -0,0 +1,148 @@
+import ctypes
+import pytest
+import sys
+from array import array
+
+from five_one_one_bplus import BPlusSet
+from tests.utils import (
+    check_contains,
+    parametrized_b,
+    parametrized_range,
+    get_randints,
+    get_subset,
+)
+
+MODULUS = sys.hash_info.modulus
+
+# an int64 in the byte order this machine does not use
+FOREIGN_INT64 = ctypes.c_int64.__ctype_be__ if sys.byteorder == "little" else ctypes.c_int64.__ctype_le__
+
+# integers whose hashes collide with each other (or with other integers)
+COLLISIONS = [3, 3 + MODULUS, -3 - MODULUS, MODULUS, -1, -2, 2**62, -2**62]
+
+@parametrized_b
+@parametrized_range
+@pytest.mark.parametrize("unboxed", [False, True])
+def test_from_buffer(b, list_from_range, unboxed):
+    s = BPlusSet.from_buffer(array("q", list_from_range), b=b, unboxed=unboxed)
+    control = BPlusSet(list_from_range, b=b)
+
+    assert type(s) is BPlusSet
+    assert s.get_b() == b
+    assert s.get_unboxed() == unboxed
+    assert s == control
+    assert list(s) == list(control)
+    check_contains(s, set(list_from_range), list_from_range + [-5, 1 << 20])
+
+@parametrized_b
+@pytest.mark.parametrize("unboxed", [False, True])
+def test_from_buffer_duplicates(b, unboxed):
+    values = get_randints(num=2000)
+    values = [x % 5000 - 2500 for x in values + values[:500]]
+    values = [x for x in values if x != -1]
+    s = BPlusSet.from_buffer(array("q", values), b=b, unboxed=unboxed)
+
+    assert len(s) == len(set(values))
+    assert sorted(s) == sorted(set(values))
+
+@parametrized_b
+def test_from_buffer_collisions(b):
+    """
+    Tests that integers whose hashes are not themselves are hashed correctly
+    and that colliding hashes end up in collision lists.
+    """
+    values = COLLISIONS + list(range(-50, 50))
+    s = BPlusSet.from_buffer(array("q", values), b=b)
+
+    assert s == BPlusSet(values, b=b)
+    assert sorted(s) == sorted(set(values))
+    check_contains(s, set(values), COLLISIONS + [3 + 2 * MODULUS])
+
+@pytest.mark.parametrize("value", [-1, MODULUS, -MODULUS, 2**62])
+def test_from_buffer_unboxed_bad_value(value):
+    with pytest.raises(ValueError):
+        BPlusSet.from_buffer(array("q", [1, 2, value]), unboxed=True)
+
+def test_from_buffer_bad_format():
+    with pytest.raises(TypeError):
+        BPlusSet.from_buffer(array("i", [1, 2, 3]))
+    with pytest.raises(TypeError):
+        BPlusSet.from_buffer((FOREIGN_INT64 * 3)(1, 2, 3))
+
+def test_from_buffer_explicit_byte_order():
+    assert list(BPlusSet.from_buffer((ctypes.c_int64 * 3)(3, 1, 2), unboxed=True)) == [1, 2, 3]
+
+def test_from_buffer_empty():
+    assert len(BPlusSet.from_buffer(array("q"))) == 0
+    assert len(BPlusSet.from_buffer(array("q"), unboxed=True)) == 0
+
+def test_from_buffer_subclass():
+    class MySet(BPlusSet):
+        pass
+
+    assert type(MySet.from_buffer(array("q", [1, 2]))) is MySet
+
+@parametrized_b
+def test_unboxed_add(b):
+    s = BPlusSet(b=b, unboxed=True)
+    values = get_randints(num=1000)
+    values = [x % (MODULUS - 1) for x in values]
+    for x in values:
+        s.add(x)
+    s.add(True)
+
+    assert len(s) == len(set(values) | {1})
+    assert sorted(s) == sorted(set(values) | {1})
+    check_contains(s, set(values) | {1}, get_subset(s) + [1.0, True, 2**62, "a"])
+
+@pytest.mark.parametrize("value, error", [
+    ("a", TypeError),
+    (1.0, TypeError),
+    (-1, ValueError),
+    (MODULUS, ValueError),
+    (-MODULUS, ValueError),
+    (2**100, ValueError),
+])
+def test_unboxed_add_bad_value(value, error):
+    s = BPlusSet([1, 2, 3], unboxed=True)
+    with pytest.raises(error):
+        s.add(value)
+    assert s == BPlusSet([1, 2, 3])
+
+@parametrized_b
+@parametrized_range
+def test_unboxed_init(b, list_from_range):
+    s = BPlusSet(list_from_range, b=b, unboxed=True)
+
+    assert s.get_unboxed()
+    assert s == BPlusSet(list_from_range)
+    assert BPlusSet(list_from_range) == s
+    assert BPlusSet(s) == s
+    assert BPlusSet(s, unboxed=True) == s
+    assert BPlusSet(s, unboxed=True).get_unboxed()
+
+@parametrized_b
+def test_unboxed_bulk(b):
+    """
+    Tests that the bulk readers, cursors and compaction all handle the
+    elements of an unboxed tree.
+    """
+    values = list(range(-5000, 5000, 3))
+    s = BPlusSet(values, b=b, unboxed=True)
+    ordered = list(s)
+
+    assert s.to_list() == ordered
+    assert [x for chunk in s.iter_chunks(7) for x in chunk] == ordered
+
+    c = s.cursor()
+    assert c.next_batch(10) == ordered[:10]
+    assert c.prev_batch(3) == ordered[9:6:-1]
+    c.seek(ordered[100])
+    assert next(c) == ordered[100]
+
+    buffer = array("q", bytes(8 * len(s)))
+    assert s.hashes(buffer) == len(s)
+    assert list(buffer) == ordered
+
+    s.compact()
+    assert list(s) == ordered
@@ -0,0 +1,133 @@
+import pytest
+import tracemalloc
+
+from five_one_one_bplus import BPlusBytesSet
+from tests.utils import (
+    parametrized_range,
+    get_randostrs,
+    get_subset,
+)
+
+class HashedStr(str):
+    def __hash__(self):
+        return 511
+
+@parametrized_range
+def test_bytes_range(list_from_range):
+    values = [str(x) for x in list_from_range] + [str(x).encode() for x in list_from_range]
+    s = BPlusBytesSet(values)
+
+    assert len(s) == len(values)
+    assert sorted(s, key=repr) == sorted(values, key=repr)
+    for x in values:
+        assert x in s
+    assert "missing" not in s
+
+def test_bytes_random():
+    values = get_randostrs(num=20_000) + [x.encode() for x in get_randostrs(num=5000)]
+    values += values[:1000]
+    s = BPlusBytesSet(values)
+    control = set(values)
+
+    assert len(s) == len(control)
+    assert list(s) == list(BPlusBytesSet(list(s)))
+    assert set(s) == control
+    for x in get_subset(values):
+        assert x in s
+    for x in get_randostrs():
+        assert (x in s) == (x in control)
+
+def test_bytes_str_and_bytes_differ():
+    s = BPlusBytesSet(["foo", b"bar", "", "föö \U0001f600"])
+
+    assert "foo" in s and b"foo" not in s
+    assert b"bar" in s and "bar" not in s
+    assert "" in s and b"" not in s
+    assert "föö \U0001f600" in s
+    assert "föö \U0001f600".encode() not in s
+    assert set(s) == {"foo", b"bar", "", "föö \U0001f600"}
+
+def test_bytes_other_types():
+    s = BPlusBytesSet(["1"])
+
+    assert 1 not in s
+    assert None not in s
+    assert HashedStr("1") in s
+    with pytest.raises(TypeError):
+        s.add(1)
+    with pytest.raises(TypeError):
+        BPlusBytesSet(["a", 1])
+
+def test_bytes_subclass_elements():
+    s = BPlusBytesSet([HashedStr("foo"), b"x"])
+
+    assert "foo" in s
+    assert [type(x) for x in sorted(s, key=repr)] == [str, bytes]
+
+def test_bytes_add_while_iterating():
+    s = BPlusBytesSet(get_randostrs(num=2000))
+    seen = []
+    for ix, x in enumerate(s):
+        seen.append(x)
+        if ix % 100 == 0:
+            s.update(get_randostrs(num=50))
+
+    assert len(seen) == len(set(seen))
+    assert set(seen) <= set(s)
+
+def test_bytes_nbytes():
+    s = BPlusBytesSet()
+    empty_nodes, empty_arena = s.get_nbytes()
+    s.update(b"%06d" % x for x in range(100_000))
+    nodes, arena = s.get_nbytes()
+
+    assert empty_arena == 0
+    assert arena >= 600_000
+    # well under the ~40 bytes of each bytes object alone
+    assert nodes < 40 * 100_000
+
+def test_bytes_sizeof():
+    s = BPlusBytesSet()
+    base = object.__sizeof__(s)
+
+    assert s.__sizeof__() == base + sum(s.get_nbytes())
+    s.update(b"%06d" % x for x in range(10_000))
+    assert s.__sizeof__() == base + sum(s.get_nbytes())
+    assert s.__sizeof__() > base + 60_000
+
+def test_bytes_traced():
+    tracemalloc.start()
+    try:
+        before = tracemalloc.get_traced_memory()[0]
+        s = BPlusBytesSet(b"%06d" % x for x in range(10_000))
+        after = tracemalloc.get_traced_memory()[0]
+    finally:
+        tracemalloc.stop()
+
+    assert after - before >= sum(s.get_nbytes())
+
+def test_bytes_new_without_init():
+    s = BPlusBytesSet.__new__(BPlusBytesSet)
+
+    assert len(s) == 0
+    assert list(s) == []
+    assert b"x" not in s
+    assert s.get_nbytes() == BPlusBytesSet().get_nbytes()
+    s.add(b"x")
+    assert list(s) == [b"x"]
+
+def test_bytes_reinit():
+    s = BPlusBytesSet([b"a", "b"])
+    nbytes = BPlusBytesSet(["c"]).get_nbytes()
+    s.__init__(["c"])
+
+    assert list(s) == ["c"]
+    assert s.get_nbytes() == nbytes
+
+def test_bytes_lone_surrogate():
+    s = BPlusBytesSet(["a", b"\xed\xa0\x80"])
+
+    assert "\ud800" not in s
+    with pytest.raises(UnicodeEncodeError):
+        s.add("\ud800")
+    assert len(s) == 2
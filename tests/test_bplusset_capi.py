@@ -0,0 +1,122 @@
+import ctypes
+
+import pytest
+
+import five_one_one_bplus.c
+from five_one_one_bplus import BPlusSet
+from tests.utils import (
+    parametrized_b,
+    get_randostrs,
+    get_subset,
+)
+
+# the table of function pointers in bplusapi.h, called through ctypes with
+# the GIL held
+VISIT = ctypes.PYFUNCTYPE(ctypes.c_int, ctypes.py_object, ctypes.c_ssize_t, ctypes.c_void_p)
+
+class BPlusCAPI(ctypes.Structure):
+    _fields_ = [
+        ("version", ctypes.c_int),
+        ("size", ctypes.c_size_t),
+        ("TreeType", ctypes.c_void_p),
+        ("insert", ctypes.PYFUNCTYPE(ctypes.c_int, ctypes.py_object, ctypes.py_object, ctypes.c_ssize_t)),
+        ("contains", ctypes.PYFUNCTYPE(ctypes.c_int, ctypes.py_object, ctypes.py_object, ctypes.c_ssize_t)),
+        ("insert_many", ctypes.PYFUNCTYPE(
+            ctypes.c_ssize_t, ctypes.py_object, ctypes.POINTER(ctypes.py_object),
+            ctypes.POINTER(ctypes.c_ssize_t), ctypes.c_ssize_t,
+        )),
+        ("contains_many", ctypes.PYFUNCTYPE(
+            ctypes.c_ssize_t, ctypes.py_object, ctypes.POINTER(ctypes.py_object),
+            ctypes.POINTER(ctypes.c_ssize_t), ctypes.c_ssize_t, ctypes.c_char_p,
+        )),
+        ("visit", ctypes.PYFUNCTYPE(ctypes.c_int, ctypes.py_object, VISIT, ctypes.c_void_p)),
+    ]
+
+@pytest.fixture
+def capi():
+    get_pointer = ctypes.pythonapi.PyCapsule_GetPointer
+    get_pointer.restype = ctypes.c_void_p
+    get_pointer.argtypes = [ctypes.py_object, ctypes.c_char_p]
+    pointer = get_pointer(five_one_one_bplus.c._C_API, b"five_one_one_bplus.c._C_API")
+    return BPlusCAPI.from_address(pointer)
+
+def as_arrays(items):
+    return (
+        (ctypes.py_object * len(items))(*items),
+        (ctypes.c_ssize_t * len(items))(*map(hash, items)),
+    )
+
+def test_capi_table(capi):
+    assert capi.version >= 1
+    assert capi.size >= ctypes.sizeof(BPlusCAPI)
+    assert capi.TreeType == id(five_one_one_bplus.c.BPlusTree)
+
+@parametrized_b
+def test_capi_insert_contains(capi, b):
+    values = get_randostrs(num=500)
+    s = BPlusSet(b=b)
+
+    for x in values:
+        assert capi.insert(s, x, hash(x)) == 1
+    assert capi.insert(s, values[0], hash(values[0])) == 0
+    assert set(s) == set(values)
+    for x in get_subset(values):
+        assert capi.contains(s, x, hash(x)) == 1
+    assert capi.contains(s, "missing", hash("missing")) == 0
+
+def test_capi_unboxed(capi):
+    s = BPlusSet(range(10), unboxed=True)
+
+    assert capi.insert(s, 511, hash(511)) == 1
+    assert capi.contains(s, 511, hash(511)) == 1
+    assert capi.contains(s, 511.0, hash(511.0)) == 1
+    assert capi.contains(s, 512, hash(512)) == 0
+    with pytest.raises(TypeError):
+        capi.insert(s, "foo", hash("foo"))
+
+def test_capi_batches(capi):
+    values = get_randostrs(num=1000)
+    s = BPlusSet(values[:600])
+
+    items, hashes = as_arrays(values)
+    out = ctypes.create_string_buffer(b"\xff" * ((len(values) + 7) // 8))
+    assert capi.contains_many(s, items, hashes, len(values), out) == 600
+    bits = int.from_bytes(out.raw, "little")
+    assert [bool(bits >> ix & 1) for ix in range(len(values))] == [x in s for x in values]
+
+    assert capi.insert_many(s, items, hashes, len(values)) == 400
+    assert set(s) == set(values)
+
+def test_capi_visit(capi):
+    s = BPlusSet(get_randostrs(num=1000) + [1, 1.5], b=8)
+    seen = []
+
+    def visit(o, h, arg):
+        seen.append((o, h))
+        return 0
+    assert capi.visit(s, VISIT(visit), None) == 0
+    assert [o for o, h in seen] == list(s)
+    assert all(hash(o) == h for o, h in seen)
+
+    def stop(o, h, arg):
+        seen.append(o)
+        return 7
+    seen = []
+    assert capi.visit(s, VISIT(stop), None) == 7
+    assert len(seen) == 1
+
+def test_capi_visit_locks_tree(capi):
+    s = BPlusSet(range(100), b=4)
+    errors = []
+
+    def visit(o, h, arg):
+        try:
+            s.add(-o - 1)
+        except RuntimeError as e:
+            errors.append(e)
+        return 0
+    assert capi.visit(s, VISIT(visit), None) == 0
+    assert len(errors) == 100
+    assert len(s) == 100
+    s.add(-1)
+    assert -1 in s
@@ -0,0 +1,87 @@
+import pytest
+import sys
+
+from tests.utils import (
+    parametrized_b,
+    parametrized_range,
+    check_contains,
+    get_subset,
+    get_randints,
+)
+
+@parametrized_b
+def test_compact_empty(bplusset_empty):
+    """
+    Tests that a BPlusSet is able to:
+        1. be initialized as empty
+        2. be compacted
+        3. be converted to a list
+    """
+    s = bplusset_empty
+    s.compact()
+
+    assert len(s) == 0
+    assert list(s) == []
+
+@parametrized_b
+@parametrized_range
+def test_compact_assert_contains(bplusset_factory, set_from_range):
+    """
+    Tests that a BPlusSet is able to:
+        1. be initialized from a non-empty iterable
+        2. be compacted
+        3. the `in` keyword works as expected
+        4. be converted to a list
+    """
+    s = bplusset_factory(set_from_range)
+    s.compact()
+
+    check_contains(s, set_from_range, get_subset(set_from_range))
+    check_contains(s, set_from_range, get_randints())
+    assert sorted(s) == sorted(set_from_range)
+
+@parametrized_b
+@pytest.mark.parametrize("fill_factor", [0.01, 0.5, 0.75, 1.0])
+def test_compact_then_add(bplusset_factory, fill_factor):
+    """
+    Tests that a BPlusSet is able to:
+        1. be initialized from an iterable that has a collision
+        2. be compacted at {fill_factor}
+        3. have elements added to it
+        4. the `in` keyword and len() work as expected
+    """
+    control = set(range(1000)) | {sys.maxsize}
+    s = bplusset_factory(control)
+    s.compact(fill_factor=fill_factor)
+
+    assert len(s) == len(control)
+    assert s == bplusset_factory(control)
+
+    for x in range(-1000, 0):
+        s.add(x)
+        control.add(x)
+
+    assert len(s) == len(control)
+    check_contains(s, control, get_subset(control))
+    assert sorted(s) == sorted(control)
+
+@parametrized_b
+def test_compact_reports_bytes(bplusset_factory):
+    """
+    Tests that compact() reports the memory used before and after, and that a
+    full compaction of a tree built by random inserts does not grow it.
+    """
+    s = bplusset_factory(get_randints(num=4096))
+
+    before, after = s.compact()
+    assert after <= before
+
+    again_before, again_after = s.compact()
+    assert again_before == after
+    assert again_after == after
+
+@parametrized_b
+@pytest.mark.parametrize("fill_factor", [0.0, -1.0, 1.5])
+def test_compact_bad_fill_factor(bplusset_empty, fill_factor):
+    with pytest.raises(ValueError):
+        bplusset_empty.compact(fill_factor=fill_factor)
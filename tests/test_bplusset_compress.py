@@ -0,0 +1,80 @@
+import pytest
+import sys
+
+from five_one_one_bplus import BPlusSet
+
+from tests.utils import (
+    parametrized_b,
+    parametrized_range,
+    check_contains,
+    get_subset,
+    get_randints,
+)
+
+@pytest.fixture(scope="function")
+def compressed_factory(b):
+    return lambda initializer: BPlusSet(initializer, b=b, compress=True)
+
+@parametrized_b
+def test_compress_flag(compressed_factory, bplusset_factory):
+    assert compressed_factory(None).get_compress() is True
+    assert bplusset_factory(None).get_compress() is False
+
+@parametrized_b
+@parametrized_range
+def test_compress_initializer_assert_contains(compressed_factory, set_from_range):
+    """
+    Tests that a compressed BPlusSet is able to:
+        1. be initialized from a non-empty iterable
+        2. the `in` keyword works as expected
+        3. be converted to a list
+    """
+    s = compressed_factory(set_from_range)
+
+    check_contains(s, set_from_range, get_subset(set_from_range))
+    check_contains(s, set_from_range, get_randints())
+    assert sorted(s) == sorted(set_from_range)
+
+@parametrized_b
+@parametrized_range
+def test_compress_equals_uncompressed(compressed_factory, bplusset_factory, list_from_range):
+    """
+    Tests that a compressed BPlusSet compares equal to an uncompressed
+    BPlusSet with the same contents, before and after compaction.
+    """
+    control = list_from_range + [sys.maxsize]
+    s = compressed_factory(control)
+
+    assert s == bplusset_factory(control)
+    s.compact()
+    assert s == bplusset_factory(control)
+
+@parametrized_b
+def test_compress_widen_leaves(compressed_factory):
+    """
+    Tests that a compressed BPlusSet is able to:
+        1. be built from a dense range of hashes and compacted
+        2. have elements added whose hashes fall far outside each leaf's range
+        3. the `in` keyword and len() work as expected
+    """
+    control = set(range(4096))
+    s = compressed_factory(control)
+    s.compact()
+
+    for x in get_randints(num=512) + [-x for x in get_randints(num=512)]:
+        s.add(x)
+        control.add(x)
+
+    assert len(s) == len(control)
+    check_contains(s, control, get_subset(control, num=1000))
+    assert sorted(s) == sorted(control)
+
+@parametrized_b
+def test_compress_saves_memory(compressed_factory, bplusset_factory):
+    """
+    Tests that compacting a dense range uses less memory when compressed.
+    """
+    _, compressed = compressed_factory(range(4096)).compact()
+    _, uncompressed = bplusset_factory(range(4096)).compact()
+
+    assert compressed < uncompressed
@@ -246,3 +246,113 @@ def test_range_initializer_with_large_number_of_collisions_assert_not_contains(b
     s = bplusset_factory(control)
 
     check_contains(s, control, list(range(500, 555)))
+
+# equality tests: elements found by an equal object that is not the same one
+
+@parametrized_b
+def test_equal_copies_contains(bplusset_factory):
+    """
+    Tests that equal str, bytes, int, float and tuple elements are found by
+    copies of themselves, and are not added twice.
+    """
+    elements = [
+        "abc", "été", "中文", "\U0001f600", "",
+        b"xyz",
+        12345, -(1 << 100), 1 << 70,
+        2.5,
+        ("abc", 1, 2.5, b"x"), (), (("nested",), 1 << 80),
+    ]
+    s = bplusset_factory(elements)
+    # build copies that are equal but not identical
+    copies = [
+        "".join(["ab", "c"]), "ét" + "é", "中" + "文", "\U0001f600" + "", "",
+        bytes(bytearray(b"xyz")),
+        int("12345"), -(1 << 100), (1 << 70) + 0,
+        float("2.5"),
+        tuple(["ab" + "c", 1, 2.5, b"x"]), tuple([]), ((("nest" + "ed"),), (1 << 80) + 0),
+    ]
+    for x in copies:
+        assert x in s
+        s.add(x)
+    assert len(s) == len(elements)
+
+    for x in ("abd", "étè", b"xyw", 12346, (1 << 70) + 1, 2.25, ("abc", 1, 2.5, b"y"), ("abc",)):
+        assert x not in s
+
+@parametrized_b
+def test_equal_across_types_contains(bplusset_factory):
+    """
+    Tests that elements of different types that compare equal, or subclasses
+    with their own __eq__, are still compared with __eq__.
+    """
+    class Insensitive(str):
+        def __eq__(self, other):
+            return str.lower(self) == str.lower(other)
+        def __hash__(self):
+            return hash(str.lower(self))
+
+    s = bplusset_factory([1, 2.0, (3, 4.0), Insensitive("abc")])
+    assert 1.0 in s
+    assert True in s
+    assert 2 in s
+    assert (3.0, 4) in s
+    assert "abc" in s
+    assert Insensitive("ABC") in s
+    assert len(s) == 4
+
+@parametrized_b
+def test_equal_colliding_contains(bplusset_factory):
+    """
+    Tests that elements whose hashes collide are told apart, in the slot and
+    in its collision list.
+    """
+    # -1 and -2 both hash to -2; 1, 2**61 and 2**122 hash to 1, as do the
+    # tuples of them
+    s = bplusset_factory([-2, 1, (1,)])
+    for x in (-1, 1 << 61, 1 << 122, (1 << 61,)):
+        assert x not in s
+        s.add(x)
+        assert x in s
+    for x in (-1, -2, 1, 1 << 61, 1 << 122):
+        assert int(str(x)) in s
+    assert (1 << 183) not in s
+    assert len(s) == 7
+
+@parametrized_b
+def test_equal_raising_contains(bplusset_factory):
+    """
+    Tests that an error raised by __eq__ while comparing against an element
+    with the same hash, in the slot or in its collision list, propagates from
+    `in` and add().
+    """
+    class Raising:
+        def __eq__(self, other):
+            raise ZeroDivisionError
+        def __hash__(self):
+            return 1
+
+    s = bplusset_factory([1])
+    with pytest.raises(ZeroDivisionError):
+        Raising() in s
+    with pytest.raises(ZeroDivisionError):
+        s.add(Raising())
+    assert len(s) == 1
+
+    # 2**61 hashes to 1 as well, so the slot becomes a collision list
+    s.add(1 << 61)
+    with pytest.raises(ZeroDivisionError):
+        Raising() in s
+    with pytest.raises(ZeroDivisionError):
+        s.add(Raising())
+    assert len(s) == 2
+
+@parametrized_b
+def test_unhashable_contains(bplusset_factory):
+    """
+    Tests that `in` passes on the TypeError from hashing an unhashable object.
+    """
+    s = bplusset_factory([1, 2, 3])
+    for x in ([], {}, set(), ([1],)):
+        with pytest.raises(TypeError):
+            x in s
+    assert 1 in s
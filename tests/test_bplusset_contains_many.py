@@ -0,0 +1,94 @@
+import ctypes
+import pytest
+import sys
+import threading
+from array import array
+
+from five_one_one_bplus import BPlusSet
+from tests.utils import (
+    parametrized_b,
+    parametrized_range,
+    get_randints,
+)
+
+# an int64 in the byte order this machine does not use
+FOREIGN_INT64 = ctypes.c_int64.__ctype_be__ if sys.byteorder == "little" else ctypes.c_int64.__ctype_le__
+
+def unpack(bitmap, n):
+    return [(bitmap[ix >> 3] >> (ix & 7)) & 1 for ix in range(n)]
+
+@parametrized_b
+@parametrized_range
+@pytest.mark.parametrize("compress", [False, True])
+def test_contains_many(b, list_from_range, compress):
+    s = BPlusSet(list_from_range, b=b, compress=compress, unboxed=True)
+    probes = list(range(-10, 2100)) + [-1, 1 << 62, -(1 << 62)]
+    bitmap = s.contains_many(array("q", probes))
+
+    assert type(bitmap) is bytearray
+    assert len(bitmap) == (len(probes) + 7) // 8
+    assert unpack(bitmap, len(probes)) == [int(x in s) for x in probes]
+
+@pytest.mark.parametrize("threads", [None, 1, 2, 7])
+def test_contains_many_threads(threads):
+    values = [x % 1_000_000 for x in get_randints(num=50_000)]
+    s = BPlusSet(values, b=32, unboxed=True)
+    control = set(values)
+    probes = [x % 1_100_000 for x in get_randints(num=100_003)]
+    bitmap = s.contains_many(array("q", probes), threads=threads)
+
+    assert unpack(bitmap, len(probes)) == [int(x in control) for x in probes]
+
+def test_contains_many_out():
+    s = BPlusSet([1, 2, 3], unboxed=True)
+    out = bytearray(b"\xff" * 4)
+
+    assert s.contains_many(array("q", [1, 5, 3, -1, 2]), out=out) is out
+    assert out == bytearray(b"\x15\xff\xff\xff")
+
+def test_contains_many_explicit_byte_order():
+    s = BPlusSet([1, 3], unboxed=True)
+
+    assert s.contains_many((ctypes.c_int64 * 4)(0, 1, 2, 3)) == bytearray(b"\x0a")
+
+def test_contains_many_empty():
+    assert BPlusSet(unboxed=True).contains_many(array("q", [1, 2])) == bytearray(1)
+    assert BPlusSet([1], unboxed=True).contains_many(array("q")) == bytearray()
+
+@pytest.mark.parametrize("call, error", [
+    (lambda: BPlusSet([1]).contains_many(array("q", [1])), TypeError),
+    (lambda: BPlusSet([1], unboxed=True).contains_many(array("i", [1])), TypeError),
+    (lambda: BPlusSet([1], unboxed=True).contains_many(array("q", [1] * 9), out=bytearray(1)), ValueError),
+    (lambda: BPlusSet([1], unboxed=True).contains_many(array("q", [1]), out=b"\x00"), BufferError),
+    (lambda: BPlusSet([1], unboxed=True).contains_many(array("q", [1]), threads=0), ValueError),
+    (lambda: BPlusSet([1], unboxed=True).contains_many(array("q", [1]), threads=(1 << 32) + 4), ValueError),
+    (lambda: BPlusSet([1], unboxed=True).contains_many(array("q", [1]), threads=1 << 64), OverflowError),
+    (lambda: BPlusSet([1], unboxed=True).contains_many((FOREIGN_INT64 * 1)(1)), TypeError),
+])
+def test_contains_many_bad_args(call, error):
+    with pytest.raises(error):
+        call()
+
+def test_contains_many_guard():
+    """
+    Tests that adds racing a batch lookup on another thread either go through
+    or raise RuntimeError, and never change the tree under the lookup.
+    """
+    s = BPlusSet(range(0, 400_000, 2), unboxed=True)
+    probes = array("q", range(400_000)) * 10
+    expected = unpack(s.contains_many(probes[:400_000]), 400_000) * 10
+    results = []
+
+    worker = threading.Thread(target=lambda: results.append(s.contains_many(probes)))
+    worker.start()
+    added = []
+    while worker.is_alive():
+        try:
+            s.add(1_000_001 + 2 * len(added))
+            added.append(True)
+        except RuntimeError:
+            pass
+    worker.join()
+
+    assert unpack(results[0], len(probes)) == expected
+    assert len(s) == 200_000 + len(added)
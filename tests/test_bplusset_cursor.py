@@ -0,0 +1,137 @@
+import pytest
+import sys
+
+from tests.utils import (
+    parametrized_b,
+    parametrized_range,
+    get_randints,
+)
+
+# integers sharing the hash of 3
+COLLISIONS = [3, 3 + sys.hash_info.modulus, 3 + 2 * sys.hash_info.modulus]
+
+def drain(cursor, batch, forward=True):
+    res = []
+    while True:
+        chunk = cursor.next_batch(batch) if forward else cursor.prev_batch(batch)
+        if not chunk:
+            return res
+        res += chunk
+
+@parametrized_b
+def test_cursor_empty(bplusset_empty):
+    c = bplusset_empty.cursor()
+
+    assert c.next_batch(10) == []
+    assert c.prev_batch(10) == []
+    assert list(c) == []
+
+@parametrized_b
+@parametrized_range
+@pytest.mark.parametrize("batch", [1, 7, 100])
+def test_cursor_batches(bplusset_factory, list_from_range, batch):
+    """
+    Tests that a cursor is able to:
+        1. page forward through every element in iteration order
+        2. page back through them again in reverse order
+    """
+    s = bplusset_factory(list_from_range + COLLISIONS)
+    c = s.cursor()
+
+    forward = drain(c, batch)
+    assert forward == list(s)
+    assert drain(c, batch, forward=False) == forward[::-1]
+
+@parametrized_b
+def test_cursor_iter(bplusset_factory):
+    s = bplusset_factory(get_randints(num=1000) + COLLISIONS)
+    c = s.cursor()
+
+    head = c.next_batch(10)
+    assert head + list(c) == list(s)
+
+@parametrized_b
+def test_cursor_token(bplusset_factory):
+    """
+    Tests that a cursor created from the token of another cursor carries on
+    from where the other cursor was.
+    """
+    s = bplusset_factory(get_randints(num=1000) + COLLISIONS)
+    order = list(s)
+
+    for stop in [0, 1, 500, len(order) - 1, len(order)]:
+        c = s.cursor()
+        c.next_batch(stop)
+        assert isinstance(c.token(), bytes)
+        assert drain(s.cursor(c.token()), 64) == order[stop:]
+
+@parametrized_b
+@pytest.mark.parametrize("compact", [False, True])
+def test_cursor_survives_changes(bplusset_factory, compact):
+    """
+    Tests that a cursor, and a token taken from it, resume from the same
+    element after the tree has been split by inserts and rebuilt.
+    """
+    s = bplusset_factory(get_randints(num=1000) + COLLISIONS)
+    c = s.cursor()
+    c.next_batch(300)
+    token = c.token()
+    following = c.next_batch(1)[0]
+    c.prev_batch(1)
+
+    for x in get_randints(num=5000):
+        s.add(x)
+    if compact:
+        s.compact()
+
+    order = list(s)
+    expected = order[order.index(following):]
+    assert drain(c, 100) == expected
+    assert drain(s.cursor(token), 100) == expected
+
+@parametrized_b
+def test_cursor_seek(bplusset_factory):
+    s = bplusset_factory(list(range(1000)) + COLLISIONS)
+    order = list(s)
+    c = s.cursor()
+
+    for x in [0, 999, 500] + COLLISIONS:
+        c.seek(x)
+        assert c.next_batch(3) == order[order.index(x):order.index(x)+3]
+
+    c.seek(hash=500)
+    assert next(c) == 500
+    c.seek(hash=sys.maxsize)
+    assert c.next_batch(1) == []
+    assert c.prev_batch(1) == [order[-1]]
+
+@parametrized_b
+def test_cursor_seek_reinit_during_comparison(bplusset_factory):
+    """
+    Tests that seek() survives an __eq__ that re-initializes the set and so
+    releases the collision list being searched.
+    """
+    s = bplusset_factory(COLLISIONS + [5])
+
+    class Probe:
+        def __hash__(self):
+            return 3
+        def __eq__(self, other):
+            s.__init__(range(1000))
+            return False
+
+    c = s.cursor()
+    c.seek(Probe())
+    # the cursor is just before hash 3 in the re-initialized set
+    assert c.next_batch(2) == [3, 4]
+
+@parametrized_b
+def test_cursor_bad_arguments(bplusset_factory):
+    s = bplusset_factory([1, 2, 3])
+
+    with pytest.raises(TypeError):
+        s.cursor().seek()
+    with pytest.raises(TypeError):
+        s.cursor().seek(1, hash=1)
+    with pytest.raises(ValueError):
+        s.cursor(b"not a token")
@@ -0,0 +1,98 @@
+import ctypes
+import pytest
+import sys
+from array import array
+
+from tests.utils import (
+    parametrized_b,
+    parametrized_range,
+    get_randints,
+    get_randostrs,
+)
+
+# an int64 in the byte order this machine does not use
+FOREIGN_INT64 = ctypes.c_int64.__ctype_be__ if sys.byteorder == "little" else ctypes.c_int64.__ctype_le__
+
+# integers sharing the hash of 3
+COLLISIONS = [3, 3 + sys.hash_info.modulus, 3 + 2 * sys.hash_info.modulus]
+
+@parametrized_b
+@parametrized_range
+def test_to_list(bplusset_factory, list_from_range):
+    s = bplusset_factory(list_from_range + COLLISIONS)
+
+    assert s.to_list() == list(s)
+
+@parametrized_b
+@pytest.mark.parametrize("n", [1, 3, 16, 1000, 100000])
+def test_iter_chunks(bplusset_factory, n):
+    """
+    Tests that iter_chunks() yields tuples of {n} elements (apart from the
+    last one) that together hold the elements in iteration order.
+    """
+    s = bplusset_factory(get_randints(num=5000) + get_randostrs(num=100) + COLLISIONS)
+    chunks = list(s.iter_chunks(n))
+
+    assert all(type(chunk) is tuple for chunk in chunks)
+    assert all(len(chunk) == n for chunk in chunks[:-1])
+    assert 0 < len(chunks[-1]) <= n
+    assert [x for chunk in chunks for x in chunk] == list(s)
+
+@parametrized_b
+def test_iter_chunks_empty(bplusset_empty):
+    assert list(bplusset_empty.iter_chunks(10)) == []
+
+@parametrized_b
+def test_iter_chunks_bad_n(bplusset_empty):
+    with pytest.raises(ValueError):
+        bplusset_empty.iter_chunks(0)
+
+@parametrized_b
+@parametrized_range
+def test_hashes(bplusset_factory, list_from_range):
+    """
+    Tests that hashes() fills a buffer with the hash of each element, lined up
+    with iteration order, including each element of a collision list.
+    """
+    s = bplusset_factory(list_from_range + COLLISIONS + get_randostrs(num=10))
+    buffer = array("q", bytes(8 * (len(s) + 5)))
+
+    assert s.hashes(buffer) == len(s)
+    assert list(buffer[:len(s)]) == [hash(x) for x in s]
+    assert list(buffer[len(s):]) == [0] * 5
+
+@parametrized_b
+def test_hashes_after_add(bplusset_factory):
+    s = bplusset_factory(range(100))
+    for x in COLLISIONS:
+        s.add(x)
+    buffer = array("q", bytes(8 * len(s)))
+
+    s.hashes(buffer)
+    assert list(buffer) == [hash(x) for x in s]
+
+@parametrized_b
+def test_hashes_bad_buffer(bplusset_factory):
+    s = bplusset_factory(range(10))
+
+    with pytest.raises(ValueError):
+        s.hashes(array("q", bytes(8 * 9)))
+    with pytest.raises(TypeError):
+        s.hashes(array("i", bytes(4 * 20)))
+    with pytest.raises(BufferError):
+        s.hashes(bytes(8 * 10))
+    with pytest.raises(TypeError):
+        s.hashes((FOREIGN_INT64 * 10)())
+
+@parametrized_b
+def test_hashes_explicit_byte_order(bplusset_factory):
+    """
+    Tests that hashes() takes a buffer whose format spells out the native byte
+    order, as ctypes does.
+    """
+    s = bplusset_factory(range(10))
+    buffer = (ctypes.c_int64 * 10)()
+
+    assert memoryview(buffer).format[0] in "<>"
+    assert s.hashes(buffer) == 10
+    assert list(buffer) == [hash(x) for x in s]
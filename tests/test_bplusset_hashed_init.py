@@ -0,0 +1,71 @@
+import pytest
+import sys
+
+from five_one_one_bplus import BPlusSet
+
+from tests.utils import (
+    parametrized_b,
+    parametrized_range,
+    check_contains,
+    get_subset,
+    get_randints,
+    get_randostrs,
+)
+
+# initializers that already store the hash of every element
+hashed_initializers = pytest.mark.parametrize(
+    "convert",
+    [set, frozenset, dict.fromkeys, BPlusSet, lambda x: BPlusSet(x, compress=True)],
+    ids=["set", "frozenset", "dict", "bplusset", "bplusset_compressed"],
+)
+
+@parametrized_b
+@parametrized_range
+@hashed_initializers
+def test_hashed_initializer_assert_contains(bplusset_factory, list_from_range, convert):
+    """
+    Tests that a BPlusSet is able to:
+        1. be initialized from a set, dict or BPlusSet containing a collision
+        2. compare equal to a BPlusSet initialized from a list
+        3. the `in` keyword and len() work as expected
+    """
+    control = list_from_range + [sys.maxsize, "foo", (1, "bar")]
+    s = bplusset_factory(convert(control))
+
+    assert len(s) == len(control)
+    assert s == bplusset_factory(control)
+    check_contains(s, set(control), get_subset(control) + get_randints())
+
+@parametrized_b
+@hashed_initializers
+def test_hashed_initializer_then_add(bplusset_factory, convert):
+    """
+    Tests that a BPlusSet initialized from a set, dict or BPlusSet is able to
+    have elements added to it.
+    """
+    control = set(get_randostrs(num=1000))
+    s = bplusset_factory(convert(control))
+
+    for x in get_randostrs(num=100):
+        s.add(x)
+        control.add(x)
+
+    assert len(s) == len(control)
+    assert sorted(s) == sorted(control)
+
+@parametrized_b
+def test_hashed_initializer_does_not_share_collisions(bplusset_factory):
+    """
+    Tests that a BPlusSet copied from another BPlusSet with a collision is not
+    affected by adding to the original.
+    """
+    original = bplusset_factory([3, sys.maxsize])
+    copy = bplusset_factory(original)
+
+    # another integer with the same hash as 3
+    collision = 3 + 2 * sys.hash_info.modulus
+    assert hash(collision) == hash(3)
+    original.add(collision)
+
+    assert len(copy) == 2
+    assert collision not in copy
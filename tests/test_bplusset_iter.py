@@ -78,3 +78,26 @@ def test_iter_initializer_contains_collision(bplusset_factory, list_from_range):
     res = list(s)
     
     assert sorted(res) == sorted(control)
+
+@parametrized_b
+@parametrized_range
+def test_iter_add_alternating_ends(bplusset_empty, list_from_range):
+    """
+    Tests that a BPlusSet is able to:
+        1. be initialized as empty
+        2. have elements added alternately at the low and high ends of its
+            hashes, so that leaves fill up from both sides
+        3. be converted to a list
+    """
+    s = bplusset_empty
+    lo, hi = 0, len(list_from_range) - 1
+    ordered = sorted(list_from_range)
+    while lo <= hi:
+        s.add(ordered[lo])
+        s.add(ordered[hi])
+        lo += 1
+        hi -= 1
+
+    res = list(s)
+
+    assert sorted(res) == ordered
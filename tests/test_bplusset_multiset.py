@@ -0,0 +1,213 @@
+import random
+from collections import Counter
+
+import pytest
+
+from five_one_one_bplus import BPlusMultiset
+from tests.utils import (
+    parametrized_b,
+    parametrized_range,
+    get_randints,
+    get_randostrs,
+    get_subset,
+)
+
+class Collides:
+    def __init__(self, x):
+        self.x = x
+    def __hash__(self):
+        return 511
+    def __eq__(self, other):
+        return isinstance(other, Collides) and self.x == other.x
+    def __repr__(self):
+        return f"Collides({self.x})"
+
+def check_counts(m, control):
+    assert len(m) == len(control)
+    assert m.total() == sum(control.values())
+    assert dict(m.items()) == dict(control)
+    assert set(m) == set(control)
+
+@parametrized_b
+@parametrized_range
+def test_multiset_range(b, list_from_range):
+    values = list_from_range + list_from_range[::3]
+    m = BPlusMultiset(values, b=b)
+    control = Counter(values)
+
+    check_counts(m, control)
+    for x in get_subset(values):
+        assert m[x] == m.count(x) == control[x]
+        assert x in m
+    assert m[-1] == 0 and -1 not in m
+
+@parametrized_b
+def test_multiset_random(b):
+    values = [random.choice(get_randostrs(num=50)) for _ in range(2000)] + get_randints(num=1000)
+    m = BPlusMultiset(b=b)
+    control = Counter()
+    for x in values:
+        n = random.randint(0, 3)
+        m.add(x, n)
+        control[x] += n
+    control = +control
+
+    check_counts(m, control)
+
+def test_multiset_add():
+    m = BPlusMultiset()
+    m.add("a")
+    m.add("a", 4)
+    m.add("b", n=2)
+    m.add("c", 0)
+
+    assert m["a"] == 5 and m["b"] == 2 and m["c"] == 0
+    assert "c" not in m
+    assert len(m) == 2 and m.total() == 7
+    with pytest.raises(ValueError):
+        m.add("a", -1)
+    with pytest.raises(TypeError):
+        m.add([])
+    with pytest.raises(TypeError):
+        m[[]]
+    with pytest.raises(OverflowError):
+        m.add("a", (1 << 63) - 1)
+    assert m.total() == 7
+
+def test_multiset_collisions():
+    m = BPlusMultiset(b=2)
+    for x in range(10):
+        m.add(Collides(x), x + 1)
+        m.add(x)
+    m.add(Collides(3), 10)
+
+    assert len(m) == 20
+    assert m[Collides(3)] == 14
+    assert m[Collides(11)] == 0
+    assert m[5] == 1
+    assert m.total() == 55 + 10 + 10
+    assert m.most_common(1) == [(Collides(3), 14)]
+
+    doubled = m + m
+    assert doubled[Collides(9)] == 20
+    assert (doubled - m).items() == m.items()
+    assert len(m - doubled) == 0
+
+def test_multiset_most_common():
+    values = get_randostrs(num=300)
+    control = Counter({x: random.randint(1, 20) for x in values})
+    m = BPlusMultiset(control)
+
+    top = m.most_common()
+    assert len(top) == len(control)
+    assert sorted(top, key=lambda item: -item[1]) == top
+    assert dict(top) == dict(control)
+    assert m.most_common(5) == top[:5]
+    assert m.most_common(0) == [] and m.most_common(-1) == []
+    assert BPlusMultiset().most_common() == []
+
+@parametrized_b
+def test_multiset_add_subtract(b):
+    first = Counter(random.choice(range(500)) for _ in range(3000))
+    second = Counter(random.choice(range(250, 750)) for _ in range(3000))
+    m1, m2 = BPlusMultiset(first, b=b), BPlusMultiset(second, b=b)
+
+    check_counts(m1 + m2, first + second)
+    check_counts(m1 - m2, first - second)
+    check_counts(m2 - m1, second - first)
+    check_counts(m1 + BPlusMultiset(), first)
+    check_counts(BPlusMultiset() - m1, Counter())
+    assert isinstance(m1 + m2, BPlusMultiset)
+    assert (m1 + m2).get_b() == b
+    with pytest.raises(TypeError):
+        m1 + Counter()
+
+def test_multiset_update():
+    m = BPlusMultiset(["a", "b", "a"])
+    m.update(BPlusMultiset({"a": 2, "c": 3}))
+    m.update(Counter({"d": 1}))
+    m.update("ab")
+
+    check_counts(m, Counter({"a": 5, "b": 2, "c": 3, "d": 1}))
+    m.update(m)
+    check_counts(m, Counter({"a": 10, "b": 4, "c": 6, "d": 2}))
+    with pytest.raises(ValueError):
+        BPlusMultiset({"a": -1})
+    with pytest.raises(TypeError):
+        BPlusMultiset({"a": "1"})
+    with pytest.raises(TypeError):
+        BPlusMultiset(["a", []])
+    with pytest.raises(TypeError):
+        BPlusMultiset(b=1)
+
+def test_multiset_reinit():
+    m = BPlusMultiset("aab")
+    m.__init__("c")
+
+    check_counts(m, Counter("c"))
+
+def test_multiset_new_without_init():
+    m = BPlusMultiset.__new__(BPlusMultiset)
+
+    check_counts(m, Counter())
+    assert "a" not in m
+    assert m.get_b() == 16
+    m.add("a")
+    check_counts(m, Counter("a"))
+    check_counts(m + BPlusMultiset.__new__(BPlusMultiset), Counter("a"))
+
+class Meddler:
+    """
+    Hashes to 1, like the int 1 and 2**61, and adds {n} new ints to {target}
+    the first time it is compared while {target} is set.
+    """
+    target = None
+
+    def __init__(self, n=20_000):
+        self.n = n
+
+    def __hash__(self):
+        return 1
+
+    def __eq__(self, other):
+        if Meddler.target is not None:
+            target, Meddler.target = Meddler.target, None
+            for i in range(self.n):
+                target.add(10 * i + 2)
+        return self is other
+
+@pytest.mark.parametrize("b", [4, 16])
+def test_multiset_changed_during_comparison(b):
+    """
+    Tests that a comparison that adds to a multiset raises RuntimeError,
+    rather than the multiset carrying on with leaves it may have freed.
+    """
+    # a single element in the slot, then a collision list
+    for first in ([1], [1, 1 << 61]):
+        m = BPlusMultiset(first, b=b)
+        Meddler.target = m
+        with pytest.raises(RuntimeError):
+            m.add(Meddler())
+        assert sorted(x for x in m if 1 < x < 1 << 60) == [10 * i + 2 for i in range(20_000)]
+        assert sum(m[x] for x in m) == m.total()
+
+        m = BPlusMultiset(first, b=b)
+        Meddler.target = m
+        with pytest.raises(RuntimeError):
+            Meddler() in m
+        assert len(m) == len(first) + 20_000
+
+    # the sources of a merge or update changing under it
+    for op in (
+        lambda a, b: a + b,
+        lambda a, b: a - b,
+        lambda a, b: b.update(a),
+    ):
+        a = BPlusMultiset([Meddler(), 1, 2], b=b)
+        m = BPlusMultiset([1, 1 << 61], b=b)
+        Meddler.target = a
+        with pytest.raises(RuntimeError):
+            op(a, m)
+        Meddler.target = None
+        # 2 was in {a} already
+        assert len(a) == 20_002
@@ -0,0 +1,172 @@
+import pytest
+import tracemalloc
+
+from five_one_one_bplus import BPlusPagedSet
+from tests.utils import (
+    parametrized_range,
+    get_randints,
+)
+
+# the keys each leaf page holds
+LEAF_CAPACITY = 511
+
+# a cache of 4 pages, the smallest allowed
+SMALL_CACHE = 4 * 4096
+
+@pytest.fixture(scope="function")
+def path(tmp_path):
+    return tmp_path / "set.pages"
+
+@parametrized_range
+def test_paged_range(list_from_range, path):
+    with BPlusPagedSet(path, list_from_range) as s:
+        assert len(s) == len(list_from_range)
+        assert list(s) == sorted(list_from_range)
+        for x in list_from_range + [-1, len(list_from_range)]:
+            assert (x in s) == (x in list_from_range)
+
+def test_paged_random_small_cache(path):
+    values = get_randints(num=100_000)
+    s = BPlusPagedSet(path, values, cache_bytes=SMALL_CACHE)
+    control = set(values)
+    stats = s.get_cache_stats()
+
+    assert len(s) == len(control)
+    assert list(s) == sorted(control)
+    assert stats["cache_pages"] == 4
+    assert stats["cached_pages"] == 4
+    assert stats["evictions"] > 0
+    assert stats["writes"] > 0
+    assert 0.0 <= stats["hit_rate"] <= 1.0
+    assert all(x in s for x in values[:2000])
+
+def test_paged_reopen(path):
+    values = get_randints(num=50_000)
+    BPlusPagedSet(path, values, cache_bytes=SMALL_CACHE).close()
+
+    with BPlusPagedSet(path, cache_bytes=SMALL_CACHE) as s:
+        assert len(s) == len(set(values))
+        assert list(s) == sorted(set(values))
+        s.add(-(1 << 63))
+        s.add((1 << 63) - 1)
+
+    with BPlusPagedSet(path) as s:
+        assert len(s) == len(set(values)) + 2
+        assert -(1 << 63) in s and (1 << 63) - 1 in s
+
+def test_paged_ascending_fills_pages(path):
+    s = BPlusPagedSet(path, range(100 * LEAF_CAPACITY))
+
+    # the header, and 100 full leaves
+    assert s.get_cache_stats()["pages"] == 101
+
+def test_paged_add_while_iterating(path):
+    s = BPlusPagedSet(path, range(0, 20_000, 2), cache_bytes=SMALL_CACHE)
+    seen = []
+    for x in s:
+        seen.append(x)
+        if x % 1000 == 0:
+            s.update(range(x + 1, x + 600, 2))
+
+    assert seen == list(s)
+    assert seen == sorted(set(seen))
+    assert len(seen) == 10_000 + 20 * 300
+
+def test_paged_contains_other_types(path):
+    s = BPlusPagedSet(path, [1, 2, 3])
+
+    assert 2.0 in s
+    assert True in s
+    assert 2.5 not in s
+    assert float("nan") not in s
+    assert float("inf") not in s
+    assert "1" not in s
+    assert 1 << 64 not in s
+
+def test_paged_hit_rate(path):
+    s = BPlusPagedSet(path, range(10_000))
+    before = s.get_cache_stats()
+    for x in range(10_000):
+        assert x in s
+    after = s.get_cache_stats()
+
+    assert after["misses"] == before["misses"]
+    assert after["hits"] == before["hits"] + 10_000
+    assert after["hit_rate"] == 1.0
+
+@pytest.mark.parametrize("value, error", [
+    ("1", TypeError),
+    (1.0, TypeError),
+    (1 << 63, OverflowError),
+])
+def test_paged_bad_add(path, value, error):
+    s = BPlusPagedSet(path)
+    with pytest.raises(error):
+        s.add(value)
+
+def test_paged_closed(path):
+    with BPlusPagedSet(path, [1]) as s:
+        iterator = iter(s)
+    s.close()
+
+    with pytest.raises(ValueError):
+        1 in s
+    with pytest.raises(ValueError):
+        s.add(2)
+    with pytest.raises(ValueError):
+        next(iterator)
+
+def test_paged_closed_while_updating(path):
+    """
+    Tests that closing or re-opening the set from inside the iterable it is
+    being updated from stops or redirects the update, rather than writing to
+    freed pages.
+    """
+    def closing(s):
+        yield 1
+        s.close()
+        yield 2
+
+    s = BPlusPagedSet(path)
+    with pytest.raises(ValueError):
+        s.update(closing(s))
+    s = BPlusPagedSet.__new__(BPlusPagedSet)
+    with pytest.raises(ValueError):
+        s.__init__(path, closing(s))
+
+    other = path.with_name("other.pages")
+    def reopening(s):
+        yield 1
+        s.__init__(other)
+        yield 2
+
+    s = BPlusPagedSet(path)
+    s.update(reopening(s))
+    assert sorted(s) == [2]
+    s.close()
+    assert sorted(BPlusPagedSet(path)) == [1]
+
+@pytest.mark.parametrize("contents", [b"x" * 4096, b"x" * 10])
+def test_paged_bad_file(path, contents):
+    path.write_bytes(contents)
+    with pytest.raises(ValueError):
+        BPlusPagedSet(path)
+
+def test_paged_truncated_file(path):
+    BPlusPagedSet(path, range(10_000)).close()
+    path.write_bytes(path.read_bytes()[:-4096])
+    with pytest.raises(ValueError):
+        BPlusPagedSet(path)
+
+def test_paged_traced(path):
+    tracemalloc.start()
+    try:
+        before = tracemalloc.get_traced_memory()[0]
+        s = BPlusPagedSet(path, range(100_000), cache_bytes=SMALL_CACHE * 4)
+        after = tracemalloc.get_traced_memory()[0]
+    finally:
+        tracemalloc.stop()
+
+    # at least the frames of its cache
+    assert after - before >= SMALL_CACHE * 4
+    s.close()
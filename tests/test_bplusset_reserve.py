@@ -0,0 +1,141 @@
+import pytest
+import sys
+
+from five_one_one_bplus import BPlusSet
+from tests.utils import get_randints
+
+parametrized_reserve_b = pytest.mark.parametrize("b", [3, 8, 32, 128, 255], indirect=True)
+
+@parametrized_reserve_b
+@pytest.mark.parametrize("n", [10, 1000, 20000])
+def test_reserve_add_random(bplusset_empty, n):
+    """
+    Tests that adding as many elements as were reserved, in random order,
+    takes no more node memory.
+    """
+    s = bplusset_empty
+    s.reserve(n)
+    size = sys.getsizeof(s)
+    elements = get_randints(n)
+    for x in elements:
+        s.add(x)
+
+    assert sys.getsizeof(s) == size
+    assert len(s) == len(set(elements))
+    assert all(x in s for x in elements)
+
+@parametrized_reserve_b
+@pytest.mark.parametrize("n", [10, 1000, 20000])
+def test_reserve_add_sorted(bplusset_empty, n):
+    """
+    Tests that adding as many elements as were reserved, in order, takes no
+    more node memory.
+    """
+    s = bplusset_empty
+    s.reserve(n)
+    size = sys.getsizeof(s)
+    for x in range(n):
+        s.add(x)
+
+    assert sys.getsizeof(s) == size
+    assert list(s) == list(range(n))
+
+@parametrized_reserve_b
+def test_reserve_partly_full(bplusset_factory):
+    """
+    Tests that reserving for a tree that already has elements only sets aside
+    nodes for the ones still to come.
+    """
+    s = bplusset_factory(range(0, 4000, 2))
+    s.reserve(4000)
+    size = sys.getsizeof(s)
+    for x in range(1, 4000, 2):
+        s.add(x)
+
+    assert sys.getsizeof(s) == size
+    assert len(s) == 4000
+
+def test_reserve_capacity():
+    """
+    Tests that the capacity given to the constructor is reserved, on top of
+    the elements of the initializer.
+    """
+    assert sys.getsizeof(BPlusSet(capacity=1000)) > sys.getsizeof(BPlusSet())
+
+    s = BPlusSet(b=8, capacity=1000)
+    t = BPlusSet(b=8)
+    t.reserve(1000)
+    assert sys.getsizeof(s) == sys.getsizeof(t)
+
+    s = BPlusSet(range(100), capacity=1000)
+    size = sys.getsizeof(s)
+    for x in range(100, 1000):
+        s.add(x)
+    assert sys.getsizeof(s) == size
+
+def test_reserve_length_hint():
+    """
+    Tests that the length hint of an iterator initializer is used to reserve
+    nodes, and that an error raised by it is passed on.
+    """
+    class Hinted:
+        def __init__(self, n, hint):
+            self.it = iter(range(n))
+            self.hint = hint
+        def __iter__(self):
+            return self
+        def __next__(self):
+            return next(self.it)
+        def __length_hint__(self):
+            return self.hint
+
+    hinted = BPlusSet(Hinted(1000, 5000), b=8)
+    unhinted = BPlusSet(Hinted(1000, 0), b=8)
+    assert list(hinted) == list(unhinted) == list(range(1000))
+    assert sys.getsizeof(hinted) > sys.getsizeof(unhinted)
+
+    class BadHint(Hinted):
+        def __length_hint__(self):
+            raise RuntimeError("no hint")
+
+    with pytest.raises(RuntimeError):
+        BPlusSet(BadHint(10, 0))
+
+def test_reserve_compact():
+    """
+    Tests that compact() gives back the reserved nodes.
+    """
+    s = BPlusSet(range(100), b=8)
+    s.compact()
+    before = sys.getsizeof(s)
+    s.reserve(100000)
+    assert sys.getsizeof(s) > before
+    s.compact()
+    assert sys.getsizeof(s) == before
+
+def test_reserve_reinit():
+    """
+    Tests that a tree with reserved nodes can be initialized again with
+    another b.
+    """
+    s = BPlusSet(range(1000), b=8, capacity=2000)
+    s.__init__(range(500), b=32, capacity=4000)
+    size = sys.getsizeof(s)
+    for x in range(500, 4000):
+        s.add(x)
+
+    assert sys.getsizeof(s) == size
+    assert s.get_b() == 32
+    assert list(s) == list(range(4000))
+
+def test_reserve_bad_arguments():
+    """
+    Tests that negative capacities are rejected.
+    """
+    s = BPlusSet()
+    with pytest.raises(ValueError):
+        s.reserve(-1)
+    with pytest.raises(ValueError):
+        BPlusSet(capacity=-1)
+    with pytest.raises(TypeError):
+        BPlusSet(capacity="10")
@@ -0,0 +1,124 @@
+import pytest
+import sys
+import tracemalloc
+
+from five_one_one_bplus import (
+    BPlusMultiset,
+    BPlusSet,
+    BPlusSortedSet,
+    get_pymalloc,
+    set_pymalloc,
+)
+from tests.utils import (
+    parametrized_b,
+    parametrized_range,
+    get_randints,
+)
+
+@parametrized_b
+def test_sizeof_empty(bplusset_empty):
+    """
+    Tests that an empty BPlusSet, whose root leaf lives in the object itself,
+    is only as big as the object.
+    """
+    s = bplusset_empty
+
+    assert s.__sizeof__() == object.__sizeof__(s)
+    assert s.stats()["nbytes"] == 0
+
+@parametrized_b
+@parametrized_range
+def test_sizeof_matches_stats(bplusset_factory, list_from_range):
+    """
+    Tests that __sizeof__() counts every node, both after being built from an
+    iterable and after more elements are added one at a time.
+    """
+    s = bplusset_factory(list_from_range)
+    base = object.__sizeof__(s)
+
+    assert s.__sizeof__() == base + s.stats()["nbytes"]
+
+    for x in get_randints():
+        s.add(x)
+    assert s.__sizeof__() == base + s.stats()["nbytes"]
+    assert sys.getsizeof(s) >= s.__sizeof__()
+
+@parametrized_b
+def test_sizeof_grows_and_compacts(bplusset_empty):
+    """
+    Tests that __sizeof__() grows as nodes are split and agrees with what
+    compact() reports.
+    """
+    s = bplusset_empty
+    base = object.__sizeof__(s)
+    last = s.__sizeof__()
+
+    for x in range(2000):
+        s.add(x)
+        assert s.__sizeof__() >= last
+        last = s.__sizeof__()
+
+    before, after = s.compact()
+    assert before == last - base
+    assert s.__sizeof__() == base + after
+
+    for x in range(2000, 4000):
+        s.add(x)
+    assert s.__sizeof__() == base + s.stats()["nbytes"]
+
+def test_sizeof_traced():
+    """
+    Tests that the nodes of a BPlusSet are visible to tracemalloc.
+    """
+    elements = get_randints(20_000)
+    tracemalloc.start()
+    try:
+        before = tracemalloc.get_traced_memory()[0]
+        s = BPlusSet(b=16)
+        for x in elements:
+            s.add(x)
+        after = tracemalloc.get_traced_memory()[0]
+    finally:
+        tracemalloc.stop()
+
+    assert s.stats()["nbytes"] > 0
+    assert after - before >= s.stats()["nbytes"]
+
+@pytest.mark.parametrize("b", [8, 16, 255])
+def test_sizeof_pymalloc(b):
+    """
+    Tests that nodes taken from pymalloc are counted and freed like any other,
+    including when the allocator is switched while a tree holds both kinds.
+    """
+    assert not get_pymalloc()
+    control = set(get_randints(1000))
+    s = BPlusSet(b=b)
+    try:
+        set_pymalloc(True)
+        assert get_pymalloc()
+        for x in range(0, 3000, 3):
+            s.add(x)
+            control.add(x)
+        set_pymalloc(False)
+        for x in range(1, 3000, 3):
+            s.add(x)
+            control.add(x)
+    finally:
+        set_pymalloc(False)
+
+    for x in control:
+        s.add(x)
+    assert s == BPlusSet(control, b=b)
+    assert s.__sizeof__() == object.__sizeof__(s) + s.stats()["nbytes"]
+    del s
+
+def test_sizeof_other_trees():
+    """
+    Tests that the sorted set and the multiset count their nodes too.
+    """
+    for cls in (BPlusSortedSet, BPlusMultiset):
+        s = cls()
+        empty = s.__sizeof__()
+        for x in range(1000):
+            s.add(x)
+        assert s.__sizeof__() > empty
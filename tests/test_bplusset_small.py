@@ -0,0 +1,78 @@
+import pytest
+import sys
+
+from five_one_one_bplus import BPlusSet
+
+from tests.utils import (
+    parametrized_b,
+    check_contains,
+    get_randints,
+)
+
+# sizes around the number of elements a tree holds before it allocates nodes
+parametrized_small = pytest.mark.parametrize("num", [1, 2, 7, 8, 9, 15, 16, 17, 32, 33])
+
+@parametrized_b
+@parametrized_small
+def test_small_initializer(bplusset_factory, num):
+    """
+    Tests that a small BPlusSet is able to:
+        1. be initialized from a list, a tuple and an iterator
+        2. the `in` keyword and len() work as expected
+        3. be converted to a list
+    """
+    control = list(range(num))
+
+    for initializer in (control, tuple(control), iter(control)):
+        s = bplusset_factory(initializer)
+        assert len(s) == num
+        check_contains(s, set(control), control + get_randints(num=10))
+        assert sorted(s) == control
+
+@parametrized_b
+@parametrized_small
+def test_small_add_equals_initializer(bplusset_empty, bplusset_factory, num):
+    """
+    Tests that a BPlusSet grown one element at a time past its inline
+    capacity compares equal to one built from an initializer, and still does
+    after compaction.
+    """
+    control = list(range(num)) + [sys.maxsize]
+    s = bplusset_empty
+    for x in control:
+        s.add(x)
+
+    assert s == bplusset_factory(control)
+    s.compact()
+    assert s == bplusset_factory(control)
+
+@parametrized_b
+def test_small_releases_references(bplusset_factory):
+    o = object()
+    before = sys.getrefcount(o)
+
+    s = bplusset_factory([o])
+    assert sys.getrefcount(o) == before + 1
+
+    del s
+    assert sys.getrefcount(o) == before
+
+@parametrized_b
+def test_small_reinit(bplusset_factory):
+    s = bplusset_factory(range(100))
+    s.__init__([1, 2, 3])
+
+    assert len(s) == 3
+    assert sorted(s) == [1, 2, 3]
+
+def test_small_initializer_not_iterable():
+    with pytest.raises(TypeError):
+        BPlusSet(5)
+
+def test_small_initializer_raises():
+    def gen():
+        yield 1
+        raise ValueError("boom")
+
+    with pytest.raises(ValueError):
+        BPlusSet(gen())
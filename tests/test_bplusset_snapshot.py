@@ -0,0 +1,165 @@
+import os
+import pytest
+import subprocess
+import sys
+
+from five_one_one_bplus import BPlusSet, BPlusSnapshot
+from tests.utils import (
+    parametrized_b,
+    parametrized_range,
+    get_randints,
+    get_randostrs,
+    get_subset,
+)
+
+# integers sharing the hash of 3, one of them too large for an int64
+COLLISIONS = [3, 3 + sys.hash_info.modulus, 3 + (sys.hash_info.modulus << 64)]
+
+def save_and_open(s, tmp_path):
+    path = tmp_path / "set.snap"
+    s.save(path)
+    return BPlusSet.open(path)
+
+@parametrized_b
+@parametrized_range
+def test_snapshot_range(b, list_from_range, tmp_path):
+    s = BPlusSet(list_from_range, b=b)
+    snapshot = save_and_open(s, tmp_path)
+
+    assert type(snapshot) is BPlusSnapshot
+    assert len(snapshot) == len(s)
+    assert sorted(snapshot) == sorted(s)
+    for x in list_from_range + [-1, len(list_from_range), 1 << 70]:
+        assert (x in snapshot) == (x in s)
+
+def test_snapshot_mixed(tmp_path):
+    values = get_randints(num=5000) + get_randostrs(num=2000) + COLLISIONS
+    values += [b"bar", "", "foo", "föö \U0001f600", -(1 << 100), (1 << 63) - 1, -(1 << 63)]
+    s = BPlusSet(values)
+    snapshot = save_and_open(s, tmp_path)
+
+    assert len(snapshot) == len(s)
+    assert sorted(snapshot, key=repr) == sorted(s, key=repr)
+    for x in get_subset(values) + values[-10:]:
+        assert x in snapshot
+    for x in get_randints() + get_randostrs() + [b"foo", "bar", 3 + 2 * sys.hash_info.modulus]:
+        assert (x in snapshot) == (x in s)
+
+def test_snapshot_equal_not_same(tmp_path):
+    snapshot = save_and_open(BPlusSet([1, 2, "1", b"2"]), tmp_path)
+
+    assert 1.0 in snapshot
+    assert True in snapshot
+    assert 2.5 not in snapshot
+    assert b"1" not in snapshot
+    assert "2" not in snapshot
+    with pytest.raises(TypeError):
+        [] in snapshot
+
+def test_snapshot_empty(tmp_path):
+    snapshot = save_and_open(BPlusSet(), tmp_path)
+
+    assert len(snapshot) == 0
+    assert list(snapshot) == []
+    assert 1 not in snapshot
+
+def test_snapshot_other_process(tmp_path):
+    """
+    Tests that a snapshot saved by one process finds its strs and bytes in a
+    process whose str hashes are seeded differently.
+    """
+    path = tmp_path / "set.snap"
+    values = get_randostrs(num=1000)
+    BPlusSet(values + [x.encode() + b"!" for x in values]).save(path)
+    script = (
+        "import sys\n"
+        "from five_one_one_bplus import BPlusSet\n"
+        "s = BPlusSet.open(sys.argv[1])\n"
+        "values = sys.argv[2:]\n"
+        "assert len(s) == 2 * len(values)\n"
+        "assert all(x in s and x.encode() + b'!' in s for x in values)\n"
+    )
+    env = dict(os.environ, PYTHONHASHSEED="511")
+    subprocess.run([sys.executable, "-c", script, str(path)] + values, env=env, check=True)
+
+def test_snapshot_overwrite(tmp_path):
+    path = tmp_path / "set.snap"
+    BPlusSet([1, 2]).save(path)
+    snapshot = BPlusSet.open(path)
+    BPlusSet([3]).save(str(path))
+
+    assert sorted(snapshot) == [1, 2]
+    assert list(BPlusSet.open(path)) == [3]
+    assert not os.path.exists(str(path) + ".tmp")
+
+def test_snapshot_unsupported(tmp_path):
+    with pytest.raises(TypeError):
+        BPlusSet([1, 2.5]).save(tmp_path / "set.snap")
+    with pytest.raises(OSError):
+        BPlusSet([1]).save(tmp_path / "missing" / "set.snap")
+
+@pytest.mark.parametrize("corrupt", [
+    lambda data: b"",
+    lambda data: b"x" * len(data),
+    lambda data: data[:-8],
+    lambda data: data + bytes(8),
+])
+def test_snapshot_bad_file(tmp_path, corrupt):
+    path = tmp_path / "set.snap"
+    BPlusSet(range(1000)).save(path)
+    path.write_bytes(corrupt(path.read_bytes()))
+
+    with pytest.raises(ValueError):
+        BPlusSet.open(path)
+
+def test_snapshot_missing_file(tmp_path):
+    with pytest.raises(FileNotFoundError):
+        BPlusSet.open(tmp_path / "missing.snap")
+
+def test_snapshot_long_collision_run(tmp_path):
+    """
+    Tests a run of equal hashes long enough to span several separators.
+    """
+    values = [3 + k * sys.hash_info.modulus for k in range(200)] + list(range(5000))
+    snapshot = save_and_open(BPlusSet(values), tmp_path)
+
+    assert all(x in snapshot for x in values)
+    assert 3 + 200 * sys.hash_info.modulus not in snapshot
+
+def test_snapshot_not_loaded(tmp_path):
+    """
+    Tests that a snapshot with no file mapped, because __init__() was never
+    called or failed, raises ValueError rather than reading through NULL.
+    """
+    path = tmp_path / "set.snap"
+    BPlusSet(range(100)).save(path)
+
+    unloaded = BPlusSnapshot.__new__(BPlusSnapshot)
+    failed = BPlusSet.open(path)
+    it = iter(failed)
+    next(it)
+    with pytest.raises(FileNotFoundError):
+        failed.__init__(tmp_path / "missing.snap")
+
+    for snapshot in (unloaded, failed):
+        with pytest.raises(ValueError):
+            len(snapshot)
+        with pytest.raises(ValueError):
+            5 in snapshot
+        with pytest.raises(ValueError):
+            iter(snapshot)
+        with pytest.raises(ValueError):
+            snapshot.get_nbytes()
+    with pytest.raises(ValueError):
+        next(it)
+
+def test_snapshot_lone_surrogate(tmp_path):
+    path = tmp_path / "set.snap"
+    BPlusSet(["a", b"\xed\xa0\x80"]).save(path)
+    snapshot = BPlusSet.open(path)
+
+    assert "\ud800" not in snapshot
+    assert "a" in snapshot
+
+    with pytest.raises(ValueError, match="UTF-8"):
+        BPlusSet(["a", "\ud800"]).save(tmp_path / "bad.snap")
@@ -0,0 +1,106 @@
+import pytest
+
+from five_one_one_bplus import BPlusSet
+from tests.utils import (
+    parametrized_b,
+    parametrized_range,
+    get_randints,
+)
+
+def check_stats(s):
+    stats = s.stats()
+    nodes = stats["nodes_per_level"]
+    fill = stats["fill_histogram"]
+
+    assert stats["height"] == len(nodes)
+    assert nodes[0] == 1
+    assert all(x <= y for x, y in zip(nodes, nodes[1:]))
+    assert len(fill) == s.get_b() + 1
+    assert sum(fill) == nodes[-1]
+    runs = _runs(s)
+    assert stats["collision_runs"] == len(runs)
+    assert sum(i * n for i, n in enumerate(fill)) == len(s) - sum(len(v) - 1 for v in runs)
+    if len(s) == 0:
+        assert stats["avg_comparisons"] == 0
+    else:
+        # at least the check of the hash found and of the element itself
+        assert stats["avg_comparisons"] >= 2
+    return stats
+
+def _runs(s):
+    # the elements sharing a hash with another element, grouped by hash
+    by_hash = {}
+    for x in s:
+        by_hash.setdefault(hash(x), []).append(x)
+    return [v for v in by_hash.values() if len(v) > 1]
+
+@parametrized_b
+def test_stats_empty(bplusset_empty):
+    """
+    Tests that an empty BPlusSet reports a lone empty leaf.
+    """
+    s = bplusset_empty
+    stats = check_stats(s)
+
+    assert stats["height"] == 1
+    assert stats["nodes_per_level"] == [1]
+    assert stats["fill_histogram"][0] == 1
+    assert stats["collision_runs"] == 0
+    assert stats["splits"] == 0
+
+@parametrized_b
+@parametrized_range
+def test_stats_from_range(bplusset_factory, set_from_range):
+    """
+    Tests that a BPlusSet built from an iterable reports a shape consistent
+    with its size and {b}.
+    """
+    s = bplusset_factory(set_from_range)
+    stats = check_stats(s)
+
+    b = s.get_b()
+    for upper, lower in zip(stats["nodes_per_level"], stats["nodes_per_level"][1:]):
+        assert lower <= upper * b
+
+@parametrized_b
+def test_stats_splits(bplusset_empty):
+    """
+    Tests that adding elements one at a time counts the splits they cause,
+    and that compacting the tree leaves the count alone.
+    """
+    s = bplusset_empty
+    for x in get_randints(1000):
+        s.add(x)
+    stats = check_stats(s)
+
+    assert stats["splits"] >= stats["nodes_per_level"][-1] - 1
+    assert stats["nbytes"] > 0
+
+    s.compact()
+    assert check_stats(s)["splits"] == stats["splits"]
+
+def test_stats_deep():
+    """
+    Tests that stats() walks trees wider than a fixed-size stack could hold.
+    """
+    s = BPlusSet(range(100_000))
+    stats = check_stats(s)
+
+    assert sum(stats["nodes_per_level"]) > 1000
+
+def test_stats_collisions():
+    """
+    Tests that elements sharing a hash are reported as collision runs, and
+    cost more comparisons to find.
+    """
+    s = BPlusSet(range(100), b=8)
+    before = check_stats(s)
+    # -1 and -2 both hash to -2; 2**61 hashes to 1
+    s.add(-1)
+    s.add(-2)
+    s.add(1 << 61)
+    after = check_stats(s)
+
+    assert before["collision_runs"] == 0
+    assert after["collision_runs"] == 2
+    assert after["avg_comparisons"] > before["avg_comparisons"]
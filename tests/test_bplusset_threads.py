@@ -0,0 +1,92 @@
+import pytest
+import sys
+import threading
+
+from five_one_one_bplus import BPlusSet, get_threads, set_threads
+from tests.utils import (
+    check_contains,
+    parametrized_b,
+    get_randints,
+    get_randostrs,
+    get_subset,
+)
+
+# large enough for the sort and the build to be split between threads
+NUM = 200_000
+
+# integers sharing the hash of 3
+COLLISIONS = [3, 3 + sys.hash_info.modulus, 3 + 2 * sys.hash_info.modulus]
+
+@pytest.fixture(scope="function")
+def threads(request):
+    previous = get_threads()
+    set_threads(request.param)
+    yield request.param
+    set_threads(previous)
+
+parametrized_threads = pytest.mark.parametrize("threads", [1, 2, 5], indirect=True)
+
+@parametrized_threads
+@parametrized_b
+def test_build_list(threads, b):
+    values = get_randints(num=NUM) + get_randostrs(num=1000) + COLLISIONS
+    values += values[:1000]
+    s = BPlusSet(values, b=b)
+    control = set(values)
+
+    assert len(s) == len(control)
+    assert s == BPlusSet(control, b=b)
+    assert list(s) == sorted(control, key=lambda x: (hash(x), str(type(x)), x))
+    check_contains(s, control, get_subset(values) + get_randints() + COLLISIONS)
+
+@parametrized_threads
+def test_build_narrow(threads):
+    """
+    Tests hashes drawn from a narrow range with many repeats, which leave most
+    of the sample sort's buckets empty.
+    """
+    values = [x % 100 for x in range(NUM)] + list(range(NUM, 0, -1))
+    s = BPlusSet(values, b=32)
+
+    assert list(s) == list(range(NUM + 1))
+
+@parametrized_threads
+def test_build_unboxed(threads):
+    values = [x % (1 << 40) for x in get_randints(num=NUM)]
+    s = BPlusSet(values, unboxed=True)
+
+    assert list(s) == sorted(set(values))
+    assert BPlusSet(s) == BPlusSet(values)
+
+@parametrized_threads
+def test_compact(threads):
+    s = BPlusSet(get_randints(num=NUM))
+    control = list(s)
+    s.compact(fill_factor=0.5)
+
+    assert list(s) == control
+
+def test_set_threads_bad():
+    with pytest.raises(ValueError):
+        set_threads(0)
+    with pytest.raises(ValueError):
+        set_threads(65)
+
+def test_build_concurrent():
+    """
+    Tests that builds on several Python threads at once, each releasing the
+    GIL, give the same results as building one at a time.
+    """
+    values = [get_randints(num=NUM) for _ in range(3)]
+    results = [None] * len(values)
+
+    def build(ix):
+        results[ix] = list(BPlusSet(values[ix]))
+
+    workers = [threading.Thread(target=build, args=(ix,)) for ix in range(len(values))]
+    for worker in workers:
+        worker.start()
+    for worker in workers:
+        worker.join()
+
+    assert results == [list(BPlusSet(v)) for v in values]
@@ -0,0 +1,120 @@
+import platform
+import pytest
+import shutil
+import subprocess
+import sys
+import time
+
+from five_one_one_bplus import BPlusSet
+from five_one_one_bplus import c as bplus_c
+from tests.utils import (
+    parametrized_b,
+    get_randints,
+)
+
+@parametrized_b
+def test_trace_off(bplusset_empty):
+    """
+    Tests that a BPlusSet records nothing until it is traced, and stops when
+    the trace is set to 0.
+    """
+    s = bplusset_empty
+    for x in range(100):
+        s.add(x)
+    assert s.get_trace() == []
+
+    s.set_trace(8)
+    s.add(100)
+    assert [e[1:3] for e in s.get_trace() if e[1] == "insert"] == [("insert", 100)]
+
+    s.set_trace(0)
+    s.add(101)
+    assert s.get_trace() == []
+
+@parametrized_b
+def test_trace_events(bplusset_empty):
+    """
+    Tests that inserts, splits and root splits are recorded in order, and
+    agree with stats().
+    """
+    s = bplusset_empty
+    s.set_trace(1 << 16)
+    start = time.monotonic_ns()
+    elements = get_randints(1000)
+    for x in elements:
+        s.add(x)
+    # adding an element again records nothing
+    s.add(elements[0])
+    events = s.get_trace()
+    stats = s.stats()
+
+    times = [e[0] for e in events]
+    assert times == sorted(times)
+    assert start <= times[0] and times[-1] <= time.monotonic_ns()
+
+    inserts = [e for e in events if e[1] == "insert"]
+    assert [e[2] for e in inserts] == [hash(x) for x in dict.fromkeys(elements)]
+    assert all(0 <= e[3] < stats["height"] for e in inserts)
+
+    splits = [e for e in events if e[1] == "split"]
+    assert len(splits) + sum(e[3] for e in splits) == stats["splits"]
+
+    grows = [e for e in events if e[1] == "grow"]
+    assert [e[3] for e in grows] == list(range(2, stats["height"] + 1))
+
+def test_trace_collisions():
+    """
+    Tests that elements with the hash of an element already in the tree are
+    recorded as collisions, starting a run or joining one.
+    """
+    s = BPlusSet(range(10), b=8)
+    s.set_trace(64)
+    # -1 and -2 both hash to -2; 2**61 and 2**122 hash to 1
+    for x in (-1, -2, 1 << 61, 1 << 122):
+        s.add(x)
+
+    collisions = [e[2:] for e in s.get_trace() if e[1] == "collision"]
+    assert collisions == [(-2, 1), (1, 1), (1, 0)]
+
+@pytest.mark.parametrize("capacity", [1, 5, 64])
+def test_trace_wraps(capacity):
+    """
+    Tests that the ring buffer keeps the most recent events once it is full,
+    rounding its capacity up to a power of 2.
+    """
+    s = BPlusSet(b=255)
+    s.set_trace(capacity)
+    for x in range(1000):
+        s.add(x)
+
+    keep = 1 << (capacity - 1).bit_length()
+    events = s.get_trace()
+    assert len(events) == keep
+    assert [e[2] for e in events] == list(range(1000 - keep, 1000))
+
+def test_trace_bad_capacity():
+    """
+    Tests that set_trace() rejects out of bounds capacities.
+    """
+    s = BPlusSet()
+    for capacity in (-1, (1 << 24) + 1):
+        with pytest.raises(ValueError):
+            s.set_trace(capacity)
+
+@pytest.mark.skipif(
+    sys.platform != "linux"
+    or platform.machine() not in ("x86_64", "aarch64")
+    or shutil.which("readelf") is None,
+    reason="the vendored sdt.h only emits probes for ELF on x86-64 and aarch64",
+)
+def test_trace_usdt_probes():
+    """
+    Tests that the built module carries a USDT probe for each kind of event.
+    """
+    notes = subprocess.run(
+        ["readelf", "-n", bplus_c.__file__],
+        capture_output=True, text=True, check=True,
+    ).stdout
+    assert notes.count("Provider: five_one_one_bplus") == 4
+    for name in ("insert", "split", "grow", "collision"):
+        assert f"Name: {name}\n" in notes
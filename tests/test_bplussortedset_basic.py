@@ -0,0 +1,162 @@
+import pytest
+import sys
+
+from five_one_one_bplus import BPlusSortedSet
+
+from tests.utils import (
+    parametrized_b,
+    parametrized_range,
+    check_contains,
+    get_subset,
+    get_randints,
+    get_randostrs,
+)
+
+@pytest.fixture(scope="function")
+def sortedset_factory(b):
+    return lambda initializer, key=None: BPlusSortedSet(initializer, key=key, b=b)
+
+@parametrized_b
+def test_sorted_empty(sortedset_factory):
+    s = sortedset_factory(None)
+
+    assert len(s) == 0
+    assert list(s) == []
+    assert 5 not in s
+
+@parametrized_b
+@parametrized_range
+def test_sorted_initializer(sortedset_factory, list_from_range):
+    """
+    Tests that a BPlusSortedSet is able to:
+        1. be initialized from a non-empty iterable
+        2. the `in` keyword and len() work as expected
+        3. be converted to a list in sorted order
+    """
+    s = sortedset_factory(list_from_range)
+
+    assert len(s) == len(list_from_range)
+    check_contains(s, set(list_from_range), get_subset(list_from_range) + get_randints())
+    assert list(s) == sorted(list_from_range)
+
+@parametrized_b
+def test_sorted_add(sortedset_factory):
+    """
+    Tests that a BPlusSortedSet is able to:
+        1. have elements added to it, including duplicates
+        2. be converted to a list in sorted order
+    """
+    control = get_randostrs(num=1000)
+    s = sortedset_factory(None)
+
+    for x in control + control[:100]:
+        s.add(x)
+
+    assert len(s) == len(set(control))
+    assert list(s) == sorted(set(control))
+
+@parametrized_b
+def test_sorted_key(sortedset_factory):
+    """
+    Tests that a BPlusSortedSet with a key function is able to:
+        1. be ordered by the key
+        2. keep only the first of several elements with equal keys
+    """
+    s = sortedset_factory(range(-499, 500), key=abs)
+
+    assert len(s) == 500
+    assert list(s) == [0] + list(range(-1, -500, -1))
+    assert -3 in s
+    assert 3 in s
+    assert s.get_key() is abs
+
+@parametrized_b
+def test_sorted_min_max(sortedset_factory):
+    control = get_randints(num=1000)
+    s = sortedset_factory(control)
+
+    assert s.min() == min(control)
+    assert s.max() == max(control)
+
+def test_sorted_min_max_empty():
+    with pytest.raises(ValueError):
+        BPlusSortedSet().min()
+    with pytest.raises(ValueError):
+        BPlusSortedSet().max()
+
+def test_sorted_incomparable():
+    with pytest.raises(TypeError):
+        BPlusSortedSet([1, "foo"])
+
+def test_sorted_key_not_callable():
+    with pytest.raises(TypeError):
+        BPlusSortedSet([1, 2], key=5)
+
+@parametrized_b
+def test_sorted_releases_references(sortedset_factory):
+    o = (sys.maxsize, "foo")
+    before = sys.getrefcount(o)
+
+    s = sortedset_factory([(x, "foo") for x in range(1000)] + [o])
+    s.add(o)
+
+    del s
+    assert sys.getrefcount(o) == before
+
+def test_sorted_new_without_init():
+    """
+    Tests that a BPlusSortedSet made by __new__() alone is an empty set.
+    """
+    s = BPlusSortedSet.__new__(BPlusSortedSet)
+
+    assert len(s) == 0
+    assert list(s) == []
+    assert 5 not in s
+    assert list(s.irange(0, 10)) == []
+    s.add(5)
+    assert list(s) == [5]
+
+class Meddler:
+    """
+    Compares by {x}, adding a new element to {target} the first time any
+    Meddler is compared while {target} is set.
+    """
+    target = None
+    added = 0
+
+    def __init__(self, x):
+        self.x = x
+
+    def __lt__(self, other):
+        if Meddler.target is not None:
+            target, Meddler.target = Meddler.target, None
+            Meddler.added += 1
+            target.add(Meddler(-Meddler.added))
+        return self.x < other.x
+
+@parametrized_b
+def test_sorted_changed_during_comparison(sortedset_factory):
+    """
+    Tests that a comparison that adds to the set raises RuntimeError, rather
+    than the set carrying on with nodes that may have been freed.
+    """
+    s = sortedset_factory([Meddler(x) for x in range(100)])
+
+    Meddler.target = s
+    with pytest.raises(RuntimeError):
+        s.add(Meddler(1000))
+    assert len(s) == 101
+
+    Meddler.target = s
+    with pytest.raises(RuntimeError):
+        s.irange(Meddler(10), Meddler(90))
+
+    Meddler.target = s
+    with pytest.raises(RuntimeError):
+        s.irange(hi=Meddler(90))
+
+    # each of the 3 meddles above still added its element
+    Meddler.target = None
+    xs = [m.x for m in s]
+    assert len(xs) == len(s) == 103
+    assert xs == sorted(xs)
@@ -0,0 +1,105 @@
+import pytest
+import bisect
+import random
+
+from five_one_one_bplus import BPlusSortedSet
+
+from tests.utils import (
+    parametrized_b,
+    get_randints,
+)
+
+parametrized_inclusive = pytest.mark.parametrize(
+    "inclusive",
+    [(True, True), (True, False), (False, True), (False, False)],
+)
+
+def get_bounds(control, num=50):
+    # mix of bounds that are and are not in {control}
+    return [random.choice(control) for _ in range(num)] + get_randints(num=num)
+
+@pytest.fixture(scope="function")
+def sorted_control():
+    return sorted(set(get_randints(num=2000)))
+
+@parametrized_b
+@parametrized_inclusive
+def test_irange(b, sorted_control, inclusive):
+    """
+    Tests that irange() returns the elements between two bounds in sorted
+    order, and in reverse order if asked to.
+    """
+    s = BPlusSortedSet(sorted_control, b=b)
+    bounds = get_bounds(sorted_control)
+
+    for lo, hi in zip(bounds, reversed(bounds)):
+        start = (bisect.bisect_left if inclusive[0] else bisect.bisect_right)(sorted_control, lo)
+        stop = (bisect.bisect_right if inclusive[1] else bisect.bisect_left)(sorted_control, hi)
+        expected = sorted_control[start:stop]
+
+        assert list(s.irange(lo, hi, inclusive=inclusive)) == expected
+        assert list(s.irange(lo, hi, inclusive=inclusive, reverse=True)) == expected[::-1]
+
+@parametrized_b
+def test_irange_open_ended(b, sorted_control):
+    s = BPlusSortedSet(sorted_control, b=b)
+
+    assert list(s.irange()) == sorted_control
+    for x in get_bounds(sorted_control, num=10):
+        assert list(s.irange(lo=x)) == [y for y in sorted_control if y >= x]
+        assert list(s.irange(hi=x)) == [y for y in sorted_control if y <= x]
+
+@parametrized_b
+def test_bisect(b, sorted_control):
+    s = BPlusSortedSet(sorted_control, b=b)
+
+    for x in get_bounds(sorted_control):
+        assert s.bisect_left(x) == bisect.bisect_left(sorted_control, x)
+        assert s.bisect_right(x) == bisect.bisect_right(sorted_control, x)
+
+@parametrized_b
+def test_bisect_random_inserts(b):
+    """
+    Tests that bisect_left() and bisect_right() keep counting correctly as the
+    tree is split in every position by elements added in random order.
+    """
+    elements = list(set(get_randints(num=3000)))
+    random.shuffle(elements)
+    s = BPlusSortedSet(b=b)
+    control = []
+
+    for ix, x in enumerate(elements):
+        s.add(x)
+        bisect.insort(control, x)
+        if ix % 300 == 0:
+            for y in get_bounds(control, num=20):
+                assert s.bisect_left(y) == bisect.bisect_left(control, y)
+                assert s.bisect_right(y) == bisect.bisect_right(control, y)
+
+    # elements already in the tree change no counts
+    for x in control[::7]:
+        s.add(x)
+    assert [s.bisect_left(x) for x in control] == list(range(len(control)))
+    assert [s.bisect_right(x) for x in control] == list(range(1, len(control) + 1))
+
+@parametrized_b
+def test_floor_ceiling(b, sorted_control):
+    s = BPlusSortedSet(sorted_control, b=b)
+
+    for x in get_bounds(sorted_control) + [-1, sorted_control[-1] + 1]:
+        ix = bisect.bisect_right(sorted_control, x)
+        assert s.floor(x) == (sorted_control[ix-1] if ix > 0 else None)
+        ix = bisect.bisect_left(sorted_control, x)
+        assert s.ceiling(x) == (sorted_control[ix] if ix < len(sorted_control) else None)
+
+@parametrized_b
+def test_irange_key(b):
+    """
+    Tests that the bounds of irange() are elements, which are mapped through
+    the key function like the elements of the set.
+    """
+    s = BPlusSortedSet(["a", "bb", "ccc", "dddd"], key=len, b=b)
+
+    assert list(s.irange("xx", "yyy")) == ["bb", "ccc"]
+    assert s.floor("zzzzzz") == "dddd"
+    assert s.ceiling("") == "a"